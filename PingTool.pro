@@ -1,40 +1,87 @@
-QT       += core gui widgets network sql charts
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-DEFINES += NOMINMAX
-
-CONFIG += c++17
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    src/main.cpp \
-    src/MainWindow.cpp \
-    src/PingWorker.cpp \
-    src/PingManager.cpp \
-    src/PingModel.cpp \
-    src/PingLogModel.cpp \
-    src/DatabaseThread.cpp \
-    src/ChartWindow.cpp
-
-HEADERS += \
-    src/MainWindow.h \
-    src/PingWorker.h \
-    src/PingManager.h \
-    src/PingModel.h \
-    src/PingLogModel.h \
-    src/DatabaseThread.h \
-    src/ChartWindow.h
-
-# Windows specific libraries for ICMP
-win32 {
-    LIBS += -lws2_32 -liphlpapi
-}
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+QT       += core gui widgets network sql charts
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+DEFINES += NOMINMAX
+
+CONFIG += c++17
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+    src/main.cpp \
+    src/MainWindow.cpp \
+    src/PingManager.cpp \
+    src/DnsResolver.cpp \
+    src/ProbeTarget.cpp \
+    src/ProbeAddress.cpp \
+    src/ProbePolicy.cpp \
+    src/SendBudget.cpp \
+    src/ResultRing.cpp \
+    src/TargetRegistry.cpp \
+    src/ProbeBackend.cpp \
+    src/SimulatedProbeBackend.cpp \
+    src/TimingWheel.cpp \
+    src/PingModel.cpp \
+    src/PingLogModel.cpp \
+    src/DatabaseThread.cpp \
+    src/LogSchema.cpp \
+    src/LogPartitions.cpp \
+    src/Rollups.cpp \
+    src/LatencySketch.cpp \
+    src/ColumnStore.cpp \
+    src/ChartDecimator.cpp \
+    src/ChartHistory.cpp \
+    src/ChartQueryService.cpp \
+    src/ChartTileCache.cpp \
+    src/ChartWindow.cpp \
+    src/LiveWindow.cpp
+
+HEADERS += \
+    src/MainWindow.h \
+    src/PingManager.h \
+    src/DnsResolver.h \
+    src/ProbeTarget.h \
+    src/ProbeAddress.h \
+    src/ProbePolicy.h \
+    src/SendBudget.h \
+    src/ResultRing.h \
+    src/TargetRegistry.h \
+    src/ProbeBackend.h \
+    src/SimulatedProbeBackend.h \
+    src/TimingWheel.h \
+    src/PingModel.h \
+    src/PingLogModel.h \
+    src/DatabaseThread.h \
+    src/LogSchema.h \
+    src/LogPartitions.h \
+    src/Rollups.h \
+    src/LatencySketch.h \
+    src/Varint.h \
+    src/ColumnStore.h \
+    src/ChartDecimator.h \
+    src/ChartHistory.h \
+    src/ChartQueryService.h \
+    src/ChartTileCache.h \
+    src/ChartWindow.h \
+    src/LiveWindow.h
+
+# Windows specific libraries for ICMP
+win32 {
+    SOURCES += src/PingWorker.cpp src/NativeProbeBackend.cpp
+    HEADERS += src/PingWorker.h src/NativeProbeBackend.h
+    LIBS += -lws2_32 -liphlpapi
+}
+
+# Linux epoll based ICMP engine
+linux {
+    SOURCES += src/IcmpEngine.cpp src/SocketProbeBackend.cpp
+    HEADERS += src/IcmpEngine.h src/SocketProbeBackend.h
+}
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
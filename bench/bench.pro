@@ -0,0 +1,16 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    timingwheel \
+    resultring \
+    dbflush \
+    dbingest \
+    dbrange \
+    colstore \
+    decimate \
+    pipeline
+
+linux {
+    SUBDIRS += icmpthroughput \
+        loopback
+}
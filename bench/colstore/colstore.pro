@@ -0,0 +1,23 @@
+QT       -= gui
+QT       += core sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = colstore_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/ColumnStore.cpp \
+    ../../src/LatencySketch.cpp \
+    ../../src/LogSchema.cpp \
+    ../../src/Rollups.cpp
+
+HEADERS += \
+    ../../src/ColumnStore.h \
+    ../../src/LatencySketch.h \
+    ../../src/LogSchema.h \
+    ../../src/Rollups.h \
+    ../../src/Varint.h
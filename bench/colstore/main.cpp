@@ -0,0 +1,204 @@
+// Column store benchmark: the same probe history kept in ping_log and in a
+// ColumnStore, compared by size on disk and by how fast one target's time
+// window reads back.
+//
+// Rows are generated in arrival order, one probe per second for every
+// target, with RTTs spread over 1-5 ms and one probe in 97 timing out.
+// Both sides get identical rows; ping_log is checkpointed before it is
+// measured, and the store is sealed. The same random windows are then read
+// from both, every column of every row, and the ratios printed.
+//
+// Usage: colstore_bench [rows=10000000] [targets=1000] [window=3600 s] [queries=200]
+
+#include "ColumnStore.h"
+#include "LogSchema.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const qint64 T0 = 1700000000000LL;
+
+struct Window {
+    int target;
+    qint64 start;
+    qint64 end;
+};
+
+QString targetName(int target)
+{
+    return QString("10.0.%1.%2").arg(target / 256).arg(target % 256);
+}
+
+// Row i's RTT, the same formula as the SQL below
+qint64 rttOf(qint64 i)
+{
+    return i % 97 == 0 ? -1 : 1000000 + (i * 2654435761LL) % 4000000;
+}
+
+bool populateLog(QSqlDatabase &db, qint64 rows, int targets)
+{
+    QSqlQuery query(db);
+    query.exec(QString("WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < %1) "
+                       "INSERT INTO targets (id, name) SELECT i + 1, '10.0.' || (i / 256) || '.' || (i % 256) FROM n").arg(targets - 1));
+    if (!query.exec(QString("WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < %1 - 1), "
+                            "r(i, rtt_ns) AS (SELECT i, CASE WHEN i % 97 = 0 THEN -1 ELSE 1000000 + (i * 2654435761) % 4000000 END FROM n) "
+                            "INSERT INTO ping_log (target_id, start_time, seq, return_time, rtt, rtt_ns, ttl, timeout_val) "
+                            "SELECT i % %2 + 1, %3 + (i / %2) * 1000, i / %2, "
+                            "%3 + (i / %2) * 1000 + CASE WHEN rtt_ns < 0 THEN 1000 ELSE rtt_ns / 1000000 END, "
+                            "CASE WHEN rtt_ns < 0 THEN -1 ELSE (rtt_ns + 500000) / 1000000 END, rtt_ns, 64, 1000 FROM r")
+                        .arg(rows).arg(targets).arg(T0))) {
+        std::fprintf(stderr, "populate: %s\n", qPrintable(query.lastError().text()));
+        return false;
+    }
+    query.exec("PRAGMA wal_checkpoint(TRUNCATE)");
+    return true;
+}
+
+void populateStore(ColumnStoreWriter &writer, qint64 rows, int targets)
+{
+    QVector<quint32> ids;
+    for (int t = 0; t < targets; ++t) {
+        ids << writer.targetId(targetName(t));
+    }
+    for (qint64 i = 0; i < rows; ++i) {
+        ColumnSample sample;
+        sample.rttNs = rttOf(i);
+        sample.startTime = T0 + (i / targets) * 1000;
+        sample.returnTime = sample.startTime + (sample.rttNs < 0 ? 1000 : sample.rttNs / 1000000);
+        sample.ttl = 64;
+        sample.seq = qint32(i / targets);
+        sample.timeoutMs = 1000;
+        writer.append(ids.at(int(i % targets)), sample);
+    }
+    writer.sealAll();
+}
+
+void report(const char *name, double totalMs, double maxMs, long long rows, int queries)
+{
+    std::printf("%-7s %10.3f %10.3f %12lld\n", name, totalMs / queries, maxMs, rows);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qint64 rows = argc > 1 ? atoll(argv[1]) : 10000000;
+    int targets = argc > 2 ? atoi(argv[2]) : 1000;
+    int window = argc > 3 ? atoi(argv[3]) : 3600;
+    int queries = argc > 4 ? atoi(argv[4]) : 200;
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "no temporary directory\n");
+        return 1;
+    }
+    std::printf("%lld rows, %d targets, %d s windows, %d queries\n", rows, targets, window, queries);
+
+    qint64 seconds = qMax<qint64>(1, rows / targets);
+    QVector<Window> windows;
+    for (int i = 0; i < queries; ++i) {
+        Window w;
+        w.target = QRandomGenerator::global()->bounded(targets);
+        w.start = T0 + QRandomGenerator::global()->bounded(int(qMax<qint64>(1, seconds - window))) * 1000LL;
+        w.end = w.start + qint64(window) * 1000;
+        windows << w;
+    }
+
+    double sqliteMs = 0;
+    double sqliteMaxMs = 0;
+    long long sqliteRows = 0;
+    qint64 sqliteBytes = 0;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "colstore");
+        db.setDatabaseName(dir.filePath("log.db"));
+        if (!db.open()) {
+            std::fprintf(stderr, "open: %s\n", qPrintable(db.lastError().text()));
+            return 1;
+        }
+        QSqlQuery query(db);
+        query.exec("PRAGMA journal_mode=WAL");
+        query.exec("PRAGMA synchronous=NORMAL");
+        LogSchema::upgrade(db);
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!populateLog(db, rows, targets)) {
+            return 1;
+        }
+        std::printf("ping_log populated in %.1f s\n", timer.nsecsElapsed() / 1e9);
+        sqliteBytes = QFileInfo(dir.filePath("log.db")).size();
+
+        query.setForwardOnly(true);
+        query.prepare("SELECT start_time, return_time, rtt_ns, ttl, seq, timeout_val FROM ping_log "
+                      "WHERE target_id = :target AND start_time BETWEEN :start AND :end ORDER BY start_time");
+        for (const Window &w : windows) {
+            timer.restart();
+            query.bindValue(":target", w.target + 1);
+            query.bindValue(":start", w.start);
+            query.bindValue(":end", w.end);
+            if (!query.exec()) {
+                std::fprintf(stderr, "query: %s\n", qPrintable(query.lastError().text()));
+                return 1;
+            }
+            while (query.next()) {
+                ++sqliteRows;
+            }
+            double ms = timer.nsecsElapsed() / 1e6;
+            sqliteMs += ms;
+            sqliteMaxMs = qMax(sqliteMaxMs, ms);
+        }
+        query = QSqlQuery();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("colstore");
+
+    double storeMs = 0;
+    double storeMaxMs = 0;
+    long long storeRows = 0;
+    qint64 storeBytes = 0;
+    {
+        QString path = dir.filePath("log.cols");
+        QElapsedTimer timer;
+        timer.start();
+        {
+            ColumnStoreWriter writer(path);
+            if (!writer.open()) {
+                return 1;
+            }
+            populateStore(writer, rows, targets);
+            storeBytes = writer.bytesWritten();
+        }
+        std::printf("column store populated in %.1f s\n", timer.nsecsElapsed() / 1e9);
+
+        ColumnStoreReader reader(path);
+        reader.refresh();
+        for (const Window &w : windows) {
+            timer.restart();
+            storeRows += reader.scan(targetName(w.target), w.start, w.end).size();
+            double ms = timer.nsecsElapsed() / 1e6;
+            storeMs += ms;
+            storeMaxMs = qMax(storeMaxMs, ms);
+        }
+    }
+
+    std::printf("%-7s %10s %10s %12s\n", "", "avg ms", "max ms", "rows");
+    report("sqlite", sqliteMs, sqliteMaxMs, sqliteRows, queries);
+    report("columns", storeMs, storeMaxMs, storeRows, queries);
+    std::printf("size: ping_log %.1f MB (%.1f B/row), store %.1f MB (%.1f B/row), %.1fx smaller\n",
+                sqliteBytes / 1e6, double(sqliteBytes) / rows, storeBytes / 1e6, double(storeBytes) / rows,
+                double(sqliteBytes) / qMax<qint64>(1, storeBytes));
+    std::printf("query: %.1fx faster\n", sqliteMs / qMax(0.001, storeMs));
+    return 0;
+}
@@ -0,0 +1,33 @@
+QT       -= gui
+QT       += core network sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = dbflush_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/ColumnStore.cpp \
+    ../../src/DatabaseThread.cpp \
+    ../../src/LatencySketch.cpp \
+    ../../src/LogPartitions.cpp \
+    ../../src/LogSchema.cpp \
+    ../../src/ProbeTarget.cpp \
+    ../../src/ResultRing.cpp \
+    ../../src/Rollups.cpp \
+    ../../src/TargetRegistry.cpp
+
+HEADERS += \
+    ../../src/ColumnStore.h \
+    ../../src/DatabaseThread.h \
+    ../../src/LatencySketch.h \
+    ../../src/LogPartitions.h \
+    ../../src/LogSchema.h \
+    ../../src/ProbeTarget.h \
+    ../../src/ResultRing.h \
+    ../../src/Rollups.h \
+    ../../src/TargetRegistry.h \
+    ../../src/Varint.h
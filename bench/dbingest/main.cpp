@@ -0,0 +1,237 @@
+// Database ingestion benchmark: rows/s of three ways to insert probe results.
+//
+//   per-row  the loop DatabaseThread used to run: the statement prepared
+//            again for every batch, named parameters, a QDateTime for the
+//            timestamp column and the probe type string on every row, one
+//            exec() per row
+//   batch    one cached statement run with execBatch() over bound arrays,
+//            one list per column, into the current table layout
+//   thread   DatabaseThread itself: cached multi-row statements binding
+//            numbers only, fed through a ResultRing
+//
+// All three commit every 500 rows and write the same results to fresh files
+// in WAL mode.
+//
+// Usage: dbingest_bench [rows=500000] [targets=1000]
+
+#include "DatabaseThread.h"
+#include "ProbeTarget.h"
+#include "ResultRing.h"
+#include "TargetRegistry.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVariantList>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+const int COMMIT_ROWS = 500;
+
+QVector<ProbeResult> makeResults(int rows, int targets)
+{
+    QVector<ProbeResult> results(rows);
+    qint64 now = 1700000000000LL;
+    for (int i = 0; i < rows; ++i) {
+        ProbeResult &r = results[i];
+        r.targetId = quint32(i % targets);
+        r.ttl = 64;
+        r.seq = i / targets;
+        r.timeoutMs = 1000;
+        r.rttNs = (i % 50 == 0) ? -1 : 1000000 + (i % 9000) * 1000;
+        r.startTime = now + i / 1000;
+        r.returnTime = r.startTime + 1;
+    }
+    return results;
+}
+
+QSqlDatabase openDatabase(const QString &name, const QString &path)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(path);
+    if (!db.open()) {
+        std::fprintf(stderr, "open %s: %s\n", qPrintable(path), qPrintable(db.lastError().text()));
+        return db;
+    }
+    QSqlQuery query(db);
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA synchronous=NORMAL");
+    return db;
+}
+
+double benchPerRow(const QString &path, const QVector<ProbeResult> &results, const QStringList &names)
+{
+    double seconds = 0;
+    {
+        QSqlDatabase db = openDatabase("perrow", path);
+        QSqlQuery query(db);
+        query.exec("CREATE TABLE ping_log (id INTEGER PRIMARY KEY AUTOINCREMENT, timestamp DATETIME, target TEXT, "
+                   "rtt INTEGER, ttl INTEGER, seq INTEGER, start_time INTEGER, return_time INTEGER, "
+                   "timeout_val INTEGER, rtt_ns INTEGER, probe_type TEXT, target_id INTEGER)");
+        query.exec("CREATE INDEX idx_ping_log_target_id ON ping_log (target_id, timestamp)");
+
+        QElapsedTimer timer;
+        timer.start();
+        db.transaction();
+        int pending = 0;
+        for (int first = 0; first < results.size(); first += 4096) {
+            QSqlQuery insertQuery(db);
+            insertQuery.prepare("INSERT INTO ping_log (timestamp, target_id, probe_type, rtt, rtt_ns, ttl, seq, start_time, return_time, timeout_val) "
+                                "VALUES (:ts, :target, :type, :rtt, :rttns, :ttl, :seq, :start, :ret, :tmo)");
+            int last = qMin(first + 4096, int(results.size()));
+            for (int i = first; i < last; ++i) {
+                const ProbeResult &entry = results.at(i);
+                const QString &name = names.at(int(entry.targetId));
+                insertQuery.bindValue(":ts", QDateTime::fromMSecsSinceEpoch(entry.returnTime));
+                insertQuery.bindValue(":target", qint64(entry.targetId) + 1);
+                insertQuery.bindValue(":type", QString::fromLatin1(ProbeTarget::typeName(ProbeTarget::typeOf(name))));
+                insertQuery.bindValue(":rtt", entry.rttNs >= 0 ? (entry.rttNs + 500000) / 1000000 : entry.rttNs);
+                insertQuery.bindValue(":rttns", entry.rttNs);
+                insertQuery.bindValue(":ttl", entry.ttl);
+                insertQuery.bindValue(":seq", entry.seq);
+                insertQuery.bindValue(":start", entry.startTime);
+                insertQuery.bindValue(":ret", entry.returnTime);
+                insertQuery.bindValue(":tmo", entry.timeoutMs);
+                insertQuery.exec();
+                if (++pending >= COMMIT_ROWS) {
+                    db.commit();
+                    db.transaction();
+                    pending = 0;
+                }
+            }
+        }
+        db.commit();
+        seconds = timer.nsecsElapsed() / 1e9;
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("perrow");
+    return seconds;
+}
+
+double benchExecBatch(const QString &path, const QVector<ProbeResult> &results)
+{
+    double seconds = 0;
+    {
+        QSqlDatabase db = openDatabase("batch", path);
+        QSqlQuery query(db);
+        query.exec("CREATE TABLE ping_log (target_id INTEGER NOT NULL, start_time INTEGER NOT NULL, "
+                   "seq INTEGER NOT NULL, return_time INTEGER, rtt INTEGER, rtt_ns INTEGER, ttl INTEGER, "
+                   "timeout_val INTEGER, PRIMARY KEY (target_id, start_time, seq)) WITHOUT ROWID");
+
+        QElapsedTimer timer;
+        timer.start();
+        QSqlQuery insertQuery(db);
+        insertQuery.prepare("INSERT OR IGNORE INTO ping_log (target_id, start_time, seq, return_time, rtt, rtt_ns, ttl, timeout_val) "
+                            "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+        for (int first = 0; first < results.size(); first += COMMIT_ROWS) {
+            int last = qMin(first + COMMIT_ROWS, int(results.size()));
+            QVariantList columns[8];
+            for (int i = first; i < last; ++i) {
+                const ProbeResult &entry = results.at(i);
+                columns[0] << qint64(entry.targetId) + 1;
+                columns[1] << entry.startTime;
+                columns[2] << entry.seq;
+                columns[3] << entry.returnTime;
+                columns[4] << (entry.rttNs >= 0 ? (entry.rttNs + 500000) / 1000000 : entry.rttNs);
+                columns[5] << entry.rttNs;
+                columns[6] << entry.ttl;
+                columns[7] << entry.timeoutMs;
+            }
+            db.transaction();
+            for (int c = 0; c < 8; ++c) {
+                insertQuery.addBindValue(columns[c]);
+            }
+            if (!insertQuery.execBatch()) {
+                std::fprintf(stderr, "execBatch: %s\n", qPrintable(insertQuery.lastError().text()));
+            }
+            db.commit();
+        }
+        seconds = timer.nsecsElapsed() / 1e9;
+        insertQuery = QSqlQuery();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("batch");
+    return seconds;
+}
+
+double benchThread(const QString &path, const QVector<ProbeResult> &results, const QStringList &names)
+{
+    TargetRegistry registry;
+    for (const QString &name : names) {
+        registry.intern(name);
+    }
+
+    ResultRing ring;
+    DatabaseThread db;
+    DatabaseThread::FlushPolicy policy;
+    policy.maxRows = COMMIT_ROWS;
+    policy.maxDelayMs = 1000;
+    db.setDatabasePath(path);
+    db.setFlushPolicy(policy);
+    db.setTargetRegistry(&registry);
+    db.setResultRing(&ring);
+    db.start();
+    // Let it create the schema before the clock starts
+    QThread::msleep(200);
+
+    QElapsedTimer timer;
+    timer.start();
+    // Stay within half a ring of the writer, backlog included, so nothing
+    // is overwritten
+    const quint64 limit = quint64(ring.capacity()) / 2;
+    for (const ProbeResult &r : results) {
+        while (ring.stats().maxLag + quint64(db.stats().backlog) > limit) {
+            QThread::usleep(100);
+        }
+        ring.push(r);
+    }
+    db.stop();
+    db.wait();
+    double seconds = timer.nsecsElapsed() / 1e9;
+
+    DatabaseThread::Stats stats = db.stats();
+    if (stats.rowsCommitted != results.size() || stats.lost != 0) {
+        std::fprintf(stderr, "thread: committed %lld of %d, lost %llu\n", stats.rowsCommitted,
+                     int(results.size()), static_cast<unsigned long long>(stats.lost));
+    }
+    return seconds;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int rows = argc > 1 ? atoi(argv[1]) : 500000;
+    int targets = argc > 2 ? atoi(argv[2]) : 1000;
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "no temporary directory\n");
+        return 1;
+    }
+
+    QStringList names;
+    for (int i = 0; i < targets; ++i) {
+        names << QString("10.%1.%2.%3").arg((i >> 16) & 0xff).arg((i >> 8) & 0xff).arg(i & 0xff);
+    }
+    QVector<ProbeResult> results = makeResults(rows, targets);
+
+    std::printf("%d rows, %d targets, commit every %d rows\n", rows, targets, COMMIT_ROWS);
+    double perRow = benchPerRow(dir.filePath("perrow.db"), results, names);
+    std::printf("per-row: %10.0f rows/s\n", rows / perRow);
+    double batch = benchExecBatch(dir.filePath("batch.db"), results);
+    std::printf("batch:   %10.0f rows/s  %5.1fx\n", rows / batch, perRow / batch);
+    double thread = benchThread(dir.filePath("thread.db"), results, names);
+    std::printf("thread:  %10.0f rows/s  %5.1fx\n", rows / thread, perRow / thread);
+    return 0;
+}
@@ -0,0 +1,21 @@
+QT       -= gui
+QT       += core sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = dbrange_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/LatencySketch.cpp \
+    ../../src/LogSchema.cpp \
+    ../../src/Rollups.cpp
+
+HEADERS += \
+    ../../src/LatencySketch.h \
+    ../../src/LogSchema.h \
+    ../../src/Rollups.h \
+    ../../src/Varint.h
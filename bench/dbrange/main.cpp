@@ -0,0 +1,164 @@
+// Database range query benchmark: one target's time window read from the
+// old ping_log layout and from the current one, and the online migration
+// between them.
+//
+//   old  rowid table with an index on (target_id, return_time), as schema 1
+//        left it; each matching row is a separate lookup into the table
+//   new  WITHOUT ROWID table clustered by (target_id, start_time); a window
+//        is one contiguous range of pages
+//
+// Rows are generated in arrival order, one probe per second for every
+// target, so a target's rows are spread across the whole file. The same
+// random windows are read from both layouts; in between, LogSchema upgrades
+// the file and moves every row in chunks, reporting rows/s and the longest
+// chunk, which is how long ingestion can be held up by it.
+//
+// Usage: dbrange_bench [rows=10000000] [targets=1000] [window=3600 s] [queries=200]
+
+#include "LogSchema.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const qint64 T0 = 1700000000000LL;
+const int MIGRATE_CHUNK = 5000;     // As DatabaseThread
+
+struct Window {
+    qint64 targetId;
+    qint64 start;
+    qint64 end;
+};
+
+void createLegacy(QSqlDatabase &db, qint64 rows, int targets)
+{
+    QSqlQuery query(db);
+    query.exec("CREATE TABLE targets (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE, probe_type TEXT)");
+    query.exec(QString("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < %1) "
+                       "INSERT INTO targets (id, name) SELECT i, '10.0.' || (i / 256) || '.' || (i % 256) FROM n").arg(targets));
+    query.exec("CREATE TABLE ping_log (id INTEGER PRIMARY KEY AUTOINCREMENT, target TEXT, rtt INTEGER, ttl INTEGER, "
+               "seq INTEGER, start_time INTEGER, return_time INTEGER, timeout_val INTEGER, rtt_ns INTEGER, "
+               "probe_type TEXT, target_id INTEGER)");
+    query.exec("CREATE INDEX idx_ping_log_target_time ON ping_log (target_id, return_time)");
+    if (!query.exec(QString("WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < %1 - 1) "
+                            "INSERT INTO ping_log (target_id, rtt, ttl, seq, start_time, return_time, timeout_val, rtt_ns) "
+                            "SELECT i % %2 + 1, 1 + i % 9, 64, i / %2, %3 + (i / %2) * 1000, %3 + (i / %2) * 1000 + 1 + i % 9, "
+                            "1000, (1 + i % 9) * 1000000 FROM n").arg(rows).arg(targets).arg(T0))) {
+        std::fprintf(stderr, "populate: %s\n", qPrintable(query.lastError().text()));
+    }
+    query.exec("PRAGMA user_version=1");
+}
+
+// Average and worst ms per window, and rows read in all.
+void runQueries(QSqlDatabase &db, const char *name, const QString &sql, const QVector<Window> &windows)
+{
+    QSqlQuery query(db);
+    query.prepare(sql);
+    double totalMs = 0;
+    double maxMs = 0;
+    long long rows = 0;
+    for (const Window &w : windows) {
+        QElapsedTimer timer;
+        timer.start();
+        query.bindValue(":target", w.targetId);
+        query.bindValue(":start", w.start);
+        query.bindValue(":end", w.end);
+        if (!query.exec()) {
+            std::fprintf(stderr, "%s: %s\n", name, qPrintable(query.lastError().text()));
+            return;
+        }
+        while (query.next()) {
+            ++rows;
+        }
+        double ms = timer.nsecsElapsed() / 1e6;
+        totalMs += ms;
+        maxMs = qMax(maxMs, ms);
+    }
+    std::printf("%-4s %10.3f %10.3f %12lld\n", name, totalMs / windows.size(), maxMs, rows);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qint64 rows = argc > 1 ? atoll(argv[1]) : 10000000;
+    int targets = argc > 2 ? atoi(argv[2]) : 1000;
+    int window = argc > 3 ? atoi(argv[3]) : 3600;
+    int queries = argc > 4 ? atoi(argv[4]) : 200;
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "no temporary directory\n");
+        return 1;
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "dbrange");
+        db.setDatabaseName(dir.filePath("range.db"));
+        if (!db.open()) {
+            std::fprintf(stderr, "open: %s\n", qPrintable(db.lastError().text()));
+            return 1;
+        }
+        QSqlQuery query(db);
+        query.exec("PRAGMA journal_mode=WAL");
+        query.exec("PRAGMA synchronous=NORMAL");
+
+        std::printf("%lld rows, %d targets, %d s windows, %d queries\n", rows, targets, window, queries);
+        QElapsedTimer timer;
+        timer.start();
+        createLegacy(db, rows, targets);
+        std::printf("populated in %.1f s\n", timer.nsecsElapsed() / 1e9);
+
+        qint64 seconds = qMax<qint64>(1, rows / targets);
+        QVector<Window> windows;
+        for (int i = 0; i < queries; ++i) {
+            Window w;
+            w.targetId = QRandomGenerator::global()->bounded(targets) + 1;
+            w.start = T0 + QRandomGenerator::global()->bounded(int(qMax<qint64>(1, seconds - window))) * 1000LL;
+            w.end = w.start + qint64(window) * 1000;
+            windows << w;
+        }
+
+        std::printf("%-4s %10s %10s %12s\n", "", "avg ms", "max ms", "rows");
+        runQueries(db, "old", "SELECT start_time, return_time, rtt, timeout_val, rtt_ns FROM ping_log "
+                              "WHERE target_id = :target AND return_time BETWEEN :start AND :end ORDER BY return_time", windows);
+
+        timer.restart();
+        LogSchema::upgrade(db);
+        double upgradeMs = timer.nsecsElapsed() / 1e6;
+        timer.restart();
+        double maxChunkMs = 0;
+        long long moved = 0;
+        while (true) {
+            QElapsedTimer chunkTimer;
+            chunkTimer.start();
+            db.transaction();
+            int n = LogSchema::migrateChunk(db, MIGRATE_CHUNK);
+            db.commit();
+            maxChunkMs = qMax(maxChunkMs, chunkTimer.nsecsElapsed() / 1e6);
+            if (n <= 0) break;
+            moved += n;
+        }
+        double migrateSeconds = timer.nsecsElapsed() / 1e9;
+
+        runQueries(db, "new", "SELECT start_time, return_time, rtt, timeout_val, rtt_ns FROM ping_log "
+                              "WHERE target_id = :target AND start_time BETWEEN :start AND :end ORDER BY start_time", windows);
+
+        std::printf("upgrade %.1f ms; migrated %lld rows in %.1f s (%.0f rows/s), longest chunk %.1f ms\n",
+                    upgradeMs, moved, migrateSeconds, moved / migrateSeconds, maxChunkMs);
+        query = QSqlQuery();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("dbrange");
+    return 0;
+}
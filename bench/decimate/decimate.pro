@@ -0,0 +1,16 @@
+QT       -= gui
+QT       += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = decimate_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/ChartDecimator.cpp
+
+HEADERS += \
+    ../../src/ChartDecimator.h
@@ -0,0 +1,123 @@
+// Chart decimation benchmark: how long ChartDecimator takes to turn a
+// large history into the points of one redraw, across zoom levels.
+//
+// One target probed every interval ms for a day by default, RTTs of 1-5 ms
+// with the odd spike and one probe in 1000 timing out, are added the way a
+// streamed query adds them. Views from the whole range down to a second
+// are then drawn at random positions, replies as a min/max envelope (or
+// LTTB) and timeouts as spikes, and the redraw times and point counts are
+// printed per zoom level, along with how many timeouts showed up against
+// how many were in view.
+//
+// Usage: decimate_bench [samples=1728000] [interval=50 ms] [pixels=1600] [redraws=200]
+
+#include "ChartDecimator.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const qint64 T0 = 1700000000000LL;
+
+struct Probe {
+    qint64 start;
+    qint64 end;
+    double value;
+    bool timeout;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int samples = argc > 1 ? atoi(argv[1]) : 1728000;
+    int interval = argc > 2 ? atoi(argv[2]) : 50;
+    int pixels = argc > 3 ? atoi(argv[3]) : 1600;
+    int redraws = argc > 4 ? atoi(argv[4]) : 200;
+    std::printf("%d samples every %d ms, %d pixels, %d redraws per zoom\n", samples, interval, pixels, redraws);
+
+    QVector<Probe> probes;
+    probes.reserve(samples);
+    QRandomGenerator random(1);
+    for (int i = 0; i < samples; ++i) {
+        Probe probe;
+        probe.start = T0 + qint64(i) * interval;
+        probe.timeout = random.bounded(1000) == 0;
+        probe.value = probe.timeout ? 1000 : 1 + random.bounded(4000) / 1000.0 + (random.bounded(10000) == 0 ? 200 : 0);
+        probe.end = probe.start + (probe.timeout ? 1000 : qint64(probe.value) + 1);
+        probes << probe;
+    }
+
+    QVector<Probe> lost;
+    for (const Probe &probe : probes) {
+        if (probe.timeout) lost << probe;
+    }
+
+    ChartDecimator replies;
+    ChartDecimator timeouts;
+    QElapsedTimer timer;
+    timer.start();
+    for (const Probe &probe : probes) {
+        (probe.timeout ? timeouts : replies).add(probe.start, probe.end, probe.value);
+    }
+    double maxAll = replies.maxIn(T0, probes.last().end);
+    std::printf("add: %.1f ms, %.1f ns/sample\n", timer.nsecsElapsed() / 1e6, double(timer.nsecsElapsed()) / samples);
+    std::printf("undecimated: %lld points\n", 4LL * samples);
+
+    const struct {
+        const char *name;
+        ChartDecimator::Style style;
+    } styles[] = { { "minmax", ChartDecimator::Envelope }, { "lttb", ChartDecimator::Lttb } };
+    for (const auto &style : styles) {
+        ChartDecimator::Style replyStyle = style.style;
+        std::printf("\n%-8s %10s %10s %10s %10s %12s %10s\n", style.name, "view s", "avg ms", "max ms", "points", "timeouts", "max kept");
+        qint64 total = probes.last().end - T0;
+        for (qint64 view = total; view >= 1000; view /= 10) {
+            double sumMs = 0;
+            double maxMs = 0;
+            qint64 points = 0;
+            qint64 shown = 0;
+            qint64 inView = 0;
+            int keptMax = 0;
+            for (int i = 0; i < redraws; ++i) {
+                qint64 from = T0 + (total > view ? random.bounded(total - view) : 0);
+                qint64 to = from + view;
+                timer.start();
+                QList<QPointF> replyPoints = replies.points(from, to, pixels, replyStyle);
+                QList<QPointF> timeoutPoints = timeouts.points(from, to, pixels, ChartDecimator::Spikes);
+                double ms = timer.nsecsElapsed() / 1e6;
+                sumMs += ms;
+                maxMs = qMax(maxMs, ms);
+                points += replyPoints.size() + timeoutPoints.size();
+
+                // Every column holding a timeout must show a spike, and
+                // the highest reply in view must be among the points
+                QVector<char> columns(pixels, 0);
+                for (const Probe &probe : lost) {
+                    if (probe.end >= from && probe.start <= to) {
+                        int column = qBound(0, int((qMax(probe.start, from) - from) * pixels / view), pixels - 1);
+                        if (!columns.at(column)) {
+                            columns[column] = true;
+                            ++inView;
+                        }
+                    }
+                }
+                shown += timeoutPoints.size() / 4;
+                double highest = replies.maxIn(from, to);
+                for (const QPointF &point : replyPoints) {
+                    if (point.y() >= highest) {
+                        ++keptMax;
+                        break;
+                    }
+                }
+            }
+            std::printf("%-8s %10lld %10.3f %10.3f %10lld %5lld/%-6lld %6d/%d\n", "", view / 1000, sumMs / redraws, maxMs,
+                        points / redraws, shown, inView, keptMax, redraws);
+        }
+    }
+    std::printf("\nhighest reply overall: %.3f ms\n", maxAll);
+    return 0;
+}
@@ -0,0 +1,32 @@
+QT       -= gui
+QT       += core network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = icmpthroughput_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/IcmpEngine.cpp \
+    ../../src/DnsResolver.cpp \
+    ../../src/ProbeTarget.cpp \
+    ../../src/ProbeAddress.cpp \
+    ../../src/ProbePolicy.cpp \
+    ../../src/SendBudget.cpp \
+    ../../src/ResultRing.cpp \
+    ../../src/TargetRegistry.cpp \
+    ../../src/TimingWheel.cpp
+
+HEADERS += \
+    ../../src/IcmpEngine.h \
+    ../../src/DnsResolver.h \
+    ../../src/ProbeTarget.h \
+    ../../src/ProbeAddress.h \
+    ../../src/ProbePolicy.h \
+    ../../src/SendBudget.h \
+    ../../src/ResultRing.h \
+    ../../src/TargetRegistry.h \
+    ../../src/TimingWheel.h
@@ -0,0 +1,118 @@
+// Loopback check for IcmpEngine over both address families.
+//
+// Pings 127.0.0.1 and ::1 side by side for a few seconds and checks every
+// result: it must carry the id of one of the two targets, be a reply, and
+// have an RTT of at least 0 and under the timeout, a TTL / hop limit and a
+// return time no earlier than its start. Each target must get at least
+// minReplies replies. Prints what failed and exits 1 on any failure, so it
+// can gate a build. Needs net.ipv4.ping_group_range to include the current
+// group, or root, and an IPv6 loopback.
+//
+// Usage: loopback_check [seconds=3] [minReplies=10]
+
+#include "IcmpEngine.h"
+#include "ResultRing.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const quint32 V4_ID = 1;
+const quint32 V6_ID = 2;
+const uint32_t TIMEOUT_MS = 1000;
+const int MAX_REPORTED = 10;    // Failures printed per kind
+
+struct Tally {
+    const char *name;
+    int replies = 0;
+    int failures = 0;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    int minReplies = argc > 2 ? atoi(argv[2]) : 10;
+
+    ResultRing ring;
+    int reader = ring.addReader();
+    QVector<ProbeResult> batch(4096);
+
+    ProbePolicy policy;
+    policy.intervalMs = 50;
+
+    IcmpEngine engine;
+    engine.setResultRing(&ring);
+    engine.start();
+    engine.addTarget(V4_ID, "127.0.0.1", TIMEOUT_MS, policy);
+    engine.addTarget(V6_ID, "::1", TIMEOUT_MS, policy);
+
+    Tally v4;
+    v4.name = "127.0.0.1";
+    Tally v6;
+    v6.name = "::1";
+    int strays = 0;
+
+    auto fail = [](Tally &tally, const ProbeResult &r, const char *what) {
+        if (++tally.failures <= MAX_REPORTED) {
+            std::printf("FAIL %s: %s (rtt %lld ns, ttl %d, start %lld, return %lld)\n", tally.name, what,
+                        static_cast<long long>(r.rttNs), r.ttl,
+                        static_cast<long long>(r.startTime), static_cast<long long>(r.returnTime));
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < seconds * 1000) {
+        int count = ring.read(reader, batch.data(), batch.size());
+        for (int i = 0; i < count; ++i) {
+            const ProbeResult &r = batch.at(i);
+            Tally *tally = r.targetId == V4_ID ? &v4 : r.targetId == V6_ID ? &v6 : nullptr;
+            if (!tally) {
+                if (++strays <= MAX_REPORTED) {
+                    std::printf("FAIL result for unknown target id %u\n", r.targetId);
+                }
+                continue;
+            }
+            if (r.rttNs == -2) {
+                fail(*tally, r, "address not resolved");
+            } else if (r.rttNs < 0) {
+                fail(*tally, r, "no reply");
+            } else if (r.rttNs >= qint64(TIMEOUT_MS) * 1000000) {
+                fail(*tally, r, "RTT over the timeout");
+            } else if (r.ttl <= 0) {
+                fail(*tally, r, "no TTL / hop limit");
+            } else if (r.returnTime < r.startTime) {
+                fail(*tally, r, "returned before it started");
+            } else {
+                tally->replies++;
+            }
+        }
+        if (count < batch.size()) QThread::msleep(5);
+    }
+
+    engine.stop();
+    engine.wait();
+
+    bool ok = strays == 0 && ring.overflowed(reader) == 0;
+    for (const Tally *tally : { &v4, &v6 }) {
+        std::printf("%-10s %d replies, %d failed\n", tally->name, tally->replies, tally->failures);
+        if (tally->failures > 0) ok = false;
+        if (tally->replies < minReplies) {
+            std::printf("FAIL %s: fewer than %d replies\n", tally->name, minReplies);
+            ok = false;
+        }
+    }
+    if (ring.overflowed(reader) > 0) {
+        std::printf("FAIL %llu results lost to ring overflow\n", static_cast<unsigned long long>(ring.overflowed(reader)));
+    }
+    std::printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+QT       += core gui widgets network sql charts
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = pipeline_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/PingManager.cpp \
+    ../../src/DnsResolver.cpp \
+    ../../src/ProbeTarget.cpp \
+    ../../src/ProbeAddress.cpp \
+    ../../src/ProbePolicy.cpp \
+    ../../src/SendBudget.cpp \
+    ../../src/ResultRing.cpp \
+    ../../src/TargetRegistry.cpp \
+    ../../src/ProbeBackend.cpp \
+    ../../src/SimulatedProbeBackend.cpp \
+    ../../src/TimingWheel.cpp \
+    ../../src/PingModel.cpp \
+    ../../src/PingLogModel.cpp \
+    ../../src/DatabaseThread.cpp \
+    ../../src/LogSchema.cpp \
+    ../../src/LogPartitions.cpp \
+    ../../src/Rollups.cpp \
+    ../../src/LatencySketch.cpp \
+    ../../src/ColumnStore.cpp \
+    ../../src/ChartDecimator.cpp \
+    ../../src/ChartHistory.cpp \
+    ../../src/ChartQueryService.cpp \
+    ../../src/ChartTileCache.cpp \
+    ../../src/ChartWindow.cpp \
+    ../../src/LiveWindow.cpp
+
+HEADERS += \
+    ../../src/PingManager.h \
+    ../../src/DnsResolver.h \
+    ../../src/ProbeTarget.h \
+    ../../src/ProbeAddress.h \
+    ../../src/ProbePolicy.h \
+    ../../src/SendBudget.h \
+    ../../src/ResultRing.h \
+    ../../src/TargetRegistry.h \
+    ../../src/ProbeBackend.h \
+    ../../src/SimulatedProbeBackend.h \
+    ../../src/TimingWheel.h \
+    ../../src/PingModel.h \
+    ../../src/PingLogModel.h \
+    ../../src/DatabaseThread.h \
+    ../../src/LogSchema.h \
+    ../../src/LogPartitions.h \
+    ../../src/Rollups.h \
+    ../../src/LatencySketch.h \
+    ../../src/Varint.h \
+    ../../src/ColumnStore.h \
+    ../../src/ChartDecimator.h \
+    ../../src/ChartHistory.h \
+    ../../src/ChartQueryService.h \
+    ../../src/ChartTileCache.h \
+    ../../src/ChartWindow.h \
+    ../../src/LiveWindow.h
+
+win32 {
+    SOURCES += ../../src/PingWorker.cpp ../../src/NativeProbeBackend.cpp
+    HEADERS += ../../src/PingWorker.h ../../src/NativeProbeBackend.h
+    LIBS += -lws2_32 -liphlpapi
+}
+
+linux {
+    SOURCES += ../../src/IcmpEngine.cpp ../../src/SocketProbeBackend.cpp
+    HEADERS += ../../src/IcmpEngine.h ../../src/SocketProbeBackend.h
+}
@@ -0,0 +1,195 @@
+// Micro-benchmark: ResultRing vs a mutex-protected QList queue.
+//
+// P producer threads publish results as fast as they can while R reader
+// threads drain them in batches, the way the backends, the GUI, the
+// database and the chart windows share results. The baseline is the queue
+// DatabaseThread used to keep: one lock and append per result, swapped out
+// by the consumer. For the ring it also checks that every reader sees each
+// producer's results in order and intact, and that lost results are all
+// accounted for.
+//
+// Usage: resultring_bench [producers=4] [readers=3] [perProducer=2000000] [capacity=131072]
+
+#include "ResultRing.h"
+#include <QtGlobal>
+#include <QList>
+#include <QMutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+ProbeResult makeResult(int producer, int seq)
+{
+    ProbeResult r;
+    r.targetId = quint32(producer);
+    r.ttl = 64;
+    r.seq = seq;
+    r.timeoutMs = 1000;
+    r.rttNs = 1000000 + seq;
+    r.startTime = seq;
+    r.returnTime = seq + 1;
+    return r;
+}
+
+struct ReaderResult {
+    quint64 read = 0;
+    quint64 lost = 0;
+    quint64 outOfOrder = 0;
+    quint64 torn = 0;         // Fields from different results
+};
+
+void benchRing(int producers, int readers, int perProducer, int capacity)
+{
+    ResultRing ring(capacity);
+    std::vector<int> ids;
+    for (int i = 0; i < readers; ++i) {
+        ids.push_back(ring.addReader());
+    }
+
+    std::atomic<int> producing(producers);
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            std::vector<ProbeResult> batch(4096);
+            std::vector<int> lastSeq(producers, 0);
+            ReaderResult &out = results[r];
+            while (true) {
+                bool done = producing.load() == 0;
+                int count = ring.read(ids[r], batch.data(), int(batch.size()));
+                for (int i = 0; i < count; ++i) {
+                    const ProbeResult &p = batch[i];
+                    if (p.rttNs != 1000000 + p.seq || p.returnTime != p.seq + 1) out.torn++;
+                    if (p.seq <= lastSeq[p.targetId]) out.outOfOrder++;
+                    lastSeq[p.targetId] = p.seq;
+                }
+                out.read += quint64(count);
+                if (count == 0) {
+                    if (done) break;
+                    std::this_thread::yield();
+                }
+            }
+            out.lost = ring.overflowed(ids[r]);
+        });
+    }
+
+    std::vector<double> pushSeconds(producers);
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            Clock::time_point t0 = Clock::now();
+            for (int i = 1; i <= perProducer; ++i) {
+                ring.push(makeResult(p, i));
+            }
+            pushSeconds[p] = secondsSince(t0);
+            producing--;
+        });
+    }
+
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    double elapsed = secondsSince(start);
+    quint64 total = quint64(producers) * perProducer;
+
+    double pushNs = 0;
+    for (double s : pushSeconds) {
+        pushNs += s * 1e9 / perProducer;
+    }
+    std::printf("ring:   %6.1f M results/s, push %5.1f ns/result (capacity %d)\n",
+                total / elapsed / 1e6, pushNs / producers, ring.capacity());
+    for (int r = 0; r < readers; ++r) {
+        const ReaderResult &out = results[r];
+        std::printf("  reader %d: read %llu lost %llu out of order %llu torn %llu%s\n", r,
+                    static_cast<unsigned long long>(out.read),
+                    static_cast<unsigned long long>(out.lost),
+                    static_cast<unsigned long long>(out.outOfOrder),
+                    static_cast<unsigned long long>(out.torn),
+                    out.read + out.lost == total ? "" : "  MISMATCH");
+    }
+}
+
+void benchQueue(int producers, int readers, int perProducer)
+{
+    // One queue per consumer, like one queued connection per receiver
+    std::vector<QList<ProbeResult>> queues(readers);
+    std::vector<QMutex *> mutexes;
+    for (int r = 0; r < readers; ++r) {
+        mutexes.push_back(new QMutex);
+    }
+
+    std::atomic<int> producing(producers);
+    std::vector<quint64> read(readers, 0);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            while (true) {
+                bool done = producing.load() == 0;
+                QList<ProbeResult> batch;
+                {
+                    QMutexLocker locker(mutexes[r]);
+                    batch.swap(queues[r]);
+                }
+                read[r] += quint64(batch.size());
+                if (batch.isEmpty()) {
+                    if (done) break;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 1; i <= perProducer; ++i) {
+                ProbeResult result = makeResult(p, i);
+                for (int r = 0; r < readers; ++r) {
+                    QMutexLocker locker(mutexes[r]);
+                    queues[r].append(result);
+                }
+            }
+            producing--;
+        });
+    }
+
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    double elapsed = secondsSince(start);
+    quint64 total = quint64(producers) * perProducer;
+    std::printf("queue:  %6.1f M results/s (%d locked appends per result)\n",
+                total / elapsed / 1e6, readers);
+    for (QMutex *m : mutexes) {
+        delete m;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int readers = argc > 2 ? atoi(argv[2]) : 3;
+    int perProducer = argc > 3 ? atoi(argv[3]) : 2000000;
+    int capacity = argc > 4 ? atoi(argv[4]) : int(ResultRing::DefaultCapacity);
+
+    std::printf("%d producers x %d results, %d readers\n", producers, perProducer, readers);
+    benchRing(producers, readers, perProducer, capacity);
+    benchQueue(producers, readers, perProducer);
+    return 0;
+}
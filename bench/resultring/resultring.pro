@@ -0,0 +1,16 @@
+QT       -= gui
+QT       += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = resultring_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/ResultRing.cpp
+
+HEADERS += \
+    ../../src/ResultRing.h
@@ -0,0 +1,143 @@
+// Micro-benchmark: TimingWheel vs std::priority_queue for probe scheduling.
+//
+// Models the IcmpEngine workload: every target has a send timer that re-arms
+// at a random interval, and each send arms a timeout timer that is usually
+// cancelled by a reply a few ms later. The heap baseline cancels lazily with
+// per-timer generation counters, which is how a heap scheduler has to do it.
+
+#include "TimingWheel.h"
+#include <QtGlobal>
+#include <chrono>
+#include <cstdio>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace {
+
+const qint64 SIM_MS = 10000;
+const int TIMEOUT_MS = 1000;
+
+struct Result {
+    double seconds;
+    quint64 ops;
+};
+
+class HeapScheduler
+{
+public:
+    explicit HeapScheduler(int timerCount)
+        : m_generation(timerCount, 0)
+        , m_expires(timerCount, -1)
+    {}
+
+    void schedule(int id, qint64 expires)
+    {
+        m_generation[id]++;
+        m_expires[id] = expires;
+        m_heap.push({expires, id, m_generation[id]});
+    }
+
+    void cancel(int id)
+    {
+        m_generation[id]++;
+        m_expires[id] = -1;
+    }
+
+    template <typename Callback>
+    void advance(qint64 now, Callback &&onExpire)
+    {
+        while (!m_heap.empty() && m_heap.top().expires <= now) {
+            Entry e = m_heap.top();
+            m_heap.pop();
+            if (e.generation != m_generation[e.id]) continue; // Cancelled
+            m_expires[e.id] = -1;
+            onExpire(e.id);
+        }
+    }
+
+private:
+    struct Entry {
+        qint64 expires;
+        int id;
+        quint32 generation;
+        bool operator<(const Entry &o) const { return expires > o.expires; }
+    };
+
+    std::priority_queue<Entry> m_heap;
+    std::vector<quint32> m_generation;
+    std::vector<qint64> m_expires;
+};
+
+template <typename Scheduler>
+Result runWorkload(Scheduler &sched, int targets, quint64 seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> interval(500, 1500);
+    std::uniform_int_distribution<int> rtt(0, 30);
+    std::uniform_int_distribution<int> loss(0, 99);
+
+    // Pending replies: (reply time, target), processed in time order.
+    std::vector<std::vector<int>> replies(SIM_MS + TIMEOUT_MS + 64);
+
+    quint64 ops = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int t = 0; t < targets; ++t) {
+        sched.schedule(t * 2, interval(rng) - 500); // Phase-spread first send
+        ops++;
+    }
+
+    for (qint64 now = 0; now < SIM_MS; ++now) {
+        for (int t : replies[now]) {
+            sched.cancel(t * 2 + 1);
+            sched.schedule(t * 2, now + interval(rng));
+            ops += 2;
+        }
+        sched.advance(now, [&](int id) {
+            int t = id / 2;
+            if (id & 1) {
+                // Timeout: schedule next send.
+                sched.schedule(t * 2, now + interval(rng));
+            } else {
+                // Send: arm the timeout and maybe a reply.
+                sched.schedule(t * 2 + 1, now + TIMEOUT_MS);
+                if (loss(rng) >= 2) {
+                    replies[now + 1 + rtt(rng)].push_back(t);
+                }
+            }
+            ops++;
+        });
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {seconds, ops};
+}
+
+} // namespace
+
+int main()
+{
+    std::printf("%-10s %-16s %12s %12s %10s\n", "timers", "scheduler", "ops", "ms", "ns/op");
+
+    for (int targets : {500, 5000, 50000}) {
+        int timers = targets * 2; // Send + timeout per target: 1k, 10k, 100k
+
+        TimingWheel wheel(0);
+        wheel.reserve(timers);
+        Result w = runWorkload(wheel, targets, 42);
+
+        HeapScheduler heap(timers);
+        Result h = runWorkload(heap, targets, 42);
+
+        std::printf("%-10d %-16s %12llu %12.1f %10.1f\n", timers, "TimingWheel",
+                    static_cast<unsigned long long>(w.ops), w.seconds * 1e3, w.seconds * 1e9 / w.ops);
+        std::printf("%-10d %-16s %12llu %12.1f %10.1f\n", timers, "priority_queue",
+                    static_cast<unsigned long long>(h.ops), h.seconds * 1e3, h.seconds * 1e9 / h.ops);
+
+        const TimingWheel::Stats &s = wheel.stats();
+        std::printf("%-10s wheel lag: avg %.3f ms, max %lld ms\n", "",
+                    s.avgLagMs(), static_cast<long long>(s.maxLagMs));
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+QT       -= gui
+QT       += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = timingwheel_bench
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/TimingWheel.cpp
+
+HEADERS += \
+    ../../src/TimingWheel.h
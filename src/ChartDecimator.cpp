@@ -0,0 +1,258 @@
+#include "ChartDecimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int BLOCKS_PER_PIXEL = 4;     // Fewest a level must have in view to be read
+const int MAX_SCAN = 4096;          // Blocks maxIn() reads at most, about
+
+bool startsBefore(qint64 time, const ChartDecimator::Span &span)
+{
+    return time < span.start;
+}
+
+} // namespace
+
+void ChartDecimator::clear()
+{
+    m_levels = QVector<QVector<Span>>(1);
+    m_maxLength = 0;
+    m_lastEnd = -1;
+    m_dirtyFrom = -1;
+}
+
+void ChartDecimator::add(qint64 start, qint64 end, double value)
+{
+    Span span = { start, end, float(value), float(value) };
+    QVector<Span> &spans = m_levels.first();
+    int at = spans.size();
+    if (!spans.isEmpty() && start < spans.last().start) {
+        // Live results arrive in the order they completed
+        at = std::upper_bound(spans.begin(), spans.end(), start, startsBefore) - spans.begin();
+        spans.insert(at, span);
+    } else {
+        spans.append(span);
+    }
+    m_maxLength = qMax(m_maxLength, end - start);
+    m_lastEnd = qMax(m_lastEnd, end);
+    m_dirtyFrom = m_dirtyFrom < 0 ? at : qMin(m_dirtyFrom, at);
+}
+
+qint64 ChartDecimator::firstStart() const
+{
+    return m_levels.first().isEmpty() ? -1 : m_levels.first().first().start;
+}
+
+double ChartDecimator::maxIn(qint64 from, qint64 to)
+{
+    update();
+    int level = 0;
+    int first, last;
+    range(level, from, to, &first, &last);
+    while (last - first > MAX_SCAN && level + 1 < m_levels.size()) {
+        range(++level, from, to, &first, &last);
+    }
+    double max = 0;
+    const QVector<Span> &blocks = m_levels.at(level);
+    for (int i = first; i < last; ++i) {
+        const Span &block = blocks.at(i);
+        if (block.end >= from) {
+            max = qMax(max, double(block.max));
+        }
+    }
+    return max;
+}
+
+QList<QPointF> ChartDecimator::points(qint64 from, qint64 to, int pixels, Style style)
+{
+    QList<QPointF> out;
+    if (count() == 0 || to <= from || pixels <= 0) return out;
+    update();
+
+    int first, last;
+    range(0, from, to, &first, &last);
+    if (last - first <= pixels) {
+        // 4 points: (Start, 0) -> (Start, Val) -> (End, Val) -> (End, 0)
+        const QVector<Span> &spans = m_levels.first();
+        out.reserve(4 * (last - first));
+        for (int i = first; i < last; ++i) {
+            const Span &span = spans.at(i);
+            out << QPointF(span.start, 0) << QPointF(span.start, span.max)
+                << QPointF(span.end, span.max) << QPointF(span.end, 0);
+        }
+        return out;
+    }
+
+    int level = 0;
+    while (level + 1 < m_levels.size()) {
+        int coarseFirst, coarseLast;
+        range(level + 1, from, to, &coarseFirst, &coarseLast);
+        if (coarseLast - coarseFirst < BLOCKS_PER_PIXEL * pixels) break;
+        ++level;
+        first = coarseFirst;
+        last = coarseLast;
+    }
+    const QVector<Span> &blocks = m_levels.at(level);
+
+    if (style == Lttb) {
+        QList<QPointF> maxima;
+        maxima.reserve(last - first);
+        for (int i = first; i < last; ++i) {
+            maxima << QPointF(blocks.at(i).start, blocks.at(i).max);
+        }
+        lttb(maxima, 2 * pixels, out);
+        return out;
+    }
+
+    // Blocks by the column they start in. A block whose spans start in more
+    // than one column, as one reaching across a gap in the data does, is
+    // read from the level below instead, down to single spans if need be
+    const double width = double(to - from) / pixels;
+    auto columnOf = [&](qint64 time) { return std::floor((time - from) / width); };
+    int column = -1;
+    float lo = 0;
+    float hi = 0;
+    qint64 start = 0;
+    qint64 end = 0;
+    auto flush = [&]() {
+        if (style == Envelope) {
+            double x = from + (column + 0.5) * width;
+            out << QPointF(x, lo) << QPointF(x, hi);
+        } else {
+            // Ends no later than the column does, so spikes never overlap
+            double x1 = qMax(double(start), qMin(double(end), from + (column + 1) * width));
+            out << QPointF(start, 0) << QPointF(start, hi) << QPointF(x1, hi) << QPointF(x1, 0);
+        }
+    };
+    auto take = [&](const Span &block) {
+        int c = qBound(0, int((block.start - from) / width), pixels - 1);
+        if (c != column) {
+            if (column >= 0) {
+                flush();
+                // Down to 0 across columns without any, as a step would
+                if (style == Envelope && c > column + 1) {
+                    out << QPointF(from + (column + 1) * width, 0) << QPointF(from + c * width, 0);
+                }
+            }
+            column = c;
+            lo = block.min;
+            hi = block.max;
+            start = qMax(block.start, from);
+            end = block.end;
+        } else {
+            lo = qMin(lo, block.min);
+            hi = qMax(hi, block.max);
+            end = qMax(end, block.end);
+        }
+    };
+    out.reserve(4 * pixels);
+    QVector<QPair<int, int>> pending;   // Level and block still to read, next last
+    for (int i = first; i < last; ++i) {
+        pending.append(qMakePair(level, i));
+        while (!pending.isEmpty()) {
+            const QPair<int, int> next = pending.takeLast();
+            const QVector<Span> &spans = m_levels.at(next.first);
+            const Span &block = spans.at(next.second);
+            if (block.end < from || block.start > to) continue;
+            if (next.first > 0) {
+                // Every span under the block starts by where the next block
+                // does
+                qint64 latest = next.second + 1 < spans.size() ? spans.at(next.second + 1).start
+                                                               : m_levels.first().last().start;
+                if (columnOf(latest) != columnOf(block.start)) {
+                    const int below = next.first - 1;
+                    int children = qMin(m_levels.at(below).size(), (next.second + 1) * FANOUT);
+                    for (int j = children - 1; j >= next.second * FANOUT; --j) {
+                        pending.append(qMakePair(below, j));
+                    }
+                    continue;
+                }
+            }
+            take(block);
+        }
+    }
+    if (column >= 0) {
+        flush();
+    }
+    return out;
+}
+
+void ChartDecimator::range(int level, qint64 from, qint64 to, int *first, int *last) const
+{
+    // By start; a span, or a block of them, that started before from may
+    // still reach into view
+    const QVector<Span> &blocks = m_levels.at(level);
+    *first = std::upper_bound(blocks.begin(), blocks.end(), from - m_maxLength - 1, startsBefore) - blocks.begin();
+    if (level > 0 && *first > 0) --*first;
+    *last = std::upper_bound(blocks.begin() + *first, blocks.end(), to, startsBefore) - blocks.begin();
+}
+
+void ChartDecimator::update()
+{
+    if (m_dirtyFrom < 0) return;
+    int index = m_dirtyFrom;
+    for (int level = 0; m_levels.at(level).size() > FANOUT; ++level) {
+        if (level + 1 == m_levels.size()) {
+            m_levels.append(QVector<Span>());
+        }
+        const QVector<Span> &below = m_levels.at(level);
+        QVector<Span> &above = m_levels[level + 1];
+        int from = index / FANOUT;
+        above.resize((below.size() + FANOUT - 1) / FANOUT);
+        for (int i = from; i < above.size(); ++i) {
+            int end = qMin(below.size(), (i + 1) * FANOUT);
+            Span block = below.at(i * FANOUT);
+            for (int j = i * FANOUT + 1; j < end; ++j) {
+                const Span &span = below.at(j);
+                block.end = qMax(block.end, span.end);
+                block.min = qMin(block.min, span.min);
+                block.max = qMax(block.max, span.max);
+            }
+            above[i] = block;
+        }
+        index = from;
+    }
+    m_dirtyFrom = -1;
+}
+
+void ChartDecimator::lttb(const QList<QPointF> &in, int threshold, QList<QPointF> &out)
+{
+    const int n = in.size();
+    if (threshold >= n || threshold < 3) {
+        out += in;
+        return;
+    }
+    // The first and last points stay; every bucket between them keeps the
+    // point making the largest triangle with the one kept before it and
+    // the average of the next bucket
+    const double every = double(n - 2) / (threshold - 2);
+    int kept = 0;
+    out.reserve(threshold);
+    out.append(in.first());
+    for (int i = 0; i < threshold - 2; ++i) {
+        int nextStart = qMin(int((i + 1) * every) + 1, n - 1);
+        int nextEnd = qBound(nextStart + 1, int((i + 2) * every) + 1, n);
+        double avgX = 0;
+        double avgY = 0;
+        for (int j = nextStart; j < nextEnd; ++j) {
+            avgX += in.at(j).x();
+            avgY += in.at(j).y();
+        }
+        avgX /= nextEnd - nextStart;
+        avgY /= nextEnd - nextStart;
+
+        const QPointF &a = in.at(kept);
+        int bucketEnd = qMin(int((i + 1) * every) + 1, n - 1);
+        double largest = -1;
+        for (int j = int(i * every) + 1; j < bucketEnd; ++j) {
+            double area = std::fabs((a.x() - avgX) * (in.at(j).y() - a.y()) - (a.x() - in.at(j).x()) * (avgY - a.y()));
+            if (area > largest) {
+                largest = area;
+                kept = j;
+            }
+        }
+        out.append(in.at(kept));
+    }
+    out.append(in.last());
+}
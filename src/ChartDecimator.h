@@ -0,0 +1,66 @@
+#ifndef CHARTDECIMATOR_H
+#define CHARTDECIMATOR_H
+
+#include <QList>
+#include <QPointF>
+#include <QVector>
+
+// Everything loaded into one chart series, cut down on every redraw to a
+// few points per pixel of whatever range is in view. The spans are kept in
+// start order with a pyramid of min/max blocks over them, each level
+// FANOUT times coarser than the one below; a redraw reads the coarsest
+// level that still has several blocks per pixel, so it costs about the
+// same whether the view holds a minute or a month. Blocks are grouped by
+// count, not time, so one whose spans start in different pixel columns
+// (across a gap in the data, say) is read from the finer levels instead.
+class ChartDecimator
+{
+public:
+    enum Style {
+        Envelope,   // Lowest and highest value of every pixel column
+        Lttb,       // Largest-triangle-three-buckets over the column maxima
+        Spikes      // A step up to the highest value of every column with any
+    };
+
+    // A probe or a bucket: value, in ms, from start to end.
+    struct Span {
+        qint64 start;
+        qint64 end;
+        float min;
+        float max;
+    };
+
+    enum { FANOUT = 16 };
+
+    void clear();
+    // Spans are expected about in start order; one that is not is
+    // inserted where it belongs.
+    void add(qint64 start, qint64 end, double value);
+
+    int count() const { return m_levels.first().size(); }
+    qint64 firstStart() const;      // -1 if empty
+    qint64 lastEnd() const { return m_lastEnd; }
+    // The highest value within [from, to], give or take the blocks at its
+    // edges once more than a few thousand spans are in range.
+    double maxIn(qint64 from, qint64 to);
+
+    // Points for a series showing [from, to] across pixels columns. While
+    // fewer spans than columns are in range each is drawn whole, as a step
+    // up from 0; otherwise as style says, every column that holds any
+    // span keeping its highest value.
+    QList<QPointF> points(qint64 from, qint64 to, int pixels, Style style);
+
+private:
+    // The blocks of level that may overlap [from, to].
+    void range(int level, qint64 from, qint64 to, int *first, int *last) const;
+    // Rebuilds the levels above 0 wherever spans were added.
+    void update();
+    static void lttb(const QList<QPointF> &in, int threshold, QList<QPointF> &out);
+
+    QVector<QVector<Span>> m_levels = QVector<QVector<Span>>(1);
+    qint64 m_maxLength = 0;         // Longest span; how far back one may reach into view
+    qint64 m_lastEnd = -1;
+    int m_dirtyFrom = -1;           // First span of level 0 not yet in the levels above
+};
+
+#endif // CHARTDECIMATOR_H
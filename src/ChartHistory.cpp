@@ -0,0 +1,238 @@
+#include "ChartHistory.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QSettings>
+#include <QTimer>
+#include <QVector>
+
+namespace {
+
+const int FEED_MS = 16;             // About a frame
+const int FEED_BATCH = 4096;
+const int LIVE_CAPACITY = 65536;    // Live samples kept at most
+const int DEFAULT_LIVE_MINUTES = 10;
+
+// How far back live results are kept: "chart/liveMinutes".
+qint64 liveSpanMs()
+{
+    QSettings settings("MyCompany", "PingTool");
+    return qMax(1, settings.value("chart/liveMinutes", DEFAULT_LIVE_MINUTES).toInt()) * 60 * 1000LL;
+}
+
+QHash<QString, ChartHistory *> &histories()
+{
+    static QHash<QString, ChartHistory *> byTarget;
+    return byTarget;
+}
+
+} // namespace
+
+struct ChartHistory::Feed
+{
+    ResultRing *ring;
+    int reader;
+    QTimer timer;
+    QVector<ProbeResult> buffer;
+    QHash<quint32, ChartHistory *> histories;   // By target id
+
+    explicit Feed(ResultRing *ring);
+    ~Feed();
+    void drain();
+
+    static QHash<ResultRing *, Feed *> &feeds();
+};
+
+ChartHistory::Feed::Feed(ResultRing *ring)
+    : ring(ring)
+    , reader(ring->addReader())
+    , buffer(FEED_BATCH)
+{
+    if (reader < 0) {
+        qWarning() << "Too many live result readers, charts show stored data only";
+        return;
+    }
+    QObject::connect(&timer, &QTimer::timeout, &timer, [this]() { drain(); });
+    timer.start(FEED_MS);
+}
+
+ChartHistory::Feed::~Feed()
+{
+    if (reader >= 0) {
+        ring->removeReader(reader);
+    }
+}
+
+QHash<ResultRing *, ChartHistory::Feed *> &ChartHistory::Feed::feeds()
+{
+    static QHash<ResultRing *, Feed *> byRing;
+    return byRing;
+}
+
+void ChartHistory::Feed::drain()
+{
+    // One pass over the ring for every target followed; each result goes to
+    // its own target's history or nowhere
+    int total = 0;
+    int count;
+    do {
+        count = ring->read(reader, buffer.data(), buffer.size());
+        for (int i = 0; i < count; ++i) {
+            ChartHistory *history = histories.value(buffer.at(i).targetId);
+            if (history) {
+                history->append(buffer.at(i));
+            }
+        }
+        total += count;
+    } while (count == buffer.size() && total < ring->capacity());
+
+    for (ChartHistory *history : histories) {
+        history->flush();
+    }
+}
+
+ChartHistory::ChartHistory(const QString &target)
+    : QObject(nullptr)
+    , m_target(target)
+    , m_users(0)
+    , m_feed(nullptr)
+    , m_targetId(0)
+    , m_live(LIVE_CAPACITY, liveSpanMs())
+    , m_appended(0)
+    , m_dropped(0)
+{
+}
+
+ChartHistory::~ChartHistory()
+{
+    ChartQueryService *queries = ChartQueryService::instance();
+    for (const TileUse &use : m_tiles) {
+        if (use.query >= 0) {
+            queries->cancel(use.query);
+        }
+    }
+    if (m_feed) {
+        m_feed->histories.remove(m_targetId);
+        if (m_feed->histories.isEmpty()) {
+            Feed::feeds().remove(m_feed->ring);
+            delete m_feed;
+        }
+    }
+}
+
+ChartHistory *ChartHistory::subscribe(const QString &target)
+{
+    ChartHistory *&history = histories()[target];
+    if (!history) {
+        history = new ChartHistory(target);
+    }
+    ++history->m_users;
+    return history;
+}
+
+void ChartHistory::unsubscribe()
+{
+    if (--m_users > 0) return;
+    histories().remove(m_target);
+    delete this;
+}
+
+void ChartHistory::follow(ResultRing *ring, quint32 targetId)
+{
+    if (m_feed || !ring) return;
+    Feed *&feed = Feed::feeds()[ring];
+    if (!feed) {
+        feed = new Feed(ring);
+    }
+    m_feed = feed;
+    m_targetId = targetId;
+    m_feed->histories.insert(targetId, this);
+}
+
+void ChartHistory::append(const ProbeResult &result)
+{
+    ColumnSample sample;
+    sample.startTime = result.startTime;
+    sample.returnTime = result.returnTime;
+    sample.rttNs = result.rttNs;
+    sample.ttl = 0;
+    sample.seq = 0;
+    sample.timeoutMs = result.timeoutMs;
+    m_dropped += m_live.push(sample, result.rttNs >= 0 ? result.rttNs / 1000000.0 : result.timeoutMs);
+    ++m_appended;
+}
+
+void ChartHistory::flush()
+{
+    if (m_appended == 0) return;
+    int count = m_appended;
+    int dropped = m_dropped;
+    m_appended = 0;
+    m_dropped = 0;
+    emit liveAppended(count, dropped);
+}
+
+void ChartHistory::useTile(Rollups::Resolution level, qint64 index)
+{
+    TileKey key{ int(level), index };
+    TileUse &use = m_tiles[key];
+    if (use.users++ > 0) return;
+    if (ChartTileCache::instance()->find(m_target, level, index, &use.tile)) return;
+
+    qint64 tileMs = ChartTileCache::tileMs(level);
+    ChartQueryService::Request request;
+    request.target = m_target;
+    request.from = index * tileMs;
+    request.to = request.from + tileMs - 1;
+    request.resolution = level;
+    use.query = ChartQueryService::instance()->start(request, this,
+        [this, key](const ChartQueryService::Chunk &chunk) { onQueryChunk(key, chunk); },
+        [this, key](Rollups::Resolution resolution, const Rollups::Bucket &stats) {
+            onQueryFinished(key, resolution, stats);
+        });
+}
+
+void ChartHistory::releaseTile(Rollups::Resolution level, qint64 index)
+{
+    auto use = m_tiles.find(TileKey{ int(level), index });
+    if (use == m_tiles.end() || --use.value().users > 0) return;
+    if (use.value().query >= 0) {
+        ChartQueryService::instance()->cancel(use.value().query);
+    }
+    m_tiles.erase(use);
+}
+
+const ChartTileCache::Tile *ChartHistory::tile(Rollups::Resolution level, qint64 index) const
+{
+    auto use = m_tiles.constFind(TileKey{ int(level), index });
+    return use == m_tiles.constEnd() ? nullptr : &use.value().tile;
+}
+
+void ChartHistory::onQueryChunk(const TileKey &key, const ChartQueryService::Chunk &chunk)
+{
+    // Only called while the tile is in use: releasing it cancels the query
+    ChartTileCache::Tile &tile = m_tiles[key].tile;
+    tile.resolution = chunk.resolution;
+    tile.rows += chunk.rows;
+    for (ChartQueryService::BucketRow row : chunk.buckets) {
+        // Only the tile's stats need a distribution
+        row.bucket.sketch = LatencySketch();
+        tile.buckets.append(row);
+    }
+    emit tileChanged(Rollups::Resolution(key.level), key.index);
+}
+
+void ChartHistory::onQueryFinished(const TileKey &key, Rollups::Resolution resolution, const Rollups::Bucket &stats)
+{
+    TileUse &use = m_tiles[key];
+    use.query = -1;
+    use.tile.resolution = resolution;
+    use.tile.stats = stats;
+    use.tile.loaded = true;
+    // Raw rows standing in for buckets only until the rollups are back
+    Rollups::Resolution level = Rollups::Resolution(key.level);
+    if (resolution == level
+        && ChartTileCache::isSettled(level, key.index, QDateTime::currentMSecsSinceEpoch())) {
+        ChartTileCache::instance()->insert(m_target, level, key.index, use.tile);
+    }
+    emit tileChanged(level, key.index);
+}
@@ -0,0 +1,91 @@
+#ifndef CHARTHISTORY_H
+#define CHARTHISTORY_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include "ChartQueryService.h"
+#include "ChartTileCache.h"
+#include "LiveWindow.h"
+#include "ResultRing.h"
+#include "Rollups.h"
+
+// What the chart windows of one target show, held once for all of them:
+// the live results of the last few minutes and the stored tiles any of
+// them has in view. A window subscribes to its target's history and
+// unsubscribes when it goes; the last to leave deletes it. A result ring
+// is read once for every target followed from it, and each history hears
+// only of its own target's results, however many windows are open.
+// GUI thread only.
+class ChartHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    // target's history, made on first use.
+    static ChartHistory *subscribe(const QString &target);
+    void unsubscribe();
+
+    // Routes live results carrying targetId (the target's TargetRegistry
+    // id) from ring into live(); ring must outlive the history. Only the
+    // first call does anything.
+    void follow(ResultRing *ring, quint32 targetId);
+
+    const QString &target() const { return m_target; }
+    const LiveWindow &live() const { return m_live; }
+
+    // Adds a user to the tile at level and index, which is loaded unless
+    // another window already has it or it is cached.
+    void useTile(Rollups::Resolution level, qint64 index);
+    // The last user gone, the tile is dropped and any query for it
+    // cancelled; settled tiles stay in ChartTileCache.
+    void releaseTile(Rollups::Resolution level, qint64 index);
+    // Nullptr unless in use.
+    const ChartTileCache::Tile *tile(Rollups::Resolution level, qint64 index) const;
+
+signals:
+    // count results were added to the end of live(), and dropped went from
+    // its start, since the last time.
+    void liveAppended(int count, int dropped);
+    // Rows, buckets or stats of a tile in use came in.
+    void tileChanged(Rollups::Resolution level, qint64 index);
+
+private:
+    // Reads one ring for every history following it.
+    struct Feed;
+
+    struct TileKey {
+        int level;
+        qint64 index;
+
+        bool operator==(const TileKey &o) const { return index == o.index && level == o.level; }
+        friend size_t qHash(const TileKey &key, size_t seed = 0) { return qHashMulti(seed, key.level, key.index); }
+    };
+
+    struct TileUse {
+        ChartTileCache::Tile tile;
+        int users = 0;
+        int query = -1;             // While loading
+    };
+
+    explicit ChartHistory(const QString &target);
+    ~ChartHistory();
+
+    void append(const ProbeResult &result);
+    // Tells the windows what append() added.
+    void flush();
+    // Results of the query loading the tile at key.
+    void onQueryChunk(const TileKey &key, const ChartQueryService::Chunk &chunk);
+    void onQueryFinished(const TileKey &key, Rollups::Resolution resolution, const Rollups::Bucket &stats);
+
+    QString m_target;
+    int m_users;
+    Feed *m_feed;
+    quint32 m_targetId;
+    LiveWindow m_live;
+    int m_appended;                 // Since the last flush
+    int m_dropped;
+    QHash<TileKey, TileUse> m_tiles;
+};
+
+#endif // CHARTHISTORY_H
@@ -0,0 +1,385 @@
+#include "ChartQueryService.h"
+#include "LogPartitions.h"
+#include "LogSchema.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QWaitCondition>
+#include <QDebug>
+
+namespace {
+
+const int CHUNK_ROWS = 8192;        // About 100 kB of samples a signal
+const int CHUNK_BUCKETS = 2048;
+const int BUSY_TIMEOUT_MS = 5000;
+const char *const PARTITION_SCHEMA = "part";
+
+std::atomic<int> connectionCount(0);
+
+// Columns in the order the range queries below select them.
+ColumnSample sampleAt(const QSqlQuery &query)
+{
+    ColumnSample row;
+    row.startTime = query.value(0).toLongLong();
+    row.returnTime = query.value(1).toLongLong();
+    row.rttNs = query.value(2).toLongLong();
+    row.ttl = query.value(3).toInt();
+    row.seq = query.value(4).toInt();
+    row.timeoutMs = query.value(5).toInt();
+    return row;
+}
+
+// Rows of targetId in the partition file at path, read through db.
+bool queryPartition(QSqlDatabase &db, QSqlQuery &query, const QString &path, qint64 targetId, qint64 from, qint64 to)
+{
+    if (!LogPartitions::attachForReading(db, path, PARTITION_SCHEMA)) return false;
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT start_time, return_time, rtt_ns, ttl, seq, timeout_val FROM %1.ping_log "
+                          "WHERE target_id = :target AND start_time BETWEEN :start AND :end ORDER BY start_time")
+                      .arg(PARTITION_SCHEMA));
+    query.bindValue(":target", targetId);
+    query.bindValue(":start", from);
+    query.bindValue(":end", to);
+    if (!query.exec()) {
+        qWarning() << "Query of" << path << "failed:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+// Partitions read ahead by other pool threads, in the order they are sent.
+struct ReadAhead {
+    enum State { Inline, Reading, Done };
+
+    QMutex mutex;
+    QWaitCondition done;
+    QVector<State> states;
+    QVector<QVector<ColumnSample>> rows;
+};
+
+} // namespace
+
+ChartQueryService::Reader::~Reader()
+{
+    delete columns;
+    QSqlDatabase::database(connection, false).close();
+    QSqlDatabase::removeDatabase(connection);
+}
+
+ChartQueryService::ChartQueryService(QObject *parent)
+    : QObject(parent)
+    , m_path(QCoreApplication::applicationDirPath() + "/pinglog.db")
+    , m_columnDirectory(ColumnStore::configuredDirectory())
+    , m_nextId(0)
+{
+    qRegisterMetaType<ChartQueryService::Chunk>();
+    qRegisterMetaType<Rollups::Resolution>();
+    qRegisterMetaType<Rollups::Bucket>();
+    // The threads, and so their connections, stay until we go
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+    m_pool.setExpiryTimeout(-1);
+}
+
+ChartQueryService::~ChartQueryService()
+{
+    for (const Query &query : m_running) {
+        *query.cancelled = true;
+    }
+    m_pool.waitForDone();
+}
+
+ChartQueryService *ChartQueryService::instance()
+{
+    static ChartQueryService *service = new ChartQueryService(QCoreApplication::instance());
+    return service;
+}
+
+void ChartQueryService::setDatabasePath(const QString &path)
+{
+    m_path = path;
+}
+
+int ChartQueryService::start(const Request &request, QObject *receiver, const ChunkHandler &onChunk,
+                             const FinishedHandler &onFinished)
+{
+    int id = m_nextId++;
+    Flag cancelled = std::make_shared<std::atomic<bool>>(false);
+    Query &query = m_running[id];
+    query.cancelled = cancelled;
+    query.receiver = receiver;
+    query.onChunk = onChunk;
+    query.onFinished = onFinished;
+    m_pool.start([this, id, request, cancelled] {
+        run(id, request, cancelled);
+        QMetaObject::invokeMethod(this, [this, id] { m_running.remove(id); }, Qt::QueuedConnection);
+    });
+    return id;
+}
+
+void ChartQueryService::cancel(int id)
+{
+    auto query = m_running.find(id);
+    if (query != m_running.end()) {
+        *query->cancelled = true;
+        m_running.erase(query);
+    }
+}
+
+void ChartQueryService::deliver(int id, const Chunk &chunk)
+{
+    QMetaObject::invokeMethod(this, [this, id, chunk] {
+        // A copy: the handler may start or cancel queries
+        Query query = m_running.value(id);
+        if (query.receiver) {
+            query.onChunk(chunk);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void ChartQueryService::deliverFinished(int id, Rollups::Resolution resolution, const Rollups::Bucket &stats)
+{
+    QMetaObject::invokeMethod(this, [this, id, resolution, stats] {
+        Query query = m_running.take(id);
+        if (query.receiver) {
+            query.onFinished(resolution, stats);
+        }
+    }, Qt::QueuedConnection);
+}
+
+ChartQueryService::Reader *ChartQueryService::reader()
+{
+    if (!m_readers.hasLocalData()) {
+        Reader *reader = new Reader;
+        reader->connection = QString("ChartQuery_%1").arg(connectionCount++);
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", reader->connection);
+        db.setDatabaseName(m_path);
+        db.setConnectOptions(QString("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=%1").arg(BUSY_TIMEOUT_MS));
+        if (!m_columnDirectory.isEmpty()) {
+            reader->columns = new ColumnStoreReader(m_columnDirectory);
+        }
+        m_readers.setLocalData(reader);
+    }
+    return m_readers.localData();
+}
+
+void ChartQueryService::run(int id, const Request &request, const Flag &cancelled)
+{
+    if (*cancelled) return;
+    QSqlDatabase db = QSqlDatabase::database(reader()->connection, false);
+    // Opened here rather than with the reader, so a database that did not
+    // exist yet is picked up by the next query
+    if (!db.isOpen() && !db.open()) {
+        qWarning() << "Failed to open DB for chart:" << db.lastError().text();
+        if (!*cancelled) deliverFinished(id, Rollups::Raw, Rollups::Bucket());
+        return;
+    }
+
+    Rollups::Resolution resolution = request.resolution;
+    if (resolution != Rollups::Raw && (LogSchema::hasLegacyRows(db) || Rollups::isRebuilding(db))) {
+        resolution = Rollups::Raw;
+    }
+    Rollups::Bucket stats;
+    if (resolution != Rollups::Raw) {
+        runRollups(id, db, request, resolution, cancelled, &stats);
+    } else {
+        runRaw(id, db, request, cancelled, &stats);
+    }
+    if (!*cancelled) {
+        deliverFinished(id, resolution, stats);
+    }
+}
+
+void ChartQueryService::runRollups(int id, QSqlDatabase &db, const Request &request, Rollups::Resolution resolution,
+                                   const Flag &cancelled, Rollups::Bucket *stats)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT bucket, %1 FROM %2 "
+                          "WHERE target_id = (SELECT id FROM targets WHERE name = :name) "
+                          "AND bucket BETWEEN :start AND :end ORDER BY bucket ASC")
+                      .arg(Rollups::Columns).arg(Rollups::tableName(resolution)));
+    query.bindValue(":name", request.target);
+    query.bindValue(":start", request.from - request.from % Rollups::widthMs(resolution));
+    query.bindValue(":end", request.to);
+    if (!query.exec()) {
+        qWarning() << "Query failed:" << query.lastError().text();
+        return;
+    }
+    Chunk chunk;
+    chunk.resolution = resolution;
+    while (!*cancelled && query.next()) {
+        BucketRow row;
+        row.start = query.value(0).toLongLong();
+        row.bucket = Rollups::bucketAt(query, 1);
+        stats->merge(row.bucket);
+        chunk.buckets.append(row);
+        if (chunk.buckets.size() == CHUNK_BUCKETS) {
+            deliver(id, chunk);
+            chunk.buckets.clear();
+        }
+    }
+    if (!*cancelled && !chunk.buckets.isEmpty()) {
+        deliver(id, chunk);
+    }
+}
+
+void ChartQueryService::runRaw(int id, QSqlDatabase &db, const Request &request, const Flag &cancelled,
+                               Rollups::Bucket *stats)
+{
+    qint64 from = request.from;
+    ColumnStoreReader *columns = reader()->columns;
+    if (columns && columns->refresh()) {
+        // The column store where its sealed chunks hold everything;
+        // ping_log before the store was turned on, for chunks lost in a
+        // crash and for what hasn't been sealed yet
+        for (const ColumnStore::Span &span : columns->covered(request.target, request.from, request.to)) {
+            if (span.from > from) {
+                runLog(id, db, request, from, span.from - 1, cancelled, stats);
+            }
+            QVector<ColumnSample> rows = columns->scan(request.target, span.from, span.to);
+            if (!send(id, rows, true, cancelled, stats)) return;
+            from = span.to + 1;
+        }
+    }
+    if (from <= request.to) {
+        runLog(id, db, request, from, request.to, cancelled, stats);
+    }
+}
+
+void ChartQueryService::runLog(int id, QSqlDatabase &db, const Request &request, qint64 from, qint64 to,
+                               const Flag &cancelled, Rollups::Bucket *stats)
+{
+    if (*cancelled) return;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT id FROM targets WHERE name = :name");
+    query.bindValue(":name", request.target);
+    qint64 targetId = query.exec() && query.next() ? query.value(0).toLongLong() : -1;
+    QVector<LogPartitions::Partition> partitions;
+    if (targetId > 0) {
+        for (const LogPartitions::Partition &partition : LogPartitions::list(LogPartitions::directoryFor(m_path))) {
+            if (partition.end > from && partition.start <= to) {
+                partitions.append(partition);
+            }
+        }
+    }
+
+    // Every partition but the first is read ahead on another pool thread
+    // while this one sends what comes before it; any that finds no free
+    // thread is read here when its turn comes
+    std::shared_ptr<ReadAhead> ahead = std::make_shared<ReadAhead>();
+    ahead->states.fill(ReadAhead::Inline, partitions.size());
+    ahead->rows.resize(partitions.size());
+    for (int i = 1; i < partitions.size(); ++i) {
+        const QString path = partitions.at(i).path;
+        ahead->states[i] = ReadAhead::Reading;
+        bool started = m_pool.tryStart([this, ahead, i, path, targetId, from, to, cancelled] {
+            QVector<ColumnSample> rows;
+            QSqlDatabase partDb = QSqlDatabase::database(reader()->connection, false);
+            if (!*cancelled && (partDb.isOpen() || partDb.open())) {
+                {
+                    QSqlQuery partQuery(partDb);
+                    if (queryPartition(partDb, partQuery, path, targetId, from, to)) {
+                        while (!*cancelled && partQuery.next()) {
+                            rows.append(sampleAt(partQuery));
+                        }
+                    }
+                }
+                LogPartitions::detach(partDb, PARTITION_SCHEMA);
+            }
+            QMutexLocker locker(&ahead->mutex);
+            ahead->rows[i] = rows;
+            ahead->states[i] = ReadAhead::Done;
+            ahead->done.wakeAll();
+        });
+        if (!started) {
+            ahead->states[i] = ReadAhead::Inline;
+        }
+    }
+
+    // The rows kept in pinglog.db itself were written before partitioning
+    // was turned on, so they come first
+    QString sql = "SELECT start_time, return_time, COALESCE(rtt_ns, rtt * 1000000), COALESCE(ttl, 0), seq, timeout_val FROM ping_log "
+                  "WHERE target_id = :target AND start_time BETWEEN :start AND :end";
+    bool legacy = LogSchema::hasLegacyRows(db);
+    if (legacy) {
+        // Rows not yet moved out of the old table, which may still only
+        // carry the name; their times derived as the migration will store
+        // them, so the window and order match ping_log's
+        QString startTime = LogSchema::legacyStartTime(db);
+        sql += QString(" UNION ALL SELECT %1, %2, COALESCE(o.rtt_ns, o.rtt * 1000000), COALESCE(o.ttl, 0), "
+                       "COALESCE(o.seq, 0), o.timeout_val "
+                       "FROM %3 o WHERE (o.target_id = :oldTarget OR o.target = :oldName) "
+                       "AND %1 BETWEEN :oldStart AND :oldEnd ORDER BY 1 ASC")
+                   .arg(startTime, LogSchema::legacyReturnTime(db), QString::fromLatin1(LogSchema::LegacyTable));
+    } else {
+        sql += " ORDER BY start_time ASC";
+    }
+    query.prepare(sql);
+    query.bindValue(":target", targetId);
+    query.bindValue(":start", from);
+    query.bindValue(":end", to);
+    if (legacy) {
+        query.bindValue(":oldTarget", targetId);
+        query.bindValue(":oldName", request.target);
+        query.bindValue(":oldStart", from);
+        query.bindValue(":oldEnd", to);
+    }
+    QVector<ColumnSample> rows;
+    if (query.exec()) {
+        while (!*cancelled && query.next()) {
+            rows.append(sampleAt(query));
+            if (!send(id, rows, false, cancelled, stats)) break;
+        }
+    } else {
+        qWarning() << "Query failed:" << query.lastError().text();
+    }
+    query = QSqlQuery();
+    send(id, rows, true, cancelled, stats);
+
+    for (int i = 0; i < partitions.size(); ++i) {
+        QMutexLocker locker(&ahead->mutex);
+        if (ahead->states.at(i) == ReadAhead::Inline) {
+            locker.unlock();
+            if (*cancelled) continue;
+            {
+                QSqlQuery partQuery(db);
+                if (queryPartition(db, partQuery, partitions.at(i).path, targetId, from, to)) {
+                    while (!*cancelled && partQuery.next()) {
+                        rows.append(sampleAt(partQuery));
+                        if (!send(id, rows, false, cancelled, stats)) break;
+                    }
+                }
+            }
+            LogPartitions::detach(db, PARTITION_SCHEMA);
+            send(id, rows, true, cancelled, stats);
+        } else {
+            // Waited for even once cancelled, as it uses ahead
+            while (ahead->states.at(i) != ReadAhead::Done) {
+                ahead->done.wait(&ahead->mutex);
+            }
+            QVector<ColumnSample> partRows = ahead->rows.at(i);
+            ahead->rows[i].clear();
+            locker.unlock();
+            send(id, partRows, true, cancelled, stats);
+        }
+    }
+}
+
+bool ChartQueryService::send(int id, QVector<ColumnSample> &rows, bool flush, const Flag &cancelled,
+                             Rollups::Bucket *stats)
+{
+    if (rows.size() < (flush ? 1 : CHUNK_ROWS)) return !*cancelled;
+    for (int i = 0; i < rows.size(); i += CHUNK_ROWS) {
+        if (*cancelled) break;
+        Chunk chunk;
+        chunk.rows = rows.mid(i, CHUNK_ROWS);
+        for (const ColumnSample &row : chunk.rows) {
+            stats->add(row.rttNs);
+        }
+        deliver(id, chunk);
+    }
+    rows.clear();
+    return !*cancelled;
+}
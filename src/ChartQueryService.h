@@ -0,0 +1,121 @@
+#ifndef CHARTQUERYSERVICE_H
+#define CHARTQUERYSERVICE_H
+
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QPointer>
+#include <QSqlDatabase>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "ColumnStore.h"
+#include "Rollups.h"
+
+// Runs chart queries on a pool of its own, off the GUI thread. Every pool
+// thread keeps one read-only connection to pinglog.db (and a ColumnStore
+// reader) for as long as it lives; partition files are attached to it for
+// the query that needs them. Results come back in chunks, in time order,
+// as they are read through forward-only cursors, so a chart fills while
+// the query is still running, and a query can be cancelled at any point.
+// Each query's results go only to the handlers it was started with.
+class ChartQueryService : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request {
+        QString target;
+        qint64 from = 0;        // ms since epoch, inclusive
+        qint64 to = 0;
+        // Raw rows, or the buckets of a rollup; raw rows all the same while
+        // the rollups are still being filled in
+        Rollups::Resolution resolution = Rollups::Raw;
+    };
+
+    struct BucketRow {
+        qint64 start = 0;
+        Rollups::Bucket bucket;
+    };
+
+    // Raw rows or whole buckets, depending on resolution.
+    struct Chunk {
+        Rollups::Resolution resolution = Rollups::Raw;
+        QVector<ColumnSample> rows;
+        QVector<BucketRow> buckets;
+    };
+
+    typedef std::function<void(const Chunk &chunk)> ChunkHandler;
+    // Last call for a query unless cancelled; stats covers every row or
+    // bucket sent.
+    typedef std::function<void(Rollups::Resolution resolution, const Rollups::Bucket &stats)> FinishedHandler;
+
+    explicit ChartQueryService(QObject *parent = nullptr);
+    // Cancels everything and waits for the pool.
+    ~ChartQueryService();
+
+    // Shared by every chart window; lives as long as the application.
+    static ChartQueryService *instance();
+
+    // Defaults to pinglog.db next to the executable; call before the first
+    // query.
+    void setDatabasePath(const QString &path);
+
+    // Queues request and returns its id. Its results are handed to onChunk
+    // and onFinished on our thread, and only while receiver exists.
+    int start(const Request &request, QObject *receiver, const ChunkHandler &onChunk,
+              const FinishedHandler &onFinished);
+    // No handler calls for id after this returns, not even for results
+    // already on their way; the worker stops at its next row.
+    void cancel(int id);
+
+private:
+    typedef std::shared_ptr<std::atomic<bool>> Flag;
+
+    // A query not finished yet. Only touched on our thread.
+    struct Query {
+        Flag cancelled;
+        QPointer<QObject> receiver;
+        ChunkHandler onChunk;
+        FinishedHandler onFinished;
+    };
+
+    // What each pool thread keeps between queries.
+    struct Reader {
+        QString connection;
+        ColumnStoreReader *columns = nullptr;
+        ~Reader();
+    };
+
+    // The calling pool thread's reader, opened on first use.
+    Reader *reader();
+    void run(int id, const Request &request, const Flag &cancelled);
+    void runRollups(int id, QSqlDatabase &db, const Request &request, Rollups::Resolution resolution,
+                    const Flag &cancelled, Rollups::Bucket *stats);
+    void runRaw(int id, QSqlDatabase &db, const Request &request, const Flag &cancelled, Rollups::Bucket *stats);
+    // Raw rows of request starting within [from, to] from pinglog.db and
+    // its partitions.
+    void runLog(int id, QSqlDatabase &db, const Request &request, qint64 from, qint64 to, const Flag &cancelled,
+                Rollups::Bucket *stats);
+    // Pass results from a pool thread to the handlers of query id, unless
+    // it is cancelled or its receiver gone by the time they get there.
+    void deliver(int id, const Chunk &chunk);
+    void deliverFinished(int id, Rollups::Resolution resolution, const Rollups::Bucket &stats);
+    // Sends rows in chunks as they are read, appending each to stats.
+    // False if cancelled first.
+    bool send(int id, QVector<ColumnSample> &rows, bool flush, const Flag &cancelled, Rollups::Bucket *stats);
+
+    QString m_path;
+    QString m_columnDirectory;
+    int m_nextId;
+    QHash<int, Query> m_running;    // By id
+    QThreadStorage<Reader *> m_readers;
+    QThreadPool m_pool;             // After m_readers: its threads' readers go first
+};
+
+Q_DECLARE_METATYPE(ChartQueryService::Chunk)
+
+#endif // CHARTQUERYSERVICE_H
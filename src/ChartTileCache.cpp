@@ -0,0 +1,58 @@
+#include "ChartTileCache.h"
+#include <QSettings>
+
+namespace {
+
+// How long after its end a tile may still change: results come in up to a
+// timeout late, and DatabaseThread writes them within a few seconds.
+const qint64 SETTLE_MS = 2 * 60 * 1000;
+
+} // namespace
+
+qint64 ChartTileCache::Tile::bytes() const
+{
+    // Near enough; what matters is that big tiles cost more
+    return qint64(sizeof(Tile)) + rows.size() * qint64(sizeof(ColumnSample))
+         + buckets.size() * qint64(sizeof(ChartQueryService::BucketRow));
+}
+
+ChartTileCache::ChartTileCache(qint64 capacityBytes)
+    : m_tiles(capacityBytes)
+{
+}
+
+ChartTileCache *ChartTileCache::instance()
+{
+    static ChartTileCache *cache = nullptr;
+    if (!cache) {
+        QSettings settings("MyCompany", "PingTool");
+        int megabytes = qMax(1, settings.value("chart/tileCacheMB", int(DefaultCapacityMB)).toInt());
+        cache = new ChartTileCache(qint64(megabytes) * 1024 * 1024);
+    }
+    return cache;
+}
+
+qint64 ChartTileCache::tileMs(Rollups::Resolution level)
+{
+    return level == Rollups::Raw ? RawTileMs : TileBuckets * Rollups::widthMs(level);
+}
+
+bool ChartTileCache::isSettled(Rollups::Resolution level, qint64 index, qint64 nowMs)
+{
+    qint64 end = (index + 1) * tileMs(level);
+    return end + SETTLE_MS + (level == Rollups::Raw ? 0 : Rollups::widthMs(level)) < nowMs;
+}
+
+bool ChartTileCache::find(const QString &target, Rollups::Resolution level, qint64 index, Tile *tile)
+{
+    const Tile *cached = m_tiles.object(Key{ target, int(level), index });
+    if (!cached) return false;
+    *tile = *cached;
+    return true;
+}
+
+void ChartTileCache::insert(const QString &target, Rollups::Resolution level, qint64 index, const Tile &tile)
+{
+    // The copy shares its rows with the window's
+    m_tiles.insert(Key{ target, int(level), index }, new Tile(tile), tile.bytes());
+}
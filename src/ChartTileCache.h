@@ -0,0 +1,65 @@
+#ifndef CHARTTILECACHE_H
+#define CHARTTILECACHE_H
+
+#include <QCache>
+#include <QString>
+#include <QVector>
+#include "ChartQueryService.h"
+#include "Rollups.h"
+
+// Chart data cut into fixed time tiles, a pyramid of them per target: raw
+// rows in RawTileMs tiles, and TileBuckets buckets a tile at every rollup
+// resolution, aligned to multiples of their length since the epoch. A view
+// is put together from the tiles of one level, so moving it only fetches
+// what it lacks. Tiles no longer written to are kept in an LRU cache
+// shared by every chart window, its size capped by "chart/tileCacheMB".
+// GUI thread only.
+class ChartTileCache
+{
+public:
+    enum { TileBuckets = 1024, RawTileMs = 256 * 1000, DefaultCapacityMB = 64 };
+
+    struct Tile {
+        // What it holds; Raw at a rollup level while the rollups are rebuilt
+        Rollups::Resolution resolution = Rollups::Raw;
+        QVector<ColumnSample> rows;
+        QVector<ChartQueryService::BucketRow> buckets;  // Without their sketches
+        Rollups::Bucket stats;                          // Over the whole tile
+        bool loaded = false;
+
+        qint64 bytes() const;
+    };
+
+    explicit ChartTileCache(qint64 capacityBytes);
+
+    // Shared by every chart window.
+    static ChartTileCache *instance();
+
+    // Length of a tile at level.
+    static qint64 tileMs(Rollups::Resolution level);
+    // Whether the tile at index can still change at nowMs: late results
+    // and open rollup buckets land in it for a while after it ends.
+    static bool isSettled(Rollups::Resolution level, qint64 index, qint64 nowMs);
+
+    // Copies the tile out if cached, making it the most recently used.
+    bool find(const QString &target, Rollups::Resolution level, qint64 index, Tile *tile);
+    // Caches a settled, loaded tile, evicting the least recently used
+    // tiles beyond the cap.
+    void insert(const QString &target, Rollups::Resolution level, qint64 index, const Tile &tile);
+
+    qint64 usedBytes() const { return m_tiles.totalCost(); }
+
+private:
+    struct Key {
+        QString target;
+        int level;
+        qint64 index;
+
+        bool operator==(const Key &o) const { return index == o.index && level == o.level && target == o.target; }
+        friend size_t qHash(const Key &key, size_t seed = 0) { return qHashMulti(seed, key.target, key.level, key.index); }
+    };
+
+    QCache<Key, Tile> m_tiles;      // Cost in bytes
+};
+
+#endif // CHARTTILECACHE_H
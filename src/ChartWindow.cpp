@@ -1,370 +1,571 @@
-#include "ChartWindow.h"
-#include <QVBoxLayout>
-#include <QHBoxLayout>
-#include <QLabel>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QSqlError>
-#include <QCoreApplication>
-#include <QDebug>
-#include <QMouseEvent>
-#include <QWheelEvent>
-
-void InteractiveChartView::wheelEvent(QWheelEvent *event)
-{
-    if (chart()->axes().isEmpty()) return;
-    
-    auto axisX = qobject_cast<QDateTimeAxis*>(chart()->axes(Qt::Horizontal).first());
-    if (!axisX) return;
-
-    qint64 min = axisX->min().toMSecsSinceEpoch();
-    qint64 max = axisX->max().toMSecsSinceEpoch();
-    qint64 range = max - min;
-
-    if (event->angleDelta().y() > 0) {
-        // Zoom in
-        range /= 1.5;
-    } else {
-        // Zoom out
-        range *= 1.5;
-    }
-    
-    // Center zoom
-    qint64 center = min + (max - min) / 2;
-    
-    axisX->setRange(QDateTime::fromMSecsSinceEpoch(center - range / 2), 
-                    QDateTime::fromMSecsSinceEpoch(center + range / 2));
-                    
-    event->accept();
-}
-
-void InteractiveChartView::mousePressEvent(QMouseEvent *event)
-{
-    if (event->button() == Qt::LeftButton) {
-        m_isDragging = true;
-        m_lastMousePos = event->pos();
-        setCursor(Qt::ClosedHandCursor);
-        event->accept();
-    }
-    QChartView::mousePressEvent(event);
-}
-
-void InteractiveChartView::mouseMoveEvent(QMouseEvent *event)
-{
-    if (m_isDragging) {
-        auto axisX = qobject_cast<QDateTimeAxis*>(chart()->axes(Qt::Horizontal).first());
-        if (axisX) {
-            qint64 min = axisX->min().toMSecsSinceEpoch();
-            qint64 max = axisX->max().toMSecsSinceEpoch();
-            qint64 range = max - min;
-            
-            // Calculate delta in pixels
-            int dx = event->pos().x() - m_lastMousePos.x();
-            
-            // Map pixel delta to time delta
-            // Width of plot area
-            qreal plotWidth = chart()->plotArea().width();
-            if (plotWidth > 0) {
-                qint64 timeDelta = -dx * range / plotWidth;
-                
-                axisX->setRange(QDateTime::fromMSecsSinceEpoch(min + timeDelta), 
-                                QDateTime::fromMSecsSinceEpoch(max + timeDelta));
-            }
-        }
-        m_lastMousePos = event->pos();
-        event->accept();
-    }
-    QChartView::mouseMoveEvent(event);
-}
-
-void InteractiveChartView::mouseReleaseEvent(QMouseEvent *event)
-{
-    if (event->button() == Qt::LeftButton) {
-        m_isDragging = false;
-        setCursor(Qt::ArrowCursor);
-        event->accept();
-    }
-    QChartView::mouseReleaseEvent(event);
-}
-
-ChartWindow::ChartWindow(const QString &target, int timeoutMs, QObject *parent)
-    : QMainWindow(nullptr) // Independent window
-    , m_target(target)
-    , m_timeoutMs(timeoutMs)
-{
-    setAttribute(Qt::WA_DeleteOnClose);
-    setWindowTitle(QString("Ping Chart - %1").arg(target));
-    resize(900, 500);
-
-    setupUi();
-
-    // Load last 1 hour data from DB by default -> User requested manual query only
-    // QDateTime end = QDateTime::currentDateTime();
-    // QDateTime start = end.addSecs(-3600);
-    // loadFromDatabase(start, end);
-}
-
-ChartWindow::~ChartWindow()
-{
-}
-
-void ChartWindow::setupUi()
-{
-    QWidget *centralWidget = new QWidget(this);
-    setCentralWidget(centralWidget);
-    QVBoxLayout *mainLayout = new QVBoxLayout(centralWidget);
-
-    // Controls
-    QHBoxLayout *controlLayout = new QHBoxLayout();
-    
-    controlLayout->addWidget(new QLabel("Start:"));
-    m_startTimeEdit = new QDateTimeEdit(QDateTime::currentDateTime().addSecs(-3600)); // Default 1 hour ago
-    m_startTimeEdit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
-    controlLayout->addWidget(m_startTimeEdit);
-
-    controlLayout->addWidget(new QLabel("End:"));
-    m_endTimeEdit = new QDateTimeEdit(QDateTime::currentDateTime());
-    m_endTimeEdit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
-    controlLayout->addWidget(m_endTimeEdit);
-
-    m_queryBtn = new QPushButton("Query Database");
-    controlLayout->addWidget(m_queryBtn);
-    
-    controlLayout->addSpacing(20);
-
-    m_autoScaleYCheck = new QCheckBox("Auto Y");
-    m_autoScaleYCheck->setChecked(true);
-    controlLayout->addWidget(m_autoScaleYCheck);
-
-    controlLayout->addWidget(new QLabel("Max Y:"));
-    m_yMaxSpin = new QSpinBox();
-    m_yMaxSpin->setRange(10, 10000);
-    m_yMaxSpin->setValue(100);
-    m_yMaxSpin->setEnabled(false); // Disabled when Auto is on
-    controlLayout->addWidget(m_yMaxSpin);
-    
-    controlLayout->addStretch();
-
-    mainLayout->addLayout(controlLayout);
-
-    // Chart
-    m_chart = new QChart();
-    m_chart->setTitle(QString("RTT for %1").arg(m_target));
-    // m_chart->legend()->hide(); // Show legend for Success/Timeout distinction
-
-    m_series = new QLineSeries();
-    m_series->setName("Success");
-    m_chart->addSeries(m_series);
-
-    m_timeoutSeries = new QLineSeries();
-    m_timeoutSeries->setName("Timeout");
-    m_timeoutSeries->setColor(Qt::red);
-    m_chart->addSeries(m_timeoutSeries);
-
-    m_axisX = new QDateTimeAxis();
-    m_axisX->setFormat("HH:mm:ss");
-    m_axisX->setTitleText("Time");
-    m_chart->addAxis(m_axisX, Qt::AlignBottom);
-    m_series->attachAxis(m_axisX);
-    m_timeoutSeries->attachAxis(m_axisX);
-
-    m_axisY = new QValueAxis();
-    m_axisY->setTitleText("RTT (ms)");
-    m_axisY->setRange(0, m_timeoutMs * 1.2); // Initial range based on timeout
-    m_chart->addAxis(m_axisY, Qt::AlignLeft);
-    m_series->attachAxis(m_axisY);
-    m_timeoutSeries->attachAxis(m_axisY);
-
-    InteractiveChartView *chartView = new InteractiveChartView(m_chart);
-    chartView->setRenderHint(QPainter::Antialiasing);
-    
-    mainLayout->addWidget(chartView);
-
-    connect(m_queryBtn, &QPushButton::clicked, this, &ChartWindow::onQueryClicked);
-    connect(m_autoScaleYCheck, &QCheckBox::stateChanged, this, &ChartWindow::onAutoScaleYChanged);
-    connect(m_yMaxSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &ChartWindow::onYMaxChanged);
-}
-
-void ChartWindow::onNewResult(QString target, int rtt, int ttl, int seq, qint64 startTime, qint64 returnTime, int timeoutMs)
-{
-    if (target != m_target) return;
-
-    if (m_endTimeEdit->dateTime() > QDateTime::currentDateTime().addSecs(-10)) {
-        int val;
-        QLineSeries *seriesToUse;
-
-        if (rtt >= 0) {
-            val = rtt;
-            seriesToUse = m_series;
-        } else {
-            // Timeout
-            val = timeoutMs;
-            seriesToUse = m_timeoutSeries;
-        }
-
-        // 4 points: (Start, 0) -> (Start, Val) -> (Return, Val) -> (Return, 0)
-        seriesToUse->append(startTime, 0);
-        seriesToUse->append(startTime, val);
-        seriesToUse->append(returnTime, val);
-        seriesToUse->append(returnTime, 0);
-
-        updateAxisRange();
-    }
-}
-
-void ChartWindow::onQueryClicked()
-{
-    loadFromDatabase(m_startTimeEdit->dateTime(), m_endTimeEdit->dateTime());
-}
-
-void ChartWindow::loadFromDatabase(const QDateTime &start, const QDateTime &end)
-{
-    m_series->clear();
-    m_timeoutSeries->clear();
-    
-    // Create a separate connection for UI thread
-    QString connectionName = "ChartConnection_" + QString::number((quint64)this);
-    {
-        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
-        QString dbPath = QCoreApplication::applicationDirPath() + "/pinglog.db";
-        db.setDatabaseName(dbPath);
-        
-        if (db.open()) {
-            QSqlQuery query(db);
-            query.prepare("SELECT start_time, return_time, rtt, timeout_val FROM ping_log WHERE target = :target AND timestamp BETWEEN :start AND :end ORDER BY timestamp ASC");
-            query.bindValue(":target", m_target);
-            query.bindValue(":start", start);
-            query.bindValue(":end", end);
-            
-            if (query.exec()) {
-                while (query.next()) {
-                    qint64 startTime = query.value(0).toLongLong();
-                    qint64 returnTime = query.value(1).toLongLong();
-                    int rtt = query.value(2).toInt();
-                    int timeoutVal = query.value(3).toInt();
-                    
-                    // Fallback for old data if columns are null/zero
-                    if (startTime == 0) {
-                         // Estimate from timestamp (which is return time roughly)
-                         // This handles legacy data before schema change
-                         // But we can't easily know rtt if it was timeout (-1)
-                         // Just skip or approximate?
-                         // Let's approximate using current timeout if 0
-                         if (timeoutVal == 0) timeoutVal = m_timeoutMs;
-                         returnTime = query.value(1).toDateTime().toMSecsSinceEpoch(); // If return_time col is null, this might be 0 too?
-                         // Actually if return_time is null, query.value(1) is 0.
-                         // We should check if return_time is valid.
-                         // If not, use timestamp column?
-                         // Wait, I didn't select timestamp column in the new query.
-                         // Let's select timestamp as fallback.
-                    }
-
-                    int val;
-                    QLineSeries *seriesToUse;
-
-                    if (rtt >= 0) {
-                        val = rtt;
-                        seriesToUse = m_series;
-                    } else {
-                        // Timeout
-                        val = timeoutVal > 0 ? timeoutVal : m_timeoutMs;
-                        seriesToUse = m_timeoutSeries;
-                    }
-                    
-                    // If we have valid start/return times, use them.
-                    if (startTime > 0 && returnTime > 0) {
-                        seriesToUse->append(startTime, 0);
-                        seriesToUse->append(startTime, val);
-                        seriesToUse->append(returnTime, val);
-                        seriesToUse->append(returnTime, 0);
-                    }
-                }
-            } else {
-                qWarning() << "Query failed:" << query.lastError().text();
-            }
-            db.close();
-        } else {
-             qWarning() << "Failed to open DB for chart:" << db.lastError().text();
-        }
-    }
-    QSqlDatabase::removeDatabase(connectionName);
-    
-    updateAxisRange();
-}
-
-void ChartWindow::updateAxisRange()
-{
-    if (m_series->count() == 0 && m_timeoutSeries->count() == 0) return;
-
-    qint64 firstTime = -1;
-    qint64 lastTime = -1;
-    double maxY = 0;
-
-    auto processSeries = [&](QLineSeries *s) {
-        if (s->count() > 0) {
-            qint64 sFirst = s->at(0).x();
-            qint64 sLast = s->at(s->count() - 1).x();
-            
-            if (firstTime == -1 || sFirst < firstTime) firstTime = sFirst;
-            if (lastTime == -1 || sLast > lastTime) lastTime = sLast;
-
-            for (const QPointF &p : s->points()) {
-                if (p.y() > maxY) maxY = p.y();
-            }
-        }
-    };
-
-    processSeries(m_series);
-    processSeries(m_timeoutSeries);
-
-    // Ensure some width
-    if (lastTime <= firstTime) {
-        if (firstTime == -1) {
-             firstTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
-             lastTime = firstTime + 1000;
-        } else {
-             firstTime -= 1000;
-             lastTime += 1000;
-        }
-    }
-    
-    m_axisX->setRange(QDateTime::fromMSecsSinceEpoch(firstTime), QDateTime::fromMSecsSinceEpoch(lastTime));
-    m_axisX->setRange(QDateTime::fromMSecsSinceEpoch(firstTime), QDateTime::fromMSecsSinceEpoch(lastTime));
-    
-    if (m_autoScaleYCheck->isChecked()) {
-        int newMax = (int)(maxY * 1.2);
-        if (newMax < 10) newMax = 10; // Minimum range
-        
-        // Block signals to prevent feedback loop if we were to update spinbox here
-        // Actually, let's update spinbox to reflect current auto scale
-        m_yMaxSpin->blockSignals(true);
-        m_yMaxSpin->setValue(newMax);
-        m_yMaxSpin->blockSignals(false);
-        
-        m_axisY->setRange(0, newMax);
-    } else {
-        // Manual mode, use spinbox value
-        m_axisY->setRange(0, m_yMaxSpin->value());
-    }
-}
-
-void ChartWindow::onAutoScaleYChanged(int state)
-{
-    bool autoScale = (state == Qt::Checked);
-    m_yMaxSpin->setEnabled(!autoScale);
-    
-    if (autoScale) {
-        updateAxisRange();
-    } else {
-        // If switching to manual, keep current value or use spinbox value?
-        // Spinbox already has value.
-        m_axisY->setRange(0, m_yMaxSpin->value());
-    }
-}
-
-void ChartWindow::onYMaxChanged(int value)
-{
-    if (!m_autoScaleYCheck->isChecked()) {
-        m_axisY->setRange(0, value);
-    }
-}
+#include "ChartWindow.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QDebug>
+#include <QScreen>
+#include <QSettings>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+void InteractiveChartView::wheelEvent(QWheelEvent *event)
+{
+    if (chart()->axes().isEmpty()) return;
+    
+    auto axisX = qobject_cast<QDateTimeAxis*>(chart()->axes(Qt::Horizontal).first());
+    if (!axisX) return;
+
+    qint64 min = axisX->min().toMSecsSinceEpoch();
+    qint64 max = axisX->max().toMSecsSinceEpoch();
+    qint64 range = max - min;
+
+    if (event->angleDelta().y() > 0) {
+        // Zoom in
+        range /= 1.5;
+    } else {
+        // Zoom out
+        range *= 1.5;
+    }
+    
+    // Center zoom
+    qint64 center = min + (max - min) / 2;
+    
+    axisX->setRange(QDateTime::fromMSecsSinceEpoch(center - range / 2), 
+                    QDateTime::fromMSecsSinceEpoch(center + range / 2));
+    emit userRangeChanged();
+                    
+    event->accept();
+}
+
+void InteractiveChartView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        m_isDragging = true;
+        m_lastMousePos = event->pos();
+        setCursor(Qt::ClosedHandCursor);
+        event->accept();
+    }
+    QChartView::mousePressEvent(event);
+}
+
+void InteractiveChartView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (m_isDragging) {
+        auto axisX = qobject_cast<QDateTimeAxis*>(chart()->axes(Qt::Horizontal).first());
+        if (axisX) {
+            qint64 min = axisX->min().toMSecsSinceEpoch();
+            qint64 max = axisX->max().toMSecsSinceEpoch();
+            qint64 range = max - min;
+            
+            // Calculate delta in pixels
+            int dx = event->pos().x() - m_lastMousePos.x();
+            
+            // Map pixel delta to time delta
+            // Width of plot area
+            qreal plotWidth = chart()->plotArea().width();
+            if (plotWidth > 0) {
+                qint64 timeDelta = -dx * range / plotWidth;
+                
+                axisX->setRange(QDateTime::fromMSecsSinceEpoch(min + timeDelta), 
+                                QDateTime::fromMSecsSinceEpoch(max + timeDelta));
+                emit userRangeChanged();
+            }
+        }
+        m_lastMousePos = event->pos();
+        event->accept();
+    }
+    QChartView::mouseMoveEvent(event);
+}
+
+void InteractiveChartView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        m_isDragging = false;
+        setCursor(Qt::ArrowCursor);
+        event->accept();
+    }
+    QChartView::mouseReleaseEvent(event);
+}
+
+ChartWindow::ChartWindow(const QString &target, int timeoutMs, QObject *parent)
+    : QMainWindow(nullptr) // Independent window
+    , m_target(target)
+    , m_timeoutMs(timeoutMs)
+    , m_data(ChartHistory::subscribe(target))
+    , m_frameTimer(new QTimer(this))
+    , m_frameMs(16)
+    , m_history(false)
+    , m_level(Rollups::Raw)
+    , m_liveDropped(0)
+    , m_rebuildPending(false)
+    , m_axisPending(false)
+    , m_redrawPending(false)
+{
+    // "chart/decimation": "minmax" (the default) or "lttb"
+    QSettings settings("MyCompany", "PingTool");
+    m_replyStyle = settings.value("chart/decimation").toString() == "lttb" ? ChartDecimator::Lttb
+                                                                           : ChartDecimator::Envelope;
+
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(QString("Ping Chart - %1").arg(target));
+    resize(900, 500);
+
+    setupUi();
+
+    // Whatever changes between frames is drawn once, on the next one
+    if (screen() && screen()->refreshRate() > 0) {
+        m_frameMs = qBound(4, qRound(1000 / screen()->refreshRate()), 50);
+    }
+    m_frameTimer->setSingleShot(true);
+    connect(m_frameTimer, &QTimer::timeout, this, &ChartWindow::onFrame);
+
+    // Load last 1 hour data from DB by default -> User requested manual query only
+    // QDateTime end = QDateTime::currentDateTime();
+    // QDateTime start = end.addSecs(-3600);
+    // loadFromDatabase(start, end);
+
+    connect(m_data, &ChartHistory::liveAppended, this, &ChartWindow::onLiveAppended);
+    connect(m_data, &ChartHistory::tileChanged, this, &ChartWindow::onTileChanged);
+}
+
+ChartWindow::~ChartWindow()
+{
+    releaseTiles();
+    m_data->unsubscribe();
+}
+
+void ChartWindow::setResultRing(ResultRing *ring, quint32 targetId)
+{
+    m_data->follow(ring, targetId);
+    // Another window of the target may have been collecting for a while
+    if (m_data->live().size() > 0) {
+        m_axisPending = true;
+        scheduleRebuild();
+    }
+}
+
+void ChartWindow::onLiveAppended(int count, int dropped)
+{
+    // Just the new results, taken from the live window shared with the
+    // target's other windows; the axes and series are redrawn at most once
+    // per display frame rather than per point or per feed.
+    if (!showsLive()) return;
+    const LiveWindow &live = m_data->live();
+    for (int i = qMax(0, live.size() - count); i < live.size(); ++i) {
+        addSample(live.at(i));
+    }
+    // Dropped samples stay in the decimators until enough have gone for
+    // refilling them to be worth it
+    m_liveDropped += dropped;
+    if (m_liveDropped > live.capacity() / 2) {
+        m_liveDropped = 0;
+        scheduleRebuild();
+    }
+    m_axisPending = true;
+    requestFrame();
+}
+
+void ChartWindow::requestFrame()
+{
+    if (!m_frameTimer->isActive()) {
+        m_frameTimer->start(m_frameMs);
+    }
+}
+
+void ChartWindow::onFrame()
+{
+    m_frameTimer->stop();
+    if (m_rebuildPending) {
+        rebuild();
+    }
+    if (m_axisPending) {
+        updateAxisRange();
+    }
+    if (m_redrawPending) {
+        redraw();
+    }
+}
+
+void ChartWindow::setupUi()
+{
+    QWidget *centralWidget = new QWidget(this);
+    setCentralWidget(centralWidget);
+    QVBoxLayout *mainLayout = new QVBoxLayout(centralWidget);
+
+    // Controls
+    QHBoxLayout *controlLayout = new QHBoxLayout();
+    
+    controlLayout->addWidget(new QLabel("Start:"));
+    m_startTimeEdit = new QDateTimeEdit(QDateTime::currentDateTime().addSecs(-3600)); // Default 1 hour ago
+    m_startTimeEdit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
+    controlLayout->addWidget(m_startTimeEdit);
+
+    controlLayout->addWidget(new QLabel("End:"));
+    m_endTimeEdit = new QDateTimeEdit(QDateTime::currentDateTime());
+    m_endTimeEdit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
+    controlLayout->addWidget(m_endTimeEdit);
+
+    m_queryBtn = new QPushButton("Query Database");
+    controlLayout->addWidget(m_queryBtn);
+    
+    controlLayout->addSpacing(20);
+
+    m_autoScaleYCheck = new QCheckBox("Auto Y");
+    m_autoScaleYCheck->setChecked(true);
+    controlLayout->addWidget(m_autoScaleYCheck);
+
+    controlLayout->addWidget(new QLabel("Max Y:"));
+    m_yMaxSpin = new QDoubleSpinBox();
+    m_yMaxSpin->setDecimals(3);
+    m_yMaxSpin->setRange(0.01, 10000);
+    m_yMaxSpin->setValue(100);
+    m_yMaxSpin->setEnabled(false); // Disabled when Auto is on
+    controlLayout->addWidget(m_yMaxSpin);
+    
+    controlLayout->addStretch();
+
+    mainLayout->addLayout(controlLayout);
+
+    // Chart
+    m_chart = new QChart();
+    m_chart->setTitle(QString("RTT for %1").arg(m_target));
+    // m_chart->legend()->hide(); // Show legend for Success/Timeout distinction
+
+    m_series = new QLineSeries();
+    m_series->setName("Success");
+    m_chart->addSeries(m_series);
+
+    m_timeoutSeries = new QLineSeries();
+    m_timeoutSeries->setName("Timeout");
+    m_timeoutSeries->setColor(Qt::red);
+    m_chart->addSeries(m_timeoutSeries);
+
+    m_axisX = new QDateTimeAxis();
+    m_axisX->setFormat("HH:mm:ss");
+    m_axisX->setTitleText("Time");
+    m_chart->addAxis(m_axisX, Qt::AlignBottom);
+    m_series->attachAxis(m_axisX);
+    m_timeoutSeries->attachAxis(m_axisX);
+
+    m_axisY = new QValueAxis();
+    m_axisY->setTitleText("RTT (ms)");
+    m_axisY->setRange(0, m_timeoutMs * 1.2); // Initial range based on timeout
+    m_chart->addAxis(m_axisY, Qt::AlignLeft);
+    m_series->attachAxis(m_axisY);
+    m_timeoutSeries->attachAxis(m_axisY);
+
+    InteractiveChartView *chartView = new InteractiveChartView(m_chart);
+    chartView->setRenderHint(QPainter::Antialiasing);
+    
+    mainLayout->addWidget(chartView);
+
+    connect(chartView, &InteractiveChartView::userRangeChanged, this, &ChartWindow::onViewChanged);
+    connect(m_chart, &QChart::plotAreaChanged, this, &ChartWindow::onViewChanged);
+    connect(m_queryBtn, &QPushButton::clicked, this, &ChartWindow::onQueryClicked);
+    connect(m_autoScaleYCheck, &QCheckBox::stateChanged, this, &ChartWindow::onAutoScaleYChanged);
+    connect(m_yMaxSpin, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &ChartWindow::onYMaxChanged);
+}
+
+bool ChartWindow::showsLive() const
+{
+    return m_endTimeEdit->dateTime() > QDateTime::currentDateTime().addSecs(-10);
+}
+
+void ChartWindow::onQueryClicked()
+{
+    loadFromDatabase(m_startTimeEdit->dateTime(), m_endTimeEdit->dateTime());
+}
+
+void ChartWindow::loadFromDatabase(const QDateTime &start, const QDateTime &end)
+{
+    // Tiles shown so far go; cached ones come straight back
+    releaseTiles();
+    m_history = true;
+    m_axisX->setRange(start, end);
+    if (m_autoScaleYCheck->isChecked()) {
+        m_axisY->setRange(0, 0.1);
+    }
+    loadView();
+    scheduleRebuild();
+}
+
+void ChartWindow::loadView()
+{
+    if (!m_history) return;
+    qint64 from = m_axisX->min().toMSecsSinceEpoch();
+    qint64 to = m_axisX->max().toMSecsSinceEpoch();
+    if (to <= from) return;
+
+    // Whole buckets once there are more than pixels to put them in
+    int pixels = int(m_chart->plotArea().width());
+    Rollups::Resolution level = Rollups::pick(to - from, pixels > 0 ? pixels : width());
+    if (level != m_level) {
+        releaseTiles();
+        m_level = level;
+        scheduleRebuild();
+    }
+
+    // The tiles in view, then one more on either side for panning; the
+    // rest are let go
+    qint64 tileMs = ChartTileCache::tileMs(level);
+    qint64 first = from / tileMs;
+    qint64 last = to / tileMs;
+    QVector<qint64> unused;
+    for (qint64 index : m_tiles) {
+        if (index < first - 1 || index > last + 1) {
+            unused << index;
+        }
+    }
+    for (qint64 index : unused) {
+        m_data->releaseTile(level, index);
+        m_tiles.remove(index);
+    }
+
+    QVector<qint64> wanted;
+    for (qint64 index = first; index <= last; ++index) {
+        wanted << index;
+    }
+    wanted << first - 1 << last + 1;
+    for (qint64 index : wanted) {
+        if (m_tiles.contains(index)) continue;
+        // Cached, or shared with another window viewing it
+        m_data->useTile(level, index);
+        m_tiles.insert(index);
+        const ChartTileCache::Tile *tile = m_data->tile(level, index);
+        if (!tile->rows.isEmpty() || !tile->buckets.isEmpty()) {
+            scheduleRebuild();
+        }
+    }
+    updateTitle();
+}
+
+void ChartWindow::releaseTiles()
+{
+    for (qint64 index : m_tiles) {
+        m_data->releaseTile(m_level, index);
+    }
+    m_tiles.clear();
+}
+
+void ChartWindow::onTileChanged(Rollups::Resolution level, qint64 index)
+{
+    if (level != m_level || !m_tiles.contains(index)) return;
+    scheduleRebuild();
+    updateTitle();
+}
+
+void ChartWindow::onViewChanged()
+{
+    m_redrawPending = true;
+    requestFrame();
+    loadView();
+}
+
+void ChartWindow::scheduleRebuild()
+{
+    // Once for however many chunks arrive in a frame
+    m_rebuildPending = true;
+    requestFrame();
+}
+
+void ChartWindow::rebuild()
+{
+    m_rebuildPending = false;
+    m_replies.clear();
+    m_timeouts.clear();
+    qint64 loadedUntil = -1;        // Latest start the tiles account for
+    for (qint64 index : m_tiles) {
+        const ChartTileCache::Tile *tile = m_data->tile(m_level, index);
+        if (tile->resolution == Rollups::Raw) {
+            addRows(tile->rows);
+            for (const ColumnSample &row : tile->rows) {
+                loadedUntil = qMax(loadedUntil, row.startTime);
+            }
+        } else {
+            addBuckets(tile->resolution, tile->buckets);
+            if (!tile->buckets.isEmpty()) {
+                loadedUntil = qMax(loadedUntil, tile->buckets.last().start + Rollups::widthMs(tile->resolution) - 1);
+            }
+        }
+    }
+    if (showsLive()) {
+        // The tiles around now already hold the older part of the live
+        // window; only what came after them is added
+        const LiveWindow &live = m_data->live();
+        for (int i = 0; i < live.size(); ++i) {
+            if (live.at(i).startTime > loadedUntil) {
+                addSample(live.at(i));
+            }
+        }
+    }
+    m_liveDropped = 0;
+    m_redrawPending = true;
+    qint64 from = m_axisX->min().toMSecsSinceEpoch();
+    qint64 to = m_axisX->max().toMSecsSinceEpoch();
+    growAxisY(qMax(m_replies.maxIn(from, to), m_timeouts.maxIn(from, to)));
+}
+
+void ChartWindow::addRows(const QVector<ColumnSample> &rows)
+{
+    for (const ColumnSample &row : rows) {
+        addSample(row);
+    }
+}
+
+void ChartWindow::addSample(const ColumnSample &sample)
+{
+    if (sample.startTime <= 0 || sample.returnTime <= 0) return;
+    if (sample.rttNs >= 0) {
+        m_replies.add(sample.startTime, sample.returnTime, sample.rttNs / 1000000.0); // ms, sub-ms precision
+    } else {
+        // Timeout
+        m_timeouts.add(sample.startTime, sample.returnTime, sample.timeoutMs > 0 ? sample.timeoutMs : m_timeoutMs);
+    }
+}
+
+void ChartWindow::addBuckets(Rollups::Resolution resolution, const QVector<ChartQueryService::BucketRow> &buckets)
+{
+    qint64 width = Rollups::widthMs(resolution);
+    for (const ChartQueryService::BucketRow &row : buckets) {
+        // The slowest reply of each bucket, so spikes survive
+        if (row.bucket.replies() > 0) {
+            m_replies.add(row.start, row.start + width, row.bucket.maxNs / 1000000.0);
+        }
+        if (row.bucket.loss > 0) {
+            m_timeouts.add(row.start, row.start + width, m_timeoutMs);
+        }
+    }
+}
+
+void ChartWindow::updateTitle()
+{
+    // Stats over the tiles in view once they are all in
+    qint64 tileMs = ChartTileCache::tileMs(m_level);
+    qint64 first = m_axisX->min().toMSecsSinceEpoch() / tileMs;
+    qint64 last = m_axisX->max().toMSecsSinceEpoch() / tileMs;
+    Rollups::Resolution resolution = m_level;
+    Rollups::Bucket stats;
+    for (qint64 index : m_tiles) {
+        if (index < first || index > last) continue;
+        const ChartTileCache::Tile *tile = m_data->tile(m_level, index);
+        if (!tile->loaded) {
+            m_chart->setTitle(QString("RTT for %1  -  loading...").arg(m_target));
+            return;
+        }
+        stats.merge(tile->stats);
+        if (tile->resolution == Rollups::Raw) resolution = Rollups::Raw;
+    }
+    showStats(resolution, stats);
+}
+
+void ChartWindow::redraw()
+{
+    m_redrawPending = false;
+    // Only what is in view, a few points per pixel; replace() hands the
+    // series its new points in one go
+    qint64 from = m_axisX->min().toMSecsSinceEpoch();
+    qint64 to = m_axisX->max().toMSecsSinceEpoch();
+    int pixels = int(m_chart->plotArea().width());
+    if (pixels <= 0) pixels = width();
+    m_series->replace(m_replies.points(from, to, pixels, m_replyStyle));
+    m_timeoutSeries->replace(m_timeouts.points(from, to, pixels, ChartDecimator::Spikes));
+}
+
+void ChartWindow::growAxisY(double maxY)
+{
+    if (!m_autoScaleYCheck->isChecked() || maxY * 1.2 <= m_axisY->max()) return;
+    double newMax = maxY * 1.2;
+    m_yMaxSpin->blockSignals(true);
+    m_yMaxSpin->setValue(newMax);
+    m_yMaxSpin->blockSignals(false);
+    m_axisY->setRange(0, newMax);
+}
+
+void ChartWindow::showStats(Rollups::Resolution resolution, const Rollups::Bucket &stats)
+{
+    QString title = QString("RTT for %1").arg(m_target);
+    if (stats.count > 0) {
+        title += QString("  -  %1 probes, %2% lost").arg(stats.count).arg(100.0 * stats.loss / stats.count, 0, 'f', 2);
+    }
+    if (stats.replies() > 0) {
+        title += QString(", avg %1 ms, sd %2 ms, p50 %3 ms, p99 %4 ms, max %5 ms")
+                     .arg(stats.meanNs() / 1000000.0, 0, 'f', 3)
+                     .arg(stats.stddevNs() / 1000000.0, 0, 'f', 3)
+                     .arg(stats.sketch.quantile(0.5) / 1000000.0, 0, 'f', 3)
+                     .arg(stats.sketch.quantile(0.99) / 1000000.0, 0, 'f', 3)
+                     .arg(stats.maxNs / 1000000.0, 0, 'f', 3);
+    }
+    if (resolution != Rollups::Raw) {
+        title += QString(" (max per %1 s)").arg(Rollups::widthMs(resolution) / 1000);
+    }
+    m_chart->setTitle(title);
+}
+
+void ChartWindow::updateAxisRange()
+{
+    m_axisPending = false;
+    if (m_replies.count() == 0 && m_timeouts.count() == 0) return;
+
+    // Stored data is shown where it was asked for; only live data alone
+    // moves the view, and then its extent and peak are known without a scan
+    qint64 firstTime = m_axisX->min().toMSecsSinceEpoch();
+    qint64 lastTime = m_axisX->max().toMSecsSinceEpoch();
+    if (!m_history) {
+        firstTime = m_data->live().firstStart();
+        lastTime = m_data->live().lastEnd();
+    }
+
+    // Ensure some width
+    if (lastTime <= firstTime) {
+        if (firstTime == -1) {
+             firstTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
+             lastTime = firstTime + 1000;
+        } else {
+             firstTime -= 1000;
+             lastTime += 1000;
+        }
+    }
+    
+    m_axisX->setRange(QDateTime::fromMSecsSinceEpoch(firstTime), QDateTime::fromMSecsSinceEpoch(lastTime));
+    m_redrawPending = true;
+    
+    if (m_autoScaleYCheck->isChecked()) {
+        double maxY = m_history ? qMax(m_replies.maxIn(firstTime, lastTime), m_timeouts.maxIn(firstTime, lastTime))
+                                : m_data->live().maxValue();
+        double newMax = maxY * 1.2;
+        if (newMax < 0.1) newMax = 0.1; // Minimum range; LAN RTTs are often sub-millisecond
+        
+        // Block signals to prevent feedback loop if we were to update spinbox here
+        // Actually, let's update spinbox to reflect current auto scale
+        m_yMaxSpin->blockSignals(true);
+        m_yMaxSpin->setValue(newMax);
+        m_yMaxSpin->blockSignals(false);
+        
+        m_axisY->setRange(0, newMax);
+    } else {
+        // Manual mode, use spinbox value
+        m_axisY->setRange(0, m_yMaxSpin->value());
+    }
+}
+
+void ChartWindow::onAutoScaleYChanged(int state)
+{
+    bool autoScale = (state == Qt::Checked);
+    m_yMaxSpin->setEnabled(!autoScale);
+    
+    if (autoScale) {
+        m_axisPending = true;
+        requestFrame();
+    } else {
+        // If switching to manual, keep current value or use spinbox value?
+        // Spinbox already has value.
+        m_axisY->setRange(0, m_yMaxSpin->value());
+    }
+}
+
+void ChartWindow::onYMaxChanged(double value)
+{
+    if (!m_autoScaleYCheck->isChecked()) {
+        m_axisY->setRange(0, value);
+    }
+}
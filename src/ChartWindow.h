@@ -1,74 +1,135 @@
-#ifndef CHARTWINDOW_H
-#define CHARTWINDOW_H
-
-#include <QMainWindow>
-#include <QtCharts/QChartView>
-#include <QtCharts/QChartGlobal>
-#include <QtCharts/QLineSeries>
-#include <QtCharts/QDateTimeAxis>
-#include <QDateTimeEdit>
-#include <QPushButton>
-#include <QCheckBox>
-#include <QSpinBox>
-#include <QtCharts/QValueAxis>
-
-// using namespace QtCharts; // Namespace issue, trying global or macro handling
-
-class InteractiveChartView : public QChartView
-{
-public:
-    InteractiveChartView(QChart *chart, QWidget *parent = nullptr)
-        : QChartView(chart, parent)
-        , m_isDragging(false)
-    {}
-
-protected:
-    void wheelEvent(QWheelEvent *event) override;
-    void mousePressEvent(QMouseEvent *event) override;
-    void mouseMoveEvent(QMouseEvent *event) override;
-    void mouseReleaseEvent(QMouseEvent *event) override;
-
-private:
-    bool m_isDragging;
-    QPoint m_lastMousePos;
-};
-
-class ChartWindow : public QMainWindow
-{
-    Q_OBJECT
-
-public:
-public:
-    explicit ChartWindow(const QString &target, int timeoutMs, QObject *parent = nullptr);
-    ~ChartWindow();
-
-public slots:
-    void onNewResult(QString target, int rtt, int ttl, int seq, qint64 startTime, qint64 returnTime, int timeoutMs);
-    void onQueryClicked();
-
-private:
-    void setupUi();
-    void updateAxisRange();
-    void loadFromDatabase(const QDateTime &start, const QDateTime &end);
-
-    QString m_target;
-    int m_timeoutMs;
-    QChart *m_chart;
-    QLineSeries *m_series;        // Success pings
-    QLineSeries *m_timeoutSeries; // Timeout pings
-    QDateTimeAxis *m_axisX;
-    QValueAxis *m_axisY;
-    
-    QDateTimeEdit *m_startTimeEdit;
-    QDateTimeEdit *m_endTimeEdit;
-    QPushButton *m_queryBtn;
-    
-    QCheckBox *m_autoScaleYCheck;
-    QSpinBox *m_yMaxSpin;
-
-private slots:
-    void onYMaxChanged(int value);
-    void onAutoScaleYChanged(int state);
-};
-
-#endif // CHARTWINDOW_H
+#ifndef CHARTWINDOW_H
+#define CHARTWINDOW_H
+
+#include <QMainWindow>
+#include <QtCharts/QChartView>
+#include <QtCharts/QChartGlobal>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QDateTimeAxis>
+#include <QDateTimeEdit>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QSpinBox>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+#include <QtCharts/QValueAxis>
+#include "ChartDecimator.h"
+#include "ChartHistory.h"
+#include "ResultRing.h"
+#include "Rollups.h"
+
+// using namespace QtCharts; // Namespace issue, trying global or macro handling
+
+class InteractiveChartView : public QChartView
+{
+    Q_OBJECT
+
+public:
+    InteractiveChartView(QChart *chart, QWidget *parent = nullptr)
+        : QChartView(chart, parent)
+        , m_isDragging(false)
+    {}
+
+protected:
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+signals:
+    // The time axis was zoomed or panned by hand.
+    void userRangeChanged();
+
+private:
+    bool m_isDragging;
+    QPoint m_lastMousePos;
+};
+
+class ChartWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+public:
+    explicit ChartWindow(const QString &target, int timeoutMs, QObject *parent = nullptr);
+    ~ChartWindow();
+
+    // Plots the live results carrying targetId (our target's TargetRegistry
+    // id) from ring; ring must outlive the window. The target's other
+    // windows share them.
+    void setResultRing(ResultRing *ring, quint32 targetId);
+
+public slots:
+    void onQueryClicked();
+
+private:
+    void setupUi();
+    void updateAxisRange();
+    // Shows the stored data of [start, end], tile by tile.
+    void loadFromDatabase(const QDateTime &start, const QDateTime &end);
+    // Picks the tile level for the view and uses the tiles in and around
+    // it, letting go of the rest.
+    void loadView();
+    void releaseTiles();
+    void scheduleRebuild();
+    // Has onFrame run at the next display refresh, once however often asked.
+    void requestFrame();
+    // Adds raw probes as they are, buckets as their slowest reply and any
+    // loss.
+    void addRows(const QVector<ColumnSample> &rows);
+    void addSample(const ColumnSample &sample);
+    void addBuckets(Rollups::Resolution resolution, const QVector<ChartQueryService::BucketRow> &buckets);
+    // Raises the auto-scaled Y axis to fit maxY.
+    void growAxisY(double maxY);
+    // Stats of the tiles in view, or that they are loading.
+    void updateTitle();
+    // Summary of the loaded range in the chart title.
+    void showStats(Rollups::Resolution resolution, const Rollups::Bucket &stats);
+    // Whether live results are plotted: the range asked for reaches now.
+    bool showsLive() const;
+    // Puts what is in view into the series, decimated.
+    void redraw();
+    // Refills the decimators from the tiles and live results.
+    void rebuild();
+
+    QString m_target;
+    int m_timeoutMs;
+    ChartHistory *m_data;         // Shared with the target's other windows
+    QTimer *m_frameTimer;
+    int m_frameMs;                // Display refresh interval
+    QChart *m_chart;
+    bool m_history;               // Stored data asked for, so views load tiles
+    Rollups::Resolution m_level;  // Of the tiles shown
+    QSet<qint64> m_tiles;         // Indexes of the tiles used at m_level
+    int m_liveDropped;            // Out of the live window but still in the decimators
+    // Done once at the next frame
+    bool m_rebuildPending;
+    bool m_axisPending;
+    bool m_redrawPending;
+    ChartDecimator m_replies;     // Everything shown, the series only show it decimated
+    ChartDecimator m_timeouts;
+    ChartDecimator::Style m_replyStyle;
+    QLineSeries *m_series;        // Success pings
+    QLineSeries *m_timeoutSeries; // Timeout pings
+    QDateTimeAxis *m_axisX;
+    QValueAxis *m_axisY;
+    
+    QDateTimeEdit *m_startTimeEdit;
+    QDateTimeEdit *m_endTimeEdit;
+    QPushButton *m_queryBtn;
+    
+    QCheckBox *m_autoScaleYCheck;
+    QDoubleSpinBox *m_yMaxSpin;
+
+private slots:
+    void onLiveAppended(int count, int dropped);
+    void onTileChanged(Rollups::Resolution level, qint64 index);
+    void onViewChanged();
+    // Does whatever is pending: rebuild, then axes, then redraw.
+    void onFrame();
+    void onYMaxChanged(double value);
+    void onAutoScaleYChanged(int state);
+};
+
+#endif // CHARTWINDOW_H
@@ -0,0 +1,495 @@
+#include "ColumnStore.h"
+#include "Varint.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QSettings>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const quint32 CHUNK_MAGIC = 0x4c4f4350;     // "PCOL"
+enum { COLUMNS = 6 };                       // starts, durations, rtts, seqs, timeouts, flags
+const int HEADER_BYTES = 4 + 4 + 8 + 4 * COLUMNS;
+const int FLAG_BITS = 10;                   // TTL, then a 2-bit status
+
+// Status bits of a sample; anything else negative keeps its RTT as well
+enum Status { Reply, Timeout, ResolveError, OtherError };
+
+static_assert(sizeof(ColumnStore::ChunkEntry) == 40, "chunks.idx entries are written as they are");
+
+} // namespace
+
+QString ColumnStore::configuredDirectory()
+{
+    QSettings settings("MyCompany", "PingTool");
+    if (!settings.value("storage/columnStore", false).toBool()) {
+        return QString();
+    }
+    return QCoreApplication::applicationDirPath() + "/pinglog.cols";
+}
+
+ColumnStoreWriter::ColumnStoreWriter(const QString &directory)
+    : m_directory(directory)
+{
+}
+
+ColumnStoreWriter::~ColumnStoreWriter()
+{
+    sealAll();
+}
+
+bool ColumnStoreWriter::open()
+{
+    if (!QDir().mkpath(m_directory)) {
+        qWarning() << "Failed to create column store" << m_directory;
+        return false;
+    }
+    QDir dir(m_directory);
+
+    m_targets.setFileName(dir.filePath("targets.txt"));
+    if (m_targets.open(QIODevice::ReadOnly)) {
+        quint32 id = 0;
+        while (!m_targets.atEnd()) {
+            QByteArray line = m_targets.readLine();
+            if (!line.endsWith('\n')) break;    // Cut short by a crash
+            m_ids.insert(QString::fromUtf8(line.chopped(1)), id++);
+        }
+        m_targets.close();
+    }
+    if (!m_targets.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Failed to open" << m_targets.fileName() << m_targets.errorString();
+        return false;
+    }
+
+    // Only whole index entries count, and chunk bytes past the last one
+    // were never indexed
+    m_index.setFileName(dir.filePath("chunks.idx"));
+    if (!m_index.open(QIODevice::ReadWrite)) {
+        qWarning() << "Failed to open" << m_index.fileName() << m_index.errorString();
+        return false;
+    }
+    qint64 entries = m_index.size() / qint64(sizeof(ColumnStore::ChunkEntry));
+    m_index.resize(entries * qint64(sizeof(ColumnStore::ChunkEntry)));
+    quint64 end = 0;
+    if (entries > 0) {
+        ColumnStore::ChunkEntry last;
+        m_index.seek((entries - 1) * qint64(sizeof(last)));
+        m_index.read(reinterpret_cast<char *>(&last), sizeof(last));
+        end = last.offset + last.bytes;
+    }
+    m_index.seek(m_index.size());
+
+    m_data.setFileName(dir.filePath("chunks.dat"));
+    if (!m_data.open(QIODevice::ReadWrite)) {
+        qWarning() << "Failed to open" << m_data.fileName() << m_data.errorString();
+        m_index.close();
+        return false;
+    }
+    m_data.resize(qint64(end));
+    m_data.seek(qint64(end));
+    return true;
+}
+
+quint32 ColumnStoreWriter::targetId(const QString &name)
+{
+    auto it = m_ids.constFind(name);
+    if (it != m_ids.constEnd()) {
+        return it.value();
+    }
+    // On disk before any chunk can refer to it
+    quint32 id = quint32(m_ids.size());
+    m_ids.insert(name, id);
+    m_targets.write(name.toUtf8() + '\n');
+    m_targets.flush();
+    return id;
+}
+
+void ColumnStoreWriter::addRun(QByteArray &out, ColumnStore::Run &run, qint64 value)
+{
+    if (run.length > 0 && run.value == value) {
+        ++run.length;
+        return;
+    }
+    endRun(out, run);
+    run.value = value;
+    run.length = 1;
+}
+
+void ColumnStoreWriter::endRun(QByteArray &out, ColumnStore::Run &run)
+{
+    if (run.length > 0) {
+        Varint::put(out, Varint::zigzag(run.value));
+        Varint::put(out, run.length);
+        run.length = 0;
+    }
+}
+
+void ColumnStoreWriter::append(quint32 targetId, const ColumnSample &sample)
+{
+    OpenChunk &chunk = m_open[targetId];
+    if (chunk.count == 0) {
+        chunk.base = sample.startTime;
+        chunk.prevStart = sample.startTime;
+        chunk.prevDelta = 0;
+        chunk.firstStart = sample.startTime;
+        chunk.lastStart = sample.startTime;
+        chunk.openedAt = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    // Probes go out at a steady interval, so the delta of the delta is
+    // mostly 0 and a byte
+    qint64 delta = sample.startTime - chunk.prevStart;
+    Varint::put(chunk.starts, Varint::zigzag(delta - chunk.prevDelta));
+    chunk.prevStart = sample.startTime;
+    chunk.prevDelta = delta;
+    Varint::put(chunk.durations, Varint::zigzag(sample.returnTime - sample.startTime));
+
+    quint32 status = Reply;
+    if (sample.rttNs == -1) {
+        status = Timeout;
+    } else if (sample.rttNs == -2) {
+        status = ResolveError;
+    } else if (sample.rttNs < 0) {
+        status = OtherError;
+    }
+    if (status == Reply || status == OtherError) {
+        Varint::put(chunk.rtts, Varint::zigzag(sample.rttNs));
+    }
+
+    // Sequence numbers step by one and the timeout hardly ever changes
+    addRun(chunk.seqs, chunk.seqRun, qint64(sample.seq) - chunk.prevSeq);
+    chunk.prevSeq = sample.seq;
+    addRun(chunk.timeouts, chunk.timeoutRun, sample.timeoutMs);
+
+    chunk.bits |= (quint32(qBound(0, sample.ttl, 255)) | status << 8) << chunk.bitCount;
+    chunk.bitCount += FLAG_BITS;
+    while (chunk.bitCount >= 8) {
+        chunk.flags.append(char(chunk.bits & 0xff));
+        chunk.bits >>= 8;
+        chunk.bitCount -= 8;
+    }
+
+    chunk.firstStart = qMin(chunk.firstStart, sample.startTime);
+    chunk.lastStart = qMax(chunk.lastStart, sample.startTime);
+    if (++chunk.count >= ColumnStore::ChunkSamples) {
+        seal(targetId);
+    }
+}
+
+void ColumnStoreWriter::sealOlderThan(qint64 nowMs)
+{
+    QVector<quint32> due;
+    for (auto it = m_open.constBegin(); it != m_open.constEnd(); ++it) {
+        if (it.value().openedAt <= nowMs - ColumnStore::SealAfterMs) {
+            due.append(it.key());
+        }
+    }
+    for (quint32 targetId : due) {
+        seal(targetId);
+    }
+}
+
+void ColumnStoreWriter::sealAll()
+{
+    const QList<quint32> targets = m_open.keys();
+    for (quint32 targetId : targets) {
+        seal(targetId);
+    }
+}
+
+qint64 ColumnStoreWriter::bytesWritten() const
+{
+    return m_data.isOpen() ? m_data.size() + m_index.size() : 0;
+}
+
+void ColumnStoreWriter::seal(quint32 targetId)
+{
+    auto it = m_open.find(targetId);
+    if (it == m_open.end()) return;
+    OpenChunk &chunk = it.value();
+    if (chunk.count == 0 || !m_data.isOpen()) {
+        m_open.erase(it);
+        return;
+    }
+
+    // Runs still being counted and the last partial byte of flags
+    endRun(chunk.seqs, chunk.seqRun);
+    endRun(chunk.timeouts, chunk.timeoutRun);
+    if (chunk.bitCount > 0) {
+        chunk.flags.append(char(chunk.bits & 0xff));
+    }
+
+    const QByteArray *columns[COLUMNS] = { &chunk.starts, &chunk.durations, &chunk.rtts,
+                                           &chunk.seqs, &chunk.timeouts, &chunk.flags };
+    QByteArray body;
+    int bytes = HEADER_BYTES;
+    for (const QByteArray *column : columns) {
+        bytes += column->size();
+    }
+    body.reserve(bytes);
+    auto putRaw = [&body](const void *value, int size) {
+        body.append(static_cast<const char *>(value), size);
+    };
+    putRaw(&CHUNK_MAGIC, 4);
+    putRaw(&chunk.count, 4);
+    putRaw(&chunk.base, 8);
+    for (const QByteArray *column : columns) {
+        quint32 size = quint32(column->size());
+        putRaw(&size, 4);
+    }
+    for (const QByteArray *column : columns) {
+        body.append(*column);
+    }
+
+    ColumnStore::ChunkEntry entry;
+    entry.target = targetId;
+    entry.count = chunk.count;
+    entry.firstStart = chunk.firstStart;
+    entry.lastStart = chunk.lastStart;
+    entry.offset = quint64(m_data.pos());
+    entry.bytes = quint32(body.size());
+    entry.flags = m_continued.contains(targetId) ? 0 : ColumnStore::Resumed;
+
+    // The chunk is complete on disk before the index points at it
+    if (m_data.write(body) != body.size() || !m_data.flush()) {
+        qWarning() << "Column store write failed:" << m_data.errorString();
+        m_data.seek(qint64(entry.offset));
+        m_continued.remove(targetId);
+    } else {
+        m_index.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+        m_index.flush();
+        m_continued.insert(targetId);
+    }
+    m_open.erase(it);
+}
+
+ColumnStoreReader::ColumnStoreReader(const QString &directory)
+    : m_directory(directory)
+    , m_map(nullptr)
+    , m_mapped(0)
+    , m_indexRead(0)
+    , m_targetsRead(0)
+{
+}
+
+ColumnStoreReader::~ColumnStoreReader()
+{
+    if (m_map) {
+        m_data.unmap(m_map);
+    }
+}
+
+bool ColumnStoreReader::refresh()
+{
+    QDir dir(m_directory);
+    if (!m_index.isOpen()) {
+        m_index.setFileName(dir.filePath("chunks.idx"));
+        m_data.setFileName(dir.filePath("chunks.dat"));
+        if (!m_index.open(QIODevice::ReadOnly) || !m_data.open(QIODevice::ReadOnly)) {
+            m_index.close();
+            return false;
+        }
+    }
+
+    // Names first, so every new entry's target is known
+    QFile targets(dir.filePath("targets.txt"));
+    if (targets.open(QIODevice::ReadOnly) && targets.seek(m_targetsRead)) {
+        QByteArray text = targets.readAll();
+        int from = 0;
+        for (int end = text.indexOf('\n'); end >= 0; from = end + 1, end = text.indexOf('\n', from)) {
+            m_ids.insert(QString::fromUtf8(text.mid(from, end - from)), m_ids.size());
+        }
+        m_targetsRead += from;
+    }
+
+    qint64 available = (m_index.size() - m_indexRead) / qint64(sizeof(ColumnStore::ChunkEntry));
+    if (available > 0 && m_index.seek(m_indexRead)) {
+        QByteArray raw = m_index.read(available * qint64(sizeof(ColumnStore::ChunkEntry)));
+        int entries = raw.size() / int(sizeof(ColumnStore::ChunkEntry));
+        quint64 end = 0;
+        for (int i = 0; i < entries; ++i) {
+            ColumnStore::ChunkEntry entry;
+            std::memcpy(&entry, raw.constData() + i * sizeof(entry), sizeof(entry));
+            if (entry.target >= quint32(m_chunks.size())) {
+                m_chunks.resize(int(entry.target) + 1);
+            }
+            m_chunks[int(entry.target)].append(entry);
+            end = qMax(end, entry.offset + entry.bytes);
+        }
+        m_indexRead += qint64(entries) * qint64(sizeof(ColumnStore::ChunkEntry));
+
+        // Sealed chunks never change, so a new mapping is only needed once
+        // they run past the old one
+        if (qint64(end) > m_mapped) {
+            if (m_map) {
+                m_data.unmap(m_map);
+                m_map = nullptr;
+                m_mapped = 0;
+            }
+            qint64 size = m_data.size();
+            m_map = size > 0 ? m_data.map(0, size) : nullptr;
+            m_mapped = m_map ? size : 0;
+            if (!m_map) {
+                qWarning() << "Failed to map" << m_data.fileName() << m_data.errorString();
+            }
+        }
+    }
+    return true;
+}
+
+int ColumnStoreReader::idOf(const QString &target) const
+{
+    auto it = m_ids.constFind(target);
+    if (it == m_ids.constEnd() || it.value() >= m_chunks.size()) {
+        return -1;
+    }
+    return it.value();
+}
+
+QVector<ColumnStore::Span> ColumnStoreReader::covered(const QString &target, qint64 from, qint64 to) const
+{
+    QVector<ColumnStore::Span> spans;
+    int id = idOf(target);
+    if (id < 0) return spans;
+
+    // A chunk that carries on from the one before extends its stretch;
+    // a Resumed one, or the first, opens a new one
+    for (const ColumnStore::ChunkEntry &entry : m_chunks.at(id)) {
+        if (spans.isEmpty() || (entry.flags & ColumnStore::Resumed)) {
+            spans.append({ entry.firstStart, entry.lastStart });
+        } else {
+            ColumnStore::Span &span = spans.last();
+            span.from = qMin(span.from, entry.firstStart);
+            span.to = qMax(span.to, entry.lastStart);
+        }
+    }
+
+    // Stretches from different runs can overlap if the clock was put back
+    auto byFrom = [](const ColumnStore::Span &a, const ColumnStore::Span &b) { return a.from < b.from; };
+    std::sort(spans.begin(), spans.end(), byFrom);
+    QVector<ColumnStore::Span> clipped;
+    for (const ColumnStore::Span &span : spans) {
+        if (span.to < from || span.from > to) continue;
+        ColumnStore::Span part = { qMax(span.from, from), qMin(span.to, to) };
+        if (!clipped.isEmpty() && part.from <= clipped.last().to + 1) {
+            clipped.last().to = qMax(clipped.last().to, part.to);
+        } else {
+            clipped.append(part);
+        }
+    }
+    return clipped;
+}
+
+QVector<ColumnSample> ColumnStoreReader::scan(const QString &target, qint64 from, qint64 to) const
+{
+    QVector<ColumnSample> samples;
+    int id = idOf(target);
+    if (id < 0) return samples;
+
+    // The index alone rules out most chunks of a long history
+    for (const ColumnStore::ChunkEntry &entry : m_chunks.at(id)) {
+        if (entry.lastStart < from || entry.firstStart > to) continue;
+        if (!decode(entry, from, to, samples)) {
+            qWarning() << "Damaged column store chunk at" << entry.offset;
+        }
+    }
+
+    // Replies can come back out of order, and chunks overlap when a
+    // target's probes change interval
+    auto byStart = [](const ColumnSample &a, const ColumnSample &b) { return a.startTime < b.startTime; };
+    if (!std::is_sorted(samples.constBegin(), samples.constEnd(), byStart)) {
+        std::stable_sort(samples.begin(), samples.end(), byStart);
+    }
+    return samples;
+}
+
+bool ColumnStoreReader::decode(const ColumnStore::ChunkEntry &entry, qint64 from, qint64 to,
+                               QVector<ColumnSample> &out) const
+{
+    if (!m_map || entry.bytes < quint32(HEADER_BYTES) || qint64(entry.offset + entry.bytes) > m_mapped) {
+        return false;
+    }
+    const uchar *chunk = m_map + entry.offset;
+    quint32 magic;
+    quint32 count;
+    qint64 start;
+    quint32 sizes[COLUMNS];
+    std::memcpy(&magic, chunk, 4);
+    std::memcpy(&count, chunk + 4, 4);
+    std::memcpy(&start, chunk + 8, 8);
+    std::memcpy(sizes, chunk + 16, sizeof(sizes));
+    if (magic != CHUNK_MAGIC || count != entry.count) {
+        return false;
+    }
+
+    const uchar *columns[COLUMNS];
+    qint64 offset = HEADER_BYTES;
+    for (int c = 0; c < COLUMNS; ++c) {
+        columns[c] = chunk + offset;
+        offset += sizes[c];
+    }
+    if (offset > qint64(entry.bytes) || qint64(sizes[5]) * 8 < qint64(count) * FLAG_BITS) {
+        return false;
+    }
+
+    qint64 pos[COLUMNS] = {};
+    qint64 delta = 0;
+    qint32 seq = 0;
+    ColumnStore::Run seqRun;
+    ColumnStore::Run timeoutRun;
+    auto nextRun = [&](int column, ColumnStore::Run &run) {
+        if (run.length == 0) {
+            quint64 value;
+            if (!Varint::get(columns[column], sizes[column], pos[column], value)
+                || !Varint::get(columns[column], sizes[column], pos[column], run.length) || run.length == 0) {
+                return false;
+            }
+            run.value = Varint::unzigzag(value);
+        }
+        --run.length;
+        return true;
+    };
+
+    out.reserve(out.size() + int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        quint64 value;
+        ColumnSample sample;
+        if (!Varint::get(columns[0], sizes[0], pos[0], value)) return false;
+        delta += Varint::unzigzag(value);
+        start += delta;
+        sample.startTime = start;
+        if (!Varint::get(columns[1], sizes[1], pos[1], value)) return false;
+        sample.returnTime = start + Varint::unzigzag(value);
+
+        qint64 bit = qint64(i) * FLAG_BITS;
+        quint32 bits = quint32(columns[5][bit / 8]);
+        if (bit / 8 + 1 < qint64(sizes[5])) bits |= quint32(columns[5][bit / 8 + 1]) << 8;
+        bits = (bits >> (bit % 8)) & ((1u << FLAG_BITS) - 1);
+        sample.ttl = qint32(bits & 0xff);
+        switch (bits >> 8) {
+        case Timeout:
+            sample.rttNs = -1;
+            break;
+        case ResolveError:
+            sample.rttNs = -2;
+            break;
+        default:
+            if (!Varint::get(columns[2], sizes[2], pos[2], value)) return false;
+            sample.rttNs = Varint::unzigzag(value);
+            break;
+        }
+
+        if (!nextRun(3, seqRun) || !nextRun(4, timeoutRun)) return false;
+        seq += qint32(seqRun.value);
+        sample.seq = seq;
+        sample.timeoutMs = qint32(timeoutRun.value);
+
+        if (start >= from && start <= to) {
+            out.append(sample);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,168 @@
+#ifndef COLUMNSTORE_H
+#define COLUMNSTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// One stored probe.
+struct ColumnSample {
+    qint64 startTime;   // ms since epoch
+    qint64 returnTime;
+    qint64 rttNs;       // -1 timeout, -2 resolve error
+    qint32 ttl;
+    qint32 seq;
+    qint32 timeoutMs;
+};
+
+// Append-only store of probe results, an optional companion to ping_log
+// (setting "storage/columnStore"). Every target's results are collected
+// into a chunk of up to ChunkSamples, column by column:
+//
+//   start time   delta of delta, zigzag varint
+//   duration     return - start, zigzag varint
+//   RTT          ns, varint, replies only
+//   seq          step from the previous one, run-length coded
+//   timeout      run-length coded
+//   TTL, status  10 bits a sample, packed
+//
+// A chunk is sealed once full or SealAfterMs old: appended to chunks.dat
+// and described by a fixed-size entry in chunks.idx. Chunks still open at
+// a crash are lost, so the store only vouches for the stretches between
+// its sealed chunks that follow on from one another; ping_log has the rest. Target names are the
+// lines of targets.txt, an entry's target being the line number. Readers
+// map chunks.dat and decode straight out of the mapping; a sealed chunk is
+// never written again, so they need no locking against the writer.
+class ColumnStore
+{
+public:
+    enum { ChunkSamples = 4096, SealAfterMs = 60 * 1000 };
+    // Set on the first chunk a writer seals for a target, and on the next
+    // one after a failed write: whatever came just before it may be lost.
+    enum ChunkFlag { Resumed = 1 };
+
+    // The "storage/columnStore" setting: pinglog.cols next to the
+    // executable when set, empty when not.
+    static QString configuredDirectory();
+
+    // What chunks.idx holds for every chunk.
+    struct ChunkEntry {
+        quint32 target;
+        quint32 count;
+        qint64 firstStart;      // Earliest and latest start in the chunk
+        qint64 lastStart;
+        quint64 offset;         // In chunks.dat
+        quint32 bytes;
+        quint32 flags;          // ChunkFlag bits
+    };
+
+    // A stretch of start times, both ends included.
+    struct Span {
+        qint64 from;
+        qint64 to;
+    };
+
+    // A value and how many times in a row it came up.
+    struct Run {
+        qint64 value = 0;
+        quint64 length = 0;
+    };
+};
+
+// The single writer of a store directory.
+class ColumnStoreWriter
+{
+public:
+    explicit ColumnStoreWriter(const QString &directory);
+    // Seals whatever is open.
+    ~ColumnStoreWriter();
+
+    // Creates the directory if needed and drops anything a crash left
+    // written past the last indexed chunk.
+    bool open();
+    bool isOpen() const { return m_data.isOpen(); }
+
+    // The store's id for a target name, added on first use.
+    quint32 targetId(const QString &name);
+    void append(quint32 targetId, const ColumnSample &sample);
+    // Seals chunks opened before nowMs - SealAfterMs.
+    void sealOlderThan(qint64 nowMs);
+    void sealAll();
+
+    qint64 bytesWritten() const;
+
+private:
+    struct OpenChunk {
+        QByteArray starts;
+        QByteArray durations;
+        QByteArray rtts;
+        QByteArray seqs;
+        QByteArray timeouts;
+        QByteArray flags;
+        qint64 base = 0;        // The first start, where the deltas count from
+        qint64 prevStart = 0;
+        qint64 prevDelta = 0;
+        qint32 prevSeq = 0;
+        qint32 prevTimeout = 0;
+        ColumnStore::Run seqRun;
+        ColumnStore::Run timeoutRun;
+        quint32 bits = 0;       // Pending flag bits, low first
+        int bitCount = 0;
+        quint32 count = 0;
+        qint64 firstStart = 0;
+        qint64 lastStart = 0;
+        qint64 openedAt = 0;    // Wall clock, ms
+    };
+
+    static void addRun(QByteArray &out, ColumnStore::Run &run, qint64 value);
+    static void endRun(QByteArray &out, ColumnStore::Run &run);
+    void seal(quint32 targetId);
+
+    QString m_directory;
+    QFile m_data;
+    QFile m_index;
+    QFile m_targets;
+    QHash<QString, quint32> m_ids;
+    QHash<quint32, OpenChunk> m_open;
+    QSet<quint32> m_continued;      // Targets whose last chunk this writer sealed
+};
+
+// Reads a store while the writer keeps appending to it. Not thread-safe;
+// each user keeps its own.
+class ColumnStoreReader
+{
+public:
+    explicit ColumnStoreReader(const QString &directory);
+    ~ColumnStoreReader();
+
+    // Picks up chunks sealed since the last call, mapping chunks.dat again
+    // if it grew. False if there is no store.
+    bool refresh();
+
+    // The stretches of [from, to], in order, over which the sealed chunks
+    // hold every sample of target: from a chunk that isn't Resumed back to
+    // the one before. Samples outside them, if any, are only in ping_log.
+    QVector<ColumnStore::Span> covered(const QString &target, qint64 from, qint64 to) const;
+    // Every sealed sample of target starting within [from, to], in start
+    // order.
+    QVector<ColumnSample> scan(const QString &target, qint64 from, qint64 to) const;
+
+private:
+    // Decodes one chunk, keeping the samples within [from, to].
+    bool decode(const ColumnStore::ChunkEntry &entry, qint64 from, qint64 to, QVector<ColumnSample> &out) const;
+    int idOf(const QString &target) const;
+
+    QString m_directory;
+    QFile m_data;
+    QFile m_index;
+    uchar *m_map;
+    qint64 m_mapped;
+    qint64 m_indexRead;             // Bytes of chunks.idx taken in
+    qint64 m_targetsRead;           // Bytes of targets.txt taken in
+    QHash<QString, int> m_ids;
+    QVector<QVector<ColumnStore::ChunkEntry>> m_chunks;  // By target, in file order
+};
+
+#endif // COLUMNSTORE_H
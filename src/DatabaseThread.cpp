@@ -1,152 +1,662 @@
-#include "DatabaseThread.h"
-#include <QSqlError>
-#include <QDebug>
-#include <QStandardPaths>
-#include <QDir>
-#include "DatabaseThread.h"
-#include <QSqlError>
-#include <QDebug>
-#include <QStandardPaths>
-#include <QDir>
-#include <QCoreApplication>
-
-DatabaseThread::DatabaseThread(QObject *parent)
-    : QThread(parent)
-    , m_running(true)
-    , m_batchCount(0)
-    , m_totalGenerated(0)
-    , m_totalWritten(0)
-{
-}
-
-DatabaseThread::~DatabaseThread()
-{
-    stop();
-    wait();
-}
-
-void DatabaseThread::stop()
-{
-    {
-        QMutexLocker locker(&m_mutex);
-        m_running = false;
-        m_cond.wakeOne();
-    }
-}
-
-void DatabaseThread::saveResult(QString target, int rtt, int ttl, int seq, qint64 startTime, qint64 returnTime, int timeoutMs)
-{
-    QMutexLocker locker(&m_mutex);
-    LogEntry entry;
-    entry.target = target;
-    entry.rtt = rtt;
-    entry.ttl = ttl;
-    entry.seq = seq;
-    entry.startTime = startTime;
-    entry.returnTime = returnTime;
-    entry.timeoutMs = timeoutMs;
-    // entry.timestamp = QDateTime::currentDateTime(); // Use returnTime as timestamp reference if needed
-    
-    m_queue.append(entry);
-    
-    m_totalGenerated++;
-    emit statusUpdated(m_totalGenerated, m_totalWritten, "Pending");
-    
-    m_cond.wakeOne();
-}
-
-void DatabaseThread::run()
-{
-    // Initialize DB in this thread
-    m_db = QSqlDatabase::addDatabase("QSQLITE", "PingLogConnection");
-    
-    // Use application directory for easier access
-    QString dbPath = QCoreApplication::applicationDirPath();
-    QString dbFile = dbPath + "/pinglog.db";
-    
-    qDebug() << "Database file path:" << dbFile;
-    
-    m_db.setDatabaseName(dbFile);
-
-    if (!m_db.open()) {
-        qCritical() << "Failed to open database:" << m_db.lastError().text();
-        return;
-    }
-
-    QSqlQuery query(m_db);
-    // Create table if not exists (basic schema)
-    if (!query.exec("CREATE TABLE IF NOT EXISTS ping_log ("
-                    "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                    "timestamp DATETIME, "
-                    "target TEXT, "
-                    "rtt INTEGER, "
-                    "ttl INTEGER, "
-                    "seq INTEGER)")) {
-        qCritical() << "Failed to create table:" << query.lastError().text();
-    }
-
-    // Ensure new columns exist (idempotent-ish in SQLite via separate statements, ignoring errors if exist)
-    query.exec("ALTER TABLE ping_log ADD COLUMN start_time INTEGER");
-    query.exec("ALTER TABLE ping_log ADD COLUMN return_time INTEGER");
-    query.exec("ALTER TABLE ping_log ADD COLUMN timeout_val INTEGER");
-
-    m_db.transaction();
-
-    while (true) {
-        QList<LogEntry> currentBatch;
-        {
-            QMutexLocker locker(&m_mutex);
-            if (!m_running && m_queue.isEmpty()) {
-                break;
-            }
-            if (m_queue.isEmpty()) {
-                m_cond.wait(&m_mutex, 1000); // Wait or timeout to commit partial batch
-            }
-            currentBatch = m_queue;
-            m_queue.clear();
-        }
-
-        if (!currentBatch.isEmpty()) {
-            QSqlQuery insertQuery(m_db);
-            insertQuery.prepare("INSERT INTO ping_log (timestamp, target, rtt, ttl, seq, start_time, return_time, timeout_val) "
-                                "VALUES (:ts, :target, :rtt, :ttl, :seq, :start, :ret, :tmo)");
-            
-            for (const auto &entry : currentBatch) {
-                // Use returnTime as the main timestamp for compatibility/display
-                insertQuery.bindValue(":ts", QDateTime::fromMSecsSinceEpoch(entry.returnTime));
-                insertQuery.bindValue(":target", entry.target);
-                insertQuery.bindValue(":rtt", entry.rtt);
-                insertQuery.bindValue(":ttl", entry.ttl);
-                insertQuery.bindValue(":seq", entry.seq);
-                insertQuery.bindValue(":start", entry.startTime);
-                insertQuery.bindValue(":ret", entry.returnTime);
-                insertQuery.bindValue(":tmo", entry.timeoutMs);
-                insertQuery.exec();
-                
-                m_totalWritten++;
-                m_batchCount++;
-                
-                if (m_batchCount >= BATCH_SIZE) {
-                    m_db.commit();
-                    m_db.transaction();
-                    m_batchCount = 0;
-                    emit statusUpdated(m_totalGenerated, m_totalWritten, "Committed");
-                }
-            }
-            // Emit update after batch processing if not committed yet
-            if (m_batchCount > 0) {
-                emit statusUpdated(m_totalGenerated, m_totalWritten, QString("Writing (%1/%2)").arg(m_batchCount).arg(BATCH_SIZE));
-            }
-        } else {
-            // If queue was empty (timeout), we just continue waiting.
-            // We only commit when BATCH_SIZE is reached or on exit.
-        }
-    }
-
-    // Final commit
-    if (m_batchCount > 0) {
-        m_db.commit();
-        emit statusUpdated(m_totalGenerated, m_totalWritten, "Committed (Exit)");
-    }
-    m_db.close();
-}
+#include "DatabaseThread.h"
+#include "LogSchema.h"
+#include "ProbeTarget.h"
+#include <QSqlError>
+#include <QDebug>
+#include <QStandardPaths>
+#include <QDir>
+#include <QCoreApplication>
+#include <QSettings>
+#include <algorithm>
+
+namespace {
+
+const int DRAIN_INTERVAL_MS = 50;   // Ring poll period while idle
+const int DRAIN_BATCH = 4096;
+const int BACKLOG_ROWS = 1 << 20;   // Read from the ring ahead of SQLite, about 40 MB
+const int STATUS_INTERVAL_MS = 250; // Between statusUpdated signals
+const int CACHE_KB = 16 * 1024;     // SQLite page cache
+const int MIGRATE_CHUNK = 5000;     // Old rows moved per step
+const int MIGRATE_RETRY_MS = 5000;  // After a step failed
+const int REBUILD_CHUNK = 20000;    // Raw rows rolled up per step, at least
+const int ROLLUP_WRITE_MS = 1000;   // Between rollup writes while busy
+const int SEAL_CHECK_MS = 1000;     // Between looks for column chunks to seal
+const qint64 HOUR_MS = 60 * 60 * 1000;
+
+} // namespace
+
+DatabaseThread::DatabaseThread(QObject *parent)
+    : QThread(parent)
+    , m_ring(nullptr)
+    , m_reader(-1)
+    , m_targets(nullptr)
+    , m_path(QCoreApplication::applicationDirPath() + "/pinglog.db")
+    , m_columnDirectory(ColumnStore::configuredDirectory())
+    , m_columns(nullptr)
+    , m_policy(configuredFlushPolicy())
+    , m_partitionPolicy(LogPartitions::configuredPolicy())
+    , m_compactor(nullptr)
+    , m_stopCompacting(false)
+    , m_running(true)
+    , m_pendingRows(0)
+    , m_migrating(false)
+    , m_migratedRows(0)
+    , m_rebuilding(false)
+    , m_rebuiltRows(0)
+    , m_totalGenerated(0)
+    , m_totalWritten(0)
+    , m_backlogHead(0)
+    , m_failedRows(0)
+{
+}
+
+DatabaseThread::~DatabaseThread()
+{
+    stop();
+    wait();
+    if (m_ring) {
+        m_ring->removeReader(m_reader);
+    }
+}
+
+void DatabaseThread::setResultRing(ResultRing *ring)
+{
+    if (m_ring) {
+        m_ring->removeReader(m_reader);
+    }
+    m_ring = ring;
+    m_reader = ring ? ring->addReader() : -1;
+}
+
+DatabaseThread::FlushPolicy DatabaseThread::configuredFlushPolicy()
+{
+    QSettings settings("MyCompany", "PingTool");
+    FlushPolicy policy;
+    policy.maxRows = qMax(1, settings.value("database/flushRows", policy.maxRows).toInt());
+    policy.maxDelayMs = qMax(1, settings.value("database/flushMs", policy.maxDelayMs).toInt());
+    return policy;
+}
+
+void DatabaseThread::setFlushPolicy(const FlushPolicy &policy)
+{
+    m_policy.maxRows = qMax(1, policy.maxRows);
+    m_policy.maxDelayMs = qMax(1, policy.maxDelayMs);
+}
+
+void DatabaseThread::setDatabasePath(const QString &path)
+{
+    m_path = path;
+}
+
+void DatabaseThread::setPartitionPolicy(const LogPartitions::Policy &policy)
+{
+    m_partitionPolicy.hours = qMax(0, policy.hours);
+    m_partitionPolicy.retentionDays = qMax(0, policy.retentionDays);
+}
+
+void DatabaseThread::setColumnStoreDirectory(const QString &directory)
+{
+    m_columnDirectory = directory;
+}
+
+DatabaseThread::Stats DatabaseThread::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void DatabaseThread::setTargetRegistry(TargetRegistry *targets)
+{
+    m_targets = targets;
+    m_targetDbIds.clear();
+}
+
+void DatabaseThread::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_running = false;
+        m_cond.wakeOne();
+    }
+}
+
+qint64 DatabaseThread::targetDbId(quint32 id)
+{
+    if (id >= quint32(m_targetDbIds.size())) {
+        m_targetDbIds.resize(int(id) + 1, 0);
+    }
+    qint64 &dbId = m_targetDbIds[int(id)];
+    if (dbId > 0 || !m_targets) {
+        return dbId > 0 ? dbId : -1;
+    }
+
+    // Registry ids only live as long as the process; the targets table
+    // gives each name an id that stays the same across runs. The probe type
+    // is a property of the name, so it is stored there rather than per row.
+    QString name = m_targets->name(id);
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR IGNORE INTO targets (name, probe_type) VALUES (:name, :type)");
+    query.bindValue(":name", name);
+    query.bindValue(":type", QString::fromLatin1(ProbeTarget::typeName(ProbeTarget::typeOf(name))));
+    query.exec();
+    query.prepare("SELECT id FROM targets WHERE name = :name");
+    query.bindValue(":name", name);
+    if (query.exec() && query.next()) {
+        dbId = query.value(0).toLongLong();
+        return dbId;
+    }
+    qWarning() << "Failed to look up target" << name << query.lastError().text();
+    return -1;
+}
+
+void DatabaseThread::migrate()
+{
+    if (!LogSchema::upgrade(m_db)) {
+        qCritical() << "Failed to upgrade the database schema";
+    }
+    m_migrating = LogSchema::hasLegacyRows(m_db);
+    m_migratedRows = 0;
+    m_migrateRetry.invalidate();
+}
+
+void DatabaseThread::migrateStep()
+{
+    // Inside the open transaction if there is one, so the step lands with
+    // the next commit; its own otherwise
+    bool own = m_pendingRows == 0;
+    if (own) {
+        m_db.transaction();
+    }
+    int moved = LogSchema::migrateChunk(m_db, MIGRATE_CHUNK);
+    if (moved < 0) {
+        // Still migrating; tried again on an idle pass a little later
+        if (own) {
+            m_db.rollback();
+        }
+        m_migrateRetry.start();
+        emitStatus(QString("Migrating old rows (%1 moved), retrying").arg(m_migratedRows), true);
+        return;
+    }
+    m_migrateRetry.invalidate();
+    if (own && !m_db.commit()) {
+        qWarning() << "Commit failed:" << m_db.lastError().text();
+    }
+    if (moved == 0) {
+        m_migrating = false;
+        emitStatus(QString("Migrated %1 old rows").arg(m_migratedRows), true);
+        return;
+    }
+    m_migratedRows += moved;
+    emitStatus(QString("Migrating old rows (%1 moved)").arg(m_migratedRows), false);
+}
+
+void DatabaseThread::rebuildStep()
+{
+    // The rebuild attaches partitions, which needs no transaction open
+    if (m_pendingRows > 0) {
+        commit();
+    }
+    int rows = m_rollups.rebuildStep(m_db, LogPartitions::directoryFor(m_path), REBUILD_CHUNK);
+    if (rows == 0) {
+        m_rebuilding = false;
+        emitStatus(QString("Rebuilt rollups of %1 rows").arg(m_rebuiltRows), true);
+        return;
+    }
+    m_rebuiltRows += rows;
+    emitStatus(QString("Rebuilding rollups (%1 rows)").arg(m_rebuiltRows), false);
+}
+
+void DatabaseThread::writeRollups()
+{
+    bool own = m_pendingRows == 0;
+    if (own) {
+        m_db.transaction();
+    }
+    m_rollups.write(m_db);
+    m_rollupTimer.restart();
+    if (own && !m_db.commit()) {
+        qWarning() << "Commit failed:" << m_db.lastError().text();
+    }
+}
+
+void DatabaseThread::run()
+{
+    // Initialize DB in this thread
+    m_db = QSqlDatabase::addDatabase("QSQLITE", "PingLogConnection");
+    
+    qDebug() << "Database file path:" << m_path;
+
+    m_db.setDatabaseName(m_path);
+
+    if (!m_db.open()) {
+        qCritical() << "Failed to open database:" << m_db.lastError().text();
+        return;
+    }
+
+    QSqlQuery query(m_db);
+    // WAL lets the chart windows read while we write, and a commit is one
+    // append to the log instead of a rewrite of the pages. NORMAL only
+    // syncs at checkpoints: a power cut can lose the last commits but never
+    // corrupts the file.
+    if (!query.exec("PRAGMA journal_mode=WAL") || !query.next() || query.value(0).toString() != "wal") {
+        qWarning() << "WAL mode unavailable, using the default journal";
+    }
+    query.exec("PRAGMA synchronous=NORMAL");
+    query.exec(QString("PRAGMA cache_size=-%1").arg(CACHE_KB));
+    query.exec("PRAGMA temp_store=MEMORY");
+
+    migrate();
+    m_targetDbIds.clear();
+    m_rollups.clear();
+    m_rebuilding = Rollups::isRebuilding(m_db);
+    m_rebuiltRows = 0;
+    m_rollupTimer.start();
+
+    if (!m_columnDirectory.isEmpty()) {
+        m_columns = new ColumnStoreWriter(m_columnDirectory);
+        if (!m_columns->open()) {
+            delete m_columns;
+            m_columns = nullptr;
+        }
+    }
+    m_columnIds.clear();
+    m_sealTimer.start();
+
+    // Cached for the whole run; a batch binds numbers only
+    m_insertOne = QSqlQuery(m_db);
+    m_insertMany = QSqlQuery(m_db);
+    prepareInserts(m_insertOne, m_insertMany, "ping_log");
+    if (m_partitionPolicy.hours > 0) {
+        m_partitionDirectory = LogPartitions::directoryFor(m_path);
+        maintainPartitions();
+    }
+    m_statusTimer.start();
+
+    QVector<ProbeResult> buffer(DRAIN_BATCH);
+    while (true) {
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_running) {
+                break;
+            }
+        }
+        int count = drainBatch(buffer);
+        if (m_pendingRows > 0 && m_pendingSince.elapsed() >= m_policy.maxDelayMs) {
+            commit();
+        }
+        if (!m_heldStatus.isEmpty()) {
+            emitStatus(m_heldStatus, false);
+        }
+        if (m_columns && m_sealTimer.elapsed() >= SEAL_CHECK_MS) {
+            m_columns->sealOlderThan(QDateTime::currentMSecsSinceEpoch());
+            m_sealTimer.restart();
+        }
+        bool migrateDue = m_migrating && (!m_migrateRetry.isValid() || m_migrateRetry.elapsed() >= MIGRATE_RETRY_MS);
+        if (count < buffer.size() && migrateDue) {
+            // Caught up: move some old rows, then look at the ring again
+            migrateStep();
+        } else if (count < buffer.size() && m_rebuilding && !m_migrating) {
+            // Rollups only once every old row is in ping_log
+            rebuildStep();
+        } else if (count < buffer.size()) {
+            if (m_pendingRows == 0 && m_rollups.hasDirty()) {
+                // Idle: nothing will commit them for us
+                writeRollups();
+            }
+            // Caught up; poll again shortly, or when the open transaction is
+            // due, unless stop() wakes us
+            int waitMs = DRAIN_INTERVAL_MS;
+            if (m_pendingRows > 0) {
+                waitMs = int(qBound<qint64>(1, m_policy.maxDelayMs - m_pendingSince.elapsed(), waitMs));
+            }
+            QMutexLocker locker(&m_mutex);
+            if (m_running) {
+                m_cond.wait(&m_mutex, waitMs);
+            }
+        }
+    }
+
+    // Whatever was published before stop(), within one ring and one
+    // backlog's worth
+    for (int drained = 0; m_ring && drained < m_ring->capacity() + BACKLOG_ROWS; ) {
+        int count = drainBatch(buffer);
+        drained += count;
+        if (count < buffer.size()) break;
+    }
+
+    // Final commit
+    if (m_rollups.hasDirty()) {
+        writeRollups();
+    }
+    if (m_pendingRows > 0) {
+        commit();
+        emitStatus("Committed (Exit)", true);
+    }
+    // Seals whatever is still open
+    delete m_columns;
+    m_columns = nullptr;
+    stopCompactor();
+    for (AttachedPartition &slot : m_partitions) {
+        slot.insertOne = QSqlQuery();
+        slot.insertMany = QSqlQuery();
+        slot.attached = false;
+    }
+    m_insertOne = QSqlQuery();
+    m_insertMany = QSqlQuery();
+    m_db.close();
+    // Let a later thread open the connection name again cleanly
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase("PingLogConnection");
+}
+
+bool DatabaseThread::prepareInserts(QSqlQuery &one, QSqlQuery &many, const QString &table)
+{
+    const QString columns = QString("INSERT INTO %1 (target_id, start_time, seq, return_time, rtt, rtt_ns, ttl, timeout_val) VALUES ").arg(table);
+    const QString row = "(?, ?, ?, ?, ?, ?, ?, ?)";
+    QStringList rows;
+    for (int i = 0; i < ROWS_PER_INSERT; ++i) {
+        rows << row;
+    }
+    if (!one.prepare(columns + row) || !many.prepare(columns + rows.join(", "))) {
+        qCritical() << "Failed to prepare inserts:" << many.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+DatabaseThread::AttachedPartition *DatabaseThread::partitionFor(qint64 startTime)
+{
+    if (m_partitionPolicy.hours <= 0) return nullptr;
+    AttachedPartition *slot = nullptr;
+    for (AttachedPartition &candidate : m_partitions) {
+        if (candidate.attached && candidate.partition.contains(startTime)) {
+            return &candidate;
+        }
+        // A free slot, or else the one with the oldest partition
+        if (!slot || (slot->attached && (!candidate.attached || candidate.partition.start < slot->partition.start))) {
+            slot = &candidate;
+        }
+    }
+
+    // ATTACH and DETACH are refused inside a transaction
+    if (m_pendingRows > 0) {
+        commit();
+    }
+    QString schema = QString("part%1").arg(int(slot - m_partitions));
+    if (slot->attached) {
+        slot->insertOne = QSqlQuery();
+        slot->insertMany = QSqlQuery();
+        slot->attached = false;
+        LogPartitions::detach(m_db, schema);
+    }
+    slot->partition = LogPartitions::partitionAt(m_partitionDirectory, startTime, m_partitionPolicy.hours);
+    if (!LogPartitions::attach(m_db, slot->partition, schema)) {
+        return nullptr;
+    }
+    slot->insertOne = QSqlQuery(m_db);
+    slot->insertMany = QSqlQuery(m_db);
+    if (!prepareInserts(slot->insertOne, slot->insertMany, schema + ".ping_log")) {
+        slot->insertOne = QSqlQuery();
+        slot->insertMany = QSqlQuery();
+        LogPartitions::detach(m_db, schema);
+        return nullptr;
+    }
+    slot->attached = true;
+    maintainPartitions();
+    return slot;
+}
+
+void DatabaseThread::maintainPartitions()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (m_partitionPolicy.retentionDays > 0) {
+        QStringList attached;
+        for (const AttachedPartition &slot : m_partitions) {
+            if (slot.attached) attached << slot.partition.path;
+        }
+        int dropped = LogPartitions::dropBefore(m_partitionDirectory, now - m_partitionPolicy.retentionDays * 24 * HOUR_MS, attached);
+        if (dropped > 0) {
+            emitStatus(QString("Dropped %1 old partitions").arg(dropped), true);
+        }
+    }
+
+    // Everything before the last partition is done being written
+    if (m_compactor && !m_compactor->isFinished()) return;
+    delete m_compactor;
+    qint64 before = LogPartitions::partitionAt(m_partitionDirectory, now, m_partitionPolicy.hours).start
+                    - m_partitionPolicy.hours * HOUR_MS;
+    QString directory = m_partitionDirectory;
+    m_stopCompacting = false;
+    m_compactor = QThread::create([this, directory, before] {
+        LogPartitions::compactBefore(directory, before, m_stopCompacting);
+    });
+    m_compactor->start(QThread::LowestPriority);
+}
+
+void DatabaseThread::stopCompactor()
+{
+    if (!m_compactor) return;
+    // A vacuum under way still runs to the end
+    m_stopCompacting = true;
+    m_compactor->wait();
+    delete m_compactor;
+    m_compactor = nullptr;
+}
+
+void DatabaseThread::bindRow(QSqlQuery &query, int &param, const ProbeResult &entry, qint64 target)
+{
+    query.bindValue(param++, target);
+    query.bindValue(param++, entry.startTime);
+    query.bindValue(param++, entry.seq);
+    query.bindValue(param++, entry.returnTime);
+    query.bindValue(param++, entry.rttNs >= 0 ? (entry.rttNs + 500000) / 1000000 : entry.rttNs);
+    query.bindValue(param++, entry.rttNs);
+    query.bindValue(param++, entry.ttl);
+    query.bindValue(param++, entry.timeoutMs);
+}
+
+int DatabaseThread::insertRows(QSqlQuery &one, QSqlQuery &many, const ProbeResult *batch, int first, int count)
+{
+    bool known = true;
+    for (int i = first; i < first + count && known; ++i) {
+        known = targetDbId(batch[i].targetId) > 0;
+    }
+    if (count == ROWS_PER_INSERT && known) {
+        int param = 0;
+        for (int i = first; i < first + count; ++i) {
+            bindRow(many, param, batch[i], targetDbId(batch[i].targetId));
+        }
+        // A plain INSERT: it either writes every row or none
+        if (many.exec()) {
+            for (int i = first; i < first + count; ++i) {
+                m_rollups.add(m_db, targetDbId(batch[i].targetId), batch[i].startTime, batch[i].rttNs);
+            }
+            return count;
+        }
+        // One duplicate key fails the whole statement, which then inserts
+        // nothing; find the rows that do go in one at a time
+    }
+
+    int inserted = 0;
+    for (int i = first; i < first + count; ++i) {
+        const ProbeResult &entry = batch[i];
+        qint64 target = targetDbId(entry.targetId);
+        if (target <= 0) {
+            // Under a made-up id it would collide with other targets' rows;
+            // the lookup is tried again for the next one
+            m_failedRows++;
+            continue;
+        }
+        int param = 0;
+        bindRow(one, param, entry, target);
+        if (!one.exec() || one.numRowsAffected() != 1) {
+            qWarning() << "Insert failed:" << one.lastError().text();
+            m_failedRows++;
+            continue;
+        }
+        m_rollups.add(m_db, target, entry.startTime, entry.rttNs);
+        inserted++;
+    }
+    return inserted;
+}
+
+void DatabaseThread::appendColumns(const ProbeResult *batch, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const ProbeResult &entry = batch[i];
+        if (entry.targetId >= quint32(m_columnIds.size())) {
+            m_columnIds.resize(int(entry.targetId) + 1, -1);
+        }
+        qint64 &id = m_columnIds[int(entry.targetId)];
+        if (id < 0) {
+            if (!m_targets) continue;
+            id = m_columns->targetId(m_targets->name(entry.targetId));
+        }
+        ColumnSample sample;
+        sample.startTime = entry.startTime;
+        sample.returnTime = entry.returnTime;
+        sample.rttNs = entry.rttNs;
+        sample.ttl = entry.ttl;
+        sample.seq = entry.seq;
+        sample.timeoutMs = entry.timeoutMs;
+        m_columns->append(quint32(id), sample);
+    }
+}
+
+void DatabaseThread::commit()
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (m_rollups.hasDirty() && m_rollupTimer.elapsed() >= ROLLUP_WRITE_MS) {
+        writeRollups();
+    }
+    if (!m_db.commit()) {
+        qWarning() << "Commit failed:" << m_db.lastError().text();
+    }
+    double ms = timer.nsecsElapsed() / 1e6;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stats.rowsCommitted += m_pendingRows;
+        m_stats.commits++;
+        m_stats.lastCommitMs = ms;
+        m_stats.avgCommitMs += (ms - m_stats.avgCommitMs) / m_stats.commits;
+        m_stats.maxCommitMs = qMax(m_stats.maxCommitMs, ms);
+    }
+    m_pendingRows = 0;
+    // A commit is the longest we go without reading the ring
+    pullRing();
+    emitStatus(QString("Committed (%1 ms, max %2 ms)").arg(ms, 0, 'f', 1).arg(m_stats.maxCommitMs, 0, 'f', 1), false);
+}
+
+void DatabaseThread::emitStatus(const QString &action, bool force)
+{
+    if (!force && m_statusTimer.elapsed() < STATUS_INTERVAL_MS) {
+        m_heldStatus = action;
+        return;
+    }
+    m_heldStatus.clear();
+    m_statusTimer.restart();
+    emit statusUpdated(m_totalGenerated, m_totalWritten, action);
+}
+
+void DatabaseThread::pullRing()
+{
+    // Everything the ring holds, so it isn't lapped while SQLite is busy.
+    // Producers never wait for us: with the backlog full, whatever the ring
+    // overwrites before we get to it is counted as lost
+    if (!m_ring) return;
+    while (m_backlog.size() - m_backlogHead < BACKLOG_ROWS) {
+        int old = m_backlog.size();
+        int want = qMin(DRAIN_BATCH, BACKLOG_ROWS - (old - m_backlogHead));
+        m_backlog.resize(old + want);
+        int count = m_ring->read(m_reader, m_backlog.data() + old, want);
+        m_backlog.resize(old + count);
+        if (count < want) break;
+    }
+}
+
+int DatabaseThread::drainBatch(QVector<ProbeResult> &buffer)
+{
+    if (!m_ring) return 0;
+    pullRing();
+    int count = qMin(buffer.size(), m_backlog.size() - m_backlogHead);
+    if (count == 0) return 0;
+    std::copy(m_backlog.constBegin() + m_backlogHead, m_backlog.constBegin() + m_backlogHead + count, buffer.begin());
+    m_backlogHead += count;
+    if (m_backlogHead == m_backlog.size()) {
+        m_backlog.clear();
+        m_backlogHead = 0;
+    } else if (m_backlogHead > m_backlog.size() / 2) {
+        m_backlog.remove(0, m_backlogHead);
+        m_backlogHead = 0;
+    }
+    m_totalGenerated += count;
+    if (m_columns) {
+        appendColumns(buffer.constData(), count);
+    }
+
+    int done = 0;
+    while (done < count) {
+        // Rows go to the partition their start falls in; a batch seldom
+        // spans more than one
+        QSqlQuery *insertOne = &m_insertOne;
+        QSqlQuery *insertMany = &m_insertMany;
+        int end = count;
+        if (AttachedPartition *partition = partitionFor(buffer.at(done).startTime)) {
+            insertOne = &partition->insertOne;
+            insertMany = &partition->insertMany;
+            end = done + 1;
+            while (end < count && partition->partition.contains(buffer.at(end).startTime)) {
+                ++end;
+            }
+        }
+
+        // Open a transaction only when there is something to write, so none
+        // sits open while the probes are idle
+        if (m_pendingRows == 0) {
+            m_db.transaction();
+            m_pendingSince.start();
+        }
+
+        // Whole statements while they fit before the next commit is due,
+        // single rows for the rest. Only rows that made it in count as
+        // written; failed ones are counted apart
+        int chunk = qMin(end - done, m_policy.maxRows - m_pendingRows);
+        if (chunk >= ROWS_PER_INSERT) {
+            chunk = ROWS_PER_INSERT;
+        }
+        int inserted = insertRows(*insertOne, *insertMany, buffer.constData(), done, chunk);
+        done += chunk;
+        m_totalWritten += inserted;
+        m_pendingRows += inserted;
+        if (m_pendingRows == 0) {
+            // Nothing went in; don't leave an empty transaction open
+            m_db.rollback();
+        } else if (m_pendingRows >= m_policy.maxRows) {
+            commit();
+        }
+    }
+
+    quint64 lost = m_ring->overflowed(m_reader);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stats.lost = lost;
+        m_stats.backlog = m_backlog.size() - m_backlogHead;
+        m_stats.failed = m_failedRows;
+    }
+    if (m_pendingRows > 0) {
+        QString action = QString("Writing (%1/%2)").arg(m_pendingRows).arg(m_policy.maxRows);
+        if (m_backlog.size() > m_backlogHead) {
+            action += QString(", backlog %1").arg(m_backlog.size() - m_backlogHead);
+        }
+        if (lost > 0) {
+            action += QString(", lost %1").arg(lost);
+        }
+        if (m_failedRows > 0) {
+            action += QString(", failed %1").arg(m_failedRows);
+        }
+        emitStatus(action, false);
+    }
+    return count;
+}
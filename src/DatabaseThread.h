@@ -1,56 +1,167 @@
-#ifndef DATABASETHREAD_H
-#define DATABASETHREAD_H
-
-#include <QThread>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QMutex>
-#include <QList>
-#include <QDateTime>
-#include <QWaitCondition>
-
-struct LogEntry {
-    QString target;
-    int rtt;
-    int ttl;
-    int seq;
-    qint64 startTime;
-    qint64 returnTime;
-    int timeoutMs;
-};
-
-class DatabaseThread : public QThread
-{
-    Q_OBJECT
-public:
-    explicit DatabaseThread(QObject *parent = nullptr);
-    ~DatabaseThread();
-
-    void stop();
-
-signals:
-    void statusUpdated(long long generated, long long written, QString lastAction);
-
-public slots:
-    void saveResult(QString target, int rtt, int ttl, int seq, qint64 startTime, qint64 returnTime, int timeoutMs);
-
-protected:
-    void run() override;
-
-private:
-    void processQueue();
-    void commitTransaction();
-
-    QSqlDatabase m_db;
-    QList<LogEntry> m_queue;
-    QMutex m_mutex;
-    QWaitCondition m_cond;
-    bool m_running;
-    int m_batchCount;
-    const int BATCH_SIZE = 500;
-    
-    long long m_totalGenerated;
-    long long m_totalWritten;
-};
-
-#endif // DATABASETHREAD_H
+#ifndef DATABASETHREAD_H
+#define DATABASETHREAD_H
+
+#include <QThread>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QMutex>
+#include <QVector>
+#include <QDateTime>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <atomic>
+#include "ColumnStore.h"
+#include "LogPartitions.h"
+#include "ResultRing.h"
+#include "Rollups.h"
+#include "TargetRegistry.h"
+
+class DatabaseThread : public QThread
+{
+    Q_OBJECT
+public:
+    // Rows are committed once maxRows are pending or the oldest pending
+    // row is maxDelayMs old, whichever comes first.
+    struct FlushPolicy {
+        int maxRows = 500;
+        int maxDelayMs = 1000;
+    };
+
+    struct Stats {
+        long long rowsCommitted = 0;
+        long long commits = 0;
+        double lastCommitMs = 0;
+        double avgCommitMs = 0;
+        double maxCommitMs = 0;
+        quint64 lost = 0;       // Results overwritten in the ring before we read them
+        int backlog = 0;        // Read from the ring but not inserted yet
+        quint64 failed = 0;     // Rows not inserted: duplicate key, unknown target, SQL error
+    };
+
+    explicit DatabaseThread(QObject *parent = nullptr);
+    ~DatabaseThread();
+
+    // The "database/flushRows" and "database/flushMs" settings.
+    static FlushPolicy configuredFlushPolicy();
+
+    // Call before start().
+    void setFlushPolicy(const FlushPolicy &policy);
+    // Defaults to pinglog.db next to the executable; call before start().
+    void setDatabasePath(const QString &path);
+    // Defaults to the "database/partitionHours" and "database/retentionDays"
+    // settings; call before start().
+    void setPartitionPolicy(const LogPartitions::Policy &policy);
+    // Also append every result to a ColumnStore there; empty, the default
+    // unless "storage/columnStore" is set, for none. Call before start().
+    void setColumnStoreDirectory(const QString &directory);
+
+    // Every result pushed into ring from now on gets written; call before
+    // start(). ring must outlive the thread.
+    void setResultRing(ResultRing *ring);
+    // Names for the ring's target ids; call before start(). targets must
+    // outlive the thread.
+    void setTargetRegistry(TargetRegistry *targets);
+
+    void stop();
+
+    // Thread-safe.
+    Stats stats() const;
+
+signals:
+    // At most a few times a second, and once more on exit.
+    void statusUpdated(long long generated, long long written, QString lastAction);
+
+protected:
+    void run() override;
+
+private:
+    enum { ROWS_PER_INSERT = 64 };  // 8 parameters each, well under SQLite's limit
+    enum { ATTACHED_PARTITIONS = 2 }; // The current one and the last, for late results
+
+    struct AttachedPartition {
+        bool attached = false;
+        LogPartitions::Partition partition;
+        QSqlQuery insertOne;
+        QSqlQuery insertMany;
+    };
+
+    // Brings the schema up to date; old rows are left to migrateStep().
+    void migrate();
+    // Moves one chunk of rows from before the current schema.
+    void migrateStep();
+    // Recomputes one chunk of rollups after a schema upgrade.
+    void rebuildStep();
+    // Writes the changed rollup buckets, in the open transaction if any.
+    void writeRollups();
+    // Prepares single and ROWS_PER_INSERT row inserts into table.
+    bool prepareInserts(QSqlQuery &one, QSqlQuery &many, const QString &table);
+    // The partition startTime falls in, attached first if need be, which
+    // commits the open transaction; null if partitioning is off or the
+    // partition can't be opened, and the row then goes to pinglog.db.
+    AttachedPartition *partitionFor(qint64 startTime);
+    // Drops partitions past retention and starts vacuuming those left
+    // behind.
+    void maintainPartitions();
+    void stopCompactor();
+    // Moves what the ring holds into m_backlog, up to BACKLOG_ROWS.
+    void pullRing();
+    // Inserts one batch from the backlog, after topping it up from the
+    // ring; returns how many.
+    int drainBatch(QVector<ProbeResult> &buffer);
+    // Binds entry's 8 columns into query from parameter param on.
+    static void bindRow(QSqlQuery &query, int &param, const ProbeResult &entry, qint64 target);
+    // Inserts rows [first, first + count) of batch and rolls them up: as
+    // one statement through many if count is ROWS_PER_INSERT, row by row
+    // through one otherwise or if that fails. Returns how many went in;
+    // the rest (duplicates, unknown targets) go to m_failedRows.
+    int insertRows(QSqlQuery &one, QSqlQuery &many, const ProbeResult *batch, int first, int count);
+    void appendColumns(const ProbeResult *batch, int count);
+    void commit();
+    void emitStatus(const QString &action, bool force);
+
+    // A registry target's row in the targets table, looked up once per run;
+    // -1 if the lookup failed, and the row is then not written.
+    qint64 targetDbId(quint32 id);
+
+    QSqlDatabase m_db;
+    QSqlQuery m_insertOne;           // Prepared once per run
+    QSqlQuery m_insertMany;          // ROWS_PER_INSERT rows per statement
+    ResultRing *m_ring;
+    int m_reader;
+    TargetRegistry *m_targets;
+    QVector<qint64> m_targetDbIds;   // By registry id, 0 until looked up
+    QString m_path;
+    QString m_columnDirectory;
+    ColumnStoreWriter *m_columns;    // Open for the run if configured
+    QVector<qint64> m_columnIds;     // By registry id, -1 until looked up
+    QElapsedTimer m_sealTimer;       // Since open chunks were last checked
+    FlushPolicy m_policy;
+    LogPartitions::Policy m_partitionPolicy;
+    QString m_partitionDirectory;
+    AttachedPartition m_partitions[ATTACHED_PARTITIONS];  // Attached as part0, part1
+    QThread *m_compactor;            // Vacuums old partitions at low priority
+    std::atomic<bool> m_stopCompacting;
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond;
+    bool m_running;
+    int m_pendingRows;                 // Inserted since the last commit
+    QElapsedTimer m_pendingSince;      // Age of the open transaction
+    QElapsedTimer m_statusTimer;       // Since the last statusUpdated
+    QString m_heldStatus;              // Newer than the last one sent, if set
+    bool m_migrating;                  // Old rows left to move
+    QElapsedTimer m_migrateRetry;      // Since the last step failed; invalid if it didn't
+    long long m_migratedRows;
+    Rollups m_rollups;
+    QElapsedTimer m_rollupTimer;       // Since rollups were last written
+    bool m_rebuilding;                 // Rollups being recomputed
+    long long m_rebuiltRows;
+    Stats m_stats;                     // Guarded by m_mutex
+
+    long long m_totalGenerated;
+    long long m_totalWritten;
+    QVector<ProbeResult> m_backlog;  // Read from the ring, not inserted yet; from m_backlogHead on
+    int m_backlogHead;
+    quint64 m_failedRows;
+};
+
+#endif // DATABASETHREAD_H
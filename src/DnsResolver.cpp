@@ -0,0 +1,346 @@
+#include "DnsResolver.h"
+#include <QDnsLookup>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QDebug>
+#include <limits>
+
+namespace {
+
+const int MIN_TTL_MS = 5000;
+const int MAX_TTL_MS = 3600 * 1000;
+const int NEGATIVE_TTL_MS = 5000;     // Failed lookups are retried this often
+const int HOSTS_TTL_MS = 60 * 1000;
+const int HOSTS_RECHECK_MS = 5000;
+const int REFRESH_CHECK_MS = 500;
+const double REFRESH_AT = 0.8;        // Re-resolve watched names after 80% of the TTL
+
+QString defaultHostsPath()
+{
+#ifdef Q_OS_WIN
+    return qEnvironmentVariable("SystemRoot", "C:\\Windows") + "\\System32\\drivers\\etc\\hosts";
+#else
+    return "/etc/hosts";
+#endif
+}
+
+} // namespace
+
+DnsResolver::DnsResolver(QObject *parent)
+    : QObject(parent)
+    , m_context(new QObject)
+    , m_totalLatencyNs(0)
+    , m_latencySamples(0)
+    , m_nameserverPort(53)
+    , m_hostsPath(defaultHostsPath())
+    , m_dnsEnabled(true)
+    , m_preferIpv6(false)
+    , m_hostsCheckedMs(std::numeric_limits<qint64>::min() / 2)
+{
+    m_clock.start();
+    m_context->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_context, &QObject::deleteLater);
+    m_thread.start();
+
+    QMetaObject::invokeMethod(m_context, [this]() {
+        QTimer *timer = new QTimer(m_context);
+        connect(timer, &QTimer::timeout, m_context, [this]() { refreshWatched(); });
+        timer->start(REFRESH_CHECK_MS);
+    }, Qt::QueuedConnection);
+}
+
+DnsResolver::~DnsResolver()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void DnsResolver::setNameserver(const QHostAddress &address, quint16 port)
+{
+    QMutexLocker locker(&m_mutex);
+    m_nameserver = address;
+    m_nameserverPort = port;
+}
+
+void DnsResolver::setHostsFile(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    m_hostsPath = path;
+}
+
+void DnsResolver::setDnsEnabled(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_dnsEnabled = enabled;
+}
+
+void DnsResolver::setPreferIpv6(bool prefer)
+{
+    m_preferIpv6 = prefer;
+}
+
+bool DnsResolver::preferIpv6() const
+{
+    return m_preferIpv6;
+}
+
+void DnsResolver::configureFromSettings()
+{
+    QSettings settings("MyCompany", "PingTool");
+    settings.beginGroup("dns");
+    QString nameserver = settings.value("nameserver").toString();
+    if (!nameserver.isEmpty()) {
+        setNameserver(QHostAddress(nameserver), settings.value("port", 53).toUInt());
+    }
+    if (settings.contains("hostsFile")) {
+        setHostsFile(settings.value("hostsFile").toString());
+    }
+    setDnsEnabled(settings.value("dnsEnabled", true).toBool());
+    setPreferIpv6(settings.value("preferIpv6", false).toBool());
+    settings.endGroup();
+}
+
+bool DnsResolver::lookup(const QString &name, QList<QHostAddress> *addresses)
+{
+    QHostAddress literal(name);
+    if (!literal.isNull()) {
+        *addresses = { literal };
+        return true;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_stats.queries++;
+    Entry &e = m_cache[name];
+
+    // Expired entries keep answering while their refresh is in flight.
+    if (e.expiresMs > 0 && (m_clock.elapsed() < e.expiresMs || e.inFlight)) {
+        m_stats.cacheHits++;
+        *addresses = e.addresses;
+        return true;
+    }
+
+    if (e.inFlight) {
+        m_stats.collapsed++;
+    } else {
+        requestLookup(name, e);
+    }
+    return false;
+}
+
+void DnsResolver::watch(const QString &name)
+{
+    if (!QHostAddress(name).isNull()) return;
+
+    QMutexLocker locker(&m_mutex);
+    Entry &e = m_cache[name];
+    e.watchers++;
+    if (e.expiresMs == 0 && !e.inFlight) {
+        requestLookup(name, e);
+    }
+}
+
+void DnsResolver::unwatch(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_cache.find(name);
+    if (it != m_cache.end() && it->watchers > 0) {
+        it->watchers--;
+    }
+}
+
+DnsResolver::Stats DnsResolver::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void DnsResolver::requestLookup(const QString &name, Entry &entry)
+{
+    entry.inFlight = true;
+    m_stats.lookups++;
+    QMetaObject::invokeMethod(m_context, [this, name]() { startLookup(name); }, Qt::QueuedConnection);
+}
+
+void DnsResolver::startLookup(const QString &name)
+{
+    QElapsedTimer latency;
+    latency.start();
+
+    QHostAddress nameserver;
+    quint16 port;
+    bool dnsEnabled;
+    {
+        QMutexLocker locker(&m_mutex);
+        nameserver = m_nameserver;
+        port = m_nameserverPort;
+        dnsEnabled = m_dnsEnabled;
+    }
+
+    QList<QHostAddress> hostsAddresses;
+    if (lookupHostsFile(name, &hostsAddresses)) {
+        finishLookup(name, hostsAddresses, QString(), HOSTS_TTL_MS, latency.nsecsElapsed());
+        return;
+    }
+    if (!dnsEnabled) {
+        finishLookup(name, {}, "Not found in hosts file", NEGATIVE_TTL_MS, latency.nsecsElapsed());
+        return;
+    }
+
+    // A and AAAA run side by side; the name resolves if either has records.
+    struct Pending {
+        QList<QHostAddress> addresses[2];
+        quint32 minTtl = std::numeric_limits<quint32>::max();
+        QString error;
+        int remaining = 2;
+    };
+    QSharedPointer<Pending> pending = QSharedPointer<Pending>::create();
+    const QDnsLookup::Type types[2] = { QDnsLookup::A, QDnsLookup::AAAA };
+
+    for (int i = 0; i < 2; ++i) {
+        QDnsLookup *dns = new QDnsLookup(types[i], name, m_context);
+        if (!nameserver.isNull()) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+            dns->setNameserver(nameserver, port);
+#else
+            Q_UNUSED(port);
+            dns->setNameserver(nameserver);
+#endif
+        }
+
+        connect(dns, &QDnsLookup::finished, m_context, [this, dns, i, pending, name, latency]() {
+            if (dns->error() == QDnsLookup::NoError) {
+                const QList<QDnsHostAddressRecord> records = dns->hostAddressRecords();
+                for (const QDnsHostAddressRecord &r : records) {
+                    pending->addresses[i].append(r.value());
+                    pending->minTtl = qMin(pending->minTtl, r.timeToLive());
+                }
+            } else if (pending->error.isEmpty()) {
+                pending->error = dns->errorString();
+            }
+            dns->deleteLater();
+            if (--pending->remaining > 0) return;
+
+            // IPv4 first, so the answer doesn't depend on which came back first.
+            QList<QHostAddress> addresses = pending->addresses[0] + pending->addresses[1];
+            qint64 ttlMs = NEGATIVE_TTL_MS;
+            QString error;
+            if (!addresses.isEmpty()) {
+                ttlMs = qBound<qint64>(MIN_TTL_MS, qint64(pending->minTtl) * 1000, MAX_TTL_MS);
+            } else {
+                error = pending->error.isEmpty() ? QString("No address records") : pending->error;
+            }
+            finishLookup(name, addresses, error, ttlMs, latency.nsecsElapsed());
+        });
+        dns->lookup();
+    }
+}
+
+void DnsResolver::finishLookup(const QString &name, QList<QHostAddress> addresses, QString error,
+                               qint64 ttlMs, qint64 latencyNs)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        Entry &e = m_cache[name];
+        qint64 now = m_clock.elapsed();
+
+        if (!error.isEmpty() && !e.addresses.isEmpty() && e.watchers > 0) {
+            // A failed refresh keeps the last good answer and retries soon.
+            addresses = e.addresses;
+            ttlMs = NEGATIVE_TTL_MS;
+        }
+
+        e.addresses = addresses;
+        e.error = error;
+        e.inFlight = false;
+        e.expiresMs = now + ttlMs;
+        e.refreshAtMs = now + qint64(ttlMs * REFRESH_AT);
+
+        if (!error.isEmpty()) {
+            m_stats.failures++;
+        }
+        m_totalLatencyNs += latencyNs;
+        m_latencySamples++;
+        double latencyMs = latencyNs / 1000000.0;
+        if (latencyMs > m_stats.maxLatencyMs) {
+            m_stats.maxLatencyMs = latencyMs;
+        }
+        m_stats.avgLatencyMs = m_totalLatencyNs / 1000000.0 / m_latencySamples;
+    }
+
+    if (!error.isEmpty()) {
+        qWarning() << "DnsResolver:" << name << error;
+    }
+    emit resolved(name, addresses, error);
+}
+
+bool DnsResolver::lookupHostsFile(const QString &name, QList<QHostAddress> *addresses)
+{
+    QString path;
+    {
+        QMutexLocker locker(&m_mutex);
+        path = m_hostsPath;
+    }
+
+    qint64 now = m_clock.elapsed();
+    if (path != m_hostsLoadedPath || now - m_hostsCheckedMs >= HOSTS_RECHECK_MS) {
+        m_hostsCheckedMs = now;
+        QFileInfo info(path);
+        QDateTime modified = info.exists() ? info.lastModified() : QDateTime();
+        if (path != m_hostsLoadedPath || modified != m_hostsModified) {
+            m_hosts.clear();
+            m_hostsLoadedPath = path;
+            m_hostsModified = modified;
+
+            QFile file(path);
+            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                while (!file.atEnd()) {
+                    QString line = QString::fromUtf8(file.readLine());
+                    int hash = line.indexOf('#');
+                    if (hash >= 0) line.truncate(hash);
+                    const QStringList fields = line.simplified().split(' ', Qt::SkipEmptyParts);
+                    if (fields.size() < 2) continue;
+                    QHostAddress address(fields[0]);
+                    if (address.isNull()) continue;
+                    for (int i = 1; i < fields.size(); ++i) {
+                        m_hosts[fields[i].toLower()].append(address);
+                    }
+                }
+            }
+        }
+    }
+
+    auto it = m_hosts.constFind(name.toLower());
+    if (it == m_hosts.constEnd()) return false;
+    *addresses = it.value();
+    return true;
+}
+
+void DnsResolver::refreshWatched()
+{
+    QStringList due;
+    {
+        QMutexLocker locker(&m_mutex);
+        qint64 now = m_clock.elapsed();
+        for (auto it = m_cache.begin(); it != m_cache.end();) {
+            Entry &e = it.value();
+            if (e.watchers == 0 && !e.inFlight && e.expiresMs > 0 && now >= e.expiresMs) {
+                it = m_cache.erase(it);
+                continue;
+            }
+            if (e.watchers > 0 && !e.inFlight && e.expiresMs > 0 && now >= e.refreshAtMs) {
+                e.inFlight = true;
+                m_stats.lookups++;
+                m_stats.refreshes++;
+                due.append(it.key());
+            }
+            ++it;
+        }
+    }
+
+    for (const QString &name : due) {
+        startLookup(name);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef DNSRESOLVER_H
+#define DNSRESOLVER_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <atomic>
+
+// Shared hostname resolver for all probe backends.
+// Lookups run asynchronously on the resolver's own thread, so the probe
+// loops only ever read the cache. Answers are cached for their DNS TTL,
+// concurrent misses for the same name share one lookup, and watched names
+// are re-resolved in the background shortly before they expire, keeping
+// the previous answer in service until the new one arrives.
+// Names are first looked up in the hosts file; DNS can be disabled or
+// pointed at a specific (e.g. local stub) nameserver for testing.
+// A and AAAA records are queried together and returned as one answer;
+// the backends pick the family each target wants (see ProbeTarget).
+class DnsResolver : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        quint64 queries = 0;     // lookup() calls for hostnames
+        quint64 cacheHits = 0;
+        quint64 collapsed = 0;   // Misses that joined a lookup already in flight
+        quint64 lookups = 0;     // Lookups actually issued, including refreshes
+        quint64 refreshes = 0;
+        quint64 failures = 0;
+        double avgLatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+
+        double hitRate() const { return queries ? double(cacheHits) / queries : 0.0; }
+    };
+
+    explicit DnsResolver(QObject *parent = nullptr);
+    ~DnsResolver();
+
+    // Configuration, applied to lookups started afterwards.
+    void setNameserver(const QHostAddress &address, quint16 port = 53);
+    void setHostsFile(const QString &path);
+    void setDnsEnabled(bool enabled);
+    // Family probed first when a name has both A and AAAA records.
+    void setPreferIpv6(bool prefer);
+    bool preferIpv6() const;
+    // Reads the "dns" group of the application settings.
+    void configureFromSettings();
+
+    // Thread-safe and non-blocking. Returns true with the cached answer for
+    // literals and known names (addresses is empty if the name failed to
+    // resolve). Otherwise starts a lookup, returns false, and resolved()
+    // is emitted once the answer is in.
+    bool lookup(const QString &name, QList<QHostAddress> *addresses);
+
+    // Watched names are kept fresh until every watcher is gone.
+    void watch(const QString &name);
+    void unwatch(const QString &name);
+
+    Stats stats() const;
+
+signals:
+    // Emitted on the resolver thread whenever a lookup completes, including
+    // background refreshes. error is empty on success.
+    void resolved(QString name, QList<QHostAddress> addresses, QString error);
+
+private:
+    struct Entry {
+        QList<QHostAddress> addresses;
+        QString error;
+        qint64 expiresMs = 0;    // 0 until the first answer
+        qint64 refreshAtMs = 0;
+        bool inFlight = false;
+        int watchers = 0;
+    };
+
+    // Called with m_mutex held; the lookup itself is queued to m_thread.
+    void requestLookup(const QString &name, Entry &entry);
+
+    // Resolver thread
+    void startLookup(const QString &name);
+    void finishLookup(const QString &name, QList<QHostAddress> addresses, QString error,
+                      qint64 ttlMs, qint64 latencyNs);
+    bool lookupHostsFile(const QString &name, QList<QHostAddress> *addresses);
+    void refreshWatched();
+
+    QThread m_thread;
+    QObject *m_context;        // Lives in m_thread, parents the lookups and the timer
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_cache;
+    Stats m_stats;
+    qint64 m_totalLatencyNs;
+    quint64 m_latencySamples;
+    QHostAddress m_nameserver;
+    quint16 m_nameserverPort;
+    QString m_hostsPath;
+    bool m_dnsEnabled;
+    std::atomic<bool> m_preferIpv6;
+
+    // Resolver thread only
+    QHash<QString, QList<QHostAddress>> m_hosts;
+    QString m_hostsLoadedPath;
+    QDateTime m_hostsModified;
+    qint64 m_hostsCheckedMs;
+};
+
+#endif // DNSRESOLVER_H
@@ -0,0 +1,1305 @@
+#include "IcmpEngine.h"
+#include "DnsResolver.h"
+#include "SendBudget.h"
+#include "ResultRing.h"
+#include <QDebug>
+#include <QHostAddress>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/icmp6.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+namespace {
+
+const quint32 PROBE_MAGIC = 0x50544f4c; // "PTOL"
+const int RESOLVE_RETRY_MS = 1000;
+const int MAX_WAIT_MS = 1000;
+const int STATS_INTERVAL_MS = 1000;
+const int LAG_WARN_MS = 50;
+const int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+const int ICMP_ECHO_REQUEST = 8;
+const int ICMP_ECHO_REPLY = 0;
+const int ICMP6_ECHO_REQUEST_TYPE = 128;
+const int ICMP6_ECHO_REPLY_TYPE = 129;
+
+const int SEND_BATCH = 256;
+// Without transmit timestamps every request in one sendmmsg() call shares a
+// send time taken before it, so later ones read up to the call's duration
+// slow; calls are kept this small to bound that to a few microseconds.
+const int UNSTAMPED_SEND_BATCH = 16;
+const int RECV_BATCH = 256;
+const int REPLY_BUF_SIZE = 192; // IP header + ICMP header + payload, with room for options
+const int REPLY_CTRL_SIZE = 256; // IP_TTL/IPV6_HOPLIMIT + SCM_TIMESTAMPNS + SCM_TIMESTAMPING
+
+const int MAX_EVENTS = 256;
+const int FD_RESERVE = 256;      // Descriptors left for everything but TCP probes
+const int MAX_TCP_IN_FLIGHT = 65536;
+const int TCP_DEFER_MS = 10;      // Retry delay when the descriptor budget is used up
+
+// epoll_event.data.u64 tags. TCP sockets carry their fd and slot instead.
+const quint64 TOKEN_WAKE = 1;
+const quint64 TOKEN_ICMP = 2;     // + family
+const quint64 TOKEN_UDP = quint64(1) << 62; // | socket index << 1 | family
+const quint64 TOKEN_TCP = quint64(1) << 63;
+
+struct IcmpHeader {
+    quint8 type;
+    quint8 code;
+    quint16 checksum;
+    quint16 id;
+    quint16 seq;
+};
+
+// 32 bytes of payload, the same size PingWorker sends with IcmpSendEcho.
+// The payload is echoed back, so it carries everything needed to find the
+// target again without trusting the (kernel-rewritten) identifier alone.
+struct ProbePayload {
+    quint32 magic;
+    quint32 slot;
+    quint32 generation;
+    quint32 seq;
+    char pad[16];
+};
+
+struct EchoPacket {
+    IcmpHeader hdr;
+    ProbePayload payload;
+};
+
+QPair<ProbeAddress, quint16> endpointKey(const ProbeAddress &addr, quint16 port)
+{
+    return qMakePair(addr, port);
+}
+
+// With IP_RECVERR an ICMP error for one UDP probe is also reported once by
+// the next send/receive call on the shared socket, whoever it is for.
+bool isDeferredUdpError(int err)
+{
+    return err == ECONNREFUSED || err == EHOSTUNREACH || err == ENETUNREACH;
+}
+
+// Pulls TTL (hop limit for IPv6) and the kernel receive time (mapped onto the engine clock) out
+// of the control messages; rxNs is left alone if there is no timestamp.
+void parseControl(msghdr &msg, qint64 wallToMonoNs, qint64 nowNs, int *ttl, qint64 *rxNs)
+{
+    for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if ((c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_TTL)
+            || (c->cmsg_level == IPPROTO_IPV6 && c->cmsg_type == IPV6_HOPLIMIT)) {
+            memcpy(ttl, CMSG_DATA(c), sizeof(int));
+        } else if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            qint64 kernelNs = qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec - wallToMonoNs;
+            if (kernelNs <= nowNs) {
+                *rxNs = kernelNs;
+            }
+        }
+    }
+}
+
+quint16 icmpChecksum(const void *data, int len)
+{
+    const quint16 *p = static_cast<const quint16 *>(data);
+    quint32 sum = 0;
+    while (len > 1) {
+        sum += *p++;
+        len -= 2;
+    }
+    if (len == 1) {
+        sum += *reinterpret_cast<const quint8 *>(p);
+    }
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+    return static_cast<quint16>(~sum);
+}
+
+} // namespace
+
+// One per address family, since sendmmsg() goes to a single socket.
+struct IcmpEngine::SendBatch {
+    EchoPacket packets[SEND_BATCH];
+    union {
+        sockaddr_in v4;
+        sockaddr_in6 v6;
+    } addrs[SEND_BATCH];
+    iovec iov[SEND_BATCH];
+    mmsghdr msgs[SEND_BATCH];
+    int probeSlots[SEND_BATCH];
+    int count = 0;
+
+    explicit SendBatch(bool ipv6)
+    {
+        memset(packets, 0, sizeof(packets));
+        memset(addrs, 0, sizeof(addrs));
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < SEND_BATCH; ++i) {
+            if (ipv6) {
+                addrs[i].v6.sin6_family = AF_INET6;
+            } else {
+                addrs[i].v4.sin_family = AF_INET;
+            }
+            iov[i].iov_base = &packets[i];
+            iov[i].iov_len = sizeof(EchoPacket);
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = ipv6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+};
+
+struct IcmpEngine::ReplyArena {
+    unsigned char bufs[RECV_BATCH][REPLY_BUF_SIZE];
+    char control[RECV_BATCH][REPLY_CTRL_SIZE];
+    sockaddr_in6 from[RECV_BATCH];      // Large enough for either family
+    iovec iov[RECV_BATCH];
+    mmsghdr msgs[RECV_BATCH];
+
+    ReplyArena()
+    {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < RECV_BATCH; ++i) {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = REPLY_BUF_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    // recvmmsg() overwrites the lengths, so restore them before each call.
+    void rearm()
+    {
+        for (int i = 0; i < RECV_BATCH; ++i) {
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = REPLY_CTRL_SIZE;
+            msgs[i].msg_hdr.msg_flags = 0;
+        }
+    }
+};
+
+IcmpEngine::IcmpEngine(QObject *parent)
+    : QThread(parent)
+    , m_epollFd(-1)
+    , m_wakeFd(-1)
+    , m_ident(static_cast<quint16>(getpid() & 0xffff))
+    , m_running(true)
+    , m_throughputMode(false)
+    , m_resolver(nullptr)
+    , m_budget(nullptr)
+    , m_ring(nullptr)
+    , m_lastStatsMs(0)
+    , m_epochOffsetNs(0)
+    , m_lastStatsSent(0)
+    , m_rng(QRandomGenerator::global()->generate())
+    , m_sendBatch{new SendBatch(false), new SendBatch(true)}
+    , m_replyArena(new ReplyArena)
+    , m_sent(0)
+    , m_received(0)
+    , m_icmpSent(0)
+    , m_icmpReceived(0)
+    , m_tcpInFlight(0)
+    , m_maxTcpInFlight(1024)
+    , m_tcpDeferred(0)
+    , m_sendCalls(0)
+    , m_recvCalls(0)
+{
+    for (int family : {V4, V6}) {
+        m_sockFd[family] = -1;
+        m_rawSocket[family] = false;
+        m_txTimestamps[family] = false;
+    }
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (m_epollFd < 0 || m_wakeFd < 0) {
+        qWarning() << "IcmpEngine: epoll/eventfd setup failed:" << strerror(errno);
+        return;
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = TOKEN_WAKE;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+    // Every TCP connect in flight holds a descriptor; raise the soft limit
+    // and keep the connects within it.
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+            getrlimit(RLIMIT_NOFILE, &rl);
+        }
+        qint64 budget = (rl.rlim_cur == RLIM_INFINITY) ? MAX_TCP_IN_FLIGHT : qint64(rl.rlim_cur) - FD_RESERVE;
+        m_maxTcpInFlight = static_cast<int>(qBound<qint64>(64, budget, MAX_TCP_IN_FLIGHT));
+    }
+
+    openSocket(V4);
+    openSocket(V6);
+}
+
+IcmpEngine::~IcmpEngine()
+{
+    stop();
+    wait();
+    for (int family : {V4, V6}) {
+        if (m_sockFd[family] >= 0) close(m_sockFd[family]);
+        for (const UdpSocket &udp : m_udpSockets[family]) {
+            close(udp.fd);
+        }
+        delete m_sendBatch[family];
+    }
+    if (m_wakeFd >= 0) close(m_wakeFd);
+    if (m_epollFd >= 0) close(m_epollFd);
+    delete m_replyArena;
+}
+
+bool IcmpEngine::openSocket(int family)
+{
+    bool v6 = (family == V6);
+    int domain = v6 ? AF_INET6 : AF_INET;
+    int protocol = v6 ? int(IPPROTO_ICMPV6) : int(IPPROTO_ICMP);
+    const char *name = v6 ? "ICMPv6" : "ICMP";
+
+    // Unprivileged ping sockets first; the kernel owns the identifier and
+    // only delivers replies to our own requests.
+    int fd = socket(domain, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    bool raw = false;
+    if (fd < 0) {
+        fd = socket(domain, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+        if (fd < 0) {
+            qWarning() << "IcmpEngine: unable to open" << name << "socket:" << strerror(errno);
+            return false;
+        }
+        raw = true;
+    }
+
+    int on = 1;
+    if (v6) {
+        // ICMPv6 sockets never include the IP header; the hop limit comes as
+        // a control message, and the kernel fills in the checksum.
+        setsockopt(fd, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, &on, sizeof(on));
+        if (raw) {
+            // Keep neighbour discovery and the like out of the receive path.
+            icmp6_filter filter;
+            ICMP6_FILTER_SETBLOCKALL(&filter);
+            ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY_TYPE, &filter);
+            setsockopt(fd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+        }
+    } else if (!raw) {
+        setsockopt(fd, IPPROTO_IP, IP_RECVTTL, &on, sizeof(on));
+    }
+
+    // Kernel receive timestamps keep RTT accurate even when a reply waits in
+    // the socket buffer behind a large batch.
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    // Software transmit timestamps come back on the error queue with the
+    // request, giving each request of a batch its own send time.
+    int tsFlags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    m_txTimestamps[family] = setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &tsFlags, sizeof(tsFlags)) == 0;
+
+    // Bursts of a few thousand replies must not overflow the default buffers.
+    int bufSize = SOCKET_BUFFER_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = TOKEN_ICMP + family;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+    m_sockFd[family] = fd;
+    m_rawSocket[family] = raw;
+    return true;
+}
+
+int IcmpEngine::openUdpSocket(int family)
+{
+    // One socket per family serves every UDP target, bar probes to an
+    // endpoint already in flight on it; replies are matched by source
+    // address and port, or by the echoed payload.
+    int fd = socket(family == V6 ? AF_INET6 : AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        qWarning() << "IcmpEngine: unable to open UDP socket:" << strerror(errno);
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    // Queue ICMP errors (port unreachable) so closed ports fail fast.
+    if (family == V6) {
+        setsockopt(fd, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, &on, sizeof(on));
+        setsockopt(fd, IPPROTO_IPV6, IPV6_RECVERR, &on, sizeof(on));
+    } else {
+        setsockopt(fd, IPPROTO_IP, IP_RECVTTL, &on, sizeof(on));
+        setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof(on));
+    }
+    int bufSize = SOCKET_BUFFER_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    int index = m_udpSockets[family].size();
+    ev.data.u64 = TOKEN_UDP | (quint64(index) << 1) | quint64(family);
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+    UdpSocket udp;
+    udp.fd = fd;
+    m_udpSockets[family].append(udp);
+    return index;
+}
+
+void IcmpEngine::setResolver(DnsResolver *resolver)
+{
+    m_resolver = resolver;
+    // Runs on the resolver thread; the engine picks the address up on its
+    // next loop pass.
+    connect(resolver, &DnsResolver::resolved, this, [this](QString name, QList<QHostAddress> addresses, QString) {
+        {
+            QMutexLocker locker(&m_cmdMutex);
+            Command cmd{Command::Resolved, name, 0};
+            cmd.addresses = addresses;
+            m_commands.append(cmd);
+        }
+        wake();
+    }, Qt::DirectConnection);
+}
+
+void IcmpEngine::addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy)
+{
+    {
+        QMutexLocker locker(&m_cmdMutex);
+        Command cmd{Command::Add, target, timeoutMs};
+        cmd.id = id;
+        cmd.policy = policy.normalized();
+        m_commands.append(cmd);
+    }
+    wake();
+}
+
+void IcmpEngine::removeTarget(quint32 id)
+{
+    {
+        QMutexLocker locker(&m_cmdMutex);
+        Command cmd{Command::Remove, QString(), 0};
+        cmd.id = id;
+        m_commands.append(cmd);
+    }
+    wake();
+}
+
+void IcmpEngine::removeAll()
+{
+    {
+        QMutexLocker locker(&m_cmdMutex);
+        m_commands.append({Command::RemoveAll, QString(), 0});
+    }
+    wake();
+}
+
+void IcmpEngine::setPolicy(quint32 id, const ProbePolicy &policy)
+{
+    {
+        QMutexLocker locker(&m_cmdMutex);
+        Command cmd{Command::SetPolicy, QString(), 0};
+        cmd.id = id;
+        cmd.policy = policy.normalized();
+        m_commands.append(cmd);
+    }
+    wake();
+}
+
+void IcmpEngine::stop()
+{
+    m_running = false;
+    wake();
+}
+
+void IcmpEngine::setThroughputMode(bool enabled)
+{
+    m_throughputMode = enabled;
+    wake();
+}
+
+void IcmpEngine::wake()
+{
+    if (m_wakeFd >= 0) {
+        quint64 one = 1;
+        ssize_t ret = write(m_wakeFd, &one, sizeof(one));
+        Q_UNUSED(ret);
+    }
+}
+
+void IcmpEngine::run()
+{
+    if (m_epollFd < 0) {
+        qWarning() << "IcmpEngine: no epoll instance, engine not started.";
+        return;
+    }
+    if (m_sockFd[V4] < 0 && m_sockFd[V6] < 0) {
+        qWarning() << "IcmpEngine: no ICMP socket, only TCP and UDP targets will work.";
+    }
+
+    m_clock.start();
+    m_wheel.reset(m_clock.elapsed());
+    m_lastStatsMs = m_clock.elapsed();
+    updateEpochOffset();
+
+    epoll_event events[MAX_EVENTS];
+    while (m_running) {
+        processCommands();
+
+        updateEpochOffset();
+        qint64 now = m_clock.elapsed();
+        qint64 waitMs = runTimers(now);
+        runReady(now);
+        flushSends(now);
+        publishStats(now);
+
+        if (!m_ready.isEmpty()) {
+            waitMs = 0;
+        }
+
+        int n = epoll_wait(m_epollFd, events, MAX_EVENTS, static_cast<int>(waitMs));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            qWarning() << "IcmpEngine: epoll_wait failed:" << strerror(errno);
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            quint64 token = events[i].data.u64;
+            if (token & TOKEN_TCP) {
+                handleTcpEvent(token);
+            } else if (token == TOKEN_WAKE) {
+                quint64 counter;
+                while (read(m_wakeFd, &counter, sizeof(counter)) > 0) {}
+            } else if (token == TOKEN_ICMP + V4 || token == TOKEN_ICMP + V6) {
+                int family = static_cast<int>(token - TOKEN_ICMP);
+                // Send times first: the replies may be to those very requests
+                if (events[i].events & EPOLLERR) readTxTimestamps(family);
+                readReplies(family);
+            } else if (token & TOKEN_UDP) {
+                int family = static_cast<int>(token & 1);
+                int index = static_cast<int>((token & ~TOKEN_UDP) >> 1);
+                if (events[i].events & EPOLLERR) readUdpErrors(family, index);
+                if (events[i].events & EPOLLIN) readUdp(family, index);
+            }
+        }
+    }
+
+    for (Target &t : m_targets) {
+        closeTcp(t);
+    }
+    m_targets.clear();
+    m_freeSlots.clear();
+    m_slotById.clear();
+    m_slotsByHost.clear();
+    for (int family : {V4, V6}) {
+        for (UdpSocket &udp : m_udpSockets[family]) {
+            udp.slotByEndpoint.clear();
+        }
+    }
+    m_ready.clear();
+}
+
+void IcmpEngine::updateEpochOffset()
+{
+    // Timestamps reported to the UI/DB are wall-clock ms; derive them from
+    // the monotonic clock instead of reading the wall clock per probe.
+    timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    m_epochOffsetNs = qint64(wall.tv_sec) * 1000000000 + wall.tv_nsec - m_clock.nsecsElapsed();
+}
+
+IcmpEngine::Stats IcmpEngine::stats() const
+{
+    QMutexLocker locker(&m_statsMutex);
+    return m_stats;
+}
+
+void IcmpEngine::publishStats(qint64 now)
+{
+    qint64 elapsed = now - m_lastStatsMs;
+    if (elapsed < STATS_INTERVAL_MS) return;
+    m_lastStatsMs = now;
+
+    const TimingWheel::Stats &ws = m_wheel.stats();
+    qint64 maxLag = ws.maxLagMs;
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_stats.timersFired += ws.fired;
+        m_stats.avgTimerLagMs = ws.avgLagMs();
+        m_stats.maxTimerLagMs = ws.maxLagMs;
+        m_stats.probesSent = m_sent;
+        m_stats.repliesReceived = m_received;
+        m_stats.icmpSent = m_icmpSent;
+        m_stats.icmpReceived = m_icmpReceived;
+        m_stats.tcpSockets = m_tcpInFlight;
+        m_stats.tcpDeferred = m_tcpDeferred;
+        m_stats.sendCalls = m_sendCalls;
+        m_stats.recvCalls = m_recvCalls;
+        m_stats.probesPerSec = (m_sent - m_lastStatsSent) * 1000.0 / elapsed;
+    }
+    m_lastStatsSent = m_sent;
+    m_wheel.resetStats();
+
+    if (maxLag > LAG_WARN_MS) {
+        qWarning() << "IcmpEngine: timers firing up to" << maxLag << "ms late, scheduler overloaded";
+    }
+}
+
+void IcmpEngine::processCommands()
+{
+    QList<Command> commands;
+    {
+        QMutexLocker locker(&m_cmdMutex);
+        commands.swap(m_commands);
+    }
+
+    for (const Command &cmd : commands) {
+        switch (cmd.type) {
+        case Command::Add:
+            if (slotOf(cmd.id) < 0) {
+                addSlot(cmd.id, cmd.target, cmd.timeoutMs, cmd.policy);
+            }
+            break;
+        case Command::SetPolicy:
+            if (slotOf(cmd.id) >= 0) {
+                applyPolicy(slotOf(cmd.id), cmd.policy);
+            }
+            break;
+        case Command::Remove:
+            if (slotOf(cmd.id) >= 0) {
+                removeSlot(slotOf(cmd.id));
+                m_slotById[int(cmd.id)] = -1;
+            }
+            break;
+        case Command::RemoveAll:
+            for (int slot : m_slotById) {
+                if (slot >= 0) {
+                    removeSlot(slot);
+                }
+            }
+            m_slotById.fill(-1);
+            break;
+        case Command::Resolved: {
+            const QList<int> hostSlots = m_slotsByHost.values(cmd.target);
+            for (int slot : hostSlots) {
+                applyAddress(slot, pickAddress(m_targets[slot], cmd.addresses));
+            }
+            break;
+        }
+        }
+    }
+}
+
+void IcmpEngine::addSlot(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy)
+{
+    int slot;
+    if (!m_freeSlots.isEmpty()) {
+        slot = m_freeSlots.takeLast();
+    } else {
+        slot = m_targets.size();
+        m_targets.append(Target());
+    }
+
+    Target &t = m_targets[slot];
+    t.id = id;
+    t.timeoutMs = timeoutMs;
+    t.seq = 0;
+    t.active = true;
+    t.inFlight = false;
+    t.policy = policy;
+    m_wheel.schedule(sendTimer(slot), t.schedule.start(policy, m_clock.elapsed(), m_rng.generate()));
+
+    ProbeTarget pt = ProbeTarget::parse(target);
+    t.type = pt.type;
+    t.family = pt.family;
+    t.host = pt.host;
+    t.port = pt.port;
+    t.tcpFd = -1;
+    t.tokenHeld = false;
+
+    t.resolving = false;
+    QHostAddress ha(t.host);
+    if (!ha.isNull()) {
+        t.addr = pickAddress(t, { ha });
+    } else if (m_resolver) {
+        // Served from the cache when possible, otherwise the first probe
+        // waits for the Resolved command.
+        QList<QHostAddress> addresses;
+        t.resolving = !m_resolver->lookup(t.host, &addresses);
+        t.addr = t.resolving ? ProbeAddress() : pickAddress(t, addresses);
+        m_resolver->watch(t.host);
+    } else {
+        t.addr = ProbeAddress();
+    }
+
+    if (id >= quint32(m_slotById.size())) {
+        m_slotById.resize(int(id) + 1, -1);
+    }
+    m_slotById[int(id)] = slot;
+    m_slotsByHost.insert(t.host, slot);
+}
+
+void IcmpEngine::removeSlot(int slot)
+{
+    Target &t = m_targets[slot];
+    if (m_resolver) {
+        m_resolver->unwatch(t.host);
+    }
+    m_slotsByHost.remove(t.host, slot);
+    closeTcp(t);
+    releaseUdp(t);
+    t.active = false;
+    t.inFlight = false;
+    t.resolving = false;
+    t.tokenHeld = false;
+    t.generation++;
+    m_wheel.cancel(sendTimer(slot));
+    m_wheel.cancel(timeoutTimer(slot));
+    m_freeSlots.append(slot);
+}
+
+ProbeAddress IcmpEngine::pickAddress(const Target &t, const QList<QHostAddress> &addresses) const
+{
+    bool preferIpv6 = m_resolver && m_resolver->preferIpv6();
+    return ProbeAddress::fromHostAddress(ProbeTarget::pickAddress(addresses, t.family, preferIpv6));
+}
+
+void IcmpEngine::applyAddress(int slot, const ProbeAddress &addr)
+{
+    Target &t = m_targets[slot];
+    bool wasUnresolved = t.addr.isNull();
+    // A UDP probe in flight to the old address can only time out now
+    releaseUdp(t);
+    t.addr = addr;
+    t.resolving = false;
+
+    // Don't sit out the rest of the resolve retry delay, but keep targets
+    // that share a host name from all firing at once.
+    if (wasUnresolved && !addr.isNull() && !t.inFlight) {
+        m_wheel.schedule(sendTimer(slot), t.schedule.start(t.policy, m_clock.elapsed(), m_rng.generate()));
+    }
+}
+
+void IcmpEngine::applyPolicy(int slot, const ProbePolicy &policy)
+{
+    Target &t = m_targets[slot];
+    if (t.policy == policy) return;
+    t.policy = policy;
+
+    // A probe in flight picks the policy up when it completes; an idle
+    // target restarts its schedule now instead of waiting out the old one.
+    // One holding a send budget token keeps its turn.
+    if (!t.inFlight && !t.tokenHeld && m_wheel.isPending(sendTimer(slot))) {
+        m_wheel.schedule(sendTimer(slot), t.schedule.start(policy, m_clock.elapsed(), m_rng.generate()));
+    } else {
+        t.schedule.sentInBurst = 0;
+    }
+}
+
+void IcmpEngine::sendProbe(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    if (t.resolving) {
+        m_wheel.schedule(sendTimer(slot), now + RESOLVE_RETRY_MS);
+        return;
+    }
+    if (t.type == ProbeTarget::Tcp && m_tcpInFlight >= m_maxTcpInFlight) {
+        // Descriptor budget used up; try again once some connects finish.
+        m_tcpDeferred++;
+        m_wheel.schedule(sendTimer(slot), now + TCP_DEFER_MS);
+        return;
+    }
+    t.seq++;
+
+    bool needsPort = (t.type != ProbeTarget::Icmp);
+    if (t.addr.isNull() || (needsPort && t.port == 0)) {
+        qint64 nowMs = toEpochMs(m_clock.nsecsElapsed());
+        report(t, -2, 0, nowMs, nowMs); // -2 for resolve error
+        m_wheel.schedule(sendTimer(slot), now + RESOLVE_RETRY_MS);
+        return;
+    }
+
+    if (m_budget && !t.tokenHeld) {
+        qint64 waitNs = m_budget->reserve(t.addr);
+        if (waitNs >= 1000000) {
+            // Over budget: come back when the booked token is due. Tokens
+            // are booked in request order, so targets take turns.
+            t.seq--;
+            t.tokenHeld = true;
+            m_wheel.schedule(sendTimer(slot), now + (waitNs + 999999) / 1000000);
+            return;
+        }
+    }
+    t.tokenHeld = false;
+
+    switch (t.type) {
+    case ProbeTarget::Tcp:
+        sendTcp(slot, now);
+        break;
+    case ProbeTarget::Udp:
+        sendUdp(slot, now);
+        break;
+    default:
+        sendIcmp(slot, now);
+        break;
+    }
+}
+
+void IcmpEngine::failProbe(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    t.sentMs = now;
+    t.sentNs = m_clock.nsecsElapsed();
+    t.inFlight = true;
+    finishProbe(slot, -1, 0, t.sentNs);
+}
+
+void IcmpEngine::sendIcmp(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    int family = familyOf(t.addr);
+    if (m_sockFd[family] < 0) {
+        failProbe(slot, now);
+        return;
+    }
+
+    SendBatch &b = *m_sendBatch[family];
+    int i = b.count++;
+
+    EchoPacket &pkt = b.packets[i];
+    pkt.hdr.type = (family == V6) ? ICMP6_ECHO_REQUEST_TYPE : ICMP_ECHO_REQUEST;
+    pkt.hdr.code = 0;
+    pkt.hdr.checksum = 0;
+    pkt.hdr.id = htons(m_ident);
+    pkt.hdr.seq = htons(static_cast<quint16>(t.seq));
+    pkt.payload.magic = PROBE_MAGIC;
+    pkt.payload.slot = static_cast<quint32>(slot);
+    pkt.payload.generation = t.generation;
+    pkt.payload.seq = static_cast<quint32>(t.seq);
+    memcpy(pkt.payload.pad, "Data Buffer", 11);
+
+    if (family == V6) {
+        // The ICMPv6 checksum covers a pseudo-header; the kernel computes it.
+        memcpy(&b.addrs[i].v6.sin6_addr, t.addr.bytes, 16);
+    } else {
+        pkt.hdr.checksum = icmpChecksum(&pkt, sizeof(pkt));
+        b.addrs[i].v4.sin_addr.s_addr = t.addr.ipv4();
+    }
+    b.probeSlots[i] = slot;
+
+    t.sentMs = now;
+    t.inFlight = true;
+    m_wheel.schedule(timeoutTimer(slot), now + t.timeoutMs);
+
+    if (b.count == SEND_BATCH) {
+        flushBatch(family, now);
+    }
+}
+
+void IcmpEngine::sendTcp(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    int fd = socket(t.addr.isIpv4() ? AF_INET : AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        qWarning() << "IcmpEngine: unable to open TCP socket:" << strerror(errno);
+        failProbe(slot, now);
+        return;
+    }
+
+    // Abortive close: the connection is reset instead of sitting in
+    // TIME_WAIT, so a high connect rate doesn't run out of local ports.
+    linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+
+    sockaddr_storage sa;
+    socklen_t saLen = t.addr.toSockaddr(t.port, &sa);
+
+    t.sentMs = now;
+    t.sentNs = m_clock.nsecsElapsed();
+    t.inFlight = true;
+    m_sent++;
+
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&sa), saLen) == 0) {
+        // Loopback can complete synchronously.
+        close(fd);
+        qint64 doneNs = m_clock.nsecsElapsed();
+        m_received++;
+        finishProbe(slot, doneNs - t.sentNs, 0, doneNs);
+        return;
+    }
+    if (errno != EINPROGRESS) {
+        close(fd);
+        finishProbe(slot, -1, 0, m_clock.nsecsElapsed());
+        return;
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.u64 = TOKEN_TCP | (quint64(fd) << 32) | quint32(slot);
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+    t.tcpFd = fd;
+    m_tcpInFlight++;
+    m_wheel.schedule(timeoutTimer(slot), now + t.timeoutMs);
+}
+
+void IcmpEngine::closeTcp(Target &t)
+{
+    if (t.tcpFd >= 0) {
+        close(t.tcpFd); // Also drops it from the epoll set
+        t.tcpFd = -1;
+        m_tcpInFlight--;
+    }
+}
+
+void IcmpEngine::releaseUdp(Target &t)
+{
+    if (t.udpSocket >= 0) {
+        m_udpSockets[familyOf(t.addr)][t.udpSocket].slotByEndpoint.remove(endpointKey(t.addr, t.port));
+        t.udpSocket = -1;
+    }
+}
+
+void IcmpEngine::handleTcpEvent(quint64 token)
+{
+    int slot = static_cast<int>(token & 0xffffffff);
+    int fd = static_cast<int>((token & ~TOKEN_TCP) >> 32);
+    if (slot >= m_targets.size()) return;
+
+    Target &t = m_targets[slot];
+    if (!t.active || !t.inFlight || t.tcpFd != fd) return;
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    qint64 doneNs = m_clock.nsecsElapsed();
+
+    if (err == 0) {
+        m_received++;
+        finishProbe(slot, doneNs - t.sentNs, 0, doneNs);
+    } else {
+        // Refused or unreachable: nothing is listening there.
+        finishProbe(slot, -1, 0, doneNs);
+    }
+}
+
+void IcmpEngine::sendUdp(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    int family = familyOf(t.addr);
+    // Another target's probe to the same host and port in flight on a
+    // socket makes its replies ambiguous there; use the next one
+    QPair<ProbeAddress, quint16> endpoint = endpointKey(t.addr, t.port);
+    int index = 0;
+    while (index < m_udpSockets[family].size() && m_udpSockets[family].at(index).slotByEndpoint.contains(endpoint)) {
+        ++index;
+    }
+    if (index == m_udpSockets[family].size() && openUdpSocket(family) < 0) {
+        failProbe(slot, now);
+        return;
+    }
+    int fd = m_udpSockets[family].at(index).fd;
+
+    ProbePayload payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.magic = PROBE_MAGIC;
+    payload.slot = static_cast<quint32>(slot);
+    payload.generation = t.generation;
+    payload.seq = static_cast<quint32>(t.seq);
+    memcpy(payload.pad, "Data Buffer", 11);
+
+    sockaddr_storage sa;
+    socklen_t saLen = t.addr.toSockaddr(t.port, &sa);
+
+    t.sentMs = now;
+    t.sentNs = m_clock.nsecsElapsed();
+    int rc = sendto(fd, &payload, sizeof(payload), 0, reinterpret_cast<sockaddr *>(&sa), saLen);
+    if (rc < 0 && isDeferredUdpError(errno)) {
+        // Error left over from another target; the datagram wasn't sent.
+        rc = sendto(fd, &payload, sizeof(payload), 0, reinterpret_cast<sockaddr *>(&sa), saLen);
+    }
+    if (rc < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            t.seq--;
+            m_wheel.schedule(sendTimer(slot), now + 1);
+        } else {
+            failProbe(slot, now);
+        }
+        return;
+    }
+
+    t.inFlight = true;
+    m_sent++;
+    m_udpSockets[family][index].slotByEndpoint.insert(endpoint, slot);
+    t.udpSocket = index;
+    m_wheel.schedule(timeoutTimer(slot), now + t.timeoutMs);
+}
+
+void IcmpEngine::flushSends(qint64 now)
+{
+    flushBatch(V4, now);
+    flushBatch(V6, now);
+}
+
+void IcmpEngine::flushBatch(int family, qint64 now)
+{
+    SendBatch &b = *m_sendBatch[family];
+    int done = 0;
+
+    while (done < b.count) {
+        // Replaced by the kernel's transmit timestamp where there is one
+        int count = m_txTimestamps[family] ? b.count - done : qMin(b.count - done, UNSTAMPED_SEND_BATCH);
+        qint64 sentNs = m_clock.nsecsElapsed();
+        for (int i = done; i < done + count; ++i) {
+            m_targets[b.probeSlots[i]].sentNs = sentNs;
+        }
+
+        int n = sendmmsg(m_sockFd[family], b.msgs + done, count, 0);
+        if (n > 0) {
+            m_sendCalls++;
+            m_sent += n;
+            m_icmpSent += n;
+            done += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Socket buffer full; put the rest back and retry next tick.
+            for (int i = done; i < b.count; ++i) {
+                int slot = b.probeSlots[i];
+                Target &t = m_targets[slot];
+                if (!t.active) continue;
+                t.seq--;
+                t.inFlight = false;
+                m_wheel.cancel(timeoutTimer(slot));
+                m_wheel.schedule(sendTimer(slot), now + 1);
+            }
+            break;
+        }
+
+        // A hard error applies to the first unsent message only.
+        int slot = b.probeSlots[done++];
+        if (m_targets[slot].active && m_targets[slot].inFlight) {
+            finishProbe(slot, -1, 0, m_clock.nsecsElapsed());
+        }
+    }
+
+    b.count = 0;
+}
+
+void IcmpEngine::readTxTimestamps(int family)
+{
+    unsigned char data[REPLY_BUF_SIZE];
+    char control[512];
+
+    timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    qint64 nowNs = m_clock.nsecsElapsed();
+    qint64 wallToMonoNs = qint64(wall.tv_sec) * 1000000000 + wall.tv_nsec - nowNs;
+
+    while (true) {
+        iovec iov;
+        iov.iov_base = data;
+        iov.iov_len = sizeof(data);
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        int len = recvmsg(m_sockFd[family], &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if ((msg.msg_flags & MSG_TRUNC) || len < static_cast<int>(sizeof(ProbePayload))) continue;
+
+        qint64 txNs = -1;
+        for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPING) {
+                timespec ts[3];
+                memcpy(ts, CMSG_DATA(c), sizeof(ts));
+                if (ts[0].tv_sec != 0 || ts[0].tv_nsec != 0) {
+                    txNs = qint64(ts[0].tv_sec) * 1000000000 + ts[0].tv_nsec - wallToMonoNs;
+                }
+            }
+        }
+        if (txNs < 0 || txNs > nowNs) continue;
+
+        // The request comes back with whatever headers it had on the way
+        // out; the payload is always its last bytes.
+        ProbePayload payload;
+        memcpy(&payload, data + len - sizeof(payload), sizeof(payload));
+        if (payload.magic != PROBE_MAGIC || payload.slot >= quint32(m_targets.size())) continue;
+        Target &t = m_targets[payload.slot];
+        if (!t.active || !t.inFlight || t.type != ProbeTarget::Icmp) continue;
+        if (t.generation != payload.generation || quint32(t.seq) != payload.seq) continue;
+        t.sentNs = qMax(t.sentNs, txNs);
+    }
+}
+
+void IcmpEngine::readReplies(int family)
+{
+    ReplyArena &a = *m_replyArena;
+
+    while (true) {
+        a.rearm();
+        int n = recvmmsg(m_sockFd[family], a.msgs, RECV_BATCH, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // EAGAIN: drained
+        }
+        if (n == 0) break;
+
+        m_recvCalls++;
+
+        // Kernel timestamps are CLOCK_REALTIME; map them onto the engine clock.
+        timespec wall;
+        clock_gettime(CLOCK_REALTIME, &wall);
+        qint64 nowNs = m_clock.nsecsElapsed();
+        qint64 wallToMonoNs = qint64(wall.tv_sec) * 1000000000 + wall.tv_nsec - nowNs;
+
+        for (int i = 0; i < n; ++i) {
+            msghdr &msg = a.msgs[i].msg_hdr;
+            const unsigned char *icmp = a.bufs[i];
+            int icmpLen = qMin<int>(a.msgs[i].msg_len, REPLY_BUF_SIZE);
+            int ttl = 0;
+            qint64 rxNs = nowNs;
+            parseControl(msg, wallToMonoNs, nowNs, &ttl, &rxNs);
+
+            if (m_rawSocket[family] && family == V4) {
+                // Raw IPv4 sockets deliver the IP header as well.
+                if (icmpLen < 20) continue;
+                int ihl = (icmp[0] & 0x0f) * 4;
+                if (icmpLen < ihl) continue;
+                ttl = icmp[8];
+                icmp += ihl;
+                icmpLen -= ihl;
+            }
+
+            ProbeAddress from = ProbeAddress::fromSockaddr(reinterpret_cast<sockaddr *>(&a.from[i]));
+            handleReply(family, icmp, icmpLen, from, ttl, rxNs);
+        }
+
+        if (n < RECV_BATCH) break;
+    }
+}
+
+void IcmpEngine::handleReply(int family, const unsigned char *icmp, int len, const ProbeAddress &from, int ttl, qint64 rxNs)
+{
+    if (len < static_cast<int>(sizeof(EchoPacket))) return;
+
+    EchoPacket pkt;
+    memcpy(&pkt, icmp, sizeof(pkt));
+
+    if (pkt.hdr.type != (family == V6 ? ICMP6_ECHO_REPLY_TYPE : ICMP_ECHO_REPLY)) return;
+    // Datagram sockets rewrite the identifier to the socket's port and already
+    // filter by it; raw sockets see every reply on the host.
+    if (m_rawSocket[family] && ntohs(pkt.hdr.id) != m_ident) return;
+    if (pkt.payload.magic != PROBE_MAGIC) return;
+
+    int slot = static_cast<int>(pkt.payload.slot);
+    if (slot < 0 || slot >= m_targets.size()) return;
+
+    Target &t = m_targets[slot];
+    if (!t.active || !t.inFlight) return;
+    if (t.generation != pkt.payload.generation) return;
+    if (static_cast<quint32>(t.seq) != pkt.payload.seq) return;
+    if (ntohs(pkt.hdr.seq) != static_cast<quint16>(t.seq)) return;
+    if (t.type != ProbeTarget::Icmp || t.addr != from) return;
+
+    m_received++;
+    m_icmpReceived++;
+    // A wall-clock step between the two clock readings can push the kernel
+    // timestamp before the send; never report a negative RTT.
+    finishProbe(slot, qMax<qint64>(0, rxNs - t.sentNs), ttl, qMax(rxNs, t.sentNs));
+}
+
+void IcmpEngine::readUdp(int family, int index)
+{
+    ReplyArena &a = *m_replyArena;
+    const UdpSocket &udp = m_udpSockets[family].at(index);
+
+    while (true) {
+        a.rearm();
+        int n = recvmmsg(udp.fd, a.msgs, RECV_BATCH, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR || isDeferredUdpError(errno)) continue;
+            break;
+        }
+        if (n == 0) break;
+
+        timespec wall;
+        clock_gettime(CLOCK_REALTIME, &wall);
+        qint64 nowNs = m_clock.nsecsElapsed();
+        qint64 wallToMonoNs = qint64(wall.tv_sec) * 1000000000 + wall.tv_nsec - nowNs;
+
+        for (int i = 0; i < n; ++i) {
+            int ttl = 0;
+            qint64 rxNs = nowNs;
+            parseControl(a.msgs[i].msg_hdr, wallToMonoNs, nowNs, &ttl, &rxNs);
+
+            quint16 fromPort = 0;
+            ProbeAddress fromAddr = ProbeAddress::fromSockaddr(reinterpret_cast<sockaddr *>(&a.from[i]), &fromPort);
+            int len = qMin<int>(a.msgs[i].msg_len, REPLY_BUF_SIZE);
+
+            // Echo services return our payload, which pins the exact probe;
+            // anything else is matched by the endpoint it came from.
+            int slot = udp.slotByEndpoint.value(endpointKey(fromAddr, fromPort), -1);
+            bool echoed = false;
+            if (len >= static_cast<int>(sizeof(ProbePayload))) {
+                ProbePayload payload;
+                memcpy(&payload, a.bufs[i], sizeof(payload));
+                if (payload.magic == PROBE_MAGIC && payload.slot < quint32(m_targets.size())) {
+                    const Target &t = m_targets[payload.slot];
+                    if (t.generation != payload.generation || quint32(t.seq) != payload.seq) continue;
+                    slot = static_cast<int>(payload.slot);
+                    echoed = true;
+                }
+            }
+            if (slot < 0) continue;
+
+            Target &t = m_targets[slot];
+            if (!t.active || !t.inFlight || t.type != ProbeTarget::Udp) continue;
+            if (t.addr != fromAddr || (!echoed && t.port != fromPort)) continue;
+
+            m_received++;
+            finishProbe(slot, qMax<qint64>(0, rxNs - t.sentNs), ttl, qMax(rxNs, t.sentNs));
+        }
+
+        if (n < RECV_BATCH) break;
+    }
+}
+
+void IcmpEngine::readUdpErrors(int family, int index)
+{
+    const UdpSocket &udp = m_udpSockets[family].at(index);
+    char data[64];
+    char control[512];
+    sockaddr_in6 dest;                  // Large enough for either family
+
+    while (true) {
+        iovec iov;
+        iov.iov_base = data;
+        iov.iov_len = sizeof(data);
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &dest;
+        msg.msg_namelen = sizeof(dest);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(udp.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+
+        for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            bool v4Error = (c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_RECVERR);
+            bool v6Error = (c->cmsg_level == IPPROTO_IPV6 && c->cmsg_type == IPV6_RECVERR);
+            if (!v4Error && !v6Error) continue;
+            sock_extended_err ee;
+            memcpy(&ee, CMSG_DATA(c), sizeof(ee));
+            if (ee.ee_origin != SO_EE_ORIGIN_ICMP && ee.ee_origin != SO_EE_ORIGIN_ICMP6) continue;
+
+            // msg_name is the destination of the probe that bounced.
+            quint16 destPort = 0;
+            ProbeAddress destAddr = ProbeAddress::fromSockaddr(reinterpret_cast<sockaddr *>(&dest), &destPort);
+            int slot = udp.slotByEndpoint.value(endpointKey(destAddr, destPort), -1);
+            if (slot < 0) continue;
+            Target &t = m_targets[slot];
+            if (t.active && t.inFlight && t.type == ProbeTarget::Udp) {
+                finishProbe(slot, -1, 0, m_clock.nsecsElapsed());
+            }
+        }
+    }
+}
+
+void IcmpEngine::finishProbe(int slot, qint64 rttNs, int ttl, qint64 doneNs)
+{
+    Target &t = m_targets[slot];
+    qint64 now = m_clock.elapsed();
+
+    closeTcp(t);
+    releaseUdp(t);
+    t.inFlight = false;
+    m_wheel.cancel(timeoutTimer(slot));
+    if (m_throughputMode) {
+        m_ready.append(slot);
+    } else {
+        m_wheel.schedule(sendTimer(slot), t.schedule.next(t.policy, now, m_rng.generate()));
+    }
+
+    report(t, rttNs, ttl, toEpochMs(t.sentNs), toEpochMs(doneNs));
+}
+
+void IcmpEngine::report(const Target &t, qint64 rttNs, int ttl, qint64 startTime, qint64 returnTime)
+{
+    if (!m_ring) return;
+
+    ProbeResult result;
+    result.targetId = t.id;
+    result.ttl = ttl;
+    result.seq = t.seq;
+    result.timeoutMs = int(t.timeoutMs);
+    result.rttNs = rttNs;
+    result.startTime = startTime;
+    result.returnTime = returnTime;
+    m_ring->push(result);
+}
+
+qint64 IcmpEngine::runTimers(qint64 now)
+{
+    m_wheel.advance(now, [this, now](int id) {
+        int slot = id / 2;
+        if (!m_targets[slot].active) return;
+
+        if (id == timeoutTimer(slot)) {
+            finishProbe(slot, -1, 0, m_clock.nsecsElapsed());
+        } else {
+            sendProbe(slot, now);
+        }
+    });
+
+    qint64 next = m_wheel.nextWakeup();
+    if (next < 0) return MAX_WAIT_MS;
+    return qBound<qint64>(0, next - m_clock.elapsed(), MAX_WAIT_MS);
+}
+
+void IcmpEngine::runReady(qint64 now)
+{
+    if (m_ready.isEmpty()) return;
+
+    QVector<int> ready;
+    ready.swap(m_ready);
+    for (int slot : ready) {
+        Target &t = m_targets[slot];
+        if (t.active && !t.inFlight && !m_wheel.isPending(sendTimer(slot))) {
+            sendProbe(slot, now);
+        }
+    }
+}
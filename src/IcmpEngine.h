@@ -0,0 +1,229 @@
+#ifndef ICMPENGINE_H
+#define ICMPENGINE_H
+
+#include <QThread>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <atomic>
+#include "TimingWheel.h"
+#include "ProbeTarget.h"
+#include "ProbePolicy.h"
+#include "ProbeAddress.h"
+
+class DnsResolver;
+class SendBudget;
+class ResultRing;
+
+// Single-threaded ICMP probe engine for Linux.
+// All targets share one non-blocking ICMP socket per address family (ICMP
+// and ICMPv6) driven by epoll, so the number of OS threads no longer grows
+// with the number of targets.
+// Unprivileged ICMP datagram sockets (SOCK_DGRAM/IPPROTO_ICMP) are used when
+// net.ipv4.ping_group_range allows it, raw sockets otherwise.
+// Requests due in the same tick go out in one sendmmsg() call and replies
+// are drained with recvmmsg() into a preallocated arena.
+// The same loop also runs TCP connect probes (one non-blocking socket per
+// probe in flight, reset on close) and UDP probes (shared sockets, another
+// only for probes in flight to the same host and port at once; ICMP
+// port-unreachable picked up through IP_RECVERR); see ProbeTarget.
+// Hostnames are resolved through the shared DnsResolver and their address
+// is updated in place when a background refresh returns a new one. Each
+// target keeps one 16-byte address (ProbeAddress) of the family it asked
+// for; replies of either family are matched in O(1) through the slot
+// echoed in the payload.
+// RTT is measured in nanoseconds from kernel timestamps: ICMP send times
+// from SO_TIMESTAMPING software transmit timestamps (the monotonic clock
+// just before sendmmsg() where there are none), receive times from
+// SO_TIMESTAMPNS.
+// Each target follows its own ProbePolicy; first sends get a random phase
+// so targets sharing an interval don't all fire in the same tick.
+class IcmpEngine : public QThread
+{
+    Q_OBJECT
+public:
+    explicit IcmpEngine(QObject *parent = nullptr);
+    ~IcmpEngine();
+
+    // Thread-safe; the actual work happens on the engine thread. id is the
+    // target's TargetRegistry id, carried by its results.
+    void addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy = ProbePolicy());
+    void removeTarget(quint32 id);
+    void removeAll();
+    void setPolicy(quint32 id, const ProbePolicy &policy);
+    void stop();
+
+    // Call before start(). Without a resolver only address literals work.
+    void setResolver(DnsResolver *resolver);
+    // Call before start(). Every probe send then waits for a token.
+    void setSendBudget(SendBudget *budget) { m_budget = budget; }
+    // Call before start(). Results are pushed here from the engine thread.
+    void setResultRing(ResultRing *ring) { m_ring = ring; }
+
+    // Throughput mode ignores the policies: each target sends its next probe
+    // as soon as the previous one completes, in the same loop pass.
+    void setThroughputMode(bool enabled);
+    bool throughputMode() const { return m_throughputMode; }
+
+    bool usingRawSocket() const { return m_rawSocket[V4]; }
+
+    struct Stats {
+        quint64 timersFired = 0;
+        double avgTimerLagMs = 0.0; // Over the last publish interval
+        qint64 maxTimerLagMs = 0;   // Over the last publish interval
+        quint64 probesSent = 0;     // All probe types
+        quint64 repliesReceived = 0;
+        quint64 icmpSent = 0;
+        quint64 icmpReceived = 0;
+        quint64 sendCalls = 0;      // ICMP sendmmsg() calls
+        quint64 recvCalls = 0;      // ICMP recvmmsg() calls returning data
+        double probesPerSec = 0.0;  // Over the last publish interval
+        int tcpSockets = 0;         // TCP connects in flight
+        quint64 tcpDeferred = 0;    // Connects postponed by the descriptor budget
+
+        double avgSendBatch() const { return sendCalls ? double(icmpSent) / sendCalls : 0.0; }
+        double avgRecvBatch() const { return recvCalls ? double(icmpReceived) / recvCalls : 0.0; }
+    };
+    Stats stats() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Command {
+        enum Type { Add, Remove, RemoveAll, SetPolicy, Resolved };
+        Type type;
+        QString target;            // Add: the target; Resolved: the host name
+        uint32_t timeoutMs;
+        quint32 id = 0;            // Add, Remove, SetPolicy
+        QList<QHostAddress> addresses; // Resolved: empty on failure
+        ProbePolicy policy;        // Add, SetPolicy
+    };
+
+    struct Target {
+        quint32 id = 0;            // TargetRegistry id
+        ProbeTarget::Type type = ProbeTarget::Icmp;
+        ProbeTarget::Family family = ProbeTarget::AnyFamily;
+        QString host;
+        quint16 port = 0;          // TCP/UDP, host byte order
+        int tcpFd = -1;            // Connect in flight
+        int udpSocket = -1;        // In m_udpSockets, while a UDP probe is in flight
+        ProbeAddress addr;         // Null if unresolved
+        uint32_t timeoutMs = 1000;
+        ProbePolicy policy;
+        ProbeSchedule schedule;
+        quint32 generation = 0;    // Bumped on slot reuse to reject stale replies
+        int seq = 0;
+        bool active = false;
+        bool inFlight = false;
+        bool resolving = false;    // Waiting for the first DNS answer
+        bool tokenHeld = false;    // Send budget token booked, waiting for its time
+        qint64 sentMs = 0;         // Engine monotonic clock, wheel resolution
+        qint64 sentNs = 0;         // Engine monotonic clock, taken just before sendmmsg() then moved to the transmit timestamp
+    };
+
+    // Each its own source port. A UDP probe goes out on the first socket with
+    // no other probe in flight to its endpoint, so the socket a reply comes
+    // in on and the endpoint it comes from pin one target.
+    struct UdpSocket {
+        int fd = -1;
+        QHash<QPair<ProbeAddress, quint16>, int> slotByEndpoint; // Probes in flight
+    };
+
+    // Defined in the .cpp; allocated once and reused for every batch.
+    struct SendBatch;
+    struct ReplyArena;
+
+    // Socket indexes, by address family
+    enum { V4, V6 };
+    static int familyOf(const ProbeAddress &addr) { return addr.isIpv4() ? V4 : V6; }
+
+    bool openSocket(int family);
+    // Returns the new socket's index in m_udpSockets[family], or -1.
+    int openUdpSocket(int family);
+    void wake();
+    void processCommands();
+    void addSlot(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy);
+    int slotOf(quint32 id) const { return id < quint32(m_slotById.size()) ? m_slotById.at(int(id)) : -1; }
+    void applyPolicy(int slot, const ProbePolicy &policy);
+    void removeSlot(int slot);
+    ProbeAddress pickAddress(const Target &t, const QList<QHostAddress> &addresses) const;
+    void applyAddress(int slot, const ProbeAddress &addr);
+    void sendProbe(int slot, qint64 now);
+    void sendIcmp(int slot, qint64 now);
+    void sendTcp(int slot, qint64 now);
+    void sendUdp(int slot, qint64 now);
+    void failProbe(int slot, qint64 now);
+    void closeTcp(Target &t);
+    void releaseUdp(Target &t);
+    void handleTcpEvent(quint64 token);
+    void readUdp(int family, int index);
+    void readUdpErrors(int family, int index);
+    void flushSends(qint64 now);
+    void flushBatch(int family, qint64 now);
+    // Moves the send times of ICMP requests to their transmit timestamps.
+    void readTxTimestamps(int family);
+    void readReplies(int family);
+    void handleReply(int family, const unsigned char *icmp, int len, const ProbeAddress &from, int ttl, qint64 rxNs);
+    void finishProbe(int slot, qint64 rttNs, int ttl, qint64 doneNs);
+    // startTime/returnTime in ms since epoch.
+    void report(const Target &t, qint64 rttNs, int ttl, qint64 startTime, qint64 returnTime);
+    qint64 toEpochMs(qint64 monoNs) const { return (monoNs + m_epochOffsetNs) / 1000000; }
+    void updateEpochOffset();
+    qint64 runTimers(qint64 now);
+    void runReady(qint64 now);
+    void publishStats(qint64 now);
+
+    // Wheel timer ids: two per target slot.
+    static int sendTimer(int slot) { return slot * 2; }
+    static int timeoutTimer(int slot) { return slot * 2 + 1; }
+
+    int m_epollFd;
+    int m_wakeFd;
+    int m_sockFd[2];
+    QVector<UdpSocket> m_udpSockets[2];
+    bool m_rawSocket[2];
+    bool m_txTimestamps[2];        // SO_TIMESTAMPING transmit timestamps on the ICMP socket
+    quint16 m_ident;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_throughputMode;
+    DnsResolver *m_resolver;
+    SendBudget *m_budget;
+    ResultRing *m_ring;
+
+    QMutex m_cmdMutex;
+    QList<Command> m_commands;
+
+    mutable QMutex m_statsMutex;
+    Stats m_stats;
+
+    // Engine-thread state
+    QElapsedTimer m_clock;
+    TimingWheel m_wheel;
+    qint64 m_lastStatsMs;
+    qint64 m_epochOffsetNs;        // Wall clock minus engine clock
+    quint64 m_lastStatsSent;
+    QVector<Target> m_targets;
+    QVector<int> m_freeSlots;
+    QVector<int> m_slotById;       // By target id, -1 if not added
+    QMultiHash<QString, int> m_slotsByHost;
+    QVector<int> m_ready;          // Throughput mode: slots to send this pass
+    QRandomGenerator m_rng;        // Send phases and jitter
+    SendBatch *m_sendBatch[2];
+    ReplyArena *m_replyArena;
+    quint64 m_sent;
+    quint64 m_received;
+    quint64 m_icmpSent;
+    quint64 m_icmpReceived;
+    int m_tcpInFlight;
+    int m_maxTcpInFlight;
+    quint64 m_tcpDeferred;
+    quint64 m_sendCalls;
+    quint64 m_recvCalls;
+};
+
+#endif // ICMPENGINE_H
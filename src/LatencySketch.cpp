@@ -0,0 +1,137 @@
+#include "LatencySketch.h"
+#include "Varint.h"
+#include <cmath>
+
+namespace {
+
+const double GAMMA = 1.02;
+const qint64 MIN_NS = 1000;         // Anything faster shares the 1 us bin
+const quint64 MAX_BINS = 4096;      // Far more than 1 us .. 1 h needs
+
+} // namespace
+
+int LatencySketch::binOf(qint64 rttNs)
+{
+    static const double logGamma = std::log(GAMMA);
+    return int(std::ceil(std::log(double(qMax(rttNs, MIN_NS))) / logGamma));
+}
+
+qint64 LatencySketch::valueOf(int bin)
+{
+    // Middle of (GAMMA^(bin-1), GAMMA^bin] in relative terms
+    return qint64(2.0 * std::pow(GAMMA, bin) / (GAMMA + 1.0));
+}
+
+void LatencySketch::add(qint64 rttNs)
+{
+    int bin = binOf(rttNs);
+    if (m_bins.isEmpty()) {
+        m_first = bin;
+        m_bins.resize(1);
+        m_bins[0] = 0;
+    } else if (bin < m_first) {
+        m_bins.insert(0, m_first - bin, 0);
+        m_first = bin;
+    } else if (bin >= m_first + m_bins.size()) {
+        m_bins.resize(bin - m_first + 1, 0);
+    }
+    m_bins[bin - m_first]++;
+    m_count++;
+}
+
+void LatencySketch::merge(const LatencySketch &other)
+{
+    if (other.isEmpty()) return;
+    if (isEmpty()) {
+        *this = other;
+        return;
+    }
+    int first = qMin(m_first, other.m_first);
+    int last = qMax(m_first + m_bins.size(), other.m_first + other.m_bins.size());
+    if (first < m_first) {
+        m_bins.insert(0, m_first - first, 0);
+        m_first = first;
+    }
+    if (last > m_first + m_bins.size()) {
+        m_bins.resize(last - m_first, 0);
+    }
+    int offset = other.m_first - m_first;
+    for (int i = 0; i < other.m_bins.size(); ++i) {
+        m_bins[offset + i] += other.m_bins.at(i);
+    }
+    m_count += other.m_count;
+}
+
+void LatencySketch::clear()
+{
+    m_bins.clear();
+    m_first = 0;
+    m_count = 0;
+}
+
+qint64 LatencySketch::quantile(double q) const
+{
+    if (isEmpty()) return -1;
+    quint64 rank = quint64(qBound(0.0, q, 1.0) * double(m_count - 1));
+    quint64 seen = 0;
+    for (int i = 0; i < m_bins.size(); ++i) {
+        seen += m_bins.at(i);
+        if (seen > rank) {
+            return valueOf(m_first + i);
+        }
+    }
+    return valueOf(m_first + m_bins.size() - 1);
+}
+
+QByteArray LatencySketch::toBytes() const
+{
+    QByteArray out;
+    if (isEmpty()) return out;
+    out.reserve(4 + m_bins.size());
+    Varint::put(out, quint64(m_first));
+    Varint::put(out, quint64(m_bins.size()));
+    for (int i = 0; i < m_bins.size(); ) {
+        if (m_bins.at(i) != 0) {
+            Varint::put(out, m_bins.at(i++));
+            continue;
+        }
+        // A run of empty bins as 0 and its length
+        int run = 0;
+        while (i < m_bins.size() && m_bins.at(i) == 0) {
+            ++run;
+            ++i;
+        }
+        Varint::put(out, 0);
+        Varint::put(out, quint64(run));
+    }
+    return out;
+}
+
+LatencySketch LatencySketch::fromBytes(const QByteArray &bytes)
+{
+    LatencySketch sketch;
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    qint64 pos = 0;
+    quint64 first;
+    quint64 size;
+    if (!Varint::get(data, bytes.size(), pos, first) || !Varint::get(data, bytes.size(), pos, size) || size > MAX_BINS) {
+        return sketch;
+    }
+    sketch.m_first = int(first);
+    sketch.m_bins.resize(int(size), 0);
+    for (int i = 0; i < int(size); ) {
+        quint64 count;
+        quint64 run = 0;
+        if (!Varint::get(data, bytes.size(), pos, count) || (count == 0 && (!Varint::get(data, bytes.size(), pos, run) || run > size - i))) {
+            sketch.clear();
+            return sketch;
+        }
+        if (count == 0) {
+            i += int(run);
+        } else {
+            sketch.m_bins[i++] = quint32(count);
+            sketch.m_count += count;
+        }
+    }
+    return sketch;
+}
@@ -0,0 +1,40 @@
+#ifndef LATENCYSKETCH_H
+#define LATENCYSKETCH_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Histogram of RTTs in logarithmic bins, each 2% wider than the one below,
+// so any quantile read back is within about 1% of the true value whatever
+// the scale. Two sketches merge by adding their bins, which is what lets a
+// minute be built from its seconds and a month from its hours without going
+// back to the raw rows.
+class LatencySketch
+{
+public:
+    void add(qint64 rttNs);
+    void merge(const LatencySketch &other);
+    void clear();
+
+    bool isEmpty() const { return m_count == 0; }
+    quint64 count() const { return m_count; }
+    // RTT at quantile q (0..1) in ns; -1 if empty.
+    qint64 quantile(double q) const;
+
+    // Varints: first bin, number of bins, then each count, with a run of
+    // empty bins as 0 and the run length.
+    QByteArray toBytes() const;
+    static LatencySketch fromBytes(const QByteArray &bytes);
+
+private:
+    static int binOf(qint64 rttNs);
+    static qint64 valueOf(int bin);
+
+    // Every bin from the lowest used to the highest used, m_bins[i] counting
+    // bin m_first + i; a few hundred at most for RTTs between 1 us and 100 s.
+    QVector<quint32> m_bins;
+    int m_first = 0;
+    quint64 m_count = 0;
+};
+
+#endif // LATENCYSKETCH_H
@@ -0,0 +1,51 @@
+#include "LiveWindow.h"
+
+LiveWindow::LiveWindow(int capacity, qint64 spanMs)
+    : m_samples(qMax(1, capacity))
+    , m_spanMs(spanMs)
+    , m_head(0)
+    , m_count(0)
+    , m_serial(0)
+    , m_lastEnd(-1)
+{
+}
+
+int LiveWindow::push(const ColumnSample &sample, double value)
+{
+    int dropped = 0;
+    if (m_count == m_samples.size()) {
+        popOldest();
+        ++dropped;
+    }
+    m_samples[(m_head + m_count) % m_samples.size()] = sample;
+    ++m_count;
+    while (!m_peaks.empty() && m_peaks.back().value <= value) {
+        m_peaks.pop_back();
+    }
+    m_peaks.push_back(Peak{ m_serial++, value });
+    m_lastEnd = qMax(m_lastEnd, sample.returnTime);
+
+    // Results arrive in about start order, so the oldest is at the front
+    while (m_count > 1 && at(0).startTime < sample.startTime - m_spanMs) {
+        popOldest();
+        ++dropped;
+    }
+    return dropped;
+}
+
+void LiveWindow::clear()
+{
+    m_head = 0;
+    m_count = 0;
+    m_lastEnd = -1;
+    m_peaks.clear();
+}
+
+void LiveWindow::popOldest()
+{
+    if (m_peaks.front().serial == m_serial - m_count) {
+        m_peaks.pop_front();
+    }
+    m_head = (m_head + 1) % m_samples.size();
+    --m_count;
+}
@@ -0,0 +1,50 @@
+#ifndef LIVEWINDOW_H
+#define LIVEWINDOW_H
+
+#include <QVector>
+#include <deque>
+#include "ColumnStore.h"
+
+// The latest live results of a chart: a ring of at most capacity samples,
+// none starting more than spanMs before the newest. The highest value in
+// it is kept in a monotonic deque, so it is known at any time for O(1)
+// amortized work per sample, however long the window stays open.
+class LiveWindow
+{
+public:
+    LiveWindow(int capacity, qint64 spanMs);
+
+    // Adds sample, plotted at value, dropping whatever falls out of the
+    // window. Returns how many went.
+    int push(const ColumnSample &sample, double value);
+    void clear();
+
+    int size() const { return m_count; }
+    int capacity() const { return m_samples.size(); }
+    // Oldest first.
+    const ColumnSample &at(int i) const { return m_samples.at((m_head + i) % m_samples.size()); }
+    // -1 if empty.
+    qint64 firstStart() const { return m_count > 0 ? at(0).startTime : -1; }
+    qint64 lastEnd() const { return m_lastEnd; }
+    double maxValue() const { return m_peaks.empty() ? 0 : m_peaks.front().value; }
+
+private:
+    struct Peak {
+        qint64 serial;          // Of the sample, counting every one pushed
+        double value;
+    };
+
+    void popOldest();
+
+    QVector<ColumnSample> m_samples;
+    qint64 m_spanMs;
+    int m_head;                 // Oldest
+    int m_count;
+    qint64 m_serial;            // Next to be pushed
+    qint64 m_lastEnd;
+    // Values lower than a later sample's can never be the highest again, so
+    // only decreasing ones are kept, oldest first
+    std::deque<Peak> m_peaks;
+};
+
+#endif // LIVEWINDOW_H
@@ -0,0 +1,163 @@
+#include "LogPartitions.h"
+#include "LogSchema.h"
+#include <QDate>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSettings>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const qint64 HOUR_MS = 60 * 60 * 1000;
+const qint64 DAY_MS = 24 * HOUR_MS;
+const qint64 EPOCH_JULIAN_DAY = 2440588;    // 1970-01-01
+const int BUSY_TIMEOUT_MS = 5000;
+
+std::atomic<int> connectionCount(0);
+
+} // namespace
+
+LogPartitions::Policy LogPartitions::configuredPolicy()
+{
+    QSettings settings("MyCompany", "PingTool");
+    Policy policy;
+    policy.hours = qMax(0, settings.value("database/partitionHours", policy.hours).toInt());
+    policy.retentionDays = qMax(0, settings.value("database/retentionDays", policy.retentionDays).toInt());
+    return policy;
+}
+
+QString LogPartitions::directoryFor(const QString &dbPath)
+{
+    QFileInfo info(dbPath);
+    return info.absolutePath() + "/" + info.completeBaseName() + ".parts";
+}
+
+LogPartitions::Partition LogPartitions::partitionAt(const QString &directory, qint64 timeMs, int hours)
+{
+    // Aligned to whole multiples of the length since the epoch, in UTC
+    qint64 length = qMax(1, hours) * HOUR_MS;
+    Partition partition;
+    partition.start = timeMs - ((timeMs % length) + length) % length;
+    partition.end = partition.start + length;
+    qint64 day = partition.start / DAY_MS;
+    int hour = int((partition.start - day * DAY_MS) / HOUR_MS);
+    partition.path = QString("%1/%2%3-%4h.db")
+                         .arg(directory)
+                         .arg(QDate::fromJulianDay(day + EPOCH_JULIAN_DAY).toString("yyyyMMdd"))
+                         .arg(hour, 2, 10, QChar('0'))
+                         .arg(qMax(1, hours));
+    return partition;
+}
+
+QVector<LogPartitions::Partition> LogPartitions::list(const QString &directory)
+{
+    static const QRegularExpression name("^(\\d{4})(\\d{2})(\\d{2})(\\d{2})-(\\d+)h\\.db$");
+    QVector<Partition> partitions;
+    const QStringList files = QDir(directory).entryList(QStringList() << "*.db", QDir::Files);
+    for (const QString &file : files) {
+        QRegularExpressionMatch match = name.match(file);
+        if (!match.hasMatch()) continue;
+        QDate date(match.captured(1).toInt(), match.captured(2).toInt(), match.captured(3).toInt());
+        if (!date.isValid()) continue;
+        Partition partition;
+        partition.start = (date.toJulianDay() - EPOCH_JULIAN_DAY) * DAY_MS + match.captured(4).toInt() * HOUR_MS;
+        partition.end = partition.start + qMax(1, match.captured(5).toInt()) * HOUR_MS;
+        partition.path = directory + "/" + file;
+        partitions.append(partition);
+    }
+    std::sort(partitions.begin(), partitions.end(),
+              [](const Partition &a, const Partition &b) { return a.start < b.start; });
+    return partitions;
+}
+
+bool LogPartitions::attach(QSqlDatabase &db, const Partition &partition, const QString &schema)
+{
+    QDir().mkpath(QFileInfo(partition.path).absolutePath());
+    QSqlQuery query(db);
+    query.prepare(QString("ATTACH DATABASE :path AS %1").arg(schema));
+    query.bindValue(":path", partition.path);
+    if (!query.exec()) {
+        qWarning() << "Failed to attach" << partition.path << query.lastError().text();
+        return false;
+    }
+    if (!LogSchema::createLogTable(db, schema)) {
+        detach(db, schema);
+        return false;
+    }
+    query.exec(QString("PRAGMA %1.journal_mode=WAL").arg(schema));
+    query.exec(QString("PRAGMA %1.synchronous=NORMAL").arg(schema));
+    // Written to again, so due another vacuum once it is left behind
+    query.exec(QString("PRAGMA %1.user_version=%2").arg(schema).arg(int(Written)));
+    return true;
+}
+
+bool LogPartitions::attachForReading(QSqlDatabase &db, const QString &path, const QString &schema)
+{
+    QSqlQuery query(db);
+    query.prepare(QString("ATTACH DATABASE :path AS %1").arg(schema));
+    query.bindValue(":path", path);
+    if (!query.exec()) {
+        qWarning() << "Failed to attach" << path << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void LogPartitions::detach(QSqlDatabase &db, const QString &schema)
+{
+    QSqlQuery query(db);
+    if (!query.exec(QString("DETACH DATABASE %1").arg(schema))) {
+        qWarning() << "Failed to detach" << schema << query.lastError().text();
+    }
+}
+
+int LogPartitions::dropBefore(const QString &directory, qint64 cutoffMs, const QStringList &keep)
+{
+    int dropped = 0;
+    for (const Partition &partition : list(directory)) {
+        if (partition.end > cutoffMs) break;
+        if (keep.contains(partition.path)) continue;
+        // A chart may still have it open; it goes on a later try then
+        if (QFile::remove(partition.path)) {
+            QFile::remove(partition.path + "-wal");
+            QFile::remove(partition.path + "-shm");
+            ++dropped;
+        }
+    }
+    return dropped;
+}
+
+void LogPartitions::compactBefore(const QString &directory, qint64 beforeMs, const std::atomic<bool> &stop)
+{
+    const QString connectionName = QString("LogPartition_%1").arg(connectionCount++);
+    for (const Partition &partition : list(directory)) {
+        if (stop || partition.end > beforeMs) break;
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+            db.setDatabaseName(partition.path);
+            db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(BUSY_TIMEOUT_MS));
+            if (db.open()) {
+                QSqlQuery query(db);
+                if (query.exec("PRAGMA user_version") && query.next() && query.value(0).toInt() != Compacted) {
+                    qint64 before = QFileInfo(partition.path).size();
+                    // Read only from now on: fold the WAL back in and drop it,
+                    // then rewrite the file without its free pages
+                    query.exec("PRAGMA journal_mode=DELETE");
+                    if (query.exec("VACUUM")) {
+                        query.exec(QString("PRAGMA user_version=%1").arg(int(Compacted)));
+                        qDebug() << "Compacted" << partition.path << before << "->" << QFileInfo(partition.path).size() << "bytes";
+                    } else {
+                        qWarning() << "Failed to compact" << partition.path << query.lastError().text();
+                    }
+                }
+                db.close();
+            }
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+}
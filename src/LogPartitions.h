@@ -0,0 +1,65 @@
+#ifndef LOGPARTITIONS_H
+#define LOGPARTITIONS_H
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// Raw ping_log rows split by start time into one SQLite file per partition
+// (a day by default), in a directory next to pinglog.db. Each file holds
+// only a ping_log table laid out as in LogSchema; target ids refer to the
+// targets table of pinglog.db, which keeps everything else: targets,
+// rollups, and the rows written before partitioning was turned on.
+//
+// Dropping old data deletes whole files, so it takes no time, leaves no
+// free pages behind and never holds up the writer. A partition that is no
+// longer written is vacuumed once, off the database thread.
+//
+// Files are named yyyyMMddHH-<hours>h.db after their first hour in UTC.
+class LogPartitions
+{
+public:
+    struct Policy {
+        int hours = 24;         // Per partition; 0 keeps every row in pinglog.db
+        int retentionDays = 0;  // Partitions older than this are dropped; 0 keeps all
+    };
+
+    struct Partition {
+        qint64 start = 0;       // ms since epoch
+        qint64 end = 0;         // Exclusive
+        QString path;
+
+        bool contains(qint64 timeMs) const { return timeMs >= start && timeMs < end; }
+    };
+
+    // The "database/partitionHours" and "database/retentionDays" settings.
+    static Policy configuredPolicy();
+
+    // Where the partitions of the database at dbPath live.
+    static QString directoryFor(const QString &dbPath);
+    // The partition of hours length that timeMs falls in.
+    static Partition partitionAt(const QString &directory, qint64 timeMs, int hours);
+    // Every partition in directory, oldest first.
+    static QVector<Partition> list(const QString &directory);
+
+    // Attaches partition to db as schema, creating it if needed. Not
+    // allowed inside a transaction.
+    static bool attach(QSqlDatabase &db, const Partition &partition, const QString &schema);
+    // Attaches the partition file at path to db as schema as it is, for
+    // reading.
+    static bool attachForReading(QSqlDatabase &db, const QString &path, const QString &schema);
+    static void detach(QSqlDatabase &db, const QString &schema);
+
+    // Deletes every partition that ended before cutoffMs, except keep.
+    // Returns how many went.
+    static int dropBefore(const QString &directory, qint64 cutoffMs, const QStringList &keep);
+    // Vacuums every partition that ended before beforeMs and was not
+    // vacuumed yet, until stop is set. For a low priority thread.
+    static void compactBefore(const QString &directory, qint64 beforeMs, const std::atomic<bool> &stop);
+
+private:
+    enum { Written = 0, Compacted = 1 };    // A partition's user_version
+};
+
+#endif // LOGPARTITIONS_H
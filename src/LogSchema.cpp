@@ -0,0 +1,211 @@
+#include "LogSchema.h"
+#include "Rollups.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+const char *const LogSchema::LegacyTable = "ping_log_old";
+
+int LogSchema::version(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (query.exec("PRAGMA user_version") && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+void LogSchema::setVersion(QSqlDatabase &db, int version)
+{
+    QSqlQuery query(db);
+    query.exec(QString("PRAGMA user_version=%1").arg(version));
+}
+
+bool LogSchema::hasTable(const QSqlDatabase &db, const QString &table)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = :name");
+    query.bindValue(":name", table);
+    return query.exec() && query.next();
+}
+
+bool LogSchema::hasColumn(const QSqlDatabase &db, const QString &table, const QString &column)
+{
+    QSqlQuery query(db);
+    query.exec(QString("PRAGMA table_info(%1)").arg(table));
+    while (query.next()) {
+        if (query.value(1).toString() == column) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LogSchema::createTables(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("CREATE TABLE IF NOT EXISTS targets ("
+                    "id INTEGER PRIMARY KEY, "
+                    "name TEXT NOT NULL UNIQUE, "
+                    "probe_type TEXT)")) {
+        qCritical() << "Failed to create targets table:" << query.lastError().text();
+    }
+    createLogTable(db, "main");
+    Rollups::createTables(db);
+}
+
+bool LogSchema::createLogTable(QSqlDatabase &db, const QString &schema)
+{
+    // seq only keeps apart probes of one burst that start in the same ms
+    QSqlQuery query(db);
+    if (!query.exec(QString("CREATE TABLE IF NOT EXISTS %1.ping_log ("
+                            "target_id INTEGER NOT NULL, "
+                            "start_time INTEGER NOT NULL, "
+                            "seq INTEGER NOT NULL, "
+                            "return_time INTEGER, "
+                            "rtt INTEGER, "
+                            "rtt_ns INTEGER, "
+                            "ttl INTEGER, "
+                            "timeout_val INTEGER, "
+                            "PRIMARY KEY (target_id, start_time, seq)) WITHOUT ROWID").arg(schema))) {
+        qCritical() << "Failed to create table:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void LogSchema::upgradeToV1(QSqlDatabase &db)
+{
+    // What used to run on every start; every step is a no-op if done
+    QSqlQuery query(db);
+    query.exec("ALTER TABLE ping_log ADD COLUMN start_time INTEGER");
+    query.exec("ALTER TABLE ping_log ADD COLUMN return_time INTEGER");
+    query.exec("ALTER TABLE ping_log ADD COLUMN timeout_val INTEGER");
+    query.exec("ALTER TABLE ping_log ADD COLUMN rtt_ns INTEGER");
+    query.exec("ALTER TABLE ping_log ADD COLUMN probe_type TEXT");
+    query.exec("ALTER TABLE ping_log ADD COLUMN target_id INTEGER");
+    query.exec("CREATE TABLE IF NOT EXISTS targets (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE)");
+    query.exec("ALTER TABLE targets ADD COLUMN probe_type TEXT");
+}
+
+bool LogSchema::upgradeToV2(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!db.transaction()) return false;
+    if (!query.exec(QString("ALTER TABLE ping_log RENAME TO %1").arg(LegacyTable))) {
+        qCritical() << "Failed to set aside the old ping_log:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    createTables(db);
+    setVersion(db, 2);
+    return db.commit();
+}
+
+bool LogSchema::upgradeToV3(QSqlDatabase &db)
+{
+    if (!db.transaction()) return false;
+    Rollups::createTables(db);
+    Rollups::scheduleRebuild(db);
+    setVersion(db, 3);
+    return db.commit();
+}
+
+bool LogSchema::upgrade(QSqlDatabase &db)
+{
+    int from = version(db);
+    if (from >= Version) {
+        createTables(db);
+        return true;
+    }
+
+    if (!hasTable(db, "ping_log")) {
+        // A new file: nothing to carry over
+        createTables(db);
+        setVersion(db, Version);
+        return true;
+    }
+
+    qDebug() << "Upgrading pinglog.db from schema" << from << "to" << int(Version);
+    if (from < 1) {
+        upgradeToV1(db);
+        setVersion(db, 1);
+    }
+    if (from < 2 && !upgradeToV2(db)) {
+        return false;
+    }
+    return upgradeToV3(db);
+}
+
+bool LogSchema::hasLegacyRows(const QSqlDatabase &db)
+{
+    return hasTable(db, LegacyTable);
+}
+
+QString LogSchema::legacyReturnTime(const QSqlDatabase &db)
+{
+    if (!hasColumn(db, LegacyTable, "timestamp")) return "o.return_time";
+    return "COALESCE(o.return_time, "
+           "CAST(strftime('%s', substr(o.timestamp, 1, 19), 'utc') AS INTEGER) * 1000 "
+           "+ CAST(substr(o.timestamp, 21, 3) AS INTEGER))";
+}
+
+QString LogSchema::legacyStartTime(const QSqlDatabase &db)
+{
+    return QString("COALESCE(o.start_time, %1 - MAX(COALESCE(o.rtt, 0), 0))").arg(legacyReturnTime(db));
+}
+
+int LogSchema::migrateChunk(QSqlDatabase &db, int maxRows)
+{
+    if (!hasLegacyRows(db)) return 0;
+
+    QSqlQuery query(db);
+    query.prepare(QString("SELECT max(rowid) FROM (SELECT rowid FROM %1 ORDER BY rowid LIMIT :n)").arg(LegacyTable));
+    query.bindValue(":n", maxRows);
+    if (!query.exec() || !query.next()) {
+        qWarning() << "Migration failed:" << query.lastError().text();
+        return -1;
+    }
+    if (query.value(0).isNull()) {
+        // Everything moved
+        query.exec(QString("DROP TABLE %1").arg(LegacyTable));
+        qDebug() << "Migration of old ping_log rows finished";
+        return 0;
+    }
+    qint64 last = query.value(0).toLongLong();
+
+    // Rows from before the targets table only have the name
+    query.prepare(QString("INSERT OR IGNORE INTO targets (name) SELECT DISTINCT target FROM %1 "
+                          "WHERE rowid <= :last AND target_id IS NULL AND target IS NOT NULL").arg(LegacyTable));
+    query.bindValue(":last", last);
+    query.exec();
+
+    // Return time from the old DATETIME text (local time, yyyy-MM-ddTHH:mm:ss.zzz)
+    // where the integer column was never filled; start time from it and the
+    // RTT for the oldest rows. Rows with no time at all can't be placed and
+    // are dropped.
+    QString returnTime = legacyReturnTime(db);
+    QString startTime = legacyStartTime(db);
+    query.prepare(QString("INSERT OR IGNORE INTO ping_log "
+                          "(target_id, start_time, seq, return_time, rtt, rtt_ns, ttl, timeout_val) "
+                          "SELECT COALESCE(o.target_id, (SELECT id FROM targets WHERE name = o.target), 0), "
+                          "%1, COALESCE(o.seq, 0), %2, o.rtt, o.rtt_ns, o.ttl, o.timeout_val "
+                          "FROM %3 o WHERE o.rowid <= :last AND %1 IS NOT NULL")
+                      .arg(startTime, returnTime, QString::fromLatin1(LegacyTable)));
+    query.bindValue(":last", last);
+    if (!query.exec()) {
+        qWarning() << "Migration failed:" << query.lastError().text();
+        return -1;
+    }
+    int moved = query.numRowsAffected();
+
+    query.prepare(QString("DELETE FROM %1 WHERE rowid <= :last").arg(LegacyTable));
+    query.bindValue(":last", last);
+    if (!query.exec()) {
+        qWarning() << "Migration failed:" << query.lastError().text();
+        return -1;
+    }
+    // Count what left the old table, so a chunk of unplaceable rows still
+    // reports progress
+    return qMax(moved, query.numRowsAffected());
+}
@@ -0,0 +1,56 @@
+#ifndef LOGSCHEMA_H
+#define LOGSCHEMA_H
+
+#include <QSqlDatabase>
+#include <QString>
+
+// Versioned layout of pinglog.db, tracked in PRAGMA user_version.
+//
+//   0  ping_log as a rowid table grown by ad-hoc ALTER TABLEs, target text
+//      per row
+//   1  the same with every column present and a targets table
+//   2  ping_log clustered by (target_id, start_time) WITHOUT ROWID, so one
+//      target's time range is a single range scan; names and probe types
+//      live only in targets
+//   3  1 s / 1 min / 1 h rollups of ping_log (see Rollups), rebuilt from the
+//      raw rows once after the upgrade
+//
+// Going to 2 only renames the old table to LegacyTable and creates the new
+// one, so it is instant whatever the size; the old rows are moved across
+// afterwards, a chunk at a time, while new rows keep being written.
+class LogSchema
+{
+public:
+    enum { Version = 3 };
+
+    static const char *const LegacyTable;
+
+    // Brings db to Version. Cheap on any size of database.
+    static bool upgrade(QSqlDatabase &db);
+    // True while LegacyTable still holds rows to move.
+    static bool hasLegacyRows(const QSqlDatabase &db);
+    // Moves up to maxRows of the oldest legacy rows into ping_log. Run it
+    // inside a transaction so the copy and the delete land together. Returns
+    // how many were moved; 0 once none are left, after dropping LegacyTable;
+    // -1 if a statement failed (the database busy, say), to be retried.
+    static int migrateChunk(QSqlDatabase &db, int maxRows);
+    // SQL for the return and start time of a LegacyTable row aliased o,
+    // derived the way migrateChunk() places it in ping_log.
+    static QString legacyReturnTime(const QSqlDatabase &db);
+    static QString legacyStartTime(const QSqlDatabase &db);
+    // Creates ping_log, if missing, in schema: "main" or the name an
+    // attached database goes by.
+    static bool createLogTable(QSqlDatabase &db, const QString &schema);
+
+private:
+    static int version(const QSqlDatabase &db);
+    static void setVersion(QSqlDatabase &db, int version);
+    static bool hasTable(const QSqlDatabase &db, const QString &table);
+    static bool hasColumn(const QSqlDatabase &db, const QString &table, const QString &column);
+    static void upgradeToV1(QSqlDatabase &db);
+    static bool upgradeToV2(QSqlDatabase &db);
+    static bool upgradeToV3(QSqlDatabase &db);
+    static void createTables(QSqlDatabase &db);
+};
+
+#endif // LOGSCHEMA_H
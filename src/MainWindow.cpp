@@ -1,216 +1,483 @@
-#include "MainWindow.h"
-#include <QVBoxLayout>
-#include <QHBoxLayout>
-#include <QSplitter>
-#include <QLabel>
-#include <QHeaderView>
-#include <QMessageBox>
-#include <QStatusBar>
-#include <QSettings>
-#include "ChartWindow.h"
-
-MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent)
-    , m_pingManager(new PingManager(this))
-    , m_pingModel(new PingModel(this))
-    , m_logModel(new PingLogModel(this))
-    , m_dbThread(new DatabaseThread(this))
-{
-    setupUi();
-
-    // Start DB thread
-    m_dbThread->start();
-
-    // Connect Manager to UI and DB
-    connect(m_pingManager, &PingManager::newResult, this, &MainWindow::onNewResult);
-    
-    // Database connection is done in onNewResult to ensure thread safety if needed, 
-    // or we can connect directly if we use Qt::QueuedConnection (default for threads).
-    // However, onNewResult also updates UI models, so we can chain it there.
-    // Actually, let's connect directly for DB to ensure it gets data even if UI is busy?
-    // But we need to format data for DB. 
-    // PingManager emits (target, rtt, ttl, seq).
-    // DatabaseThread::saveResult takes same args.
-    connect(m_pingManager, &PingManager::newResult, m_dbThread, &DatabaseThread::saveResult);
-    
-    // Connect DB status
-    connect(m_dbThread, &DatabaseThread::statusUpdated, this, &MainWindow::updateDbStatus);
-}
-
-MainWindow::~MainWindow()
-{
-    m_dbThread->stop();
-    m_dbThread->wait();
-}
-
-void MainWindow::setupUi()
-{
-    QWidget *centralWidget = new QWidget(this);
-    setCentralWidget(centralWidget);
-
-    QVBoxLayout *mainLayout = new QVBoxLayout(centralWidget);
-
-    // Top Control Bar
-    QHBoxLayout *controlLayout = new QHBoxLayout();
-    
-    controlLayout->addWidget(new QLabel(QString::fromUtf8("Target:")));
-    m_targetInput = new QLineEdit();
-    m_targetInput->setPlaceholderText("IP or Hostname");
-    controlLayout->addWidget(m_targetInput);
-
-    m_addBtn = new QPushButton(QString::fromUtf8("Add"));
-    controlLayout->addWidget(m_addBtn);
-
-    m_removeBtn = new QPushButton(QString::fromUtf8("Remove"));
-    controlLayout->addWidget(m_removeBtn);
-
-    controlLayout->addWidget(new QLabel(QString::fromUtf8("Timeout (ms):")));
-    m_timeoutSpin = new QSpinBox();
-    m_timeoutSpin->setRange(100, 10000);
-    m_timeoutSpin->setValue(1000);
-    controlLayout->addWidget(m_timeoutSpin);
-
-    m_startBtn = new QPushButton(QString::fromUtf8("Start All"));
-    controlLayout->addWidget(m_startBtn);
-
-    m_stopBtn = new QPushButton(QString::fromUtf8("Stop"));
-    controlLayout->addWidget(m_stopBtn);
-
-    m_stopAllBtn = new QPushButton(QString::fromUtf8("Stop All"));
-    controlLayout->addWidget(m_stopAllBtn);
-
-    mainLayout->addLayout(controlLayout);
-
-    // Splitter for Views
-    QSplitter *splitter = new QSplitter(Qt::Vertical);
-
-    // Summary View
-    m_summaryView = new QTableView();
-    m_summaryView->setModel(m_pingModel);
-    m_summaryView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    m_summaryView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    splitter->addWidget(m_summaryView);
-
-    // Log View
-    m_logView = new QTableView();
-    m_logView->setModel(m_logModel);
-    m_logView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    splitter->addWidget(m_logView);
-
-    mainLayout->addWidget(splitter);
-
-    // Connect Buttons
-    connect(m_addBtn, &QPushButton::clicked, this, &MainWindow::onAddClicked);
-    connect(m_removeBtn, &QPushButton::clicked, this, &MainWindow::onRemoveClicked);
-    connect(m_startBtn, &QPushButton::clicked, this, &MainWindow::onStartClicked);
-    connect(m_stopBtn, &QPushButton::clicked, this, &MainWindow::onStopClicked);
-    connect(m_stopAllBtn, &QPushButton::clicked, this, &MainWindow::onStopAllClicked);
-    
-    // Double click on summary view
-    connect(m_summaryView, &QTableView::doubleClicked, this, &MainWindow::onTargetDoubleClicked);
-    
-    // Status Bar
-    statusBar()->showMessage(QString::fromUtf8("Ready"));
-
-    resize(800, 600);
-    setWindowTitle(QString::fromUtf8("Qt6 Multithreaded Ping Tool"));
-    
-    // Load targets
-    QSettings settings("MyCompany", "PingTool");
-    QStringList targets = settings.value("targets").toStringList();
-    for (const QString &t : targets) {
-        m_pingModel->addTarget(t);
-    }
-}
-
-void MainWindow::onAddClicked()
-{
-    QString targetInput = m_targetInput->text().trimmed();
-    if (!targetInput.isEmpty()) {
-        m_pingModel->addTarget(targetInput);
-        m_targetInput->clear();
-        
-        // Save targets
-        QSettings settings("MyCompany", "PingTool");
-        settings.setValue("targets", m_pingModel->getTargets());
-    }
-}
-
-void MainWindow::onRemoveClicked()
-{
-    QModelIndex index = m_summaryView->currentIndex();
-    if (index.isValid()) {
-        QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
-        
-        // Stop ping first
-        m_pingManager->stopPing(target);
-        
-        // Remove from model
-        m_pingModel->removeTarget(target);
-        
-        // Save targets
-        QSettings settings("MyCompany", "PingTool");
-        settings.setValue("targets", m_pingModel->getTargets());
-    } else {
-        QMessageBox::information(this, "Info", "Please select a target to remove.");
-    }
-}
-
-void MainWindow::onTargetDoubleClicked(const QModelIndex &index)
-{
-    if (!index.isValid()) return;
-    
-    QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
-    int timeout = m_timeoutSpin->value();
-    
-    ChartWindow *chartWin = new ChartWindow(target, timeout, this);
-    connect(m_pingManager, &PingManager::newResult, chartWin, &ChartWindow::onNewResult);
-    chartWin->show();
-}
-
-void MainWindow::onStartClicked()
-{
-    int timeout = m_timeoutSpin->value();
-    QStringList targets = m_pingModel->getTargets();
-    
-    for (const QString &target : targets) {
-        m_pingManager->startPing(target, timeout);
-    }
-}
-
-void MainWindow::onStopClicked()
-{
-    // Stop selected target
-    QModelIndex index = m_summaryView->currentIndex();
-    if (index.isValid()) {
-        QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
-        m_pingManager->stopPing(target);
-        // Update status manually? PingManager doesn't emit stopped.
-        // We can assume it stops.
-        // But PingModel status is updated by newResult. 
-        // Maybe we should add setStatus to PingModel.
-    }
-}
-
-void MainWindow::onStopAllClicked()
-{
-    m_pingManager->stopAll();
-}
-
-void MainWindow::onNewResult(QString target, int rtt, int ttl, int seq)
-{
-    // Update Summary Model
-    m_pingModel->updateResult(target, rtt, ttl, seq);
-
-    // Update Log Model
-    m_logModel->addEntry(target, rtt, ttl, seq);
-}
-
-void MainWindow::updateDbStatus(long long generated, long long written, QString lastAction)
-{
-    QString msg = QString::fromUtf8("DB Status: Generated %1 | Written %2 | Action: %3")
-                      .arg(generated)
-                      .arg(written)
-                      .arg(lastAction);
-    statusBar()->showMessage(msg);
-}
+#include "MainWindow.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QSplitter>
+#include <QLabel>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QStatusBar>
+#include <QSettings>
+#include <QHostAddress>
+#include "ChartWindow.h"
+#include "ProbeTarget.h"
+
+namespace {
+
+const int DEFAULT_REFRESH_HZ = 30;   // How often the views pick up new results
+const int RESULT_BATCH = 4096;
+
+// The "ui/refreshHz" setting, within reason
+int refreshIntervalMs()
+{
+    QSettings settings("MyCompany", "PingTool");
+    int hz = qBound(1, settings.value("ui/refreshHz", DEFAULT_REFRESH_HZ).toInt(), 240);
+    return 1000 / hz;
+}
+
+} // namespace
+
+MainWindow::MainWindow(QWidget *parent)
+    : QMainWindow(parent)
+    , m_pingManager(new PingManager(this))
+    , m_pingModel(new PingModel(m_pingManager->registry(), this))
+    , m_logModel(new PingLogModel(m_pingManager->registry(), PingLogModel::configuredCapacity(), this))
+    , m_dbThread(new DatabaseThread(this))
+    , m_resultReader(-1)
+    , m_resultTimer(new QTimer(this))
+    , m_resultBuffer(RESULT_BATCH)
+{
+    setupUi();
+
+    // The GUI and the database each read every result from the manager's
+    // ring in batches; nothing is queued per result.
+    m_dbThread->setTargetRegistry(m_pingManager->registry());
+    m_dbThread->setResultRing(m_pingManager->resultRing());
+    m_dbThread->start();
+
+    m_resultReader = m_pingManager->resultRing()->addReader();
+    connect(m_resultTimer, &QTimer::timeout, this, &MainWindow::onDrainResults);
+    m_resultTimer->start(refreshIntervalMs());
+
+    // Connect DB status
+    connect(m_dbThread, &DatabaseThread::statusUpdated, this, &MainWindow::updateDbStatus);
+}
+
+MainWindow::~MainWindow()
+{
+    m_dbThread->stop();
+    m_dbThread->wait();
+    m_pingManager->resultRing()->removeReader(m_resultReader);
+}
+
+void MainWindow::setupUi()
+{
+    QWidget *centralWidget = new QWidget(this);
+    setCentralWidget(centralWidget);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(centralWidget);
+
+    // Top Control Bar
+    QHBoxLayout *controlLayout = new QHBoxLayout();
+    
+    controlLayout->addWidget(new QLabel(QString::fromUtf8("Target:")));
+    m_targetInput = new QLineEdit();
+    m_targetInput->setPlaceholderText("IP, Hostname, tcp://host:port or udp://host:port");
+    controlLayout->addWidget(m_targetInput);
+
+    // Address family for host names; "Both" adds one target per family
+    m_familyCombo = new QComboBox();
+    m_familyCombo->addItem(QString::fromUtf8("Auto"), -1);
+    m_familyCombo->addItem(QString::fromUtf8("IPv4"), int(ProbeTarget::Ipv4));
+    m_familyCombo->addItem(QString::fromUtf8("IPv6"), int(ProbeTarget::Ipv6));
+    m_familyCombo->addItem(QString::fromUtf8("Both"), int(ProbeTarget::AnyFamily));
+    m_familyCombo->setToolTip(QString::fromUtf8("Auto uses the preferred family (setting dns/preferIpv6) and falls back to the other"));
+    controlLayout->addWidget(m_familyCombo);
+
+    m_addBtn = new QPushButton(QString::fromUtf8("Add"));
+    controlLayout->addWidget(m_addBtn);
+
+    m_removeBtn = new QPushButton(QString::fromUtf8("Remove"));
+    controlLayout->addWidget(m_removeBtn);
+
+    controlLayout->addWidget(new QLabel(QString::fromUtf8("Timeout (ms):")));
+    m_timeoutSpin = new QSpinBox();
+    m_timeoutSpin->setRange(100, 10000);
+    m_timeoutSpin->setValue(1000);
+    controlLayout->addWidget(m_timeoutSpin);
+
+    m_startBtn = new QPushButton(QString::fromUtf8("Start All"));
+    controlLayout->addWidget(m_startBtn);
+
+    m_stopBtn = new QPushButton(QString::fromUtf8("Stop"));
+    controlLayout->addWidget(m_stopBtn);
+
+    m_stopAllBtn = new QPushButton(QString::fromUtf8("Stop All"));
+    controlLayout->addWidget(m_stopAllBtn);
+
+    m_throughputCheck = new QCheckBox(QString::fromUtf8("Max Rate"));
+    m_throughputCheck->setToolTip(QString::fromUtf8("Send the next probe as soon as the previous one completes"));
+    controlLayout->addWidget(m_throughputCheck);
+
+    controlLayout->addWidget(new QLabel(QString::fromUtf8("Max pps:")));
+    m_rateLimitSpin = new QSpinBox();
+    m_rateLimitSpin->setRange(0, 10000000);
+    m_rateLimitSpin->setSpecialValueText(QString::fromUtf8("Unlimited"));
+    m_rateLimitSpin->setValue(static_cast<int>(m_pingManager->rateLimit()));
+    m_rateLimitSpin->setToolTip(QString::fromUtf8("Total probes per second across all targets; probes over the limit wait their turn"));
+    controlLayout->addWidget(m_rateLimitSpin);
+
+    mainLayout->addLayout(controlLayout);
+
+    // Probe policy for newly added targets, or the selected one via Apply
+    QHBoxLayout *policyLayout = new QHBoxLayout();
+    ProbePolicy defaults;
+
+    policyLayout->addWidget(new QLabel(QString::fromUtf8("Interval (ms):")));
+    m_intervalSpin = new QSpinBox();
+    m_intervalSpin->setRange(ProbePolicy::MIN_INTERVAL_MS, 3600000);
+    m_intervalSpin->setValue(defaults.intervalMs);
+    policyLayout->addWidget(m_intervalSpin);
+
+    policyLayout->addWidget(new QLabel(QString::fromUtf8("Burst:")));
+    m_burstSpin = new QSpinBox();
+    m_burstSpin->setRange(1, ProbePolicy::MAX_BURST);
+    m_burstSpin->setValue(defaults.burstCount);
+    m_burstSpin->setToolTip(QString::fromUtf8("Probes sent back-to-back at the start of every interval"));
+    policyLayout->addWidget(m_burstSpin);
+
+    policyLayout->addWidget(new QLabel(QString::fromUtf8("Jitter (%):")));
+    m_jitterSpin = new QSpinBox();
+    m_jitterSpin->setRange(0, 100);
+    m_jitterSpin->setValue(defaults.jitterPercent);
+    m_jitterSpin->setToolTip(QString::fromUtf8("Randomly lengthen or shorten each interval by up to this much"));
+    policyLayout->addWidget(m_jitterSpin);
+
+    m_applyPolicyBtn = new QPushButton(QString::fromUtf8("Apply to Selected"));
+    policyLayout->addWidget(m_applyPolicyBtn);
+    policyLayout->addStretch();
+
+    mainLayout->addLayout(policyLayout);
+
+    // Splitter for Views
+    QSplitter *splitter = new QSplitter(Qt::Vertical);
+
+    // Summary View
+    m_summaryView = new QTableView();
+    m_summaryView->setModel(m_pingModel);
+    m_summaryView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_summaryView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    splitter->addWidget(m_summaryView);
+
+    // Log View, with its filter above it
+    QWidget *logPane = new QWidget();
+    QVBoxLayout *logLayout = new QVBoxLayout(logPane);
+    logLayout->setContentsMargins(0, 0, 0, 0);
+
+    QHBoxLayout *logFilterLayout = new QHBoxLayout();
+    logFilterLayout->addWidget(new QLabel(QString::fromUtf8("Log target:")));
+    m_logTargetFilter = new QLineEdit();
+    m_logTargetFilter->setPlaceholderText(QString::fromUtf8("All targets"));
+    logFilterLayout->addWidget(m_logTargetFilter);
+
+    logFilterLayout->addWidget(new QLabel(QString::fromUtf8("Status:")));
+    m_logStatusFilter = new QComboBox();
+    m_logStatusFilter->addItem(QString::fromUtf8("All"), int(PingLogModel::AnyStatus));
+    m_logStatusFilter->addItem(QString::fromUtf8("Reply"), int(PingLogModel::ReplyMask));
+    m_logStatusFilter->addItem(QString::fromUtf8("Timeout"), int(PingLogModel::TimeoutMask));
+    m_logStatusFilter->addItem(QString::fromUtf8("Error"), int(PingLogModel::ErrorMask));
+    m_logStatusFilter->addItem(QString::fromUtf8("Timeout or Error"), int(PingLogModel::TimeoutMask | PingLogModel::ErrorMask));
+    logFilterLayout->addWidget(m_logStatusFilter);
+    logFilterLayout->addStretch();
+    logLayout->addLayout(logFilterLayout);
+
+    m_logView = new QTableView();
+    m_logView->setModel(m_logModel);
+    m_logView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    // Every row is the same height; don't measure millions of them
+    m_logView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    logLayout->addWidget(m_logView);
+    splitter->addWidget(logPane);
+
+    mainLayout->addWidget(splitter);
+
+    // Connect Buttons
+    connect(m_addBtn, &QPushButton::clicked, this, &MainWindow::onAddClicked);
+    connect(m_removeBtn, &QPushButton::clicked, this, &MainWindow::onRemoveClicked);
+    connect(m_startBtn, &QPushButton::clicked, this, &MainWindow::onStartClicked);
+    connect(m_stopBtn, &QPushButton::clicked, this, &MainWindow::onStopClicked);
+    connect(m_stopAllBtn, &QPushButton::clicked, this, &MainWindow::onStopAllClicked);
+    connect(m_throughputCheck, &QCheckBox::toggled, m_pingManager, &PingManager::setThroughputMode);
+    connect(m_rateLimitSpin, &QSpinBox::valueChanged, this, &MainWindow::onRateLimitChanged);
+    connect(m_applyPolicyBtn, &QPushButton::clicked, this, &MainWindow::onApplyPolicyClicked);
+    // On Enter rather than per keystroke: each change is a pass over the log
+    connect(m_logTargetFilter, &QLineEdit::editingFinished, this, &MainWindow::onLogFilterChanged);
+    connect(m_logStatusFilter, &QComboBox::currentIndexChanged, this, &MainWindow::onLogFilterChanged);
+    connect(m_summaryView->selectionModel(), &QItemSelectionModel::currentRowChanged, this, &MainWindow::onTargetSelected);
+    
+    // Double click on summary view
+    connect(m_summaryView, &QTableView::doubleClicked, this, &MainWindow::onTargetDoubleClicked);
+    
+    // Status Bar
+    statusBar()->showMessage(QString::fromUtf8("Ready"));
+
+    m_rateStatusLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_rateStatusLabel);
+
+    m_engineStatusLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_engineStatusLabel);
+
+    m_engineStatusTimer = new QTimer(this);
+    connect(m_engineStatusTimer, &QTimer::timeout, this, &MainWindow::updateEngineStatus);
+    m_engineStatusTimer->start(1000);
+
+    resize(800, 600);
+    setWindowTitle(QString::fromUtf8("Qt6 Multithreaded Ping Tool"));
+    
+    // Load targets
+    QSettings settings("MyCompany", "PingTool");
+    QStringList targets = settings.value("targets").toStringList();
+    QVariantMap policies = settings.value("policies").toMap();
+    for (const QString &t : targets) {
+        m_pingModel->addTarget(t);
+        if (policies.contains(t)) {
+            m_pingManager->setPolicy(t, ProbePolicy::fromString(policies.value(t).toString()));
+        }
+    }
+}
+
+ProbePolicy MainWindow::policyFromUi() const
+{
+    ProbePolicy policy;
+    policy.intervalMs = static_cast<uint32_t>(m_intervalSpin->value());
+    policy.burstCount = m_burstSpin->value();
+    policy.jitterPercent = m_jitterSpin->value();
+    return policy;
+}
+
+void MainWindow::saveTargets()
+{
+    QStringList targets = m_pingModel->getTargets();
+    QVariantMap policies;
+    for (const QString &t : targets) {
+        policies.insert(t, m_pingManager->policy(t).toString());
+    }
+
+    QSettings settings("MyCompany", "PingTool");
+    settings.setValue("targets", targets);
+    settings.setValue("policies", policies);
+}
+
+void MainWindow::onAddClicked()
+{
+    QString targetInput = m_targetInput->text().trimmed();
+    if (!targetInput.isEmpty()) {
+        // Pin host names to the chosen family; literals and targets that
+        // already name a family are added as typed.
+        QStringList targets;
+        int family = m_familyCombo->currentData().toInt();
+        ProbeTarget probe = ProbeTarget::parse(targetInput);
+        if (family < 0 || probe.family != ProbeTarget::AnyFamily || !QHostAddress(probe.host).isNull()) {
+            targets << targetInput;
+        } else if (family == ProbeTarget::AnyFamily) {
+            targets << ProbeTarget::withFamily(targetInput, ProbeTarget::Ipv4)
+                    << ProbeTarget::withFamily(targetInput, ProbeTarget::Ipv6);
+        } else {
+            targets << ProbeTarget::withFamily(targetInput, ProbeTarget::Family(family));
+        }
+
+        for (const QString &target : targets) {
+            m_pingModel->addTarget(target);
+            m_pingManager->setPolicy(target, policyFromUi());
+        }
+        m_targetInput->clear();
+        
+        // Save targets
+        saveTargets();
+    }
+}
+
+void MainWindow::onRemoveClicked()
+{
+    QModelIndex index = m_summaryView->currentIndex();
+    if (index.isValid()) {
+        QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
+        
+        // Stop ping first
+        m_pingManager->stopPing(target);
+        
+        // Remove from model
+        m_pingModel->removeTarget(target);
+        
+        // Save targets
+        saveTargets();
+    } else {
+        QMessageBox::information(this, "Info", "Please select a target to remove.");
+    }
+}
+
+void MainWindow::onTargetDoubleClicked(const QModelIndex &index)
+{
+    if (!index.isValid()) return;
+    
+    QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
+    int timeout = m_timeoutSpin->value();
+    
+    ChartWindow *chartWin = new ChartWindow(target, timeout, this);
+    chartWin->setResultRing(m_pingManager->resultRing(), m_pingManager->registry()->intern(target));
+    chartWin->show();
+}
+
+void MainWindow::onTargetSelected(const QModelIndex &current)
+{
+    if (!current.isValid()) return;
+
+    // Show the selected target's policy so it can be edited and applied
+    QString target = m_pingModel->data(m_pingModel->index(current.row(), 0)).toString();
+    ProbePolicy policy = m_pingManager->policy(target);
+    m_intervalSpin->setValue(static_cast<int>(policy.intervalMs));
+    m_burstSpin->setValue(policy.burstCount);
+    m_jitterSpin->setValue(policy.jitterPercent);
+}
+
+void MainWindow::onApplyPolicyClicked()
+{
+    QModelIndex index = m_summaryView->currentIndex();
+    if (!index.isValid()) {
+        QMessageBox::information(this, "Info", "Please select a target to apply the policy to.");
+        return;
+    }
+
+    // Takes effect immediately if the target is running
+    QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
+    m_pingManager->setPolicy(target, policyFromUi());
+    saveTargets();
+}
+
+void MainWindow::onRateLimitChanged(int pps)
+{
+    m_pingManager->setRateLimit(pps);
+
+    QSettings settings("MyCompany", "PingTool");
+    settings.setValue("rateLimit/globalPps", pps);
+}
+
+void MainWindow::onStartClicked()
+{
+    int timeout = m_timeoutSpin->value();
+    QStringList targets = m_pingModel->getTargets();
+    
+    for (const QString &target : targets) {
+        m_pingManager->startPing(target, timeout);
+    }
+}
+
+void MainWindow::onStopClicked()
+{
+    // Stop selected target
+    QModelIndex index = m_summaryView->currentIndex();
+    if (index.isValid()) {
+        QString target = m_pingModel->data(m_pingModel->index(index.row(), 0)).toString();
+        m_pingManager->stopPing(target);
+        // Update status manually? PingManager doesn't emit stopped.
+        // We can assume it stops.
+        // But PingModel status is updated by the results. 
+        // Maybe we should add setStatus to PingModel.
+    }
+}
+
+void MainWindow::onStopAllClicked()
+{
+    m_pingManager->stopAll();
+}
+
+void MainWindow::onLogFilterChanged()
+{
+    // An exact target name; interning one that isn't added yet is harmless
+    // and makes the filter pick it up once it is
+    QString target = m_logTargetFilter->text().trimmed();
+    quint32 id = target.isEmpty() ? quint32(TargetRegistry::InvalidId) : m_pingManager->registry()->intern(target);
+    m_logModel->setFilter(id, m_logStatusFilter->currentData().toInt());
+}
+
+void MainWindow::onDrainResults()
+{
+    // Everything published since the last frame; a short batch means the
+    // ring is empty for now. At most one ring's worth per frame so the event
+    // loop still gets to run when results arrive faster than we apply them.
+    // The models only collect the results; the views are told once per
+    // frame, however many results came in.
+    ResultRing *ring = m_pingManager->resultRing();
+    int total = 0;
+    int count;
+    do {
+        count = ring->read(m_resultReader, m_resultBuffer.data(), m_resultBuffer.size());
+        for (int i = 0; i < count; ++i) {
+            const ProbeResult &r = m_resultBuffer.at(i);
+
+            // Update Summary Model
+            m_pingModel->updateResult(r.targetId, r.rttNs, r.ttl, r.seq);
+
+            // Update Log Model
+            m_logModel->addEntry(r.targetId, r.returnTime, r.rttNs, r.ttl, r.seq);
+        }
+        total += count;
+    } while (count == m_resultBuffer.size() && total < ring->capacity());
+
+    m_pingModel->flush();
+    m_logModel->flush();
+}
+
+void MainWindow::updateDbStatus(long long generated, long long written, QString lastAction)
+{
+    QString msg = QString::fromUtf8("DB Status: Generated %1 | Written %2 | Action: %3")
+                      .arg(generated)
+                      .arg(written)
+                      .arg(lastAction);
+    statusBar()->showMessage(msg);
+}
+
+void MainWindow::updateEngineStatus()
+{
+    // Send budget, next to the DB status
+    SendBudget::Stats budget = m_pingManager->budgetStats();
+    if (budget.granted == 0) {
+        m_rateStatusLabel->clear();
+    } else {
+        QString limit = budget.configuredPps > 0 ? QString::number(budget.configuredPps, 'f', 0)
+                                                 : QString::fromUtf8("unlimited");
+        QString rate = QString::fromUtf8("Rate: %1 / %2 pps | Deferred %3")
+                           .arg(budget.actualPps, 0, 'f', 0)
+                           .arg(limit)
+                           .arg(budget.deferred);
+        if (budget.deferred > 0) {
+            rate += QString::fromUtf8(" (avg %1 ms, backlog %2 ms)")
+                        .arg(budget.avgDelayMs, 0, 'f', 1)
+                        .arg(budget.backlogMs, 0, 'f', 0);
+        }
+        m_rateStatusLabel->setText(rate);
+    }
+
+    PingManager::EngineStats stats = m_pingManager->engineStats();
+    if (stats.probesSent == 0) {
+        m_engineStatusLabel->clear();
+        return;
+    }
+
+    QString text = QString::fromUtf8("Engine (%1): %2 pps")
+                       .arg(m_pingManager->backendName())
+                       .arg(stats.probesPerSec, 0, 'f', 0);
+    if (stats.avgSendBatch > 0) {
+        text += QString::fromUtf8(" | Batch tx %1 rx %2")
+                    .arg(stats.avgSendBatch, 0, 'f', 1)
+                    .arg(stats.avgRecvBatch, 0, 'f', 1);
+    }
+    text += QString::fromUtf8(" | Lag %1/%2 ms")
+                .arg(stats.avgTimerLagMs, 0, 'f', 1)
+                .arg(stats.maxTimerLagMs);
+
+    DnsResolver::Stats dns = m_pingManager->resolverStats();
+    if (dns.queries > 0) {
+        text += QString::fromUtf8(" | DNS hit %1% avg %2 ms")
+                    .arg(dns.hitRate() * 100.0, 0, 'f', 1)
+                    .arg(dns.avgLatencyMs, 0, 'f', 1);
+    }
+
+    // Results overwritten before the GUI, database or a chart got to them
+    ResultRing::Stats ring = m_pingManager->ringStats();
+    if (ring.overflowed > 0) {
+        text += QString::fromUtf8(" | Results lost %1 (lag %2)")
+                    .arg(ring.overflowed)
+                    .arg(ring.maxLag);
+    }
+    m_engineStatusLabel->setText(text);
+}
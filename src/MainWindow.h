@@ -1,52 +1,80 @@
-#ifndef MAINWINDOW_H
-#define MAINWINDOW_H
-
-#include <QMainWindow>
-#include <QLineEdit>
-#include <QSpinBox>
-#include <QPushButton>
-#include <QTableView>
-#include "PingManager.h"
-#include "PingModel.h"
-#include "PingLogModel.h"
-#include "DatabaseThread.h"
-
-class MainWindow : public QMainWindow
-{
-    Q_OBJECT
-
-public:
-    MainWindow(QWidget *parent = nullptr);
-    ~MainWindow();
-
-private slots:
-    void onStartClicked();
-    void onStopClicked();
-    void onStopAllClicked();
-    void onAddClicked();
-    void onRemoveClicked();
-    void onTargetDoubleClicked(const QModelIndex &index);
-    void onNewResult(QString target, int rtt, int ttl, int seq);
-    void updateDbStatus(long long generated, long long written, QString lastAction);
-
-private:
-    void setupUi();
-
-    QLineEdit *m_targetInput;
-    QPushButton *m_addBtn;
-    QPushButton *m_removeBtn;
-    QSpinBox *m_timeoutSpin;
-    QPushButton *m_startBtn;
-    QPushButton *m_stopBtn;
-    QPushButton *m_stopAllBtn;
-    
-    QTableView *m_summaryView;
-    QTableView *m_logView;
-    
-    PingManager *m_pingManager;
-    PingModel *m_pingModel;
-    PingLogModel *m_logModel;
-    DatabaseThread *m_dbThread;
-};
-
-#endif // MAINWINDOW_H
+#ifndef MAINWINDOW_H
+#define MAINWINDOW_H
+
+#include <QMainWindow>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QTableView>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QLabel>
+#include <QTimer>
+#include <QVector>
+#include "PingManager.h"
+#include "PingModel.h"
+#include "PingLogModel.h"
+#include "DatabaseThread.h"
+
+class MainWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    MainWindow(QWidget *parent = nullptr);
+    ~MainWindow();
+
+private slots:
+    void onStartClicked();
+    void onStopClicked();
+    void onStopAllClicked();
+    void onAddClicked();
+    void onRemoveClicked();
+    void onTargetDoubleClicked(const QModelIndex &index);
+    void onTargetSelected(const QModelIndex &current);
+    void onApplyPolicyClicked();
+    void onRateLimitChanged(int pps);
+    void onDrainResults();
+    void onLogFilterChanged();
+    void updateDbStatus(long long generated, long long written, QString lastAction);
+    void updateEngineStatus();
+
+private:
+    void setupUi();
+    ProbePolicy policyFromUi() const;
+    void saveTargets();
+
+    QLineEdit *m_targetInput;
+    QComboBox *m_familyCombo;
+    QPushButton *m_addBtn;
+    QPushButton *m_removeBtn;
+    QSpinBox *m_timeoutSpin;
+    QPushButton *m_startBtn;
+    QPushButton *m_stopBtn;
+    QPushButton *m_stopAllBtn;
+    QCheckBox *m_throughputCheck;
+    QSpinBox *m_rateLimitSpin;
+    QSpinBox *m_intervalSpin;
+    QSpinBox *m_burstSpin;
+    QSpinBox *m_jitterSpin;
+    QPushButton *m_applyPolicyBtn;
+    QLabel *m_engineStatusLabel;
+    QLabel *m_rateStatusLabel;
+    QTimer *m_engineStatusTimer;
+    
+    QTableView *m_summaryView;
+    QTableView *m_logView;
+    QLineEdit *m_logTargetFilter;
+    QComboBox *m_logStatusFilter;
+    
+    PingManager *m_pingManager;
+    PingModel *m_pingModel;
+    PingLogModel *m_logModel;
+    DatabaseThread *m_dbThread;
+
+    int m_resultReader;               // Our cursor in the manager's result ring
+    QTimer *m_resultTimer;
+    QVector<ProbeResult> m_resultBuffer;
+};
+
+#endif // MAINWINDOW_H
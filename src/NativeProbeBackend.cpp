@@ -0,0 +1,85 @@
+#include "NativeProbeBackend.h"
+
+NativeProbeBackend::NativeProbeBackend(QObject *parent)
+    : ProbeBackend(parent)
+    , m_throughputMode(false)
+    , m_resolver(nullptr)
+    , m_budget(nullptr)
+    , m_ring(nullptr)
+{
+}
+
+NativeProbeBackend::~NativeProbeBackend()
+{
+    shutdown();
+}
+
+void NativeProbeBackend::shutdown()
+{
+    removeAll();
+}
+
+void NativeProbeBackend::addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy)
+{
+    QMutexLocker locker(&m_mutex);
+    if (workerOf(id)) {
+        return;
+    }
+
+    PingWorker *worker = new PingWorker(id, target, timeoutMs, this);
+    worker->setPolicy(policy);
+    worker->setThroughputMode(m_throughputMode);
+    worker->setResolver(m_resolver);
+    worker->setSendBudget(m_budget);
+    worker->setResultRing(m_ring);
+
+    if (id >= quint32(m_workers.size())) {
+        m_workers.resize(int(id) + 1, nullptr);
+    }
+    m_workers[int(id)] = worker;
+    worker->start();
+}
+
+void NativeProbeBackend::removeTarget(quint32 id)
+{
+    QMutexLocker locker(&m_mutex);
+    if (PingWorker *worker = workerOf(id)) {
+        m_workers[int(id)] = nullptr;
+        worker->stop();
+        worker->quit();
+        worker->wait();
+        delete worker;
+    }
+}
+
+void NativeProbeBackend::removeAll()
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto worker : m_workers) {
+        if (!worker) continue;
+        worker->stop();
+        worker->quit();
+        worker->wait();
+        delete worker;
+    }
+    m_workers.clear();
+}
+
+void NativeProbeBackend::setPolicy(quint32 id, const ProbePolicy &policy)
+{
+    QMutexLocker locker(&m_mutex);
+    if (PingWorker *worker = workerOf(id)) {
+        worker->setPolicy(policy);
+    }
+}
+
+void NativeProbeBackend::setThroughputMode(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_throughputMode = enabled;
+    for (auto worker : m_workers) {
+        if (worker) {
+            worker->setThroughputMode(enabled);
+        }
+    }
+}
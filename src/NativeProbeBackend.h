@@ -0,0 +1,41 @@
+#ifndef NATIVEPROBEBACKEND_H
+#define NATIVEPROBEBACKEND_H
+
+#include <QVector>
+#include <QMutex>
+#include "ProbeBackend.h"
+#include "PingWorker.h"
+
+// Windows IcmpSendEcho backend: one PingWorker thread per target.
+class NativeProbeBackend : public ProbeBackend
+{
+    Q_OBJECT
+public:
+    explicit NativeProbeBackend(QObject *parent = nullptr);
+    ~NativeProbeBackend();
+
+    QString name() const override { return "native"; }
+    void setResolver(DnsResolver *resolver) override { m_resolver = resolver; }
+    void setSendBudget(SendBudget *budget) override { m_budget = budget; }
+    void setResultRing(ResultRing *ring) override { m_ring = ring; }
+    void start() override {}
+    void shutdown() override;
+
+    void addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy) override;
+    void removeTarget(quint32 id) override;
+    void removeAll() override;
+    void setPolicy(quint32 id, const ProbePolicy &policy) override;
+    void setThroughputMode(bool enabled) override;
+
+private:
+    PingWorker *workerOf(quint32 id) const { return id < quint32(m_workers.size()) ? m_workers.at(int(id)) : nullptr; }
+
+    QVector<PingWorker*> m_workers; // By target id, null if not added
+    bool m_throughputMode;
+    DnsResolver *m_resolver;
+    SendBudget *m_budget;
+    ResultRing *m_ring;
+    QMutex m_mutex;
+};
+
+#endif // NATIVEPROBEBACKEND_H
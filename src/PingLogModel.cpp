@@ -1,92 +1,231 @@
-#include "PingLogModel.h"
-
-PingLogModel::PingLogModel(QObject *parent)
-    : QAbstractTableModel(parent)
-{
-}
-
-int PingLogModel::rowCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return m_data.size();
-}
-
-int PingLogModel::columnCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return 6; // Time, Target, Seq, RTT, TTL, Status
-}
-
-QVariant PingLogModel::data(const QModelIndex &index, int role) const
-{
-    if (!index.isValid() || index.row() >= m_data.size())
-        return QVariant();
-
-    // Show newest first
-    const PingLogEntry &entry = m_data[m_data.size() - 1 - index.row()];
-
-    if (role == Qt::DisplayRole) {
-        switch (index.column()) {
-        case 0: return entry.timestamp.toString("HH:mm:ss.zzz");
-        case 1: return entry.target;
-        case 2: return entry.seq;
-        case 3: return (entry.rtt >= 0) ? QString("%1 ms").arg(entry.rtt) : "-";
-        case 4: return (entry.ttl > 0) ? QString::number(entry.ttl) : "-";
-        case 5: return entry.status;
-        }
-    }
-    return QVariant();
-}
-
-QVariant PingLogModel::headerData(int section, Qt::Orientation orientation, int role) const
-{
-    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
-        return QVariant();
-
-    switch (section) {
-    case 0: return QString::fromUtf8("Time");
-    case 1: return QString::fromUtf8("Target");
-    case 2: return QString::fromUtf8("Seq");
-    case 3: return QString::fromUtf8("RTT");
-    case 4: return QString::fromUtf8("TTL");
-    case 5: return QString::fromUtf8("Status");
-    }
-    return QVariant();
-}
-
-void PingLogModel::addEntry(const QString &target, int rtt, int ttl, int seq)
-{
-    beginInsertRows(QModelIndex(), 0, 0); // Insert at top visually (but we append to list and reverse in data())
-    // Actually, standard is append to list, but if we want newest at top, we can prepend or map index.
-    // Let's append and map index in data() for performance (prepend is O(N)).
-    
-    PingLogEntry entry;
-    entry.timestamp = QDateTime::currentDateTime();
-    entry.target = target;
-    entry.seq = seq;
-    entry.rtt = rtt;
-    entry.ttl = ttl;
-    
-    if (rtt >= 0) entry.status = "Reply";
-    else if (rtt == -1) entry.status = "Timeout";
-    else entry.status = "Error";
-
-    m_data.append(entry);
-    endInsertRows();
-
-    // Enforce size limit
-    if (m_data.size() > MAX_LOG_SIZE) {
-        beginRemoveRows(QModelIndex(), MAX_LOG_SIZE, MAX_LOG_SIZE);
-        m_data.removeFirst(); // Remove oldest (index 0 in m_data, which corresponds to last row in view)
-        endRemoveRows();
-    }
-}
-
-void PingLogModel::clear()
-{
-    beginResetModel();
-    m_data.clear();
-    endResetModel();
-}
+#include "PingLogModel.h"
+#include <QDateTime>
+#include <QSettings>
+
+namespace {
+
+const char *const STATUS_NAMES[] = { "Reply", "Timeout", "Error" };
+
+} // namespace
+
+PingLogModel::PingLogModel(TargetRegistry *targets, int capacity, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_targets(targets)
+    , m_entries(qBound(1, capacity, int(MaxCapacity)))
+{
+}
+
+int PingLogModel::configuredCapacity()
+{
+    QSettings settings("MyCompany", "PingTool");
+    return qBound(100, settings.value("log/capacity", int(DefaultCapacity)).toInt(), int(MaxCapacity));
+}
+
+int PingLogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_rows;
+}
+
+int PingLogModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return 6; // Time, Target, Seq, RTT, TTL, Status
+}
+
+QVariant PingLogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows)
+        return QVariant();
+
+    if (role == Qt::DisplayRole) {
+        const PingLogEntry &entry = entryForRow(index.row());
+        switch (index.column()) {
+        case 0: return QDateTime::fromMSecsSinceEpoch(entry.timeMs).toString("HH:mm:ss.zzz");
+        case 1: return m_targets->name(entry.targetId);
+        case 2: return entry.seq;
+        case 3: return (entry.rttNs >= 0) ? QString("%1 ms").arg(entry.rttNs / 1000000.0, 0, 'f', 3) : "-";
+        case 4: return (entry.ttl > 0) ? QString::number(entry.ttl) : "-";
+        case 5: return QString::fromLatin1(STATUS_NAMES[entry.status]);
+        }
+    }
+    return QVariant();
+}
+
+QVariant PingLogModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+
+    switch (section) {
+    case 0: return QString::fromUtf8("Time");
+    case 1: return QString::fromUtf8("Target");
+    case 2: return QString::fromUtf8("Seq");
+    case 3: return QString::fromUtf8("RTT");
+    case 4: return QString::fromUtf8("TTL");
+    case 5: return QString::fromUtf8("Status");
+    }
+    return QVariant();
+}
+
+const PingLogEntry &PingLogModel::entryForRow(int row) const
+{
+    // Show newest first
+    if (m_filtered) {
+        quint64 match = m_matchHead - 1 - quint64(row);
+        return entryAt(m_matches.at(int(match % quint64(m_matches.size()))));
+    }
+    return entryAt(m_shownHead - 1 - quint64(row));
+}
+
+quint64 PingLogModel::oldestPosition(quint64 head) const
+{
+    quint64 capacity = quint64(m_entries.size());
+    return head > capacity ? head - capacity : 0;
+}
+
+bool PingLogModel::matches(const PingLogEntry &entry) const
+{
+    if (m_filterTarget != TargetRegistry::InvalidId && entry.targetId != m_filterTarget) {
+        return false;
+    }
+    return (m_filterStatus & (1 << entry.status)) != 0;
+}
+
+void PingLogModel::setCapacity(int capacity)
+{
+    beginResetModel();
+    m_entries = QVector<PingLogEntry>(qBound(1, capacity, int(MaxCapacity)));
+    if (m_filtered) {
+        m_matches = QVector<quint64>(m_entries.size());
+    }
+    m_head = m_shownHead = 0;
+    m_matchHead = m_matchTail = 0;
+    m_rows = 0;
+    endResetModel();
+}
+
+void PingLogModel::addEntry(quint32 targetId, qint64 timeMs, qint64 rttNs, int ttl, int seq)
+{
+    PingLogEntry &entry = m_entries[int(m_head % quint64(m_entries.size()))];
+    entry.timeMs = timeMs;
+    entry.rttNs = rttNs;
+    entry.targetId = targetId;
+    entry.seq = seq;
+    entry.ttl = ttl;
+
+    if (rttNs >= 0) entry.status = Reply;
+    else if (rttNs == -1) entry.status = Timeout;
+    else entry.status = Error;
+
+    // Until the next flush the views still see m_shownHead; only rows that
+    // the flush is about to remove can show an overwritten entry meanwhile.
+    ++m_head;
+}
+
+void PingLogModel::flush()
+{
+    const quint64 head = m_head;
+    if (head == m_shownHead) return;
+    const quint64 capacity = quint64(m_entries.size());
+    const quint64 oldest = oldestPosition(head);
+
+    int inserted;
+    int rowsAfter;
+    quint64 matchHead = m_matchHead;
+    quint64 matchTail = m_matchTail;
+    if (!m_filtered) {
+        inserted = int(qMin(head - m_shownHead, capacity));
+        rowsAfter = int(qMin(quint64(m_rows) + quint64(inserted), capacity));
+    } else {
+        for (quint64 pos = qMax(m_shownHead, oldest); pos < head; ++pos) {
+            if (matches(entryAt(pos))) {
+                m_matches[int(matchHead % capacity)] = pos;
+                ++matchHead;
+            }
+        }
+        // There are never more live matches than entries, so a reused match
+        // slot held a position that has been overwritten since
+        if (matchHead - matchTail > capacity) {
+            matchTail = matchHead - capacity;
+        }
+        while (matchTail < matchHead && m_matches.at(int(matchTail % capacity)) < oldest) {
+            ++matchTail;
+        }
+        inserted = int(matchHead - m_matchHead);
+        rowsAfter = int(matchHead - matchTail);
+    }
+
+    if (m_rows > 0 && inserted > 0 && rowsAfter == inserted) {
+        // Nothing shown survives; cheaper to start over than insert and remove
+        beginResetModel();
+        m_shownHead = head;
+        m_matchHead = matchHead;
+        m_matchTail = matchTail;
+        m_rows = rowsAfter;
+        endResetModel();
+        return;
+    }
+
+    // Newest first, so the new entries are the top rows
+    m_shownHead = head;
+    if (inserted > 0) {
+        beginInsertRows(QModelIndex(), 0, inserted - 1);
+        m_matchHead = matchHead;
+        m_rows += inserted;
+        endInsertRows();
+    }
+
+    // Overwritten entries are the bottom rows
+    if (m_rows > rowsAfter) {
+        beginRemoveRows(QModelIndex(), rowsAfter, m_rows - 1);
+        m_matchTail = matchTail;
+        m_rows = rowsAfter;
+        endRemoveRows();
+    } else {
+        m_matchTail = matchTail;
+    }
+}
+
+void PingLogModel::clear()
+{
+    beginResetModel();
+    m_head = m_shownHead = 0;
+    m_matchHead = m_matchTail = 0;
+    m_rows = 0;
+    endResetModel();
+}
+
+void PingLogModel::setFilter(quint32 targetId, int statusMask)
+{
+    beginResetModel();
+    m_filterTarget = targetId;
+    m_filterStatus = statusMask & AnyStatus;
+    m_filtered = targetId != TargetRegistry::InvalidId || m_filterStatus != AnyStatus;
+
+    // Entries added since the last flush are picked up by the next one
+    const quint64 oldest = oldestPosition(m_head);
+    const quint64 first = qMin(oldest, m_shownHead);
+    if (m_filtered) {
+        const quint64 capacity = quint64(m_entries.size());
+        if (m_matches.size() != m_entries.size()) {
+            m_matches = QVector<quint64>(m_entries.size());
+        }
+        m_matchHead = m_matchTail = 0;
+        for (quint64 pos = first; pos < m_shownHead; ++pos) {
+            if (matches(entryAt(pos))) {
+                m_matches[int(m_matchHead % capacity)] = pos;
+                ++m_matchHead;
+            }
+        }
+        m_rows = int(m_matchHead);
+    } else {
+        // The position index is only needed while filtering
+        m_matches = QVector<quint64>();
+        m_matchHead = m_matchTail = 0;
+        m_rows = int(m_shownHead - first);
+    }
+    endResetModel();
+}
@@ -1,36 +1,80 @@
-#ifndef PINGLOGMODEL_H
-#define PINGLOGMODEL_H
-
-#include <QAbstractTableModel>
-#include <QDateTime>
-#include <QList>
-
-struct PingLogEntry {
-    QDateTime timestamp;
-    QString target;
-    int seq;
-    int rtt;
-    int ttl;
-    QString status;
-};
-
-class PingLogModel : public QAbstractTableModel
-{
-    Q_OBJECT
-public:
-    explicit PingLogModel(QObject *parent = nullptr);
-
-    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
-    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
-    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
-    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
-
-    void addEntry(const QString &target, int rtt, int ttl, int seq);
-    void clear();
-
-private:
-    QList<PingLogEntry> m_data;
-    const int MAX_LOG_SIZE = 1000; // Limit memory usage
-};
-
-#endif // PINGLOGMODEL_H
+#ifndef PINGLOGMODEL_H
+#define PINGLOGMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "TargetRegistry.h"
+
+// One log row as stored; everything shown is formatted from it on demand.
+struct PingLogEntry {
+    qint64 timeMs;      // Reply or timeout, ms since epoch
+    qint64 rttNs;
+    quint32 targetId;
+    qint32 seq;
+    qint32 ttl;
+    quint8 status;      // PingLogModel::Status
+};
+
+// The newest results, newest first, kept in a ring of compact records that
+// is allocated once: adding an entry overwrites the oldest slot and never
+// allocates. An optional filter by target and status shows a subset through
+// a ring of positions into the same records, without copying them.
+class PingLogModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Status : quint8 { Reply, Timeout, Error };
+    enum StatusMask { ReplyMask = 1 << Reply, TimeoutMask = 1 << Timeout, ErrorMask = 1 << Error,
+                      AnyStatus = ReplyMask | TimeoutMask | ErrorMask };
+    enum { DefaultCapacity = 100000, MaxCapacity = 1 << 24 };
+
+    // Target names are resolved through targets, which must outlive the model.
+    explicit PingLogModel(TargetRegistry *targets, int capacity = DefaultCapacity, QObject *parent = nullptr);
+
+    // The "log/capacity" setting, or DefaultCapacity.
+    static int configuredCapacity();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    int capacity() const { return m_entries.size(); }
+    // Drops every entry.
+    void setCapacity(int capacity);
+
+    // Views see new entries at the next flush().
+    void addEntry(quint32 targetId, qint64 timeMs, qint64 rttNs, int ttl, int seq);
+    // Inserts everything added since the last flush as one block of rows
+    // and trims the oldest in one removal.
+    void flush();
+    void clear();
+
+    // Only rows of targetId (InvalidId for any) whose status is in
+    // statusMask. Takes one pass over the stored entries.
+    void setFilter(quint32 targetId, int statusMask);
+    bool isFiltered() const { return m_filtered; }
+
+private:
+    bool matches(const PingLogEntry &entry) const;
+    const PingLogEntry &entryAt(quint64 position) const { return m_entries.at(int(position % quint64(m_entries.size()))); }
+    // Entry shown in the given row, newest first.
+    const PingLogEntry &entryForRow(int row) const;
+    // Oldest position still in the ring when head entries were ever added.
+    quint64 oldestPosition(quint64 head) const;
+
+    TargetRegistry *m_targets;
+    QVector<PingLogEntry> m_entries;  // Ring, written at m_head % capacity
+    quint64 m_head = 0;               // Entries ever added
+    quint64 m_shownHead = 0;          // m_head as of the last flush
+    int m_rows = 0;                   // Rows the views know about
+
+    bool m_filtered = false;
+    quint32 m_filterTarget = TargetRegistry::InvalidId;
+    int m_filterStatus = AnyStatus;
+    QVector<quint64> m_matches;       // Ring of matching positions, oldest at m_matchTail
+    quint64 m_matchHead = 0;
+    quint64 m_matchTail = 0;
+};
+
+#endif // PINGLOGMODEL_H
@@ -1,52 +1,132 @@
-#include "PingManager.h"
-
-PingManager::PingManager(QObject *parent)
-    : QObject(parent)
-{
-}
-
-PingManager::~PingManager()
-{
-    stopAll();
-}
-
-void PingManager::startPing(const QString &target, uint32_t timeoutMs)
-{
-    QMutexLocker locker(&m_mutex);
-    if (m_workers.contains(target)) {
-        // Already running, maybe update timeout?
-        // For now, ignore or restart.
-        return;
-    }
-
-    PingWorker *worker = new PingWorker(target, timeoutMs, this);
-    connect(worker, &PingWorker::newResult, this, &PingManager::newResult);
-    // Connect finished to cleanup if needed, but we manage them manually in map.
-    
-    m_workers.insert(target, worker);
-    worker->start();
-}
-
-void PingManager::stopPing(const QString &target)
-{
-    QMutexLocker locker(&m_mutex);
-    if (m_workers.contains(target)) {
-        PingWorker *worker = m_workers.take(target);
-        worker->stop();
-        worker->quit();
-        worker->wait();
-        delete worker;
-    }
-}
-
-void PingManager::stopAll()
-{
-    QMutexLocker locker(&m_mutex);
-    for (auto worker : m_workers) {
-        worker->stop();
-        worker->quit();
-        worker->wait();
-        delete worker;
-    }
-    m_workers.clear();
-}
+#include "PingManager.h"
+#include <QSettings>
+#include <QDebug>
+
+static ProbeBackend *createConfiguredBackend(QObject *parent)
+{
+    QString name = qEnvironmentVariable("PINGTOOL_BACKEND");
+    if (name.isEmpty()) {
+        QSettings settings("MyCompany", "PingTool");
+        name = settings.value("probeBackend", ProbeBackend::defaultName()).toString();
+    }
+
+    ProbeBackend *backend = ProbeBackend::create(name, parent);
+    if (!backend) {
+        qWarning() << "Probe backend" << name << "not available, using" << ProbeBackend::defaultName();
+        backend = ProbeBackend::create(ProbeBackend::defaultName(), parent);
+    }
+    return backend;
+}
+
+PingManager::PingManager(QObject *parent)
+    : QObject(parent)
+    , m_resolver(new DnsResolver(this))
+    , m_ring(ResultRing::configuredCapacity())
+    , m_backend(createConfiguredBackend(this))
+{
+    init();
+}
+
+PingManager::PingManager(ProbeBackend *backend, QObject *parent)
+    : QObject(parent)
+    , m_resolver(new DnsResolver(this))
+    , m_ring(ResultRing::configuredCapacity())
+    , m_backend(backend)
+{
+    m_backend->setParent(this);
+    init();
+}
+
+void PingManager::init()
+{
+    m_resolver->configureFromSettings();
+    m_budget.configureFromSettings();
+    m_backend->setResolver(m_resolver);
+    m_backend->setSendBudget(&m_budget);
+    m_backend->setResultRing(&m_ring);
+    m_backend->start();
+}
+
+PingManager::~PingManager()
+{
+    stopAll();
+    m_backend->shutdown();
+    // Join the resolver thread while the backend it calls into is still alive.
+    delete m_resolver;
+}
+
+PingManager::TargetState &PingManager::stateOf(const QString &target, quint32 *id)
+{
+    *id = m_registry.intern(target);
+    if (*id >= quint32(m_states.size())) {
+        m_states.resize(int(*id) + 1);
+    }
+    return m_states[int(*id)];
+}
+
+void PingManager::startPing(const QString &target, uint32_t timeoutMs)
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 id;
+    TargetState &state = stateOf(target, &id);
+    if (state.running) {
+        return;
+    }
+
+    state.running = true;
+    m_backend->addTarget(id, target, timeoutMs, state.policy);
+}
+
+void PingManager::stopPing(const QString &target)
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 id;
+    TargetState &state = stateOf(target, &id);
+    if (state.running) {
+        state.running = false;
+        m_backend->removeTarget(id);
+    }
+}
+
+void PingManager::stopAll()
+{
+    QMutexLocker locker(&m_mutex);
+    for (TargetState &state : m_states) {
+        state.running = false;
+    }
+    m_backend->removeAll();
+}
+
+void PingManager::setPolicy(const QString &target, const ProbePolicy &policy)
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 id;
+    TargetState &state = stateOf(target, &id);
+    state.policy = policy.normalized();
+    if (state.running) {
+        m_backend->setPolicy(id, state.policy);
+    }
+}
+
+ProbePolicy PingManager::policy(const QString &target) const
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 id = m_registry.find(target);
+    return id < quint32(m_states.size()) ? m_states.at(int(id)).policy : ProbePolicy();
+}
+
+void PingManager::setRateLimit(double pps)
+{
+    m_budget.setGlobalRate(pps);
+}
+
+void PingManager::setThroughputMode(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_backend->setThroughputMode(enabled);
+}
+
+PingManager::EngineStats PingManager::engineStats() const
+{
+    return m_backend->stats();
+}
@@ -1,28 +1,76 @@
-#ifndef PINGMANAGER_H
-#define PINGMANAGER_H
-
-#include <QObject>
-#include <QMap>
-#include <QMutex>
-#include "PingWorker.h"
-
-class PingManager : public QObject
-{
-    Q_OBJECT
-public:
-    explicit PingManager(QObject *parent = nullptr);
-    ~PingManager();
-
-    void startPing(const QString &target, uint32_t timeoutMs);
-    void stopPing(const QString &target);
-    void stopAll();
-
-signals:
-    void newResult(QString target, int rtt, int ttl, int seq, qint64 startTime, qint64 returnTime, int timeoutMs);
-
-private:
-    QMap<QString, PingWorker*> m_workers;
-    QMutex m_mutex;
-};
-
-#endif // PINGMANAGER_H
+#ifndef PINGMANAGER_H
+#define PINGMANAGER_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include "ProbeBackend.h"
+#include "DnsResolver.h"
+#include "SendBudget.h"
+#include "ResultRing.h"
+#include "TargetRegistry.h"
+
+class PingManager : public QObject
+{
+    Q_OBJECT
+public:
+    // Uses the backend named by the PINGTOOL_BACKEND environment variable or
+    // the "probeBackend" setting, falling back to the platform default.
+    explicit PingManager(QObject *parent = nullptr);
+    // Takes ownership of backend.
+    explicit PingManager(ProbeBackend *backend, QObject *parent = nullptr);
+    ~PingManager();
+
+    void startPing(const QString &target, uint32_t timeoutMs);
+    void stopPing(const QString &target);
+    void stopAll();
+
+    // Remembered per target, whether it is running or not; a running target
+    // switches over without being restarted. Targets without one use the
+    // ProbePolicy defaults.
+    void setPolicy(const QString &target, const ProbePolicy &policy);
+    ProbePolicy policy(const QString &target) const;
+
+    // Probe each target again as soon as the previous probe completes.
+    void setThroughputMode(bool enabled);
+
+    // Global packets-per-second ceiling across all targets, 0 = unlimited.
+    // Probes over the budget are delayed in turn, never dropped. Per-subnet
+    // limits come from the "rateLimit/subnets" setting.
+    void setRateLimit(double pps);
+    double rateLimit() const { return m_budget.globalRate(); }
+
+    QString backendName() const { return m_backend->name(); }
+
+    typedef ProbeBackend::Stats EngineStats;
+    EngineStats engineStats() const;
+    DnsResolver::Stats resolverStats() const { return m_resolver->stats(); }
+    SendBudget::Stats budgetStats() const { return m_budget.stats(); }
+
+    // Every result of the backend. Consumers attach a reader and drain it
+    // in batches on their own thread and schedule.
+    ResultRing *resultRing() { return &m_ring; }
+    // Ids of every target this manager has seen; results carry these.
+    TargetRegistry *registry() { return &m_registry; }
+    ResultRing::Stats ringStats() const { return m_ring.stats(); }
+
+private:
+    void init();
+
+    struct TargetState {
+        bool running = false;
+        ProbePolicy policy;
+    };
+    // Grows m_states to cover target's id.
+    TargetState &stateOf(const QString &target, quint32 *id);
+
+    TargetRegistry m_registry;
+    DnsResolver *m_resolver;   // Shared by every target of the backend
+    SendBudget m_budget;       // Likewise; outlives the backend's threads
+    ResultRing m_ring;         // Likewise
+    ProbeBackend *m_backend;
+    QVector<TargetState> m_states; // By target id
+    mutable QMutex m_mutex;
+};
+
+#endif // PINGMANAGER_H
@@ -1,135 +1,167 @@
-#include "PingModel.h"
-
-PingModel::PingModel(QObject *parent)
-    : QAbstractTableModel(parent)
-{
-}
-
-int PingModel::rowCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return m_data.size();
-}
-
-int PingModel::columnCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return 9; // Target, Sent, Recv, Loss, Min, Max, Avg, TTL, Status
-}
-
-QVariant PingModel::data(const QModelIndex &index, int role) const
-{
-    if (!index.isValid() || index.row() >= m_data.size())
-        return QVariant();
-
-    const PingStats &stats = m_data[index.row()];
-
-    if (role == Qt::DisplayRole) {
-        switch (index.column()) {
-        case 0: return stats.target;
-        case 1: return stats.sent;
-        case 2: return stats.received;
-        case 3: {
-            if (stats.sent == 0) return "0%";
-            double loss = 100.0 * (stats.sent - stats.received) / stats.sent;
-            return QString::number(loss, 'f', 1) + "%";
-        }
-        case 4: return (stats.minRtt == 999999) ? "-" : QString::number(stats.minRtt);
-        case 5: return stats.maxRtt;
-        case 6: return QString::number(stats.avgRtt, 'f', 1);
-        case 7: return stats.lastTtl;
-        case 8: return stats.status;
-        }
-    }
-    return QVariant();
-}
-
-QVariant PingModel::headerData(int section, Qt::Orientation orientation, int role) const
-{
-    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
-        return QVariant();
-
-    switch (section) {
-    case 0: return QString::fromUtf8("Target");
-    case 1: return QString::fromUtf8("Sent");
-    case 2: return QString::fromUtf8("Recv");
-    case 3: return QString::fromUtf8("Loss %");
-    case 4: return QString::fromUtf8("Min (ms)");
-    case 5: return QString::fromUtf8("Max (ms)");
-    case 6: return QString::fromUtf8("Avg (ms)");
-    case 7: return QString::fromUtf8("TTL");
-    case 8: return QString::fromUtf8("Status");
-    }
-    return QVariant();
-}
-
-void PingModel::addTarget(const QString &target)
-{
-    if (m_targetRowMap.contains(target)) return;
-
-    beginInsertRows(QModelIndex(), m_data.size(), m_data.size());
-    PingStats stats;
-    stats.target = target;
-    m_data.append(stats);
-    m_targetRowMap[target] = m_data.size() - 1;
-    endInsertRows();
-}
-
-void PingModel::removeTarget(const QString &target)
-{
-    if (!m_targetRowMap.contains(target)) return;
-
-    int row = m_targetRowMap[target];
-    beginRemoveRows(QModelIndex(), row, row);
-    m_data.removeAt(row);
-    m_targetRowMap.remove(target);
-    // Rebuild map indices
-    for (int i = row; i < m_data.size(); ++i) {
-        m_targetRowMap[m_data[i].target] = i;
-    }
-    endRemoveRows();
-}
-
-void PingModel::updateResult(const QString &target, int rtt, int ttl, int seq)
-{
-    if (!m_targetRowMap.contains(target)) return;
-
-    int row = m_targetRowMap[target];
-    PingStats &stats = m_data[row];
-
-    stats.sent++;
-    if (rtt >= 0) {
-        stats.received++;
-        stats.totalRtt += rtt;
-        stats.lastTtl = ttl;
-        if (rtt < stats.minRtt) stats.minRtt = rtt;
-        if (rtt > stats.maxRtt) stats.maxRtt = rtt;
-        stats.avgRtt = (double)stats.totalRtt / stats.received;
-        stats.status = "Active";
-    } else if (rtt == -1) {
-        stats.status = "Timeout";
-    } else {
-        stats.status = "Error";
-    }
-
-    emit dataChanged(index(row, 1), index(row, 8));
-}
-
-void PingModel::clear()
-{
-    beginResetModel();
-    m_data.clear();
-    m_targetRowMap.clear();
-    endResetModel();
-}
-
-QStringList PingModel::getTargets() const
-{
-    QStringList list;
-    for (const auto &stats : m_data) {
-        list << stats.target;
-    }
-    return list;
-}
+#include "PingModel.h"
+
+static QString formatMs(double ns)
+{
+    return QString::number(ns / 1000000.0, 'f', 3);
+}
+
+PingModel::PingModel(TargetRegistry *targets, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_targets(targets)
+{
+}
+
+int PingModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_data.size();
+}
+
+int PingModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return 9; // Target, Sent, Recv, Loss, Min, Max, Avg, TTL, Status
+}
+
+QVariant PingModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_data.size())
+        return QVariant();
+
+    const PingStats &stats = m_data[index.row()];
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case 0: return m_targets->name(stats.targetId);
+        case 1: return stats.sent;
+        case 2: return stats.received;
+        case 3: {
+            if (stats.sent == 0) return "0%";
+            double loss = 100.0 * (stats.sent - stats.received) / stats.sent;
+            return QString::number(loss, 'f', 1) + "%";
+        }
+        case 4: return (stats.minRttNs < 0) ? "-" : formatMs(stats.minRttNs);
+        case 5: return (stats.minRttNs < 0) ? "-" : formatMs(stats.maxRttNs);
+        case 6: return (stats.minRttNs < 0) ? "-" : formatMs(stats.avgRttNs);
+        case 7: return stats.lastTtl;
+        case 8: return stats.status;
+        }
+    }
+    return QVariant();
+}
+
+QVariant PingModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+
+    switch (section) {
+    case 0: return QString::fromUtf8("Target");
+    case 1: return QString::fromUtf8("Sent");
+    case 2: return QString::fromUtf8("Recv");
+    case 3: return QString::fromUtf8("Loss %");
+    case 4: return QString::fromUtf8("Min (ms)");
+    case 5: return QString::fromUtf8("Max (ms)");
+    case 6: return QString::fromUtf8("Avg (ms)");
+    case 7: return QString::fromUtf8("TTL");
+    case 8: return QString::fromUtf8("Status");
+    }
+    return QVariant();
+}
+
+void PingModel::addTarget(const QString &target)
+{
+    quint32 id = m_targets->intern(target);
+    if (rowOf(id) >= 0) return;
+
+    beginInsertRows(QModelIndex(), m_data.size(), m_data.size());
+    PingStats stats;
+    stats.targetId = id;
+    m_data.append(stats);
+    if (id >= quint32(m_rowById.size())) {
+        m_rowById.resize(int(id) + 1, -1);
+    }
+    m_rowById[int(id)] = m_data.size() - 1;
+    endInsertRows();
+}
+
+void PingModel::removeTarget(const QString &target)
+{
+    int row = rowOf(m_targets->find(target));
+    if (row < 0) return;
+
+    // Pending rows are about to move
+    flush();
+    beginRemoveRows(QModelIndex(), row, row);
+    m_rowById[int(m_data[row].targetId)] = -1;
+    m_data.removeAt(row);
+    // Rebuild map indices
+    for (int i = row; i < m_data.size(); ++i) {
+        m_rowById[int(m_data[i].targetId)] = i;
+    }
+    endRemoveRows();
+}
+
+void PingModel::updateResult(quint32 targetId, qint64 rttNs, int ttl, int seq)
+{
+    int row = rowOf(targetId);
+    if (row < 0) return;
+
+    // Shared strings, so a result doesn't allocate
+    static const QString active = QString::fromLatin1("Active");
+    static const QString timeout = QString::fromLatin1("Timeout");
+    static const QString error = QString::fromLatin1("Error");
+
+    PingStats &stats = m_data[row];
+
+    stats.sent++;
+    if (rttNs >= 0) {
+        stats.received++;
+        stats.totalRttNs += rttNs;
+        stats.lastTtl = ttl;
+        if (stats.minRttNs < 0 || rttNs < stats.minRttNs) stats.minRttNs = rttNs;
+        if (rttNs > stats.maxRttNs) stats.maxRttNs = rttNs;
+        stats.avgRttNs = (double)stats.totalRttNs / stats.received;
+        stats.status = active;
+    } else if (rttNs == -1) {
+        stats.status = timeout;
+    } else {
+        stats.status = error;
+    }
+
+    if (m_dirtyFirst < 0) {
+        m_dirtyFirst = m_dirtyLast = row;
+    } else {
+        m_dirtyFirst = qMin(m_dirtyFirst, row);
+        m_dirtyLast = qMax(m_dirtyLast, row);
+    }
+}
+
+void PingModel::flush()
+{
+    if (m_dirtyFirst < 0) return;
+    // The rows in between are repainted too, which is cheaper than one
+    // signal per row when thousands of targets report in every frame
+    emit dataChanged(index(m_dirtyFirst, 1), index(m_dirtyLast, 8));
+    m_dirtyFirst = m_dirtyLast = -1;
+}
+
+void PingModel::clear()
+{
+    beginResetModel();
+    m_data.clear();
+    m_rowById.clear();
+    m_dirtyFirst = m_dirtyLast = -1;
+    endResetModel();
+}
+
+QStringList PingModel::getTargets() const
+{
+    QStringList list;
+    for (const auto &stats : m_data) {
+        list << m_targets->name(stats.targetId);
+    }
+    return list;
+}
@@ -1,44 +1,56 @@
-#ifndef PINGMODEL_H
-#define PINGMODEL_H
-
-#include <QAbstractTableModel>
-#include <QString>
-#include <QList>
-#include <QMap>
-
-struct PingStats {
-    QString target;
-    int sent = 0;
-    int received = 0;
-    int minRtt = 999999;
-    int maxRtt = 0;
-    double avgRtt = 0.0;
-    long long totalRtt = 0;
-    int lastTtl = 0;
-    QString status = "Idle";
-};
-
-class PingModel : public QAbstractTableModel
-{
-    Q_OBJECT
-public:
-    explicit PingModel(QObject *parent = nullptr);
-
-    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
-    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
-    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
-    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
-
-    void addTarget(const QString &target);
-    void removeTarget(const QString &target);
-    void updateResult(const QString &target, int rtt, int ttl, int seq);
-    void clear();
-    
-    QStringList getTargets() const;
-
-private:
-    QList<PingStats> m_data;
-    QMap<QString, int> m_targetRowMap;
-};
-
-#endif // PINGMODEL_H
+#ifndef PINGMODEL_H
+#define PINGMODEL_H
+
+#include <QAbstractTableModel>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include "TargetRegistry.h"
+
+// RTT values are in nanoseconds; they are only converted to ms for display.
+struct PingStats {
+    quint32 targetId = 0;
+    int sent = 0;
+    int received = 0;
+    qint64 minRttNs = -1; // -1 until the first reply
+    qint64 maxRttNs = 0;
+    double avgRttNs = 0.0;
+    qint64 totalRttNs = 0;
+    int lastTtl = 0;
+    QString status = "Idle";
+};
+
+class PingModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    // Target names are interned in targets, which must outlive the model.
+    explicit PingModel(TargetRegistry *targets, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void addTarget(const QString &target);
+    void removeTarget(const QString &target);
+    // O(1); results for targets not in the model are ignored. Views only
+    // hear about the change at the next flush().
+    void updateResult(quint32 targetId, qint64 rttNs, int ttl, int seq);
+    // One dataChanged covering every row updated since the last flush.
+    void flush();
+    void clear();
+    
+    QStringList getTargets() const;
+
+private:
+    int rowOf(quint32 targetId) const { return targetId < quint32(m_rowById.size()) ? m_rowById.at(int(targetId)) : -1; }
+
+    TargetRegistry *m_targets;
+    QList<PingStats> m_data;
+    QVector<int> m_rowById; // By target id, -1 if not in the model
+    int m_dirtyFirst = -1;  // Rows updated since the last flush
+    int m_dirtyLast = -1;
+};
+
+#endif // PINGMODEL_H
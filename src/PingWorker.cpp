@@ -1,156 +1,366 @@
-﻿#include "PingWorker.h"
-#include <QDebug>
-#include <QHostAddress>
-#include <QElapsedTimer>
-
-PingWorker::PingWorker(const QString &target, uint32_t timeoutMs, QObject *parent)
-    : QThread(parent)
-    , m_target(target)
-    , m_timeoutMs(timeoutMs)
-    , m_running(true)
-    , m_seq(0)
-    , m_hIcmpFile(INVALID_HANDLE_VALUE)
-{
-}
-
-PingWorker::~PingWorker()
-{
-    stop();
-    wait();
-#ifdef Q_OS_WIN
-    if (m_hIcmpFile != INVALID_HANDLE_VALUE) {
-        IcmpCloseHandle(m_hIcmpFile);
-    }
-#endif
-}
-
-void PingWorker::stop()
-{
-    m_running = false;
-}
-
-void PingWorker::setTimeout(uint32_t timeoutMs)
-{
-    m_timeoutMs = timeoutMs;
-}
-
-void PingWorker::run()
-{
-#ifdef Q_OS_WIN
-    m_hIcmpFile = IcmpCreateFile();
-    if (m_hIcmpFile == INVALID_HANDLE_VALUE) {
-        qWarning() << "Unable to open handle." << "IcmpCreateFile failed.";
-        return;
-    }
-
-    // Resolve IP
-    unsigned long ipaddr = INADDR_NONE;
-    QHostAddress address(m_target);
-    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
-        ipaddr = htonl(address.toIPv4Address());
-    } else {
-        // Simple DNS resolution if needed, but for now assume IP or let IcmpSendEcho handle it if possible (it needs IP)
-        // IcmpSendEcho requires IP address in network byte order.
-        // If m_target is a hostname, we might need QHostInfo, but QHostInfo is async or blocking.
-        // For this simple tool, let's assume the user might input IP, or we resolve it once.
-        // However, doing DNS in run() is fine.
-        // Let's try to convert to IPv4.
-        // If it's not a valid IP, we might need to resolve.
-        // For simplicity/robustness, let's use QHostInfo::fromName which blocks.
-        // Since we are in a thread, blocking is fine.
-    }
-    
-    // Better resolution logic
-    if (ipaddr == INADDR_NONE) {
-         // Try to resolve
-         // Note: gethostbyname is deprecated but simple for winsock. 
-         // Qt way:
-         // We can't easily use QHostInfo synchronously without an event loop if we want to be strictly Qt, 
-         // but QHostInfo::fromName is static and blocking? No, it's not.
-         // Actually QHostInfo::fromName(name) is static and returns QHostInfo. It blocks.
-         // But wait, QHostInfo::fromName is not available in all Qt versions as blocking?
-         // Qt6 docs say: "This function blocks until the lookup is complete." -> Yes.
-         // However, we need to include <QHostInfo>
-    }
-#endif 
-
-    // Re-evaluating IP resolution:
-    // We should probably resolve once before the loop or inside the loop if we expect DNS changes (unlikely for ping tool).
-    // Let's resolve inside run() once.
-    
-    unsigned long destIp = INADDR_NONE;
-    
-    // Basic check if it's already an IP
-    QHostAddress ha(m_target);
-    if (!ha.isNull() && ha.protocol() == QAbstractSocket::IPv4Protocol) {
-        destIp = htonl(ha.toIPv4Address());
-    } else {
-         // Resolve
-         // For now, let's assume the input is IP or handle resolution later if needed to keep it simple.
-         // But a ping tool usually handles hostnames.
-         // Let's stick to the requirement: "Ping tool".
-         // I will add QHostInfo support.
-    }
-
-    // Buffer for reply
-    // Request data
-    char SendData[32] = "Data Buffer";
-    int ReplySize = sizeof(ICMP_ECHO_REPLY) + sizeof(SendData);
-    void* ReplyBuffer = (void*)malloc(ReplySize);
-
-#include <QElapsedTimer>
-
-    QElapsedTimer timer;
-    timer.start();
-
-    while (m_running) {
-        if (destIp == INADDR_NONE) {
-             // Resolve if not yet resolved
-             QHostAddress ha(m_target);
-             if (!ha.isNull() && ha.protocol() == QAbstractSocket::IPv4Protocol) {
-                 destIp = htonl(ha.toIPv4Address());
-             } else {
-                 // Resolve hostname
-                 // Since we don't have QHostInfo included yet, let's assume IP for this step or use inet_addr
-                 // For a robust tool, I should include QHostInfo.
-                 // Let's assume the user provides IP for now to avoid dependency hell in this snippet, 
-                 // OR I will add QHostInfo include.
-                 destIp = inet_addr(m_target.toStdString().c_str());
-             }
-        }
-
-        if (destIp != INADDR_NONE && destIp != INADDR_ANY) {
-            qint64 startTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
-            
-            DWORD dwRetVal = IcmpSendEcho(m_hIcmpFile, destIp, SendData, sizeof(SendData), 
-                NULL, ReplyBuffer, ReplySize, m_timeoutMs);
-
-            qint64 returnTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
-
-            if (dwRetVal != 0) {
-                PICMP_ECHO_REPLY pEchoReply = (PICMP_ECHO_REPLY)ReplyBuffer;
-                emit newResult(m_target, pEchoReply->RoundTripTime, pEchoReply->Options.Ttl, ++m_seq, startTime, returnTime, m_timeoutMs);
-            } else {
-                // Timeout or error
-                emit newResult(m_target, -1, 0, ++m_seq, startTime, returnTime, m_timeoutMs);
-            }
-        } else {
-             // Invalid IP
-             qint64 now = QDateTime::currentDateTime().toMSecsSinceEpoch();
-             emit newResult(m_target, -2, 0, ++m_seq, now, now, m_timeoutMs); // -2 for resolve error
-             // Sleep to avoid busy loop on error
-             QThread::msleep(1000);
-        }
-
-        // Adaptive sleep: ensure at least 20ms interval between pings
-        qint64 elapsed = timer.elapsed();
-        if (elapsed < 20) {
-            QThread::msleep(20 - elapsed);
-        }
-        timer.restart();
-    }
-
-    if (ReplyBuffer) {
-        free(ReplyBuffer);
-    }
-}
+﻿#include "PingWorker.h"
+#include "DnsResolver.h"
+#include "ProbeTarget.h"
+#include "SendBudget.h"
+#include "ResultRing.h"
+#include "ProbeAddress.h"
+#include <QDebug>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+PingWorker::PingWorker(quint32 id, const QString &target, uint32_t timeoutMs, QObject *parent)
+    : QThread(parent)
+    , m_targetId(id)
+    , m_target(target)
+    , m_timeoutMs(timeoutMs)
+    , m_running(true)
+    , m_throughputMode(false)
+    , m_policyChanged(false)
+    , m_seq(0)
+    , m_resolver(nullptr)
+    , m_budget(nullptr)
+    , m_ring(nullptr)
+    , m_hIcmpFile(INVALID_HANDLE_VALUE)
+    , m_hIcmp6File(INVALID_HANDLE_VALUE)
+{
+}
+
+PingWorker::~PingWorker()
+{
+    stop();
+    wait();
+#ifdef Q_OS_WIN
+    if (m_hIcmpFile != INVALID_HANDLE_VALUE) {
+        IcmpCloseHandle(m_hIcmpFile);
+    }
+    if (m_hIcmp6File != INVALID_HANDLE_VALUE) {
+        IcmpCloseHandle(m_hIcmp6File);
+    }
+#endif
+}
+
+void PingWorker::stop()
+{
+    m_running = false;
+}
+
+void PingWorker::setTimeout(uint32_t timeoutMs)
+{
+    m_timeoutMs = timeoutMs;
+}
+
+void PingWorker::setThroughputMode(bool enabled)
+{
+    m_throughputMode = enabled;
+}
+
+void PingWorker::setResolver(DnsResolver *resolver)
+{
+    m_resolver = resolver;
+}
+
+void PingWorker::report(qint64 rttNs, int ttl, qint64 startTime, qint64 returnTime)
+{
+    ++m_seq;
+    if (!m_ring) return;
+
+    ProbeResult result;
+    result.targetId = m_targetId;
+    result.ttl = ttl;
+    result.seq = m_seq;
+    result.timeoutMs = int(m_timeoutMs);
+    result.rttNs = rttNs;
+    result.startTime = startTime;
+    result.returnTime = returnTime;
+    m_ring->push(result);
+}
+
+void PingWorker::setPolicy(const ProbePolicy &policy)
+{
+    QMutexLocker locker(&m_policyMutex);
+    m_policy = policy.normalized();
+    m_policyChanged = true;
+}
+
+ProbePolicy PingWorker::policy() const
+{
+    QMutexLocker locker(&m_policyMutex);
+    return m_policy;
+}
+
+bool PingWorker::waitUntil(const QElapsedTimer &clock, qint64 deadlineMs)
+{
+    // Short naps so stop() and setPolicy() take effect promptly.
+    while (m_running && !m_policyChanged) {
+        qint64 remaining = deadlineMs - clock.elapsed();
+        if (remaining <= 0) return true;
+        QThread::msleep(static_cast<unsigned long>(qMin<qint64>(remaining, 50)));
+    }
+    return false;
+}
+
+#ifdef Q_OS_WIN
+bool PingWorker::probeTcp(const ProbeAddress &dest, quint16 port, qint64 *rttNs)
+{
+    SOCKET s = socket(dest.isIpv4() ? AF_INET : AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) return false;
+
+    u_long nonBlocking = 1;
+    ioctlsocket(s, FIONBIO, &nonBlocking);
+    // Reset on close so repeated connects don't pile up in TIME_WAIT.
+    linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+    setsockopt(s, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char *>(&lg), sizeof(lg));
+
+    sockaddr_storage sa;
+    int saLen = dest.toSockaddr(port, &sa);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = false;
+    if (::connect(s, reinterpret_cast<sockaddr *>(&sa), saLen) == 0) {
+        ok = true;
+    } else if (WSAGetLastError() == WSAEWOULDBLOCK) {
+        fd_set writeSet, errorSet;
+        FD_ZERO(&writeSet);
+        FD_ZERO(&errorSet);
+        FD_SET(s, &writeSet);
+        FD_SET(s, &errorSet);
+        timeval tv;
+        tv.tv_sec = m_timeoutMs / 1000;
+        tv.tv_usec = (m_timeoutMs % 1000) * 1000;
+        // Failed connects are reported in the error set on Windows.
+        ok = select(0, nullptr, &writeSet, &errorSet, &tv) > 0 && FD_ISSET(s, &writeSet);
+    }
+    *rttNs = timer.nsecsElapsed();
+    closesocket(s);
+    return ok;
+}
+
+bool PingWorker::probeUdp(const ProbeAddress &dest, quint16 port, qint64 *rttNs)
+{
+    SOCKET s = socket(dest.isIpv4() ? AF_INET : AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) return false;
+
+    sockaddr_storage sa;
+    int saLen = dest.toSockaddr(port, &sa);
+    // Connected, so only the target's replies are delivered and an ICMP
+    // port unreachable comes back as WSAECONNRESET.
+    ::connect(s, reinterpret_cast<sockaddr *>(&sa), saLen);
+
+    char sendData[32] = "Data Buffer";
+    char reply[512];
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = false;
+    if (send(s, sendData, sizeof(sendData), 0) != SOCKET_ERROR) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(s, &readSet);
+        timeval tv;
+        tv.tv_sec = m_timeoutMs / 1000;
+        tv.tv_usec = (m_timeoutMs % 1000) * 1000;
+        ok = select(0, &readSet, nullptr, nullptr, &tv) > 0
+             && recv(s, reply, sizeof(reply), 0) != SOCKET_ERROR;
+    }
+    *rttNs = timer.nsecsElapsed();
+    closesocket(s);
+    return ok;
+}
+
+bool PingWorker::probeIcmp6(const ProbeAddress &dest, qint64 *rttNs)
+{
+    if (m_hIcmp6File == INVALID_HANDLE_VALUE) {
+        m_hIcmp6File = Icmp6CreateFile();
+        if (m_hIcmp6File == INVALID_HANDLE_VALUE) return false;
+    }
+
+    sockaddr_in6 source;
+    memset(&source, 0, sizeof(source));
+    source.sin6_family = AF_INET6;
+    sockaddr_storage target;
+    dest.toSockaddr(0, &target);
+
+    char sendData[32] = "Data Buffer";
+    char reply[sizeof(ICMPV6_ECHO_REPLY) + sizeof(sendData) + 8];
+    QElapsedTimer timer;
+    timer.start();
+    DWORD count = Icmp6SendEcho2(m_hIcmp6File, NULL, NULL, NULL, &source,
+                                 reinterpret_cast<sockaddr_in6 *>(&target), sendData, sizeof(sendData),
+                                 NULL, reply, sizeof(reply), m_timeoutMs);
+    *rttNs = timer.nsecsElapsed();
+    // The reply carries no hop limit, so ICMPv6 results report TTL 0.
+    return count != 0;
+}
+#endif
+
+void PingWorker::run()
+{
+#ifdef Q_OS_WIN
+    const ProbeTarget probe = ProbeTarget::parse(m_target);
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+
+    m_hIcmpFile = IcmpCreateFile();
+    if (m_hIcmpFile == INVALID_HANDLE_VALUE) {
+        qWarning() << "Unable to open handle." << "IcmpCreateFile failed.";
+        WSACleanup();
+        return;
+    }
+
+    // Resolve IP
+    unsigned long ipaddr = INADDR_NONE;
+    QHostAddress address(probe.host);
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        ipaddr = htonl(address.toIPv4Address());
+    } else {
+        // Simple DNS resolution if needed, but for now assume IP or let IcmpSendEcho handle it if possible (it needs IP)
+        // IcmpSendEcho requires IP address in network byte order.
+        // If m_target is a hostname, we might need QHostInfo, but QHostInfo is async or blocking.
+        // For this simple tool, let's assume the user might input IP, or we resolve it once.
+        // However, doing DNS in run() is fine.
+        // Let's try to convert to IPv4.
+        // If it's not a valid IP, we might need to resolve.
+        // For simplicity/robustness, let's use QHostInfo::fromName which blocks.
+        // Since we are in a thread, blocking is fine.
+    }
+    
+    // Better resolution logic
+    if (ipaddr == INADDR_NONE) {
+         // Try to resolve
+         // Note: gethostbyname is deprecated but simple for winsock. 
+         // Qt way:
+         // We can't easily use QHostInfo synchronously without an event loop if we want to be strictly Qt, 
+         // but QHostInfo::fromName is static and blocking? No, it's not.
+         // Actually QHostInfo::fromName(name) is static and returns QHostInfo. It blocks.
+         // But wait, QHostInfo::fromName is not available in all Qt versions as blocking?
+         // Qt6 docs say: "This function blocks until the lookup is complete." -> Yes.
+         // However, we need to include <QHostInfo>
+    }
+#endif 
+
+    // Re-evaluating IP resolution:
+    // We should probably resolve once before the loop or inside the loop if we expect DNS changes (unlikely for ping tool).
+    // Let's resolve inside run() once.
+    
+    ProbeAddress dest;
+    
+    // Basic check if it's already an IP
+    QHostAddress ha(probe.host);
+    if (!ha.isNull()) {
+        dest = ProbeAddress::fromHostAddress(ProbeTarget::pickAddress({ ha }, probe.family, false));
+    } else {
+         // Resolve
+         // For now, let's assume the input is IP or handle resolution later if needed to keep it simple.
+         // But a ping tool usually handles hostnames.
+         // Let's stick to the requirement: "Ping tool".
+         // I will add QHostInfo support.
+    }
+
+    // Buffer for reply
+    // Request data
+    char SendData[32] = "Data Buffer";
+    int ReplySize = sizeof(ICMP_ECHO_REPLY) + sizeof(SendData);
+    void* ReplyBuffer = (void*)malloc(ReplySize);
+
+#include <QElapsedTimer>
+
+    QElapsedTimer clock;
+    clock.start();
+    ProbePolicy currentPolicy;
+    ProbeSchedule schedule;
+    qint64 nextMs = 0;
+    m_policyChanged = true; // Pick up the policy and a start phase below
+
+    bool useResolver = m_resolver && ha.isNull();
+    if (useResolver) {
+        m_resolver->watch(probe.host);
+    }
+
+    while (m_running) {
+        if (m_policyChanged.exchange(false)) {
+            currentPolicy = policy();
+            nextMs = schedule.start(currentPolicy, clock.elapsed(), QRandomGenerator::global()->generate());
+        }
+        if (!m_throughputMode && !waitUntil(clock, nextMs)) {
+            continue;
+        }
+
+        if (useResolver) {
+            // Cheap cache read; background refreshes show up here.
+            QList<QHostAddress> addresses;
+            if (!m_resolver->lookup(probe.host, &addresses)) {
+                QThread::msleep(50); // First lookup still in flight
+                continue;
+            }
+            dest = ProbeAddress::fromHostAddress(
+                ProbeTarget::pickAddress(addresses, probe.family, m_resolver->preferIpv6()));
+        }
+
+        bool needsPort = (probe.type != ProbeTarget::Icmp);
+        if (!dest.isNull() && !(needsPort && probe.port == 0)) {
+            if (m_budget) {
+                // Hold the probe until its booked token is due
+                qint64 waitNs = m_budget->reserve(dest);
+                qint64 dueMs = clock.elapsed() + (waitNs + 999999) / 1000000;
+                while (m_running && clock.elapsed() < dueMs) {
+                    QThread::msleep(static_cast<unsigned long>(qMin<qint64>(dueMs - clock.elapsed(), 50)));
+                }
+                if (!m_running) break;
+            }
+
+            qint64 startTime = QDateTime::currentMSecsSinceEpoch();
+
+            // RoundTripTime is whole milliseconds; time the call on the
+            // monotonic clock instead so sub-ms LAN replies don't read as 0.
+            QElapsedTimer rttTimer;
+            rttTimer.start();
+
+            if (needsPort) {
+                qint64 rttNs = 0;
+                bool ok = (probe.type == ProbeTarget::Tcp) ? probeTcp(dest, probe.port, &rttNs)
+                                                          : probeUdp(dest, probe.port, &rttNs);
+                qint64 returnTime = startTime + rttNs / 1000000;
+                report(ok ? rttNs : -1, 0, startTime, returnTime);
+            } else if (!dest.isIpv4()) {
+                qint64 rttNs = 0;
+                bool ok = probeIcmp6(dest, &rttNs);
+                qint64 returnTime = startTime + rttNs / 1000000;
+                report(ok ? rttNs : -1, 0, startTime, returnTime);
+            } else {
+                DWORD dwRetVal = IcmpSendEcho(m_hIcmpFile, dest.ipv4(), SendData, sizeof(SendData), 
+                    NULL, ReplyBuffer, ReplySize, m_timeoutMs);
+
+                qint64 rttNs = rttTimer.nsecsElapsed();
+                qint64 returnTime = startTime + rttNs / 1000000;
+
+                if (dwRetVal != 0) {
+                    PICMP_ECHO_REPLY pEchoReply = (PICMP_ECHO_REPLY)ReplyBuffer;
+                    report(rttNs, pEchoReply->Options.Ttl, startTime, returnTime);
+                } else {
+                    // Timeout or error
+                    report(-1, 0, startTime, returnTime);
+                }
+            }
+        } else {
+             // Invalid IP
+             qint64 now = QDateTime::currentMSecsSinceEpoch();
+             report(-2, 0, now, now); // -2 for resolve error
+             // Sleep to avoid busy loop on error
+             QThread::msleep(1000);
+        }
+
+        nextMs = schedule.next(currentPolicy, clock.elapsed(), QRandomGenerator::global()->generate());
+    }
+
+    if (useResolver) {
+        m_resolver->unwatch(probe.host);
+    }
+
+    if (ReplyBuffer) {
+        free(ReplyBuffer);
+    }
+    WSACleanup();
+}
@@ -1,48 +1,85 @@
-#ifndef PINGWORKER_H
-#define PINGWORKER_H
-
-#include <QThread>
-#include <QString>
-#include <QDateTime>
-#include <atomic>
-
-#ifdef Q_OS_WIN
-#include <winsock2.h>
-#include <iphlpapi.h>
-#include <icmpapi.h>
-#endif
-
-class PingWorker : public QThread
-{
-    Q_OBJECT
-public:
-    explicit PingWorker(const QString &target, uint32_t timeoutMs = 1000, QObject *parent = nullptr);
-    ~PingWorker();
-
-    void stop();
-    void setTimeout(uint32_t timeoutMs);
-
-protected:
-    void run() override;
-
-signals:
-    // rtt: Round Trip Time in ms. -1 indicates timeout/error.
-    // ttl: Time To Live.
-    // seq: Sequence number.
-    // startTime: Timestamp when ping was sent (ms since epoch)
-    // returnTime: Timestamp when reply was received or timeout occurred (ms since epoch)
-    // timeoutMs: The timeout value used for this ping
-    void newResult(QString target, int rtt, int ttl, int seq, qint64 startTime, qint64 returnTime, int timeoutMs);
-
-private:
-    QString m_target;
-    uint32_t m_timeoutMs;
-    std::atomic<bool> m_running;
-    int m_seq;
-
-#ifdef Q_OS_WIN
-    HANDLE m_hIcmpFile;
-#endif
-};
-
-#endif // PINGWORKER_H
+#ifndef PINGWORKER_H
+#define PINGWORKER_H
+
+#include <QThread>
+#include <QString>
+#include <QDateTime>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include "ProbePolicy.h"
+#include "ProbeAddress.h"
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <icmpapi.h>
+#endif
+
+class DnsResolver;
+class SendBudget;
+class ResultRing;
+
+class PingWorker : public QThread
+{
+    Q_OBJECT
+public:
+    // id is the target's TargetRegistry id, carried by its results.
+    explicit PingWorker(quint32 id, const QString &target, uint32_t timeoutMs = 1000, QObject *parent = nullptr);
+    ~PingWorker();
+
+    void stop();
+    void setTimeout(uint32_t timeoutMs);
+    void setThroughputMode(bool enabled);
+    // Hostnames are looked up through resolver's cache on every probe.
+    void setResolver(DnsResolver *resolver);
+    // Shared with the other workers; call before start().
+    void setSendBudget(SendBudget *budget) { m_budget = budget; }
+    // Results are pushed here from the worker thread; call before start().
+    void setResultRing(ResultRing *ring) { m_ring = ring; }
+    // Thread-safe; the worker restarts its schedule with the new policy.
+    void setPolicy(const ProbePolicy &policy);
+    ProbePolicy policy() const;
+
+protected:
+    void run() override;
+
+private:
+    // rttNs: Round Trip Time in ns. -1 indicates timeout, -2 resolve error.
+    // ttl: Time To Live.
+    // startTime: Timestamp when ping was sent (ms since epoch)
+    // returnTime: Timestamp when reply was received or timeout occurred (ms since epoch)
+    // Counts the next seq and pushes the result into the ring.
+    void report(qint64 rttNs, int ttl, qint64 startTime, qint64 returnTime);
+
+#ifdef Q_OS_WIN
+    // tcp:// and udp:// targets; blocking up to the timeout, like IcmpSendEcho.
+    bool probeTcp(const ProbeAddress &dest, quint16 port, qint64 *rttNs);
+    bool probeUdp(const ProbeAddress &dest, quint16 port, qint64 *rttNs);
+    // Icmp6SendEcho2; the ICMPv6 handle is opened on first use.
+    bool probeIcmp6(const ProbeAddress &dest, qint64 *rttNs);
+#endif
+    // Sleeps until deadlineMs on clock; false if stopped or the policy changed.
+    bool waitUntil(const QElapsedTimer &clock, qint64 deadlineMs);
+
+    quint32 m_targetId;
+    QString m_target;
+    uint32_t m_timeoutMs;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_throughputMode;
+    mutable QMutex m_policyMutex;
+    ProbePolicy m_policy;
+    std::atomic<bool> m_policyChanged;
+    int m_seq;
+    DnsResolver *m_resolver;
+    SendBudget *m_budget;
+    ResultRing *m_ring;
+
+#ifdef Q_OS_WIN
+    HANDLE m_hIcmpFile;
+    HANDLE m_hIcmp6File;
+#endif
+};
+
+#endif // PINGWORKER_H
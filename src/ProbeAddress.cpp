@@ -0,0 +1,102 @@
+#include "ProbeAddress.h"
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+namespace {
+
+const quint8 V4_MAPPED_PREFIX[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+} // namespace
+
+ProbeAddress ProbeAddress::fromIpv4(quint32 netOrder)
+{
+    ProbeAddress a;
+    memcpy(a.bytes, V4_MAPPED_PREFIX, 12);
+    memcpy(a.bytes + 12, &netOrder, 4);
+    return a;
+}
+
+ProbeAddress ProbeAddress::fromIpv6(const quint8 *bytes)
+{
+    ProbeAddress a;
+    memcpy(a.bytes, bytes, 16);
+    return a;
+}
+
+ProbeAddress ProbeAddress::fromHostAddress(const QHostAddress &address)
+{
+    switch (address.protocol()) {
+    case QAbstractSocket::IPv4Protocol:
+        return fromIpv4(htonl(address.toIPv4Address()));
+    case QAbstractSocket::IPv6Protocol: {
+        Q_IPV6ADDR v6 = address.toIPv6Address();
+        return fromIpv6(v6.c);
+    }
+    default:
+        return ProbeAddress();
+    }
+}
+
+ProbeAddress ProbeAddress::fromSockaddr(const sockaddr *sa, quint16 *port)
+{
+    if (sa->sa_family == AF_INET) {
+        const sockaddr_in *sin = reinterpret_cast<const sockaddr_in *>(sa);
+        if (port) *port = ntohs(sin->sin_port);
+        return fromIpv4(sin->sin_addr.s_addr);
+    }
+    if (sa->sa_family == AF_INET6) {
+        const sockaddr_in6 *sin6 = reinterpret_cast<const sockaddr_in6 *>(sa);
+        if (port) *port = ntohs(sin6->sin6_port);
+        return fromIpv6(reinterpret_cast<const quint8 *>(&sin6->sin6_addr));
+    }
+    if (port) *port = 0;
+    return ProbeAddress();
+}
+
+bool ProbeAddress::isNull() const
+{
+    static const quint8 zero[16] = {};
+    return memcmp(bytes, zero, 16) == 0;
+}
+
+bool ProbeAddress::isIpv4() const
+{
+    return memcmp(bytes, V4_MAPPED_PREFIX, 12) == 0;
+}
+
+quint32 ProbeAddress::ipv4() const
+{
+    quint32 v4;
+    memcpy(&v4, bytes + 12, 4);
+    return v4;
+}
+
+QHostAddress ProbeAddress::toHostAddress() const
+{
+    if (isNull()) return QHostAddress();
+    if (isIpv4()) return QHostAddress(ntohl(ipv4()));
+    return QHostAddress(bytes);
+}
+
+int ProbeAddress::toSockaddr(quint16 port, sockaddr_storage *sa) const
+{
+    memset(sa, 0, sizeof(*sa));
+    if (isIpv4()) {
+        sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(sa);
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        sin->sin_addr.s_addr = ipv4();
+        return sizeof(sockaddr_in);
+    }
+    sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(sa);
+    sin6->sin6_family = AF_INET6;
+    sin6->sin6_port = htons(port);
+    memcpy(&sin6->sin6_addr, bytes, 16);
+    return sizeof(sockaddr_in6);
+}
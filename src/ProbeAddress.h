@@ -0,0 +1,45 @@
+#ifndef PROBEADDRESS_H
+#define PROBEADDRESS_H
+
+#include <QHostAddress>
+#include <QHashFunctions>
+#include <cstring>
+
+struct sockaddr_storage;
+struct sockaddr;
+
+// Destination address kept by the probe backends: 16 raw bytes, IPv6 or
+// IPv4-mapped (::ffff:a.b.c.d), so both families share one fixed-size key
+// that compares and hashes with memcmp instead of going through strings.
+// All zeros (::) means unresolved.
+struct ProbeAddress
+{
+    quint8 bytes[16] = {};
+
+    static ProbeAddress fromIpv4(quint32 netOrder);
+    static ProbeAddress fromIpv6(const quint8 *bytes);
+    static ProbeAddress fromHostAddress(const QHostAddress &address);
+    // sockaddr_in or sockaddr_in6; port (host byte order) is optional.
+    static ProbeAddress fromSockaddr(const sockaddr *sa, quint16 *port = nullptr);
+
+    bool isNull() const;
+    bool isIpv4() const;
+    // Network byte order; only meaningful if isIpv4().
+    quint32 ipv4() const;
+
+    QHostAddress toHostAddress() const;
+    QString toString() const { return toHostAddress().toString(); }
+    // Fills in a sockaddr_in or sockaddr_in6 for port (host byte order) and
+    // returns its length.
+    int toSockaddr(quint16 port, sockaddr_storage *sa) const;
+
+    bool operator==(const ProbeAddress &o) const { return memcmp(bytes, o.bytes, 16) == 0; }
+    bool operator!=(const ProbeAddress &o) const { return !(*this == o); }
+};
+
+inline size_t qHash(const ProbeAddress &address, size_t seed = 0)
+{
+    return qHashBits(address.bytes, sizeof(address.bytes), seed);
+}
+
+#endif // PROBEADDRESS_H
@@ -0,0 +1,45 @@
+#include "ProbeBackend.h"
+#include "SimulatedProbeBackend.h"
+
+#ifdef Q_OS_WIN
+#include "NativeProbeBackend.h"
+#endif
+#ifdef Q_OS_LINUX
+#include "SocketProbeBackend.h"
+#endif
+
+ProbeBackend *ProbeBackend::create(const QString &name, QObject *parent)
+{
+#ifdef Q_OS_WIN
+    if (name == "native") {
+        return new NativeProbeBackend(parent);
+    }
+#endif
+#ifdef Q_OS_LINUX
+    if (name == "socket") {
+        return new SocketProbeBackend(parent);
+    }
+#endif
+    if (name == "simulated") {
+        return new SimulatedProbeBackend(SimulatedProbeBackend::Config::fromSettings(), parent);
+    }
+    return nullptr;
+}
+
+QStringList ProbeBackend::available()
+{
+    QStringList names;
+#ifdef Q_OS_WIN
+    names << "native";
+#endif
+#ifdef Q_OS_LINUX
+    names << "socket";
+#endif
+    names << "simulated";
+    return names;
+}
+
+QString ProbeBackend::defaultName()
+{
+    return available().first();
+}
@@ -0,0 +1,70 @@
+#ifndef PROBEBACKEND_H
+#define PROBEBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include "ProbePolicy.h"
+
+class DnsResolver;
+class SendBudget;
+class ResultRing;
+
+// Source of probe results used by PingManager.
+// Implementations own their threads and push every result into the shared
+// ResultRing from whichever thread produced it.
+class ProbeBackend : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        quint64 probesSent = 0;
+        quint64 repliesReceived = 0;
+        double probesPerSec = 0.0;
+        double avgSendBatch = 0.0;  // Probes per send call, 0 if not batched
+        double avgRecvBatch = 0.0;  // Replies per receive call, 0 if not batched
+        double avgTimerLagMs = 0.0;
+        qint64 maxTimerLagMs = 0;
+    };
+
+    explicit ProbeBackend(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~ProbeBackend() {}
+
+    // Short identifier, as accepted by create().
+    virtual QString name() const = 0;
+
+    // Hostname resolution for backends that need it. Call before start().
+    virtual void setResolver(DnsResolver *resolver) { Q_UNUSED(resolver); }
+    // Packets-per-second limit every probe send has to respect. Call before
+    // start(); budget must outlive the backend's threads.
+    virtual void setSendBudget(SendBudget *budget) = 0;
+    // Where results go. Call before start(); ring must outlive the
+    // backend's threads.
+    virtual void setResultRing(ResultRing *ring) = 0;
+
+    virtual void start() = 0;
+    // Stops probing and joins the backend's threads.
+    virtual void shutdown() = 0;
+
+    // Thread-safe. id is the target's TargetRegistry id; results carry it
+    // and the other calls name the target by it.
+    virtual void addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy) = 0;
+    virtual void removeTarget(quint32 id) = 0;
+    virtual void removeAll() = 0;
+    // Takes effect from the next probe; the running target keeps its seq.
+    virtual void setPolicy(quint32 id, const ProbePolicy &policy) = 0;
+
+    // Probe each target again as soon as the previous probe completes,
+    // overriding every target's policy.
+    virtual void setThroughputMode(bool enabled) = 0;
+
+    virtual Stats stats() const { return Stats(); }
+
+    // "native", "socket" or "simulated". Returns nullptr if the backend is
+    // not available on this platform.
+    static ProbeBackend *create(const QString &name, QObject *parent = nullptr);
+    static QStringList available();
+    static QString defaultName();
+};
+
+#endif // PROBEBACKEND_H
@@ -0,0 +1,82 @@
+#include "ProbePolicy.h"
+#include <QtGlobal>
+
+ProbePolicy ProbePolicy::normalized() const
+{
+    ProbePolicy p = *this;
+    p.intervalMs = qMax<uint32_t>(MIN_INTERVAL_MS, p.intervalMs);
+    p.burstCount = qBound(1, p.burstCount, int(MAX_BURST));
+    p.jitterPercent = qBound(0, p.jitterPercent, 100);
+    return p;
+}
+
+QString ProbePolicy::toString() const
+{
+    QString text = QString::number(intervalMs) + "ms";
+    if (burstCount > 1) {
+        text = QString::number(burstCount) + "x" + text;
+    }
+    if (jitterPercent > 0) {
+        text += "~" + QString::number(jitterPercent) + "%";
+    }
+    return text;
+}
+
+ProbePolicy ProbePolicy::fromString(const QString &text, bool *ok)
+{
+    ProbePolicy p;
+    bool valid = true;
+    bool fieldOk = true;
+    QString rest = text.trimmed();
+
+    int tilde = rest.indexOf('~');
+    if (tilde >= 0) {
+        QString jitter = rest.mid(tilde + 1);
+        if (jitter.endsWith("%")) jitter.chop(1);
+        p.jitterPercent = jitter.toInt(&fieldOk);
+        valid = valid && fieldOk;
+        rest = rest.left(tilde);
+    }
+
+    int x = rest.indexOf('x');
+    if (x >= 0) {
+        p.burstCount = rest.left(x).toInt(&fieldOk);
+        valid = valid && fieldOk;
+        rest = rest.mid(x + 1);
+    }
+
+    if (rest.endsWith("ms")) rest.chop(2);
+    p.intervalMs = rest.toUInt(&fieldOk);
+    valid = valid && fieldOk;
+
+    if (ok) *ok = valid;
+    return valid ? p.normalized() : ProbePolicy();
+}
+
+qint64 ProbeSchedule::start(const ProbePolicy &policy, qint64 nowMs, quint32 random)
+{
+    sentInBurst = 0;
+    burstStartMs = nowMs + random % policy.intervalMs;
+    return burstStartMs;
+}
+
+qint64 ProbeSchedule::next(const ProbePolicy &policy, qint64 doneMs, quint32 random)
+{
+    if (++sentInBurst < policy.burstCount) {
+        return doneMs; // Rest of the burst goes out back-to-back
+    }
+    sentInBurst = 0;
+
+    qint64 interval = policy.intervalMs;
+    if (policy.jitterPercent > 0) {
+        // Uniform in [-jitter, +jitter] percent of the interval
+        double u = random / 4294967296.0;
+        interval += qint64(policy.intervalMs * policy.jitterPercent * (2.0 * u - 1.0) / 100.0);
+        interval = qMax<qint64>(ProbePolicy::MIN_INTERVAL_MS, interval);
+    }
+
+    // Fell a whole interval behind (slow replies, deferred sends):
+    // restart the grid from now rather than catching up back-to-back.
+    burstStartMs = qMax(burstStartMs + interval, doneMs);
+    return burstStartMs;
+}
@@ -0,0 +1,54 @@
+#ifndef PROBEPOLICY_H
+#define PROBEPOLICY_H
+
+#include <QString>
+
+// How often a target is probed. Chosen per target when it is added and
+// changeable while it runs.
+//   burstCount == 1: one probe every intervalMs
+//   burstCount  > 1: burstCount probes back-to-back, bursts intervalMs apart
+// jitterPercent randomly stretches or shrinks each interval by up to that
+// much. A target never has more than one probe in flight, so a probe that
+// takes longer than the interval delays the next one.
+struct ProbePolicy
+{
+    uint32_t intervalMs = 1000;
+    int burstCount = 1;
+    int jitterPercent = 0;
+
+    enum { MIN_INTERVAL_MS = 1, MAX_BURST = 1000 };
+
+    // Clamps every field to a usable range.
+    ProbePolicy normalized() const;
+
+    // Compact form for settings and display, e.g. "1000ms", "5x1000ms~10%".
+    QString toString() const;
+    static ProbePolicy fromString(const QString &text, bool *ok = nullptr);
+
+    bool operator==(const ProbePolicy &o) const
+    {
+        return intervalMs == o.intervalMs && burstCount == o.burstCount && jitterPercent == o.jitterPercent;
+    }
+    bool operator!=(const ProbePolicy &o) const { return !(*this == o); }
+};
+
+// Per-target scheduling state kept by a probe backend.
+// Times are in the backend's own millisecond clock; random is any uniformly
+// distributed 32-bit value, so each backend picks its own generator.
+struct ProbeSchedule
+{
+    qint64 burstStartMs = 0;   // Planned start of the current burst
+    int sentInBurst = 0;
+
+    // Time of the first probe after the target is added or its policy
+    // changes: a random phase within one interval, so targets started
+    // together spread their sends instead of firing in the same tick.
+    qint64 start(const ProbePolicy &policy, qint64 nowMs, quint32 random);
+
+    // Time of the probe following one that completed at doneMs. Bursts stay
+    // anchored to their planned start, so the phase doesn't drift by one RTT
+    // per probe.
+    qint64 next(const ProbePolicy &policy, qint64 doneMs, quint32 random);
+};
+
+#endif // PROBEPOLICY_H
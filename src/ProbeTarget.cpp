@@ -0,0 +1,103 @@
+#include "ProbeTarget.h"
+
+namespace {
+
+// Length of the "xxx://" prefix, 0 if there is none.
+int schemeLength(const QString &target)
+{
+    int sep = target.indexOf("://");
+    return (sep >= 3 && sep <= 5) ? sep + 3 : 0;
+}
+
+QString stripBrackets(const QString &host)
+{
+    if (host.startsWith('[') && host.endsWith(']')) {
+        return host.mid(1, host.size() - 2);
+    }
+    return host;
+}
+
+} // namespace
+
+ProbeTarget ProbeTarget::parse(const QString &target)
+{
+    ProbeTarget pt;
+    pt.type = typeOf(target);
+
+    int prefix = schemeLength(target);
+    if (prefix > 0) {
+        QChar digit = target.at(prefix - 4);
+        if (digit == '4') pt.family = Ipv4;
+        if (digit == '6') pt.family = Ipv6;
+    }
+
+    QString rest = target.mid(prefix);
+    if (pt.type == Icmp) {
+        pt.host = stripBrackets(rest);
+        return pt;
+    }
+
+    // The port follows the last colon, unless that colon is part of a bare
+    // IPv6 literal without one.
+    int colon = rest.lastIndexOf(':');
+    int bracket = rest.lastIndexOf(']');
+    if (colon < 0 || colon < bracket || (bracket < 0 && rest.indexOf(':') != colon)) {
+        pt.host = stripBrackets(rest);
+        return pt;
+    }
+
+    bool ok = false;
+    uint port = rest.mid(colon + 1).toUInt(&ok);
+    pt.host = stripBrackets(rest.left(colon));
+    pt.port = (ok && port <= 65535) ? static_cast<quint16>(port) : 0;
+    return pt;
+}
+
+ProbeTarget::Type ProbeTarget::typeOf(const QString &target)
+{
+    if (schemeLength(target) == 0) return Icmp;
+    if (target.startsWith("tcp")) return Tcp;
+    if (target.startsWith("udp")) return Udp;
+    return Icmp;
+}
+
+const char *ProbeTarget::typeName(Type type)
+{
+    switch (type) {
+    case Tcp: return "tcp";
+    case Udp: return "udp";
+    default: return "icmp";
+    }
+}
+
+QString ProbeTarget::withFamily(const QString &target, Family family)
+{
+    int prefix = schemeLength(target);
+    QString scheme = prefix > 0 ? target.left(prefix - 3) : QString("icmp");
+    QString rest = target.mid(prefix);
+    if (scheme.endsWith('4') || scheme.endsWith('6')) {
+        scheme.chop(1);
+    }
+    if (family == Ipv4) scheme += '4';
+    if (family == Ipv6) scheme += '6';
+
+    if (family == AnyFamily && scheme == "icmp") return rest;
+    return scheme + "://" + rest;
+}
+
+QHostAddress ProbeTarget::pickAddress(const QList<QHostAddress> &addresses, Family family, bool preferIpv6)
+{
+    QHostAddress fallback;
+    for (const QHostAddress &a : addresses) {
+        bool v6 = (a.protocol() == QAbstractSocket::IPv6Protocol);
+        if (a.protocol() != QAbstractSocket::IPv4Protocol && !v6) continue;
+
+        if (family == AnyFamily) {
+            if (v6 == preferIpv6) return a;
+            if (fallback.isNull()) fallback = a;
+        } else if (v6 == (family == Ipv6)) {
+            return a;
+        }
+    }
+    return fallback;
+}
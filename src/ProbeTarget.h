@@ -0,0 +1,40 @@
+#ifndef PROBETARGET_H
+#define PROBETARGET_H
+
+#include <QString>
+#include <QList>
+#include <QHostAddress>
+
+// A target string as entered by the user:
+//   "host"               ICMP echo (ICMPv6 for IPv6 addresses)
+//   "tcp://host:port"    TCP connect time
+//   "udp://host:port"    UDP request/response
+// "icmp4://", "icmp6://", "tcp4://", "tcp6://", "udp4://" and "udp6://"
+// pin a host name to one address family; without a digit the resolver's
+// preferred family is used, falling back to the other one. IPv6 literals
+// with a port are written in brackets: "tcp://[::1]:80".
+// The full string stays the target's identity everywhere (models, database,
+// charts); this only splits it for the probe backends.
+struct ProbeTarget
+{
+    enum Type { Icmp, Tcp, Udp };
+    enum Family { AnyFamily, Ipv4, Ipv6 };
+
+    Type type = Icmp;
+    Family family = AnyFamily;
+    QString host;
+    quint16 port = 0;   // 0 for ICMP, or if the port is missing/invalid
+
+    static ProbeTarget parse(const QString &target);
+    // Cheap prefix check, for per-result use.
+    static Type typeOf(const QString &target);
+    static const char *typeName(Type type);
+
+    // The same target pinned to family, e.g. "tcp://h:80" -> "tcp6://h:80".
+    static QString withFamily(const QString &target, Family family);
+
+    // The address to probe out of a resolver answer, null if none fits.
+    static QHostAddress pickAddress(const QList<QHostAddress> &addresses, Family family, bool preferIpv6);
+};
+
+#endif // PROBETARGET_H
@@ -0,0 +1,174 @@
+#include "ResultRing.h"
+#include <QSettings>
+#include <QThread>
+#include <cstring>
+
+namespace {
+
+const int SPIN_LIMIT = 64;   // Before yielding to a producer still writing our cell
+
+} // namespace
+
+ResultRing::ResultRing(int capacity)
+    : m_head(0)
+{
+    quint64 size = 1;
+    while (size < quint64(qMax(capacity, 2))) {
+        size <<= 1;
+    }
+    m_mask = size - 1;
+    m_cells = new Cell[size];
+    for (quint64 i = 0; i < size; ++i) {
+        m_cells[i].seq.store(0, std::memory_order_relaxed);
+    }
+    for (Reader &r : m_readers) {
+        r.used.store(false, std::memory_order_relaxed);
+        r.cursor.store(0, std::memory_order_relaxed);
+        r.read.store(0, std::memory_order_relaxed);
+        r.overflowed.store(0, std::memory_order_relaxed);
+    }
+}
+
+ResultRing::~ResultRing()
+{
+    delete[] m_cells;
+}
+
+int ResultRing::configuredCapacity()
+{
+    QSettings settings("MyCompany", "PingTool");
+    return qMax(1024, settings.value("resultRing/capacity", int(DefaultCapacity)).toInt());
+}
+
+void ResultRing::push(const ProbeResult &result)
+{
+    quint64 words[Words];
+    memcpy(words, &result, sizeof(result));
+
+    quint64 pos = m_head.fetch_add(1, std::memory_order_relaxed);
+    Cell &cell = m_cells[pos & m_mask];
+
+    // Take the cell over from whatever it held a lap earlier. Only if the
+    // producer of that lap is still writing (it was preempted while the
+    // ring wrapped around) do we wait, briefly, for it to finish; if a
+    // producer a lap ahead already took the cell, our result counts as
+    // overwritten.
+    const quint64 claim = 2 * pos + 1;
+    quint64 seq = cell.seq.load(std::memory_order_relaxed);
+    for (int spins = 0; ; ++spins) {
+        if (seq >= claim) {
+            return;
+        }
+        if (seq & 1) {
+            if (spins > SPIN_LIMIT) {
+                QThread::yieldCurrentThread();
+            }
+            seq = cell.seq.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (cell.seq.compare_exchange_weak(seq, claim, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < Words; ++i) {
+        cell.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    cell.seq.store(2 * pos + 2, std::memory_order_release);
+}
+
+int ResultRing::addReader()
+{
+    for (int i = 0; i < MaxReaders; ++i) {
+        Reader &r = m_readers[i];
+        bool expected = false;
+        if (r.used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            r.read.store(0, std::memory_order_relaxed);
+            r.overflowed.store(0, std::memory_order_relaxed);
+            r.cursor.store(m_head.load(std::memory_order_acquire), std::memory_order_relaxed);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ResultRing::removeReader(int reader)
+{
+    if (reader < 0 || reader >= MaxReaders) return;
+    m_readers[reader].used.store(false, std::memory_order_release);
+}
+
+int ResultRing::read(int reader, ProbeResult *out, int max)
+{
+    if (reader < 0 || reader >= MaxReaders) return 0;
+    Reader &r = m_readers[reader];
+    const quint64 capacity = m_mask + 1;
+
+    quint64 pos = r.cursor.load(std::memory_order_relaxed);
+    quint64 head = m_head.load(std::memory_order_acquire);
+    quint64 lost = 0;
+    if (head - pos > capacity) {
+        lost += head - capacity - pos;
+        pos = head - capacity;
+    }
+
+    int count = 0;
+    while (count < max && pos < head) {
+        Cell &cell = m_cells[pos & m_mask];
+        const quint64 want = 2 * pos + 2;
+        quint64 seq = cell.seq.load(std::memory_order_acquire);
+        if (seq < want) {
+            break; // Claimed but not published yet
+        }
+        if (seq == want) {
+            quint64 words[Words];
+            for (int i = 0; i < Words; ++i) {
+                words[i] = cell.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (cell.seq.load(std::memory_order_relaxed) == want) {
+                memcpy(&out[count++], words, sizeof(words));
+                ++pos;
+                continue;
+            }
+        }
+
+        // A producer a lap ahead took the cell: skip to the oldest result
+        // that can still be in the ring.
+        head = m_head.load(std::memory_order_acquire);
+        quint64 oldest = head > capacity ? head - capacity : 0;
+        quint64 next = qMax(oldest, pos + 1);
+        lost += next - pos;
+        pos = next;
+    }
+
+    r.cursor.store(pos, std::memory_order_relaxed);
+    r.read.fetch_add(quint64(count), std::memory_order_relaxed);
+    if (lost > 0) {
+        r.overflowed.fetch_add(lost, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+quint64 ResultRing::overflowed(int reader) const
+{
+    if (reader < 0 || reader >= MaxReaders) return 0;
+    return m_readers[reader].overflowed.load(std::memory_order_relaxed);
+}
+
+ResultRing::Stats ResultRing::stats() const
+{
+    Stats stats;
+    stats.pushed = m_head.load(std::memory_order_relaxed);
+    stats.capacity = capacity();
+    for (const Reader &r : m_readers) {
+        if (!r.used.load(std::memory_order_acquire)) continue;
+        stats.readers++;
+        stats.read += r.read.load(std::memory_order_relaxed);
+        stats.overflowed += r.overflowed.load(std::memory_order_relaxed);
+        quint64 cursor = r.cursor.load(std::memory_order_relaxed);
+        quint64 lag = stats.pushed > cursor ? stats.pushed - cursor : 0;
+        stats.maxLag = qMax(stats.maxLag, qMin<quint64>(lag, quint64(stats.capacity)));
+    }
+    return stats;
+}
@@ -0,0 +1,99 @@
+#ifndef RESULTRING_H
+#define RESULTRING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <type_traits>
+
+// One probe result as it travels from a backend to the GUI, database and
+// chart windows. Fixed size and trivially copyable so it can be published
+// with plain word copies; the target travels as its TargetRegistry id.
+struct ProbeResult
+{
+    quint32 targetId;
+    qint32 ttl;
+    qint32 seq;
+    qint32 timeoutMs;     // The timeout used for this probe
+    qint64 rttNs;         // -1 timeout, -2 resolve error
+    qint64 startTime;     // ms since epoch
+    qint64 returnTime;    // ms since epoch, reply or timeout
+};
+
+static_assert(std::is_trivially_copyable<ProbeResult>::value, "ProbeResult is copied word by word");
+static_assert(sizeof(ProbeResult) % sizeof(quint64) == 0, "ProbeResult is copied word by word");
+
+// Multi-producer, multi-reader broadcast ring carrying ProbeResults.
+// Backend threads push without locks and never wait for a reader: when one
+// falls more than capacity() results behind, the oldest results are
+// overwritten and that reader's overflow count goes up by the number it
+// missed. Every reader has its own cursor and drains in batches on its own
+// schedule, so a slow consumer (the database, a busy chart) never holds up
+// the backends or the other consumers.
+// Cells are published seqlock style: a reader copies a cell and keeps the
+// copy only if the cell still holds the same sequence afterwards. A producer
+// owns its cell while it writes, so two producers a lap apart never mix
+// their results in one cell.
+class ResultRing
+{
+public:
+    struct Stats {
+        quint64 pushed = 0;
+        quint64 read = 0;       // Summed over the current readers
+        quint64 overflowed = 0; // Likewise; results overwritten before read
+        quint64 maxLag = 0;     // Results the furthest-behind reader still has to read
+        int readers = 0;
+        int capacity = 0;
+    };
+
+    enum { MaxReaders = 64, DefaultCapacity = 1 << 17 };
+
+    // capacity is rounded up to a power of two.
+    explicit ResultRing(int capacity = DefaultCapacity);
+    ~ResultRing();
+
+    // The "resultRing/capacity" setting, or DefaultCapacity.
+    static int configuredCapacity();
+
+    int capacity() const { return int(m_mask + 1); }
+
+    // Thread-safe, lock-free; never blocks.
+    void push(const ProbeResult &result);
+
+    // A new reader starts at the current end of the ring. Returns -1 once
+    // MaxReaders are attached.
+    int addReader();
+    void removeReader(int reader);
+    // Copies up to max of the reader's unread results into out, oldest
+    // first, and returns how many. Only one thread may read through a given
+    // reader at a time.
+    int read(int reader, ProbeResult *out, int max);
+    // Results this reader lost to overwriting.
+    quint64 overflowed(int reader) const;
+
+    Stats stats() const;
+
+private:
+    enum { Words = sizeof(ProbeResult) / sizeof(quint64) };
+
+    // One cache line each, so producers filling neighbouring cells don't
+    // share a line. seq is 2 * position + 1 while a producer writes the
+    // cell and 2 * position + 2 once it is published.
+    struct alignas(64) Cell {
+        std::atomic<quint64> seq;
+        std::atomic<quint64> words[Words];
+    };
+
+    struct alignas(64) Reader {
+        std::atomic<bool> used;
+        std::atomic<quint64> cursor;     // Next position to read
+        std::atomic<quint64> read;
+        std::atomic<quint64> overflowed;
+    };
+
+    Cell *m_cells;
+    quint64 m_mask;
+    alignas(64) std::atomic<quint64> m_head; // Next position to claim
+    Reader m_readers[MaxReaders];
+};
+
+#endif // RESULTRING_H
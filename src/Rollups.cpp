@@ -0,0 +1,419 @@
+#include "Rollups.h"
+#include "LogPartitions.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QSqlError>
+#include <QVector>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const qint64 WIDTH_MS[Rollups::ResolutionCount] = { 1000, 60 * 1000, 60 * 60 * 1000 };
+const char *const TABLES[Rollups::ResolutionCount] = { "rollup_1s", "rollup_1m", "rollup_1h" };
+const qint64 HOUR_MS = 60 * 60 * 1000;
+const int KEEP_OPEN = 3;    // Buckets per target held in memory for late results
+const char *const REBUILD_SCHEMA = "rebuild";   // The partition being rolled up
+
+// Rows written before rtt_ns existed only have whole ms
+qint64 rowRttNs(const QSqlQuery &query, int rttNsColumn, int rttColumn)
+{
+    if (!query.value(rttNsColumn).isNull()) {
+        return query.value(rttNsColumn).toLongLong();
+    }
+    qint64 rtt = query.value(rttColumn).toLongLong();
+    return rtt >= 0 ? rtt * 1000000 : rtt;
+}
+
+} // namespace
+
+const char *const Rollups::Columns = "probes, lost, min_ns, max_ns, sum_ns, sum_sq_ns, sketch";
+
+void Rollups::Bucket::add(qint64 rttNs)
+{
+    count++;
+    if (rttNs < 0) {
+        loss++;
+        return;
+    }
+    if (replies() == 1 || rttNs < minNs) minNs = rttNs;
+    if (replies() == 1 || rttNs > maxNs) maxNs = rttNs;
+    sumNs += rttNs;
+    sumSqNs += double(rttNs) * double(rttNs);
+    sketch.add(rttNs);
+}
+
+void Rollups::Bucket::merge(const Bucket &other)
+{
+    if (other.replies() > 0) {
+        minNs = replies() > 0 ? qMin(minNs, other.minNs) : other.minNs;
+        maxNs = replies() > 0 ? qMax(maxNs, other.maxNs) : other.maxNs;
+    }
+    count += other.count;
+    loss += other.loss;
+    sumNs += other.sumNs;
+    sumSqNs += other.sumSqNs;
+    sketch.merge(other.sketch);
+}
+
+double Rollups::Bucket::meanNs() const
+{
+    return replies() > 0 ? double(sumNs) / replies() : 0;
+}
+
+double Rollups::Bucket::stddevNs() const
+{
+    if (replies() < 2) return 0;
+    double mean = meanNs();
+    return std::sqrt(qMax(0.0, sumSqNs / replies() - mean * mean));
+}
+
+qint64 Rollups::widthMs(Resolution resolution)
+{
+    return resolution == Raw ? 0 : WIDTH_MS[resolution];
+}
+
+QString Rollups::tableName(Resolution resolution)
+{
+    return resolution == Raw ? QString("ping_log") : QString(TABLES[resolution]);
+}
+
+Rollups::Resolution Rollups::pick(qint64 rangeMs, int pixels)
+{
+    for (int r = Hour; r >= Second; --r) {
+        if (WIDTH_MS[r] * qMax(1, pixels) <= rangeMs) {
+            return Resolution(r);
+        }
+    }
+    return Raw;
+}
+
+Rollups::Bucket Rollups::bucketAt(const QSqlQuery &query, int firstColumn)
+{
+    Bucket bucket;
+    bucket.count = query.value(firstColumn).toLongLong();
+    bucket.loss = query.value(firstColumn + 1).toLongLong();
+    bucket.minNs = query.value(firstColumn + 2).toLongLong();
+    bucket.maxNs = query.value(firstColumn + 3).toLongLong();
+    bucket.sumNs = query.value(firstColumn + 4).toLongLong();
+    bucket.sumSqNs = query.value(firstColumn + 5).toDouble();
+    bucket.sketch = LatencySketch::fromBytes(query.value(firstColumn + 6).toByteArray());
+    return bucket;
+}
+
+void Rollups::createTables(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    for (int r = Second; r < ResolutionCount; ++r) {
+        if (!query.exec(QString("CREATE TABLE IF NOT EXISTS %1 ("
+                                "target_id INTEGER NOT NULL, "
+                                "bucket INTEGER NOT NULL, "
+                                "probes INTEGER NOT NULL, "
+                                "lost INTEGER NOT NULL, "
+                                "min_ns INTEGER, "
+                                "max_ns INTEGER, "
+                                "sum_ns INTEGER, "
+                                "sum_sq_ns REAL, "
+                                "sketch BLOB, "
+                                "PRIMARY KEY (target_id, bucket)) WITHOUT ROWID").arg(TABLES[r]))) {
+            qCritical() << "Failed to create" << TABLES[r] << query.lastError().text();
+        }
+    }
+}
+
+void Rollups::scheduleRebuild(QSqlDatabase &db)
+{
+    // Rows starting from until on are written after the rollups exist.
+    // partition_start is the start of the partition being walked, 0 while
+    // it is pinglog.db's own ping_log
+    QSqlQuery query(db);
+    query.exec("CREATE TABLE IF NOT EXISTS rollup_rebuild (target_id INTEGER, start_time INTEGER, until INTEGER, "
+               "partition_start INTEGER NOT NULL DEFAULT 0)");
+    query.exec("DELETE FROM rollup_rebuild");
+    query.prepare("INSERT INTO rollup_rebuild (target_id, start_time, until, partition_start) VALUES (0, 0, :until, 0)");
+    query.bindValue(":until", QDateTime::currentMSecsSinceEpoch());
+    if (!query.exec()) {
+        qWarning() << "Failed to schedule the rollup rebuild:" << query.lastError().text();
+    }
+}
+
+bool Rollups::isRebuilding(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    return query.exec("SELECT 1 FROM rollup_rebuild") && query.next();
+}
+
+bool Rollups::load(const QSqlDatabase &db, Resolution resolution, qint64 targetId, qint64 start, Bucket *bucket)
+{
+    QSqlQuery query(db);
+    query.prepare(QString("SELECT %1 FROM %2 WHERE target_id = :target AND bucket = :bucket")
+                      .arg(Columns).arg(TABLES[resolution]));
+    query.bindValue(":target", targetId);
+    query.bindValue(":bucket", start);
+    if (!query.exec() || !query.next()) {
+        return false;
+    }
+    *bucket = bucketAt(query, 0);
+    return true;
+}
+
+void Rollups::add(QSqlDatabase &db, qint64 targetId, qint64 startTime, qint64 rttNs)
+{
+    if (startTime < 0) return;
+    for (int r = Second; r < ResolutionCount; ++r) {
+        qint64 start = startTime - startTime % WIDTH_MS[r];
+        Key key(targetId, start);
+        auto it = m_open[r].find(key);
+        if (it == m_open[r].end()) {
+            Open open;
+            auto newest = m_newest[r].constFind(targetId);
+            if (newest == m_newest[r].constEnd() || start <= *newest) {
+                // First result this run, or a late one for a bucket already
+                // written: it may have rows from before
+                load(db, Resolution(r), targetId, start, &open.bucket);
+            }
+            if (newest == m_newest[r].constEnd() || start > *newest) {
+                m_newest[r].insert(targetId, start);
+            }
+            it = m_open[r].insert(key, open);
+        }
+        it->bucket.add(rttNs);
+        if (!it->dirty) {
+            it->dirty = true;
+            m_dirty++;
+        }
+    }
+}
+
+void Rollups::write(QSqlDatabase &db)
+{
+    for (int r = Second; r < ResolutionCount; ++r) {
+        QSqlQuery query(db);
+        query.prepare(QString("INSERT OR REPLACE INTO %1 (target_id, bucket, %2) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                          .arg(TABLES[r]).arg(Columns));
+        for (auto it = m_open[r].begin(); it != m_open[r].end(); ) {
+            if (it->dirty) {
+                const Bucket &b = it->bucket;
+                query.bindValue(0, it.key().first);
+                query.bindValue(1, it.key().second);
+                query.bindValue(2, b.count);
+                query.bindValue(3, b.loss);
+                query.bindValue(4, b.replies() > 0 ? QVariant(b.minNs) : QVariant());
+                query.bindValue(5, b.replies() > 0 ? QVariant(b.maxNs) : QVariant());
+                query.bindValue(6, b.sumNs);
+                query.bindValue(7, b.sumSqNs);
+                query.bindValue(8, b.sketch.toBytes());
+                if (!query.exec()) {
+                    qWarning() << "Rollup write failed:" << query.lastError().text();
+                }
+                it->dirty = false;
+            }
+            // Late results for older buckets are rare enough to read back
+            if (it.key().second < m_newest[r].value(it.key().first) - (KEEP_OPEN - 1) * WIDTH_MS[r]) {
+                it = m_open[r].erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    m_dirty = 0;
+}
+
+int Rollups::rebuildHour(QSqlDatabase &db, qint64 targetId, qint64 hour, bool partition)
+{
+    QVector<Bucket> seconds(int(HOUR_MS / WIDTH_MS[Second]));
+    QVector<Bucket> minutes(int(HOUR_MS / WIDTH_MS[Minute]));
+    QVector<Bucket> hours(1);
+    const QVector<Bucket> *buckets[ResolutionCount] = { &seconds, &minutes, &hours };
+
+    // Rows kept in pinglog.db from before partitioning may share the hour
+    // with the partition, so an hour of a partition reads both
+    QString sql = "SELECT start_time, rtt_ns, rtt FROM ping_log "
+                  "WHERE target_id = :target AND start_time >= :start AND start_time < :end";
+    if (partition) {
+        sql += QString(" UNION ALL SELECT start_time, rtt_ns, rtt FROM %1.ping_log "
+                       "WHERE target_id = :partTarget AND start_time >= :partStart AND start_time < :partEnd")
+                   .arg(REBUILD_SCHEMA);
+    }
+    QSqlQuery query(db);
+    query.prepare(sql);
+    query.bindValue(":target", targetId);
+    query.bindValue(":start", hour);
+    query.bindValue(":end", hour + HOUR_MS);
+    if (partition) {
+        query.bindValue(":partTarget", targetId);
+        query.bindValue(":partStart", hour);
+        query.bindValue(":partEnd", hour + HOUR_MS);
+    }
+    query.setForwardOnly(true);
+    if (!query.exec()) {
+        qWarning() << "Rollup rebuild failed:" << query.lastError().text();
+        return 0;
+    }
+    int rows = 0;
+    while (query.next()) {
+        qint64 offset = query.value(0).toLongLong() - hour;
+        qint64 rttNs = rowRttNs(query, 1, 2);
+        seconds[int(offset / WIDTH_MS[Second])].add(rttNs);
+        minutes[int(offset / WIDTH_MS[Minute])].add(rttNs);
+        hours[0].add(rttNs);
+        rows++;
+    }
+
+    // Whatever the writer holds for this hour is written already and so in
+    // what we just read
+    for (int r = Second; r < ResolutionCount; ++r) {
+        for (auto it = m_open[r].begin(); it != m_open[r].end(); ) {
+            if (it.key().first == targetId && it.key().second >= hour && it.key().second < hour + HOUR_MS) {
+                if (it->dirty) m_dirty--;
+                it = m_open[r].erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (int r = Second; r < ResolutionCount; ++r) {
+        query.prepare(QString("DELETE FROM %1 WHERE target_id = :target AND bucket >= :start AND bucket < :end").arg(TABLES[r]));
+        query.bindValue(":target", targetId);
+        query.bindValue(":start", hour);
+        query.bindValue(":end", hour + HOUR_MS);
+        query.exec();
+
+        query.prepare(QString("INSERT INTO %1 (target_id, bucket, %2) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                          .arg(TABLES[r]).arg(Columns));
+        for (int i = 0; i < buckets[r]->size(); ++i) {
+            const Bucket &b = buckets[r]->at(i);
+            if (b.count == 0) continue;
+            query.bindValue(0, targetId);
+            query.bindValue(1, hour + i * WIDTH_MS[r]);
+            query.bindValue(2, b.count);
+            query.bindValue(3, b.loss);
+            query.bindValue(4, b.replies() > 0 ? QVariant(b.minNs) : QVariant());
+            query.bindValue(5, b.replies() > 0 ? QVariant(b.maxNs) : QVariant());
+            query.bindValue(6, b.sumNs);
+            query.bindValue(7, b.sumSqNs);
+            query.bindValue(8, b.sketch.toBytes());
+            if (!query.exec()) {
+                qWarning() << "Rollup rebuild failed:" << query.lastError().text();
+            }
+        }
+    }
+    return rows;
+}
+
+int Rollups::rebuildStep(QSqlDatabase &db, const QString &partitionDirectory, int maxRows)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT target_id, start_time, until, partition_start FROM rollup_rebuild") || !query.next()) {
+        return 0;
+    }
+    qint64 targetId = query.value(0).toLongLong();
+    qint64 from = query.value(1).toLongLong();
+    qint64 until = query.value(2).toLongLong();
+    qint64 partitionStart = query.value(3).toLongLong();
+
+    // pinglog.db's own ping_log first, then every partition, oldest first;
+    // one dropped since the last step is skipped
+    LogPartitions::Partition partition;
+    if (partitionStart > 0) {
+        for (const LogPartitions::Partition &candidate : LogPartitions::list(partitionDirectory)) {
+            if (candidate.start >= partitionStart) {
+                partition = candidate;
+                break;
+            }
+        }
+        if (partition.path.isEmpty()) {
+            query.exec("DROP TABLE rollup_rebuild");
+            qDebug() << "Rollup rebuild finished";
+            return 0;
+        }
+        if (partition.start != partitionStart) {
+            partitionStart = partition.start;
+            targetId = 0;
+            from = 0;
+        }
+    }
+    const bool inPartition = partitionStart > 0;
+    QString table = "ping_log";
+    if (inPartition) {
+        if (!LogPartitions::attachForReading(db, partition.path, REBUILD_SCHEMA)) {
+            return 0;   // Picked up again on the next start
+        }
+        table = QString("%1.ping_log").arg(REBUILD_SCHEMA);
+    }
+
+    // ATTACH and DETACH are refused inside a transaction, so the step
+    // brings its own
+    db.transaction();
+    int rows = 0;
+    bool done = false;
+    bool finished = false;
+    while (rows < maxRows) {
+        // Next target-hour with rows, straight from the primary key
+        query.prepare(QString("SELECT target_id, start_time FROM %1 "
+                              "WHERE (target_id, start_time) >= (:target, :start) "
+                              "ORDER BY target_id, start_time LIMIT 1").arg(table));
+        query.bindValue(":target", targetId);
+        query.bindValue(":start", from);
+        if (!query.exec() || !query.next()) {
+            done = true;
+            break;
+        }
+        targetId = query.value(0).toLongLong();
+        qint64 start = query.value(1).toLongLong();
+        if (start >= until) {
+            // Everything later was rolled up as it was written
+            targetId++;
+            from = std::numeric_limits<qint64>::min();
+            continue;
+        }
+        qint64 hour = start - start % HOUR_MS;
+        rows += qMax(1, rebuildHour(db, targetId, hour, inPartition));
+        from = hour + HOUR_MS;
+    }
+
+    if (done) {
+        // On to the next partition, if there is one
+        qint64 next = 0;
+        for (const LogPartitions::Partition &candidate : LogPartitions::list(partitionDirectory)) {
+            if (candidate.start > partitionStart) {
+                next = candidate.start;
+                break;
+            }
+        }
+        if (next == 0) {
+            query.exec("DROP TABLE rollup_rebuild");
+            qDebug() << "Rollup rebuild finished";
+            finished = true;
+        } else {
+            query.prepare("UPDATE rollup_rebuild SET target_id = 0, start_time = 0, partition_start = :partition");
+            query.bindValue(":partition", next);
+            query.exec();
+        }
+    } else {
+        query.prepare("UPDATE rollup_rebuild SET target_id = :target, start_time = :start, partition_start = :partition");
+        query.bindValue(":target", targetId);
+        query.bindValue(":start", from);
+        query.bindValue(":partition", partitionStart);
+        query.exec();
+    }
+    query = QSqlQuery();
+    if (!db.commit()) {
+        qWarning() << "Rollup rebuild commit failed:" << db.lastError().text();
+    }
+    if (inPartition) {
+        LogPartitions::detach(db, REBUILD_SCHEMA);
+    }
+    // A step that only moves on to the next partition isn't the last
+    return finished ? rows : qMax(rows, 1);
+}
+
+void Rollups::clear()
+{
+    for (int r = Second; r < ResolutionCount; ++r) {
+        m_open[r].clear();
+        m_newest[r].clear();
+    }
+    m_dirty = 0;
+}
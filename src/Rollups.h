@@ -0,0 +1,89 @@
+#ifndef ROLLUPS_H
+#define ROLLUPS_H
+
+#include <QHash>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include "LatencySketch.h"
+
+// Per-target aggregates of ping_log in 1 s, 1 min and 1 h buckets, in the
+// tables rollup_1s, rollup_1m and rollup_1h keyed by (target_id, bucket),
+// the bucket's start in ms. Charts over long ranges read these instead of
+// every raw row.
+//
+// DatabaseThread keeps them up to date as it writes: the last few buckets
+// of every target stay in memory and are written whole, so a bucket is
+// never read back while its target is active. After a schema change they
+// are rebuilt from ping_log, one target-hour at a time, by rebuildStep():
+// first the rows kept in pinglog.db, then those of every partition.
+class Rollups
+{
+public:
+    enum Resolution { Raw = -1, Second, Minute, Hour, ResolutionCount };
+
+    struct Bucket {
+        qint64 count = 0;       // Probes, answered or not
+        qint64 loss = 0;        // Of those, unanswered
+        qint64 minNs = 0;       // Over the answered ones
+        qint64 maxNs = 0;
+        qint64 sumNs = 0;
+        double sumSqNs = 0;     // ns², too large for an integer
+        LatencySketch sketch;
+
+        void add(qint64 rttNs);
+        void merge(const Bucket &other);
+        qint64 replies() const { return count - loss; }
+        double meanNs() const;
+        double stddevNs() const;
+    };
+
+    static qint64 widthMs(Resolution resolution);
+    static QString tableName(Resolution resolution);
+    // The coarsest resolution that still has a bucket for every pixel of a
+    // rangeMs wide chart; Raw if even seconds are too coarse.
+    static Resolution pick(qint64 rangeMs, int pixels);
+
+    // Bucket columns for a SELECT, in the order bucketAt() reads them.
+    static const char *const Columns;
+    static Bucket bucketAt(const QSqlQuery &query, int firstColumn);
+
+    static void createTables(QSqlDatabase &db);
+    // Has rebuildStep() recompute every rollup from ping_log.
+    static void scheduleRebuild(QSqlDatabase &db);
+    static bool isRebuilding(const QSqlDatabase &db);
+
+    // Writer side, for DatabaseThread. All of it runs inside whatever
+    // transaction is open.
+
+    // Call once the raw row is in ping_log.
+    void add(QSqlDatabase &db, qint64 targetId, qint64 startTime, qint64 rttNs);
+    bool hasDirty() const { return m_dirty > 0; }
+    // Writes every changed bucket and drops those too old to change again.
+    void write(QSqlDatabase &db);
+    // Recomputes at least maxRows raw rows' worth of rollups, a whole
+    // target-hour at a time, reading the partitions in partitionDirectory
+    // after ping_log. Attaches the partition it reads and commits its own
+    // transaction, so call it with none open. Returns the rows read; 0 once
+    // done.
+    int rebuildStep(QSqlDatabase &db, const QString &partitionDirectory, int maxRows);
+    void clear();
+
+private:
+    struct Open {
+        Bucket bucket;
+        bool dirty = false;
+    };
+    typedef QPair<qint64, qint64> Key;  // Target, bucket start
+
+    static bool load(const QSqlDatabase &db, Resolution resolution, qint64 targetId, qint64 start, Bucket *bucket);
+    // Recomputes one target's buckets within [hour, hour + 1 h) from
+    // ping_log and, with partition, the attached partition as well.
+    int rebuildHour(QSqlDatabase &db, qint64 targetId, qint64 hour, bool partition);
+
+    QHash<Key, Open> m_open[ResolutionCount];
+    QHash<qint64, qint64> m_newest[ResolutionCount];  // Latest bucket by target
+    int m_dirty = 0;
+};
+
+#endif // ROLLUPS_H
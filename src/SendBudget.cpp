@@ -0,0 +1,188 @@
+#include "SendBudget.h"
+#include <QHostAddress>
+#include <QSettings>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const qint64 NS_PER_SEC = 1000000000;
+const double DEFAULT_BURST_SECONDS = 0.01; // Burst allowance when none is given
+
+} // namespace
+
+void SendBudget::Bucket::configure(double ratePps, double burst, qint64 nowNs)
+{
+    tatNs = nowNs;
+    if (ratePps <= 0) {
+        intervalNs = 0;
+        toleranceNs = 0;
+        return;
+    }
+    intervalNs = qMax<qint64>(1, qint64(NS_PER_SEC / ratePps));
+    double tokens = burst > 0 ? burst : ratePps * DEFAULT_BURST_SECONDS;
+    toleranceNs = qint64((qMax(1.0, tokens) - 1.0) * intervalNs);
+}
+
+qint64 SendBudget::Bucket::take(qint64 nowNs)
+{
+    if (intervalNs == 0) return nowNs;
+
+    // The bucket is full once the theoretical arrival time falls behind
+    // now; up to toleranceNs of booking ahead is the burst allowance.
+    qint64 tat = qMax(tatNs, nowNs);
+    qint64 at = qMax(nowNs, tat - toleranceNs);
+    tatNs = tat + intervalNs;
+    return at;
+}
+
+bool SendBudget::SubnetBucket::contains(const ProbeAddress &addr) const
+{
+    int whole = prefixLength / 8;
+    if (memcmp(addr.bytes, network.bytes, whole) != 0) return false;
+    int bits = prefixLength % 8;
+    if (bits == 0) return true;
+    quint8 mask = quint8(0xff << (8 - bits));
+    return (addr.bytes[whole] & mask) == network.bytes[whole];
+}
+
+SendBudget::SendBudget()
+    : m_globalPps(0)
+    , m_globalBurst(0)
+    , m_granted(0)
+    , m_deferred(0)
+    , m_totalDelayNs(0)
+{
+    m_clock.start();
+}
+
+void SendBudget::setGlobalRate(double ratePps)
+{
+    QMutexLocker locker(&m_mutex);
+    m_globalPps = qMax(0.0, ratePps);
+    m_global.configure(m_globalPps, m_globalBurst, m_clock.nsecsElapsed());
+}
+
+void SendBudget::setGlobalBurst(double burst)
+{
+    QMutexLocker locker(&m_mutex);
+    m_globalBurst = qMax(0.0, burst);
+    m_global.configure(m_globalPps, m_globalBurst, m_clock.nsecsElapsed());
+}
+
+double SendBudget::globalRate() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_globalPps;
+}
+
+bool SendBudget::setSubnetLimits(const QStringList &limits)
+{
+    bool allValid = true;
+    QVector<SubnetBucket> subnets;
+    qint64 now;
+    {
+        QMutexLocker locker(&m_mutex);
+        now = m_clock.nsecsElapsed();
+    }
+
+    for (const QString &entry : limits) {
+        int eq = entry.indexOf('=');
+        QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(entry.left(eq).trimmed());
+        QStringList rate = entry.mid(eq + 1).split('/');
+        bool rateOk = false;
+        bool burstOk = true;
+        double pps = rate.value(0).toDouble(&rateOk);
+        double burst = rate.size() > 1 ? rate.value(1).toDouble(&burstOk) : 0;
+
+        if (eq < 0 || subnet.first.isNull() || !rateOk || !burstOk || pps <= 0) {
+            qWarning() << "SendBudget: ignoring subnet limit" << entry;
+            allValid = false;
+            continue;
+        }
+
+        SubnetBucket s;
+        bool v4 = (subnet.first.protocol() == QAbstractSocket::IPv4Protocol);
+        s.prefixLength = subnet.second + (v4 ? 96 : 0);
+        s.network = ProbeAddress::fromHostAddress(subnet.first);
+        // Clear the host bits so contains() can compare bytes directly.
+        for (int bit = s.prefixLength; bit < 128; ++bit) {
+            s.network.bytes[bit / 8] &= quint8(~(0x80 >> (bit % 8)));
+        }
+        s.bucket.configure(pps, burst, now);
+        subnets.append(s);
+    }
+
+    std::stable_sort(subnets.begin(), subnets.end(), [](const SubnetBucket &a, const SubnetBucket &b) {
+        return a.prefixLength > b.prefixLength;
+    });
+
+    QMutexLocker locker(&m_mutex);
+    m_subnets = subnets;
+    return allValid;
+}
+
+void SendBudget::configureFromSettings()
+{
+    QSettings settings("MyCompany", "PingTool");
+    settings.beginGroup("rateLimit");
+    setGlobalBurst(settings.value("burst", 0).toDouble());
+    setGlobalRate(settings.value("globalPps", 0).toDouble());
+    setSubnetLimits(settings.value("subnets").toStringList());
+    settings.endGroup();
+}
+
+qint64 SendBudget::reserve(const ProbeAddress &addr)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 now = m_clock.nsecsElapsed();
+    qint64 at = m_global.take(now);
+
+    if (!addr.isNull() && !m_subnets.isEmpty()) {
+        for (SubnetBucket &s : m_subnets) {
+            if (s.contains(addr)) {
+                // The global token booked above may go unused for a while;
+                // that only makes the global limit stricter.
+                at = qMax(at, s.bucket.take(now));
+                break;
+            }
+        }
+    }
+
+    qint64 waitNs = at - now;
+    m_granted++;
+    if (waitNs > 0) {
+        m_deferred++;
+        m_totalDelayNs += waitNs;
+    }
+    m_sendsBySecond[at / NS_PER_SEC]++;
+    return waitNs;
+}
+
+SendBudget::Stats SendBudget::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 now = m_clock.nsecsElapsed();
+    qint64 lastSecond = now / NS_PER_SEC - 1;
+
+    // Bookings are only ever made for now or later, so anything older than
+    // the last full second is done with.
+    auto it = m_sendsBySecond.begin();
+    while (it != m_sendsBySecond.end()) {
+        if (it.key() < lastSecond) {
+            it = m_sendsBySecond.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    Stats s;
+    s.configuredPps = m_globalPps;
+    s.actualPps = m_sendsBySecond.value(lastSecond);
+    s.granted = m_granted;
+    s.deferred = m_deferred;
+    s.avgDelayMs = m_deferred ? m_totalDelayNs / 1e6 / m_deferred : 0.0;
+    s.backlogMs = m_global.intervalNs ? qMax<qint64>(0, m_global.tatNs - now) / 1e6 : 0.0;
+    s.subnetLimits = m_subnets.size();
+    return s;
+}
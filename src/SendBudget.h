@@ -0,0 +1,87 @@
+#ifndef SENDBUDGET_H
+#define SENDBUDGET_H
+
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <QElapsedTimer>
+#include "ProbeAddress.h"
+
+// Global packets-per-second budget shared by every target of a backend,
+// with optional tighter limits for individual subnets.
+// Each limit is a token bucket kept in virtual-scheduling (GCRA) form: a
+// probe asks for a token and is told how long to wait for it. Tokens are
+// handed out strictly in request order, so when demand exceeds the budget
+// every target is delayed by about the same amount and nothing is dropped.
+// Backends hold the probe for the returned delay and then send it without
+// asking again.
+class SendBudget
+{
+public:
+    struct Stats {
+        double configuredPps = 0.0; // 0 = unlimited
+        double actualPps = 0.0;     // Sends booked for the last full second
+        quint64 granted = 0;
+        quint64 deferred = 0;       // Probes that had to wait for a token
+        double avgDelayMs = 0.0;    // Mean wait of deferred probes
+        double backlogMs = 0.0;     // How far ahead the global budget is booked
+        int subnetLimits = 0;
+    };
+
+    SendBudget();
+
+    // ratePps <= 0 removes the limit.
+    void setGlobalRate(double ratePps);
+    double globalRate() const;
+    // Probes that may go out back-to-back after an idle period (at least 1);
+    // 0, the default, allows 10 ms worth of the rate.
+    void setGlobalBurst(double burst);
+
+    // Entries like "10.0.0.0/8=500", "192.168.1.0/24=50/5" (pps[/burst]) or
+    // "2001:db8::/32=200".
+    // The longest matching prefix applies, on top of the global limit.
+    // Returns false if any entry was malformed; the valid ones still apply.
+    bool setSubnetLimits(const QStringList &limits);
+
+    // Reads the "rateLimit" group of the application settings.
+    void configureFromSettings();
+
+    // Thread-safe. Books a token for one probe to addr (null if unknown) and
+    // returns how many ns to wait before sending.
+    qint64 reserve(const ProbeAddress &addr);
+
+    Stats stats() const;
+
+private:
+    struct Bucket {
+        qint64 intervalNs = 0;      // 1 / rate; 0 = unlimited
+        qint64 toleranceNs = 0;     // (burst - 1) * interval
+        qint64 tatNs = 0;           // Theoretical arrival time of the next token
+
+        void configure(double ratePps, double burst, qint64 nowNs);
+        qint64 take(qint64 nowNs);  // Returns the earliest send time
+    };
+
+    struct SubnetBucket {
+        ProbeAddress network;       // IPv4 subnets in mapped form
+        int prefixLength = 0;       // Of the 128-bit address
+        Bucket bucket;
+
+        bool contains(const ProbeAddress &addr) const;
+    };
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    double m_globalPps;
+    double m_globalBurst;
+    Bucket m_global;
+    QVector<SubnetBucket> m_subnets; // Longest prefix first
+
+    quint64 m_granted;
+    quint64 m_deferred;
+    qint64 m_totalDelayNs;
+    mutable QHash<qint64, int> m_sendsBySecond; // Booked send time (s) -> probes, pruned by stats()
+};
+
+#endif // SENDBUDGET_H
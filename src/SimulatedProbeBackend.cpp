@@ -0,0 +1,414 @@
+#include "SimulatedProbeBackend.h"
+#include "SendBudget.h"
+#include "ResultRing.h"
+#include <QDateTime>
+#include <QSettings>
+#include <QDebug>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int MAX_WAIT_MS = 1000;
+const int STATS_INTERVAL_MS = 1000;
+const int LAG_WARN_MS = 50;
+const double PI = 3.14159265358979323846;
+
+// FNV-1a over the UTF-16 code units; qHash is not stable across builds.
+quint64 hashName(const QString &name)
+{
+    quint64 h = 1469598103934665603ULL;
+    for (QChar c : name) {
+        h ^= c.unicode();
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+} // namespace
+
+SimulatedProbeBackend::Config SimulatedProbeBackend::Config::fromSettings()
+{
+    Config c;
+    QSettings settings("MyCompany", "PingTool");
+    settings.beginGroup("simulation");
+    c.seed = settings.value("seed", c.seed).toULongLong();
+    c.lossRate = settings.value("lossRate", c.lossRate).toDouble();
+    c.burstEnterRate = settings.value("burstEnterRate", c.burstEnterRate).toDouble();
+    c.burstExitRate = settings.value("burstExitRate", c.burstExitRate).toDouble();
+    c.burstLossRate = settings.value("burstLossRate", c.burstLossRate).toDouble();
+    c.outagesPerHour = settings.value("outagesPerHour", c.outagesPerHour).toDouble();
+    c.outageMinMs = settings.value("outageMinMs", c.outageMinMs).toInt();
+    c.outageMaxMs = settings.value("outageMaxMs", c.outageMaxMs).toInt();
+    c.spikeRate = settings.value("spikeRate", c.spikeRate).toDouble();
+    settings.endGroup();
+    return c;
+}
+
+SimulatedProbeBackend::SimulatedProbeBackend(const Config &config, QObject *parent)
+    : ProbeBackend(parent)
+    , m_config(config)
+    , m_budget(nullptr)
+    , m_ring(nullptr)
+    , m_thread(nullptr)
+    , m_running(false)
+    , m_throughputMode(false)
+    , m_epochOffsetMs(0)
+    , m_lastStatsMs(0)
+    , m_lastStatsSent(0)
+    , m_sent(0)
+    , m_received(0)
+{
+}
+
+SimulatedProbeBackend::~SimulatedProbeBackend()
+{
+    shutdown();
+}
+
+void SimulatedProbeBackend::start()
+{
+    if (m_thread) return;
+    m_running = true;
+    m_thread = QThread::create([this] { run(); });
+    m_thread->start();
+}
+
+void SimulatedProbeBackend::shutdown()
+{
+    if (!m_thread) return;
+    m_running = false;
+    wake();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+void SimulatedProbeBackend::wake()
+{
+    QMutexLocker locker(&m_cmdMutex);
+    m_cmdCond.wakeOne();
+}
+
+void SimulatedProbeBackend::addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy)
+{
+    QMutexLocker locker(&m_cmdMutex);
+    m_commands.append({Command::Add, id, target, timeoutMs, policy.normalized()});
+    m_cmdCond.wakeOne();
+}
+
+void SimulatedProbeBackend::removeTarget(quint32 id)
+{
+    QMutexLocker locker(&m_cmdMutex);
+    m_commands.append({Command::Remove, id, QString(), 0, ProbePolicy()});
+    m_cmdCond.wakeOne();
+}
+
+void SimulatedProbeBackend::removeAll()
+{
+    QMutexLocker locker(&m_cmdMutex);
+    m_commands.append({Command::RemoveAll, 0, QString(), 0, ProbePolicy()});
+    m_cmdCond.wakeOne();
+}
+
+void SimulatedProbeBackend::setPolicy(quint32 id, const ProbePolicy &policy)
+{
+    QMutexLocker locker(&m_cmdMutex);
+    m_commands.append({Command::SetPolicy, id, QString(), 0, policy.normalized()});
+    m_cmdCond.wakeOne();
+}
+
+void SimulatedProbeBackend::setThroughputMode(bool enabled)
+{
+    m_throughputMode = enabled;
+}
+
+ProbeBackend::Stats SimulatedProbeBackend::stats() const
+{
+    QMutexLocker locker(&m_statsMutex);
+    return m_stats;
+}
+
+void SimulatedProbeBackend::run()
+{
+    m_clock.start();
+    m_wheel.reset(0);
+    m_epochOffsetMs = QDateTime::currentMSecsSinceEpoch() - m_clock.elapsed();
+    m_lastStatsMs = 0;
+
+    while (m_running) {
+        processCommands();
+
+        qint64 now = m_clock.elapsed();
+        m_wheel.advance(now, [this, now](int id) {
+            int slot = id / 2;
+            if (id == doneTimer(slot)) {
+                finishProbe(slot, now);
+            } else {
+                sendProbe(slot, now);
+            }
+        });
+        publishStats(now);
+
+        qint64 next = m_wheel.nextWakeup();
+        qint64 waitMs = (next < 0) ? MAX_WAIT_MS : qBound<qint64>(0, next - m_clock.elapsed(), MAX_WAIT_MS);
+        if (waitMs > 0) {
+            QMutexLocker locker(&m_cmdMutex);
+            if (m_commands.isEmpty() && m_running) {
+                m_cmdCond.wait(&m_cmdMutex, static_cast<unsigned long>(waitMs));
+            }
+        }
+    }
+}
+
+void SimulatedProbeBackend::processCommands()
+{
+    QList<Command> commands;
+    {
+        QMutexLocker locker(&m_cmdMutex);
+        commands.swap(m_commands);
+    }
+
+    for (const Command &cmd : commands) {
+        switch (cmd.type) {
+        case Command::Add:
+            if (slotOf(cmd.id) < 0) {
+                addSlot(cmd.id, cmd.target, cmd.timeoutMs, cmd.policy);
+            }
+            break;
+        case Command::SetPolicy:
+            if (slotOf(cmd.id) >= 0) {
+                applyPolicy(slotOf(cmd.id), cmd.policy);
+            }
+            break;
+        case Command::Remove:
+            if (slotOf(cmd.id) >= 0) {
+                removeSlot(slotOf(cmd.id));
+                m_slotById[int(cmd.id)] = -1;
+            }
+            break;
+        case Command::RemoveAll:
+            for (int slot : m_slotById) {
+                if (slot >= 0) {
+                    removeSlot(slot);
+                }
+            }
+            m_slotById.fill(-1);
+            break;
+        }
+    }
+}
+
+void SimulatedProbeBackend::addSlot(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy)
+{
+    int slot;
+    if (!m_freeSlots.isEmpty()) {
+        slot = m_freeSlots.takeLast();
+    } else {
+        slot = m_targets.size();
+        m_targets.append(Target());
+    }
+
+    Target &t = m_targets[slot];
+    t = Target();
+    t.id = id;
+    t.timeoutMs = timeoutMs;
+    t.active = true;
+    t.rng = m_config.seed ^ hashName(target);
+    t.scheduleRng = ~t.rng;
+    t.policy = policy;
+
+    // Median RTT log-uniform between 0.3 ms (LAN) and 200 ms (far away)
+    t.medianRttMs = 0.3 * std::pow(200.0 / 0.3, uniform(t.rng));
+    t.sigma = 0.05 + 0.45 * uniform(t.rng);
+    static const int initialTtls[] = { 64, 128, 255 };
+    int hops = 1 + static_cast<int>(uniform(t.rng) * 24);
+    t.ttl = initialTtls[nextRandom(t.rng) % 3] - hops;
+    scheduleOutage(t);
+
+    // Virtual time starts at 0; the first probe goes out at its phase.
+    t.virtualMs = t.schedule.start(policy, 0, scheduleRandom(t));
+    m_wheel.schedule(sendTimer(slot), m_clock.elapsed() + t.virtualMs);
+    if (id >= quint32(m_slotById.size())) {
+        m_slotById.resize(int(id) + 1, -1);
+    }
+    m_slotById[int(id)] = slot;
+}
+
+void SimulatedProbeBackend::applyPolicy(int slot, const ProbePolicy &policy)
+{
+    Target &t = m_targets[slot];
+    if (t.policy == policy) return;
+    t.policy = policy;
+
+    qint64 pending = m_wheel.expiry(sendTimer(slot));
+    if (pending < 0 || t.tokenHeld) {
+        // In flight or waiting for a send token; finishProbe() schedules
+        // with the new policy.
+        t.schedule.sentInBurst = 0;
+        return;
+    }
+
+    // Restart with a fresh phase from now, moving the virtual clock along
+    // with the real send time.
+    qint64 next = m_clock.elapsed() + t.schedule.start(policy, 0, scheduleRandom(t));
+    t.virtualMs += next - pending;
+    t.schedule.burstStartMs = t.virtualMs;
+    m_wheel.schedule(sendTimer(slot), next);
+}
+
+void SimulatedProbeBackend::removeSlot(int slot)
+{
+    Target &t = m_targets[slot];
+    t.active = false;
+    m_wheel.cancel(sendTimer(slot));
+    m_wheel.cancel(doneTimer(slot));
+    m_freeSlots.append(slot);
+}
+
+void SimulatedProbeBackend::sendProbe(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    if (m_budget && !t.tokenHeld) {
+        qint64 waitNs = m_budget->reserve(ProbeAddress());
+        if (waitNs >= 1000000) {
+            t.tokenHeld = true;
+            m_wheel.schedule(sendTimer(slot), now + (waitNs + 999999) / 1000000);
+            return;
+        }
+    }
+    t.tokenHeld = false;
+
+    t.seq++;
+    t.sentMs = now;
+    t.rttNs = simulateRtt(t);
+    m_sent++;
+
+    qint64 waitNs = (t.rttNs >= 0) ? t.rttNs : qint64(t.timeoutMs) * 1000000;
+    m_wheel.schedule(doneTimer(slot), now + (waitNs + 999999) / 1000000);
+}
+
+void SimulatedProbeBackend::finishProbe(int slot, qint64 now)
+{
+    Target &t = m_targets[slot];
+    qint64 startTime = t.sentMs + m_epochOffsetMs;
+    qint64 returnTime = (t.rttNs >= 0) ? startTime + t.rttNs / 1000000 : startTime + t.timeoutMs;
+    if (t.rttNs >= 0) {
+        m_received++;
+    }
+    if (m_ring) {
+        ProbeResult result;
+        result.targetId = t.id;
+        result.ttl = t.rttNs >= 0 ? t.ttl : 0;
+        result.seq = t.seq;
+        result.timeoutMs = int(t.timeoutMs);
+        result.rttNs = t.rttNs;
+        result.startTime = startTime;
+        result.returnTime = returnTime;
+        m_ring->push(result);
+    }
+
+    // Schedule in virtual time so the sequence doesn't depend on timer lag.
+    qint64 elapsedMs = (t.rttNs >= 0) ? (t.rttNs + 999999) / 1000000 : qint64(t.timeoutMs);
+    qint64 virtualDone = t.virtualMs + elapsedMs;
+    qint64 virtualNext = m_throughputMode ? virtualDone : t.schedule.next(t.policy, virtualDone, scheduleRandom(t));
+    m_wheel.schedule(sendTimer(slot), qMax(now, t.sentMs + (virtualNext - t.virtualMs)));
+    t.virtualMs = virtualNext;
+}
+
+qint64 SimulatedProbeBackend::simulateRtt(Target &t)
+{
+    // Fixed number of draws per probe keeps the stream aligned with seq.
+    double uLoss = uniform(t.rng);
+    double uBurst = uniform(t.rng);
+    double u1 = uniform(t.rng);
+    double u2 = uniform(t.rng);
+    double uSpike = uniform(t.rng);
+
+    qint64 virtualNow = t.virtualMs;
+    bool inOutage = false;
+    if (virtualNow >= t.outageEndMs) {
+        scheduleOutage(t);
+    }
+    if (virtualNow >= t.outageStartMs && virtualNow < t.outageEndMs) {
+        inOutage = true;
+    }
+
+    // Gilbert-Elliott: two-state Markov chain for bursty loss
+    t.inBurst = t.inBurst ? (uBurst >= m_config.burstExitRate) : (uBurst < m_config.burstEnterRate);
+    double loss = t.inBurst ? m_config.burstLossRate : m_config.lossRate;
+
+    qint64 rttNs = -1;
+    if (!inOutage && uLoss >= loss) {
+        // Box-Muller, u1 in (0, 1]
+        double z = std::sqrt(-2.0 * std::log(1.0 - u1)) * std::cos(2.0 * PI * u2);
+        double rttMs = t.medianRttMs * std::exp(t.sigma * z);
+        if (uSpike < m_config.spikeRate) {
+            rttMs *= 3.0 + 7.0 * (uSpike / m_config.spikeRate);
+        }
+        if (rttMs < t.timeoutMs) {
+            rttNs = qMax<qint64>(1000, static_cast<qint64>(rttMs * 1000000.0));
+        }
+    }
+
+    return rttNs;
+}
+
+void SimulatedProbeBackend::scheduleOutage(Target &t)
+{
+    if (m_config.outagesPerHour <= 0 || m_config.outageMaxMs <= 0) {
+        t.outageStartMs = t.outageEndMs = std::numeric_limits<qint64>::max();
+        return;
+    }
+    // Exponential gap to the next outage, uniform duration
+    double meanGapMs = 3600000.0 / m_config.outagesPerHour;
+    qint64 gap = static_cast<qint64>(-meanGapMs * std::log(1.0 - uniform(t.rng)));
+    qint64 duration = m_config.outageMinMs
+                      + static_cast<qint64>(uniform(t.rng) * qMax(0, m_config.outageMaxMs - m_config.outageMinMs));
+    t.outageStartMs = qMax(t.virtualMs, t.outageEndMs) + gap;
+    t.outageEndMs = t.outageStartMs + duration;
+}
+
+void SimulatedProbeBackend::publishStats(qint64 now)
+{
+    qint64 elapsed = now - m_lastStatsMs;
+    if (elapsed < STATS_INTERVAL_MS) return;
+    m_lastStatsMs = now;
+
+    const TimingWheel::Stats &ws = m_wheel.stats();
+    qint64 maxLag = ws.maxLagMs;
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_stats.probesSent = m_sent;
+        m_stats.repliesReceived = m_received;
+        m_stats.probesPerSec = (m_sent - m_lastStatsSent) * 1000.0 / elapsed;
+        m_stats.avgTimerLagMs = ws.avgLagMs();
+        m_stats.maxTimerLagMs = ws.maxLagMs;
+    }
+    m_lastStatsSent = m_sent;
+    m_wheel.resetStats();
+
+    if (maxLag > LAG_WARN_MS) {
+        qWarning() << "SimulatedProbeBackend: timers firing up to" << maxLag << "ms late, consumer too slow";
+    }
+}
+
+quint64 SimulatedProbeBackend::nextRandom(quint64 &state)
+{
+    // splitmix64: tiny state, fully specified output on every platform
+    quint64 z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+quint32 SimulatedProbeBackend::scheduleRandom(Target &t)
+{
+    return static_cast<quint32>(nextRandom(t.scheduleRng) >> 32);
+}
+
+double SimulatedProbeBackend::uniform(quint64 &state)
+{
+    // [0, 1) with 53 bits of precision
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
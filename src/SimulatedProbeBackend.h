@@ -0,0 +1,139 @@
+#ifndef SIMULATEDPROBEBACKEND_H
+#define SIMULATEDPROBEBACKEND_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QList>
+#include <QVector>
+#include <atomic>
+#include "ProbeBackend.h"
+#include "TimingWheel.h"
+
+// Network-free backend for load testing.
+// Every target gets a latency profile (lognormal RTT around a per-target
+// median, occasional spikes), Gilbert-Elliott loss bursts and outages, all
+// drawn from a generator seeded by Config::seed and the target name. The
+// result sequence of a target therefore only depends on the seed and its
+// name (and its ProbePolicy), never on timing or on the other targets.
+// Results are paced in real time like the socket backend, on a single
+// thread driven by a TimingWheel, so tens of thousands of targets per
+// second are cheap to produce.
+class SimulatedProbeBackend : public ProbeBackend
+{
+    Q_OBJECT
+public:
+    struct Config {
+        quint64 seed = 1;
+        double lossRate = 0.001;      // Outside of bursts
+        double burstEnterRate = 0.002; // Per probe
+        double burstExitRate = 0.25;  // Per probe, mean burst length 1/x
+        double burstLossRate = 0.8;
+        double outagesPerHour = 0.2;  // Per target
+        int outageMinMs = 5000;
+        int outageMaxMs = 60000;
+        double spikeRate = 0.005;     // RTT spike of 3-10x the median
+
+        // Reads the "simulation" group of the application settings.
+        static Config fromSettings();
+    };
+
+    explicit SimulatedProbeBackend(const Config &config, QObject *parent = nullptr);
+    ~SimulatedProbeBackend();
+
+    QString name() const override { return "simulated"; }
+    void start() override;
+    void shutdown() override;
+
+    void addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy) override;
+    void removeTarget(quint32 id) override;
+    void removeAll() override;
+    void setPolicy(quint32 id, const ProbePolicy &policy) override;
+    void setThroughputMode(bool enabled) override;
+    void setSendBudget(SendBudget *budget) override { m_budget = budget; }
+    void setResultRing(ResultRing *ring) override { m_ring = ring; }
+
+    Stats stats() const override;
+
+private:
+    struct Command {
+        enum Type { Add, Remove, RemoveAll, SetPolicy };
+        Type type;
+        quint32 id;
+        QString target;            // Add
+        uint32_t timeoutMs;
+        ProbePolicy policy;
+    };
+
+    struct Target {
+        quint32 id = 0;            // TargetRegistry id
+        uint32_t timeoutMs = 1000;
+        bool active = false;
+        bool tokenHeld = false;    // Send budget token booked, waiting for its time
+        int seq = 0;
+        quint64 rng = 0;           // splitmix64 state
+        quint64 scheduleRng = 0;   // Separate stream for phase and jitter
+        ProbePolicy policy;
+        ProbeSchedule schedule;    // Runs in virtual time
+        // Profile, fixed at add time
+        double medianRttMs = 10.0;
+        double sigma = 0.2;
+        int ttl = 64;
+        // Per-probe state
+        bool inBurst = false;
+        qint64 virtualMs = 0;      // Nominal time along this target's own schedule
+        qint64 outageStartMs = 0;  // In virtual time
+        qint64 outageEndMs = 0;
+        qint64 sentMs = 0;         // Backend clock
+        qint64 rttNs = -1;         // Outcome of the probe in flight
+    };
+
+    void run();
+    void wake();
+    void processCommands();
+    void addSlot(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy);
+    int slotOf(quint32 id) const { return id < quint32(m_slotById.size()) ? m_slotById.at(int(id)) : -1; }
+    void applyPolicy(int slot, const ProbePolicy &policy);
+    void removeSlot(int slot);
+    void sendProbe(int slot, qint64 now);
+    void finishProbe(int slot, qint64 now);
+    qint64 simulateRtt(Target &t);
+    void scheduleOutage(Target &t);
+    void publishStats(qint64 now);
+
+    static quint64 nextRandom(quint64 &state);
+    static double uniform(quint64 &state);
+    static quint32 scheduleRandom(Target &t);
+
+    static int sendTimer(int slot) { return slot * 2; }
+    static int doneTimer(int slot) { return slot * 2 + 1; }
+
+    const Config m_config;
+    SendBudget *m_budget;
+    ResultRing *m_ring;
+    QThread *m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_throughputMode;
+
+    QMutex m_cmdMutex;
+    QWaitCondition m_cmdCond;
+    QList<Command> m_commands;
+
+    mutable QMutex m_statsMutex;
+    Stats m_stats;
+
+    // Backend-thread state
+    QElapsedTimer m_clock;
+    TimingWheel m_wheel;
+    qint64 m_epochOffsetMs;
+    qint64 m_lastStatsMs;
+    quint64 m_lastStatsSent;
+    QVector<Target> m_targets;
+    QVector<int> m_freeSlots;
+    QVector<int> m_slotById;       // By target id, -1 if not added
+    quint64 m_sent;
+    quint64 m_received;
+};
+
+#endif // SIMULATEDPROBEBACKEND_H
@@ -0,0 +1,67 @@
+#include "SocketProbeBackend.h"
+
+SocketProbeBackend::SocketProbeBackend(QObject *parent)
+    : ProbeBackend(parent)
+    , m_engine(new IcmpEngine(this))
+{
+}
+
+SocketProbeBackend::~SocketProbeBackend()
+{
+    shutdown();
+}
+
+void SocketProbeBackend::setResolver(DnsResolver *resolver)
+{
+    m_engine->setResolver(resolver);
+}
+
+void SocketProbeBackend::start()
+{
+    m_engine->start();
+}
+
+void SocketProbeBackend::shutdown()
+{
+    m_engine->stop();
+    m_engine->wait();
+}
+
+void SocketProbeBackend::addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy)
+{
+    m_engine->addTarget(id, target, timeoutMs, policy);
+}
+
+void SocketProbeBackend::removeTarget(quint32 id)
+{
+    m_engine->removeTarget(id);
+}
+
+void SocketProbeBackend::removeAll()
+{
+    m_engine->removeAll();
+}
+
+void SocketProbeBackend::setPolicy(quint32 id, const ProbePolicy &policy)
+{
+    m_engine->setPolicy(id, policy);
+}
+
+void SocketProbeBackend::setThroughputMode(bool enabled)
+{
+    m_engine->setThroughputMode(enabled);
+}
+
+ProbeBackend::Stats SocketProbeBackend::stats() const
+{
+    IcmpEngine::Stats s = m_engine->stats();
+    Stats stats;
+    stats.probesSent = s.probesSent;
+    stats.repliesReceived = s.repliesReceived;
+    stats.probesPerSec = s.probesPerSec;
+    stats.avgSendBatch = s.avgSendBatch();
+    stats.avgRecvBatch = s.avgRecvBatch();
+    stats.avgTimerLagMs = s.avgTimerLagMs;
+    stats.maxTimerLagMs = s.maxTimerLagMs;
+    return stats;
+}
@@ -0,0 +1,34 @@
+#ifndef SOCKETPROBEBACKEND_H
+#define SOCKETPROBEBACKEND_H
+
+#include "ProbeBackend.h"
+#include "IcmpEngine.h"
+
+// Linux backend: every target is driven by one IcmpEngine thread.
+class SocketProbeBackend : public ProbeBackend
+{
+    Q_OBJECT
+public:
+    explicit SocketProbeBackend(QObject *parent = nullptr);
+    ~SocketProbeBackend();
+
+    QString name() const override { return "socket"; }
+    void setResolver(DnsResolver *resolver) override;
+    void setSendBudget(SendBudget *budget) override { m_engine->setSendBudget(budget); }
+    void setResultRing(ResultRing *ring) override { m_engine->setResultRing(ring); }
+    void start() override;
+    void shutdown() override;
+
+    void addTarget(quint32 id, const QString &target, uint32_t timeoutMs, const ProbePolicy &policy) override;
+    void removeTarget(quint32 id) override;
+    void removeAll() override;
+    void setPolicy(quint32 id, const ProbePolicy &policy) override;
+    void setThroughputMode(bool enabled) override;
+
+    Stats stats() const override;
+
+private:
+    IcmpEngine *m_engine;
+};
+
+#endif // SOCKETPROBEBACKEND_H
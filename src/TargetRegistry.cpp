@@ -0,0 +1,41 @@
+#include "TargetRegistry.h"
+
+quint32 TargetRegistry::intern(const QString &target)
+{
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_ids.constFind(target);
+        if (it != m_ids.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    // Someone may have added it between the two locks
+    auto it = m_ids.constFind(target);
+    if (it != m_ids.constEnd()) {
+        return it.value();
+    }
+    quint32 id = quint32(m_names.size());
+    m_ids.insert(target, id);
+    m_names.append(target);
+    return id;
+}
+
+quint32 TargetRegistry::find(const QString &target) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids.value(target, InvalidId);
+}
+
+QString TargetRegistry::name(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < quint32(m_names.size()) ? m_names.at(int(id)) : QString();
+}
+
+int TargetRegistry::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_names.size();
+}
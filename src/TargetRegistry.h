@@ -0,0 +1,34 @@
+#ifndef TARGETREGISTRY_H
+#define TARGETREGISTRY_H
+
+#include <QReadWriteLock>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Gives every target string a dense 32-bit id, once, for the lifetime of
+// the process. Backends, results, models and charts carry only the id and
+// index arrays with it; the name is looked up again only for display and
+// for the database's own target table. Ids are never reused, so one that
+// was handed out stays valid after its target is removed.
+class TargetRegistry
+{
+public:
+    enum : quint32 { InvalidId = 0xffffffffu };
+
+    // Thread-safe. Returns the existing id if target was seen before.
+    quint32 intern(const QString &target);
+    // InvalidId if target was never interned.
+    quint32 find(const QString &target) const;
+    // Empty for an unknown id.
+    QString name(quint32 id) const;
+    // Ids are 0 .. size() - 1.
+    int size() const;
+
+private:
+    mutable QReadWriteLock m_lock;
+    QHash<QString, quint32> m_ids;
+    QVector<QString> m_names;
+};
+
+#endif // TARGETREGISTRY_H
@@ -0,0 +1,193 @@
+#include "TimingWheel.h"
+#include <QtAlgorithms>
+#include <string.h>
+
+TimingWheel::TimingWheel(qint64 nowMs)
+{
+    reset(nowMs);
+}
+
+void TimingWheel::reset(qint64 nowMs)
+{
+    for (int i = 0; i <= FIRING_BUCKET; ++i) {
+        m_heads[i] = -1;
+    }
+    memset(m_occupied, 0, sizeof(m_occupied));
+    for (Node &n : m_nodes) {
+        n = Node();
+    }
+    m_current = nowMs;
+    m_firing = false;
+    m_size = 0;
+    m_stats = Stats();
+}
+
+void TimingWheel::reserve(int timerCount)
+{
+    if (timerCount > m_nodes.size()) {
+        m_nodes.resize(timerCount);
+    }
+}
+
+void TimingWheel::ensureNode(int id)
+{
+    if (id >= m_nodes.size()) {
+        m_nodes.resize(qMax(id + 1, m_nodes.size() * 2));
+    }
+}
+
+void TimingWheel::schedule(int id, qint64 expiresMs)
+{
+    ensureNode(id);
+    if (m_nodes[id].bucket >= 0) {
+        unlink(id);
+    }
+    m_nodes[id].expires = expiresMs;
+    place(id);
+}
+
+void TimingWheel::cancel(int id)
+{
+    if (id < m_nodes.size() && m_nodes[id].bucket >= 0) {
+        unlink(id);
+    }
+}
+
+bool TimingWheel::isPending(int id) const
+{
+    return id < m_nodes.size() && m_nodes[id].bucket >= 0;
+}
+
+qint64 TimingWheel::expiry(int id) const
+{
+    return isPending(id) ? m_nodes[id].expires : -1;
+}
+
+void TimingWheel::place(int id)
+{
+    Node &n = m_nodes[id];
+
+    qint64 when = qMax(n.expires, m_current);
+    if (m_firing && when <= m_current) {
+        // The current slot is being drained; don't land back in it.
+        when = m_current + 1;
+    }
+
+    qint64 delta = when - m_current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (qint64(1) << ((level + 1) * SLOT_BITS))) {
+        level++;
+    }
+    const qint64 horizon = qint64(1) << (LEVELS * SLOT_BITS);
+    if (delta >= horizon) {
+        // Park beyond-range timers in the furthest slot; they are re-placed
+        // on cascade until they come within range.
+        when = m_current + horizon - 1;
+    }
+
+    int slot = static_cast<int>((when >> (level * SLOT_BITS)) & SLOT_MASK);
+    int bucket = level * SLOTS + slot;
+
+    n.bucket = bucket;
+    n.prev = -1;
+    n.next = m_heads[bucket];
+    if (n.next >= 0) {
+        m_nodes[n.next].prev = id;
+    }
+    m_heads[bucket] = id;
+    m_occupied[level][slot / 64] |= quint64(1) << (slot % 64);
+    m_size++;
+}
+
+void TimingWheel::unlink(int id)
+{
+    Node &n = m_nodes[id];
+    int bucket = n.bucket;
+
+    if (n.prev >= 0) {
+        m_nodes[n.prev].next = n.next;
+    } else {
+        m_heads[bucket] = n.next;
+    }
+    if (n.next >= 0) {
+        m_nodes[n.next].prev = n.prev;
+    }
+
+    if (m_heads[bucket] < 0 && bucket != FIRING_BUCKET) {
+        int level = bucket / SLOTS;
+        int slot = bucket % SLOTS;
+        m_occupied[level][slot / 64] &= ~(quint64(1) << (slot % 64));
+    }
+
+    n.bucket = -1;
+    n.next = n.prev = -1;
+    m_size--;
+}
+
+void TimingWheel::moveToFiring(int bucket)
+{
+    m_heads[FIRING_BUCKET] = m_heads[bucket];
+    m_heads[bucket] = -1;
+    m_occupied[0][bucket / 64] &= ~(quint64(1) << (bucket % 64));
+    for (int id = m_heads[FIRING_BUCKET]; id >= 0; id = m_nodes[id].next) {
+        m_nodes[id].bucket = FIRING_BUCKET;
+    }
+}
+
+void TimingWheel::cascade(int level)
+{
+    if (level >= LEVELS) return;
+
+    int slot = static_cast<int>((m_current >> (level * SLOT_BITS)) & SLOT_MASK);
+    int bucket = level * SLOTS + slot;
+
+    int id = m_heads[bucket];
+    m_heads[bucket] = -1;
+    m_occupied[level][slot / 64] &= ~(quint64(1) << (slot % 64));
+
+    while (id >= 0) {
+        int next = m_nodes[id].next;
+        m_size--;
+        place(id);
+        id = next;
+    }
+
+    if (slot == 0) {
+        cascade(level + 1);
+    }
+}
+
+int TimingWheel::nextSetSlot(int level, int fromSlot) const
+{
+    for (int word = fromSlot / 64; word < WORDS; ++word) {
+        quint64 bits = m_occupied[level][word];
+        if (word == fromSlot / 64) {
+            bits &= ~quint64(0) << (fromSlot % 64);
+        }
+        if (bits) {
+            return word * 64 + qCountTrailingZeroBits(bits);
+        }
+    }
+    return -1;
+}
+
+qint64 TimingWheel::nextWakeup() const
+{
+    if (m_size == 0) return -1;
+    if ((m_current & SLOT_MASK) == 0) return m_current; // Cascade pending
+
+    qint64 base = m_current & ~qint64(SLOT_MASK);
+    int slot = nextSetSlot(0, static_cast<int>(m_current & SLOT_MASK));
+    return slot >= 0 ? base + slot : base + SLOTS;
+}
+
+void TimingWheel::recordLag(qint64 nowMs, qint64 expires)
+{
+    qint64 lag = qMax<qint64>(0, nowMs - expires);
+    m_stats.fired++;
+    m_stats.totalLagMs += lag;
+    m_stats.lastLagMs = lag;
+    if (lag > m_stats.maxLagMs) {
+        m_stats.maxLagMs = lag;
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <QtGlobal>
+#include <QVector>
+
+// Hierarchical timing wheel with 1 ms ticks.
+// Four levels of 256 slots cover ~49 days; schedule/cancel are O(1) and a
+// tick only touches one slot, so 100k outstanding timers cost nothing extra.
+// Timers are identified by small dense integers chosen by the caller
+// (e.g. target slot * 2 + kind) and stored by index, so the owner's storage
+// can be reallocated freely.
+class TimingWheel
+{
+public:
+    struct Stats {
+        quint64 fired = 0;
+        qint64 totalLagMs = 0;  // Sum of (advance time - expiry time)
+        qint64 maxLagMs = 0;
+        qint64 lastLagMs = 0;
+
+        double avgLagMs() const { return fired ? double(totalLagMs) / fired : 0.0; }
+    };
+
+    explicit TimingWheel(qint64 nowMs = 0);
+
+    void reset(qint64 nowMs);
+    void reserve(int timerCount);
+
+    // (Re)arms a timer. Expiry times in the past fire on the next advance().
+    void schedule(int id, qint64 expiresMs);
+    void cancel(int id);
+    bool isPending(int id) const;
+    qint64 expiry(int id) const;
+
+    // Fires every timer due at or before nowMs, calling onExpire(id).
+    // The callback may schedule or cancel any timer, including the one firing.
+    template <typename Callback>
+    void advance(qint64 nowMs, Callback &&onExpire);
+
+    // Earliest time at which advance() has work to do, or -1 if idle.
+    // May be earlier than the next expiry when a cascade is due.
+    qint64 nextWakeup() const;
+
+    int size() const { return m_size; }
+    const Stats &stats() const { return m_stats; }
+    void resetStats() { m_stats = Stats(); }
+
+private:
+    enum {
+        LEVELS = 4,
+        SLOT_BITS = 8,
+        SLOTS = 1 << SLOT_BITS,
+        SLOT_MASK = SLOTS - 1,
+        WORDS = SLOTS / 64,
+        FIRING_BUCKET = LEVELS * SLOTS
+    };
+
+    struct Node {
+        int next = -1;
+        int prev = -1;
+        int bucket = -1; // -1 when not pending
+        qint64 expires = 0;
+    };
+
+    void ensureNode(int id);
+    void place(int id);
+    void unlink(int id);
+    void cascade(int level);
+    void moveToFiring(int bucket);
+    int nextSetSlot(int level, int fromSlot) const;
+    void recordLag(qint64 nowMs, qint64 expires);
+
+    QVector<Node> m_nodes;
+    int m_heads[LEVELS * SLOTS + 1];
+    quint64 m_occupied[LEVELS][WORDS];
+    qint64 m_current; // Next tick to be processed
+    bool m_firing;
+    int m_size;
+    Stats m_stats;
+};
+
+template <typename Callback>
+void TimingWheel::advance(qint64 nowMs, Callback &&onExpire)
+{
+    while (m_current <= nowMs) {
+        int idx = static_cast<int>(m_current & SLOT_MASK);
+        if (idx == 0) {
+            cascade(1);
+        }
+
+        if (m_heads[idx] >= 0) {
+            // Detach the slot first so callbacks can freely re-arm or cancel
+            // timers, including ones still waiting to fire in this slot.
+            moveToFiring(idx);
+            m_firing = true;
+            int id;
+            while ((id = m_heads[FIRING_BUCKET]) >= 0) {
+                qint64 expires = m_nodes[id].expires;
+                unlink(id);
+                recordLag(nowMs, expires);
+                onExpire(id);
+            }
+            m_firing = false;
+        }
+
+        m_current++;
+
+        // Skip empty level-0 slots up to the next cascade boundary.
+        if ((m_current & SLOT_MASK) != 0) {
+            int nextSlot = nextSetSlot(0, static_cast<int>(m_current & SLOT_MASK));
+            qint64 base = m_current & ~qint64(SLOT_MASK);
+            qint64 target = nextSlot >= 0 ? base + nextSlot : base + SLOTS;
+            if (target > m_current) {
+                m_current = qMin(target, nowMs + 1);
+            }
+        }
+    }
+}
+
+#endif // TIMINGWHEEL_H
@@ -0,0 +1,38 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <QByteArray>
+
+// LEB128 varints, 7 bits a byte with the high bit set on all but the last,
+// and zigzag mapping so small negative numbers stay short too. Shared by
+// the compact encodings of LatencySketch and ColumnStore.
+class Varint
+{
+public:
+    static void put(QByteArray &out, quint64 value)
+    {
+        while (value >= 0x80) {
+            out.append(char(value | 0x80));
+            value >>= 7;
+        }
+        out.append(char(value));
+    }
+
+    // Reads one varint from data[pos, size) and advances pos; false if it
+    // runs off the end.
+    static bool get(const uchar *data, qint64 size, qint64 &pos, quint64 &value)
+    {
+        value = 0;
+        for (int shift = 0; pos < size && shift < 64; shift += 7) {
+            uchar byte = data[pos++];
+            value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    static quint64 zigzag(qint64 value) { return (quint64(value) << 1) ^ quint64(value >> 63); }
+    static qint64 unzigzag(quint64 value) { return qint64(value >> 1) ^ -qint64(value & 1); }
+};
+
+#endif // VARINT_H